@@ -80,6 +80,30 @@ else
         DYNAMIC_PARTITION_SUPPORT := DYNAMIC_PARTITION_SUPPORT=0
 endif
 
+ifeq ($(BOARD_ABL_FDT_DIRECT_OVERLAY),true)
+        FDT_DIRECT_OVERLAY := FDT_DIRECT_OVERLAY=1
+else
+        FDT_DIRECT_OVERLAY := FDT_DIRECT_OVERLAY=0
+endif
+
+ifeq ($(BOARD_ABL_AVB_RSA_64BIT_LIMBS),true)
+        AVB_RSA_64BIT_LIMBS := AVB_RSA_64BIT_LIMBS=1
+else
+        AVB_RSA_64BIT_LIMBS := AVB_RSA_64BIT_LIMBS=0
+endif
+
+ifeq ($(BOARD_ABL_AVB_PARALLEL_HASH),true)
+        AVB_PARALLEL_HASH := AVB_PARALLEL_HASH=1
+else
+        AVB_PARALLEL_HASH := AVB_PARALLEL_HASH=0
+endif
+
+ifeq ($(BOARD_ABL_CVM_PARALLEL_LOAD),true)
+        CVM_PARALLEL_LOAD := CVM_PARALLEL_LOAD=1
+else
+        CVM_PARALLEL_LOAD := CVM_PARALLEL_LOAD=0
+endif
+
 SAFESTACK_SUPPORTED_CLANG_VERSION = 6.0
 
 # For most platform, abl needed always be built
@@ -132,6 +156,10 @@ $(TARGET_ABL): $(LOCAL_ABL_SRC_FILE) | $(ABL_OUT) $(INSTALLED_KEYSTOREIMAGE_TARG
 		$(DISABLE_PARALLEL_DOWNLOAD_FLASH) \
 		$(AB_RETRYCOUNT_DISABLE) \
 		$(DYNAMIC_PARTITION_SUPPORT) \
+		$(FDT_DIRECT_OVERLAY) \
+		$(AVB_RSA_64BIT_LIMBS) \
+		$(AVB_PARALLEL_HASH) \
+		$(CVM_PARALLEL_LOAD) \
 		CLANG_BIN=$(CLANG_BIN) \
 		CLANG_PREFIX=$(CLANG35_PREFIX)\
 		ABL_USE_SDLLVM=$(ABL_USE_SDLLVM) \
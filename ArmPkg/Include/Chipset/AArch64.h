@@ -35,6 +35,14 @@
 #define AARCH64_PFR0_FP         (0xF << 16)
 #define AARCH64_PFR0_GIC        (0xF << 24)
 
+// ID_AA64ISAR0 - AArch64 Instruction Set Attribute Register 0 definitions
+#define AARCH64_ISAR0_SHA2_SHIFT  12
+#define AARCH64_ISAR0_SHA2_MASK   (0xFUL << AARCH64_ISAR0_SHA2_SHIFT)
+#define AARCH64_ISAR0_SHA2_256    1
+#define AARCH64_ISAR0_SHA2_512    2
+#define AARCH64_ISAR0_CRC32_SHIFT 16
+#define AARCH64_ISAR0_CRC32_MASK  (0xFUL << AARCH64_ISAR0_CRC32_SHIFT)
+
 // SCR - Secure Configuration Register definitions
 #define SCR_NS                  (1 << 0)
 #define SCR_IRQ                 (1 << 1)
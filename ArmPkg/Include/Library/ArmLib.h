@@ -210,6 +210,14 @@ ArmReadIdPfr1 (
   VOID
   );
 
+#ifdef MDE_CPU_AARCH64
+UINTN
+EFIAPI
+ArmReadIdAa64Isar0 (
+  VOID
+  );
+#endif
+
 UINTN
 EFIAPI
 ArmCacheInfo (
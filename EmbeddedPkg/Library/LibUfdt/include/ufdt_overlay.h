@@ -26,4 +26,18 @@ struct fdt_header *ufdt_apply_overlay(struct fdt_header *main_fdt_header,
 struct fdt_header *ufdt_apply_multi_overlay(struct fdt_header *main_fdt_header,
                                     size_t main_fdt_size,
                                     struct fdt_entry_node *overlay_dt_list);
+/* Applies the .dtbo in fdto to the fdt in place without building a ufdt.
+ * fdt must have room for the result, e.g. fdt_totalsize(fdt) of at least
+ * the base size plus the overlay size. fdto is fixed up in place.
+ * Returns 0 or a negative libfdt error code. Named apart from libfdt's
+ * fdt_overlay_apply() so both can be linked into one image.
+ */
+int ufdt_fdt_overlay_apply(void *fdt, void *fdto);
+
+/* Same contract as ufdt_apply_multi_overlay(), but merges each overlay
+ * straight into a flat blob instead of going through a ufdt.
+ */
+struct fdt_header *ufdt_fdt_apply_multi_overlay(
+    struct fdt_header *main_fdt_header, size_t main_fdt_size,
+    struct fdt_entry_node *overlay_dt_list);
 #endif /* UFDT_OVERLAY_H */
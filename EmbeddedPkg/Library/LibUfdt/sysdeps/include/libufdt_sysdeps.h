@@ -66,4 +66,14 @@ void* pre_overlay_malloc();
 
 void post_overlay_free();
 
+/* Allocator statistics of the current or last overlay application */
+struct dto_mem_stats {
+  size_t in_use;
+  size_t peak;
+  size_t reserved;
+  size_t chunks;
+};
+
+void dto_get_mem_stats(struct dto_mem_stats *stats);
+
 #endif /* LIBDTOVERLAY_SYSDEPS_H */
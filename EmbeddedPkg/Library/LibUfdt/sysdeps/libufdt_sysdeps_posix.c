@@ -49,3 +49,14 @@ int dto_strncmp(const char *s1, const char *s2, size_t n) {
 void *dto_memchr(const void *s, int c, size_t n) { return memchr(s, c, n); }
 
 void *dto_memset(void *s, int c, size_t n) { return memset(s, c, n); }
+
+/* No arena here, every allocation goes straight to malloc() */
+static char no_arena;
+
+void *pre_overlay_malloc() { return &no_arena; }
+
+void post_overlay_free() {}
+
+void dto_get_mem_stats(struct dto_mem_stats *stats) {
+  memset(stats, 0, sizeof(*stats));
+}
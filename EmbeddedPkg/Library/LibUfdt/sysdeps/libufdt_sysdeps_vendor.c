@@ -1,6 +1,5 @@
 #include "libufdt_sysdeps.h"
 #define EFI_DTBO_ERROR -1
-#define PRE_ALLOC_BUFFER_SZ (5 * 1024 * 1024)
 
 #if INCLUDE_PLATFORM_HDRS
 #include <debug.h>
@@ -186,37 +185,201 @@ void dto_qsort(void *base, size_t nmemb, size_t size,
  * bootloader source with the names conforming to POSIX.
  */
 
-static void* buffer;
+/* Overlay arena. Memory is carved from ARENA_CHUNK_SZ chunks that are only
+ * returned by post_overlay_free(), so one overlay application is one arena
+ * lifetime. Every block carries its rounded size in front of it; freed blocks
+ * go to per-size-class free lists so the ufdt_nodes and dicts of an overlay
+ * tree destroyed in ufdt_apply_multi_overlay() are reused by the next one.
+ */
+#define ARENA_CHUNK_SZ (1024 * 1024)
+#define ARENA_ALIGN 8
+#define ARENA_HDR_SZ ARENA_ALIGN
+#define ARENA_SMALL_MAX 128
+#define ARENA_LARGE_MIN 256
+#define ARENA_LARGE_MAX (64 * 1024)
+#define ARENA_SMALL_CLASSES (ARENA_SMALL_MAX / ARENA_ALIGN)
+#define ARENA_CLASSES (ARENA_SMALL_CLASSES + 9) /* 256 .. 64K */
+
+struct arena_chunk {
+	struct arena_chunk *next;
+	size_t size;
+	size_t used;
+};
+
+static struct arena_chunk *chunks;
+static void *free_lists[ARENA_CLASSES];
+static struct dto_mem_stats stats;
+
+/* Round size up to its class, -1 for sizes that are not recycled */
+static size_t arena_class_size(size_t size, int *cls)
+{
+	size_t csize;
 
-void* pre_overlay_malloc()
+	if (size <= ARENA_SMALL_MAX) {
+		csize = size ? (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1)
+			     : ARENA_ALIGN;
+		*cls = csize / ARENA_ALIGN - 1;
+		return csize;
+	}
+
+	if (size <= ARENA_LARGE_MAX) {
+		csize = ARENA_LARGE_MIN;
+		*cls = ARENA_SMALL_CLASSES;
+		while (csize < size) {
+			csize <<= 1;
+			(*cls)++;
+		}
+		return csize;
+	}
+
+	*cls = -1;
+	return (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+}
+
+static struct arena_chunk *arena_add_chunk(size_t size)
 {
-	buffer = AllocatePool(PRE_ALLOC_BUFFER_SZ);
-	if (!buffer) {
+	struct arena_chunk *chunk;
+
+	chunk = AllocatePool(sizeof(*chunk) + size);
+	if (!chunk)
 		return NULL;
+
+	chunk->size = size;
+	chunk->used = 0;
+	stats.reserved += size;
+	stats.chunks++;
+	return chunk;
+}
+
+static void *arena_carve(size_t need)
+{
+	struct arena_chunk *chunk = chunks;
+	void *ptr;
+
+	if (!chunk || chunk->size - chunk->used < need) {
+		if (need > ARENA_CHUNK_SZ / 4) {
+			/* Give big blocks their own chunk and keep bumping
+			 * in the current one */
+			chunk = arena_add_chunk(need);
+			if (!chunk)
+				return NULL;
+			if (chunks) {
+				chunk->next = chunks->next;
+				chunks->next = chunk;
+			} else {
+				chunk->next = NULL;
+				chunks = chunk;
+			}
+		} else {
+			chunk = arena_add_chunk(ARENA_CHUNK_SZ);
+			if (!chunk)
+				return NULL;
+			chunk->next = chunks;
+			chunks = chunk;
+		}
 	}
-	return buffer;
+
+	ptr = (char *)(chunk + 1) + chunk->used;
+	chunk->used += need;
+	return ptr;
+}
+
+void* pre_overlay_malloc()
+{
+	/* Start every application from an empty arena */
+	post_overlay_free();
+	stats.peak = 0;
+	stats.reserved = 0;
+	stats.chunks = 0;
+
+	chunks = arena_add_chunk(ARENA_CHUNK_SZ);
+	if (!chunks)
+		return NULL;
+	chunks->next = NULL;
+	return chunks;
 }
 
 void post_overlay_free()
 {
-	if (buffer)
-		FreePool(buffer);
+	struct arena_chunk *chunk;
+
+	while (chunks) {
+		chunk = chunks;
+		chunks = chunk->next;
+		FreePool(chunk);
+	}
+	memset(free_lists, 0, sizeof(free_lists));
+	stats.in_use = 0;
+}
+
+void dto_get_mem_stats(struct dto_mem_stats *out)
+{
+	*out = stats;
 }
 
 void *dto_malloc(size_t size) {
-	static int ssize = 0;
-        void *retbuf;
+	size_t csize;
+	void *ptr;
+	int cls;
 
-	if (((MAX_UINT64 - ssize) < size) || ((ssize + size) > PRE_ALLOC_BUFFER_SZ)) {
+	if (size > MAX_UINT32)
 		return NULL;
+
+	csize = arena_class_size(size, &cls);
+	if (cls >= 0 && free_lists[cls]) {
+		ptr = free_lists[cls];
+		free_lists[cls] = *(void **)ptr;
+	} else {
+		ptr = arena_carve(ARENA_HDR_SZ + csize);
+		if (!ptr)
+			return NULL;
+		*(size_t *)ptr = csize;
+		ptr = (char *)ptr + ARENA_HDR_SZ;
 	}
 
-	retbuf = buffer + ssize;
-	ssize += size;
-	return retbuf;
+	stats.in_use += csize;
+	if (stats.in_use > stats.peak)
+		stats.peak = stats.in_use;
+	return ptr;
 }
 
-void dto_free(void *ptr) { }
+void dto_free(void *ptr) {
+	struct arena_chunk **link;
+	struct arena_chunk *chunk;
+	size_t csize;
+	int cls;
+
+	if (!ptr)
+		return;
+
+	csize = *(size_t *)((char *)ptr - ARENA_HDR_SZ);
+	stats.in_use -= csize;
+
+	arena_class_size(csize, &cls);
+	if (cls >= 0) {
+		*(void **)ptr = free_lists[cls];
+		free_lists[cls] = ptr;
+		return;
+	}
+
+	/* Big block: drop its chunk if it has one to itself, or give the
+	 * space back if it was the last thing carved. */
+	for (link = &chunks; *link; link = &(*link)->next) {
+		chunk = *link;
+		if ((char *)ptr - ARENA_HDR_SZ == (char *)(chunk + 1) &&
+		    chunk->used == ARENA_HDR_SZ + csize && chunk != chunks) {
+			*link = chunk->next;
+			stats.reserved -= chunk->size;
+			stats.chunks--;
+			FreePool(chunk);
+			return;
+		}
+		if ((char *)ptr + csize == (char *)(chunk + 1) + chunk->used) {
+			chunk->used -= ARENA_HDR_SZ + csize;
+			return;
+		}
+	}
+}
 
 char *dto_strdup(const char *s) {
 	char * RetPtr = NULL;
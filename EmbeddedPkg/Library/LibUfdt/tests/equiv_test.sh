@@ -0,0 +1,81 @@
+#!/bin/bash
+
+# Checks that ufdt_fdt_apply_multi_overlay() merges every test case the same
+# way ufdt_apply_multi_overlay() does. Each testdata/*-base.dts and
+# *-overlay.dts pair is compiled with dtc -@, applied with both engines by
+# overlay_equiv_test_app and the name-sorted dumps of the results diffed.
+#
+# Usage: equiv_test.sh [OUT_DIR]
+#   OUT_DIR holds overlay_equiv_test_app, as built by `make`, and receives
+#   the compiled blobs and dumps. Defaults to ./out.
+
+SCRIPT_DIR="$(dirname "$(readlink -f "$0")")"
+source ${SCRIPT_DIR}/common.sh
+
+OUT_DIR="$(readlink -f "${1:-${SCRIPT_DIR}/out}")"
+DTC="${DTC:-dtc}"
+APP="${OUT_DIR}/overlay_equiv_test_app"
+WORK_DIR="${OUT_DIR}/equiv"
+
+compile_dts() {
+  "$DTC" -@ -qq -O dtb -o "$2" "$1" ||
+    die "Can not compile $1"
+}
+
+# Usage: run_equiv_case <name> <base> <overlay>...
+# Args:
+#   name: prefix of the dumps under ${WORK_DIR}
+#   base, overlay: test case names, for testdata/${case}-base.dts and
+#     testdata/${case}-overlay.dts. Overlays are applied in order.
+run_equiv_case() {
+  local name="$1"
+  local base="$2"
+  local overlays=()
+  shift 2
+
+  compile_dts "testdata/${base}-base.dts" "${WORK_DIR}/${base}-base.dtb"
+  for overlay in "$@"; do
+    compile_dts "testdata/${overlay}-overlay.dts" \
+      "${WORK_DIR}/${overlay}-overlay.dtbo"
+    overlays+=("${WORK_DIR}/${overlay}-overlay.dtbo")
+  done
+
+  alert "Comparing engines on ${name}"
+  if ! "$APP" "${WORK_DIR}/${name}" "${WORK_DIR}/${base}-base.dtb" \
+       "${overlays[@]}" >&2; then
+    diff -u "${WORK_DIR}/${name}.ufdt.txt" "${WORK_DIR}/${name}.fdt.txt" >&2
+    return 1
+  fi
+}
+
+main() {
+  local failed=0
+
+  alert "========== Comparing ufdt and direct fdt overlays =========="
+
+  if ! command_exists "$DTC"; then
+    die "dtc not found, set DTC to the dtc binary"
+  fi
+  if [ ! -x "$APP" ]; then
+    die "Run make in ${SCRIPT_DIR} yet?"
+  fi
+
+  mkdir -p "$WORK_DIR"
+  cd "${SCRIPT_DIR}"
+
+  for base_dts in testdata/*-base.dts; do
+    local name="$(basename "${base_dts%-base.dts}")"
+    run_equiv_case "$name" "$name" "$name" || failed=1
+  done
+
+  # Several overlays on one base, all targeting &a
+  run_equiv_case "multi_overlay" "overlay_2_layers" \
+    "no_local_fixup" "overlay_2_layers" "node_ordering" || failed=1
+
+  if [ $failed -ne 0 ]; then
+    die "The engines disagree, see the diffs above"
+  fi
+  alert "All cases match"
+}
+
+main "$@"
@@ -0,0 +1,237 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "libfdt.h"
+#include "ufdt_overlay.h"
+#include "libufdt_sysdeps.h"
+
+#include "util.h"
+
+/*
+ * Applies the same overlays with ufdt_apply_multi_overlay() and
+ * ufdt_fdt_apply_multi_overlay() and compares the results. Both trees are
+ * dumped with properties and subnodes sorted by name, since the engines are
+ * free to order new nodes differently.
+ */
+
+struct dump_item {
+  const char *name;
+  int offset; /* subnode offset, or -1 for a property */
+  const unsigned char *value;
+  int len;
+};
+
+static int compare_items(const void *a, const void *b) {
+  return strcmp(((const struct dump_item *)a)->name,
+                ((const struct dump_item *)b)->name);
+}
+
+static int dump_node(FILE *out, const void *fdt, int node, int depth) {
+  struct dump_item *items = NULL;
+  int count = 0;
+  int cap = 0;
+  int offset;
+  int i, j;
+  int ret = 0;
+
+  for (offset = fdt_first_property_offset(fdt, node); offset >= 0;
+       offset = fdt_next_property_offset(fdt, offset)) {
+    if (count == cap) {
+      cap = cap ? cap * 2 : 16;
+      items = realloc(items, cap * sizeof(*items));
+      if (!items) return -1;
+    }
+    items[count].value = fdt_getprop_by_offset(fdt, offset,
+                                               &items[count].name,
+                                               &items[count].len);
+    items[count].offset = -1;
+    count++;
+  }
+  /* Properties first, then subnodes */
+  qsort(items, count, sizeof(*items), compare_items);
+  for (i = 0; i < count; i++) {
+    fprintf(out, "%*s%s =", depth * 2, "", items[i].name);
+    for (j = 0; j < items[i].len; j++) fprintf(out, " %02x", items[i].value[j]);
+    fprintf(out, "\n");
+  }
+
+  count = 0;
+  for (offset = fdt_first_subnode(fdt, node); offset >= 0;
+       offset = fdt_next_subnode(fdt, offset)) {
+    if (count == cap) {
+      cap = cap ? cap * 2 : 16;
+      items = realloc(items, cap * sizeof(*items));
+      if (!items) return -1;
+    }
+    items[count].name = fdt_get_name(fdt, offset, NULL);
+    items[count].offset = offset;
+    count++;
+  }
+  qsort(items, count, sizeof(*items), compare_items);
+  for (i = 0; i < count && ret == 0; i++) {
+    fprintf(out, "%*s%s {\n", depth * 2, "", items[i].name);
+    ret = dump_node(out, fdt, items[i].offset, depth + 1);
+    fprintf(out, "%*s}\n", depth * 2, "");
+  }
+
+  free(items);
+  return ret;
+}
+
+static char *dump_fdt(const void *fdt, const char *filename) {
+  char *text = NULL;
+  size_t len = 0;
+  FILE *out;
+
+  out = open_memstream(&text, &len);
+  if (!out) return NULL;
+  if (dump_node(out, fdt, 0, 0) != 0) {
+    fclose(out);
+    free(text);
+    return NULL;
+  }
+  fclose(out);
+
+  out = fopen(filename, "w");
+  if (!out || fwrite(text, 1, len, out) != len) {
+    fprintf(stderr, "Write file error: %s\n", filename);
+    if (out) fclose(out);
+    free(text);
+    return NULL;
+  }
+  fclose(out);
+  return text;
+}
+
+/* Each engine fixes the overlays up in place, so each gets its own copies */
+static struct fdt_entry_node *copy_overlays(char **overlay_bufs,
+                                            size_t *overlay_lens, int count) {
+  struct fdt_entry_node *list = calloc(count, sizeof(*list));
+  int i;
+
+  if (!list) return NULL;
+  for (i = 0; i < count; i++) {
+    void *copy = dto_malloc(overlay_lens[i]);
+    if (!copy) return NULL;
+    dto_memcpy(copy, overlay_bufs[i], overlay_lens[i]);
+    list[i].address = (uintptr_t)copy;
+    list[i].size = overlay_lens[i];
+    list[i].next = i + 1 < count ? &list[i + 1] : NULL;
+  }
+  return list;
+}
+
+static void free_overlays(struct fdt_entry_node *list, int count) {
+  int i;
+
+  if (!list) return;
+  for (i = 0; i < count; i++) dto_free((void *)(uintptr_t)list[i].address);
+  free(list);
+}
+
+int compare_overlay_files(const char *out_prefix, const char *base_filename,
+                          char **overlay_filenames, int overlay_count) {
+  int ret = 1;
+  char *base_buf = NULL;
+  char *base_copy = NULL;
+  char **overlay_bufs = NULL;
+  size_t *overlay_lens = NULL;
+  struct fdt_entry_node *ufdt_list = NULL;
+  struct fdt_entry_node *fdt_list = NULL;
+  struct fdt_header *ufdt_blob = NULL;
+  struct fdt_header *fdt_blob = NULL;
+  char *ufdt_text = NULL;
+  char *fdt_text = NULL;
+  char filename[4096];
+  int i;
+
+  size_t blob_len;
+  base_buf = load_file(base_filename, &blob_len);
+  if (!base_buf) {
+    fprintf(stderr, "Can not load base file: %s\n", base_filename);
+    goto end;
+  }
+
+  overlay_bufs = calloc(overlay_count, sizeof(*overlay_bufs));
+  overlay_lens = calloc(overlay_count, sizeof(*overlay_lens));
+  if (!overlay_bufs || !overlay_lens) goto end;
+  for (i = 0; i < overlay_count; i++) {
+    overlay_bufs[i] = load_file(overlay_filenames[i], &overlay_lens[i]);
+    if (!overlay_bufs[i]) {
+      fprintf(stderr, "Can not load overlay file: %s\n", overlay_filenames[i]);
+      goto end;
+    }
+  }
+
+  ufdt_list = copy_overlays(overlay_bufs, overlay_lens, overlay_count);
+  fdt_list = copy_overlays(overlay_bufs, overlay_lens, overlay_count);
+  base_copy = dto_malloc(blob_len);
+  if (!ufdt_list || !fdt_list || !base_copy) goto end;
+  dto_memcpy(base_copy, base_buf, blob_len);
+
+  struct fdt_header *blob = ufdt_install_blob(base_buf, blob_len);
+  if (!blob) {
+    fprintf(stderr, "ufdt_install_blob() returns null\n");
+    goto end;
+  }
+
+  clock_t start = clock();
+  ufdt_blob = ufdt_apply_multi_overlay(blob, blob_len, ufdt_list);
+  clock_t mid = clock();
+  fdt_blob = ufdt_fdt_apply_multi_overlay((struct fdt_header *)base_copy,
+                                          blob_len, fdt_list);
+  clock_t end = clock();
+
+  if (!ufdt_blob || !fdt_blob) {
+    fprintf(stderr, "%s failed\n",
+            !ufdt_blob ? "ufdt_apply_multi_overlay()"
+                       : "ufdt_fdt_apply_multi_overlay()");
+    goto end;
+  }
+
+  printf("ufdt_apply_multi_overlay: took %.9f secs\n",
+         ((double)(mid - start)) / CLOCKS_PER_SEC);
+  printf("ufdt_fdt_apply_multi_overlay: took %.9f secs\n",
+         ((double)(end - mid)) / CLOCKS_PER_SEC);
+
+  snprintf(filename, sizeof(filename), "%s.ufdt.txt", out_prefix);
+  ufdt_text = dump_fdt(ufdt_blob, filename);
+  snprintf(filename, sizeof(filename), "%s.fdt.txt", out_prefix);
+  fdt_text = dump_fdt(fdt_blob, filename);
+  if (!ufdt_text || !fdt_text) goto end;
+
+  ret = strcmp(ufdt_text, fdt_text) != 0;
+  if (ret) fprintf(stderr, "Merged trees differ: %s.{ufdt,fdt}.txt\n", out_prefix);
+
+end:
+  free(ufdt_text);
+  free(fdt_text);
+  if (ufdt_blob) dto_free(ufdt_blob);
+  if (fdt_blob) dto_free(fdt_blob);
+  free_overlays(ufdt_list, overlay_count);
+  free_overlays(fdt_list, overlay_count);
+  for (i = 0; overlay_bufs && i < overlay_count; i++) {
+    if (overlay_bufs[i]) dto_free(overlay_bufs[i]);
+  }
+  free(overlay_bufs);
+  free(overlay_lens);
+  if (base_copy) dto_free(base_copy);
+  if (base_buf) dto_free(base_buf);
+
+  return ret;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 4) {
+    fprintf(stderr,
+            "Usage: %s <out_prefix> <base_file> <overlay_file>...\n"
+            "  Writes <out_prefix>.ufdt.txt and <out_prefix>.fdt.txt and\n"
+            "  fails if the two merged trees differ.\n",
+            argv[0]);
+    return 1;
+  }
+
+  return compare_overlay_files(argv[1], argv[2], argv + 3, argc - 3);
+}
@@ -0,0 +1,1193 @@
+/* Copyright (c) 2026, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimer in the documentation and/or other materials provided
+ *  with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "ufdt_overlay.h"
+
+#include "fdt_internal.h"
+
+/*
+ * Applies overlays straight from one flattened device tree into another.
+ *
+ * ufdt_apply_multi_overlay() unflattens the whole base tree, merges the
+ * overlays into it and flattens it again. Here both blobs are only indexed
+ * (one entry per node: offset, parent, path hash and phandle), the overlay is
+ * fixed up in place and the merged tree is written out in a single pass.
+ * Subtrees no fragment touches are copied with one memcpy per run of
+ * siblings; only the nodes on the way to a fragment target and the targets
+ * themselves are walked property by property.
+ *
+ * The merge follows ufdt_overlay.c so that both engines build the same tree:
+ * root properties of the overlay replace existing root properties, fragments
+ * with an unknown target are skipped and the base __symbols__ node is left
+ * untouched.
+ */
+
+#define FDT_OV_HASH_SEED 2166136261U
+#define FDT_OV_HASH_PRIME 16777619U
+
+struct fdt_ov_node {
+  int offset;       /* FDT_BEGIN_NODE tag of the node */
+  int end;          /* offset just past the matching FDT_END_NODE */
+  int next;         /* index of the first entry after this subtree */
+  int parent;       /* index of the parent entry, -1 for the root */
+  uint32_t hash;    /* hash of the full path */
+  uint32_t phandle;
+};
+
+struct fdt_ov_hash {
+  uint32_t hash;
+  int index;
+};
+
+/*
+ * Nodes of one blob in document order, so the subtree of entry i is
+ * [i, next) and its children are reached by following next from i + 1.
+ */
+struct fdt_ov_index {
+  const void *fdt;
+  struct fdt_ov_node *nodes;
+  int count;
+  int max;
+  struct fdt_ov_hash *hashes;   /* sorted by path hash */
+  struct fdt_ov_hash *phandles; /* sorted by phandle, kept in .hash */
+  int phandle_count;
+  uint32_t max_phandle;
+};
+
+/*
+ * An overlay node (index into the overlay index) to be merged into base node
+ * @base, -1 when the node is new. When several overlay nodes land on the same
+ * node, the one from the later fragment wins.
+ */
+struct fdt_ov_item {
+  int base;
+  int frag;
+  int node;
+};
+
+struct fdt_ov_ctx {
+  const void *base;
+  void *fdto;
+  struct fdt_ov_index base_index;
+  struct fdt_ov_index ov_index;
+
+  uint32_t *symtab; /* open addressing table of __symbols__ prop offset + 1 */
+  uint32_t symtab_mask;
+
+  struct fdt_ov_item *frags; /* sorted by target, then fragment order */
+  int frag_count;
+
+  uint32_t *strtab; /* open addressing table of nameoff + 1 */
+  uint32_t strtab_mask;
+  const char *base_strings;
+  int base_strings_len;
+  char *new_strings;
+  int new_strings_len;
+  int new_strings_max;
+
+  char *out; /* structure block of the merged tree */
+  int out_len;
+  int out_max;
+};
+
+static uint32_t fdt_ov_hash_bytes(uint32_t hash, const char *s, int len) {
+  int i;
+
+  for (i = 0; i < len; i++) {
+    hash ^= (uint8_t)s[i];
+    hash *= FDT_OV_HASH_PRIME;
+  }
+  return hash;
+}
+
+static uint32_t fdt_ov_path_hash(uint32_t parent, const char *name, int len) {
+  return fdt_ov_hash_bytes(fdt_ov_hash_bytes(parent, "/", 1), name, len);
+}
+
+static int fdt_ov_name_eq(const char *s, const char *name, int len) {
+  return dto_strncmp(s, name, len) == 0 && s[len] == '\0';
+}
+
+/* BEGIN of the node index. */
+
+static const char *fdt_ov_node_name(const struct fdt_ov_index *idx, int i) {
+  const struct fdt_node_header *nh =
+      _fdt_offset_ptr(idx->fdt, idx->nodes[i].offset);
+  return nh->name;
+}
+
+static int fdt_ov_is_phandle(const char *name) {
+  return name && (dto_strcmp(name, "phandle") == 0 ||
+                  dto_strcmp(name, "linux,phandle") == 0);
+}
+
+static int fdt_ov_hash_cmp(const void *a, const void *b) {
+  const struct fdt_ov_hash *ha = a, *hb = b;
+
+  if (ha->hash != hb->hash) return ha->hash < hb->hash ? -1 : 1;
+  return ha->index - hb->index;
+}
+
+static int fdt_ov_add_node(struct fdt_ov_index *idx) {
+  struct fdt_ov_node *nodes;
+
+  if (idx->count == idx->max) {
+    nodes = dto_malloc(idx->max * 2 * sizeof(*nodes));
+    if (nodes == NULL) return -FDT_ERR_NOSPACE;
+    dto_memcpy(nodes, idx->nodes, idx->count * sizeof(*nodes));
+    dto_free(idx->nodes);
+    idx->nodes = nodes;
+    idx->max *= 2;
+  }
+  return idx->count++;
+}
+
+/*
+ * Walks the structure block once, recording every node with its path hash
+ * and phandle. The tags are decoded here rather than with fdt_next_tag(),
+ * which checks node names one byte at a time.
+ */
+static int fdt_ov_index_build(struct fdt_ov_index *idx, const void *fdt) {
+  const char *blk = (const char *)fdt + fdt_off_dt_struct(fdt);
+  int size = fdt_size_dt_struct(fdt);
+  const struct fdt_property *prop;
+  const char *name, *name_end;
+  struct fdt_ov_node *node;
+  int offset = 0, next, cur = -1, i, len;
+  uint32_t tag, phandle;
+
+  dto_memset(idx, 0, sizeof(*idx));
+  idx->fdt = fdt;
+  idx->max = size / 64 + 16;
+  idx->nodes = dto_malloc(idx->max * sizeof(*idx->nodes));
+  if (idx->nodes == NULL) return -FDT_ERR_NOSPACE;
+
+  do {
+    if (offset + (int)FDT_TAGSIZE > size) return -FDT_ERR_TRUNCATED;
+    tag = fdt32_to_cpu(*(const fdt32_t *)(blk + offset));
+    next = offset + FDT_TAGSIZE;
+
+    switch (tag) {
+      case FDT_BEGIN_NODE:
+        name = blk + next;
+        name_end = dto_memchr(name, '\0', size - next);
+        if (name_end == NULL) return -FDT_ERR_TRUNCATED;
+        len = name_end - name;
+        next = FDT_TAGALIGN(next + len + 1);
+
+        i = fdt_ov_add_node(idx);
+        if (i < 0) return i;
+        node = &idx->nodes[i];
+        node->offset = offset;
+        node->parent = cur;
+        node->phandle = 0;
+        node->hash = cur < 0 ? FDT_OV_HASH_SEED
+                             : fdt_ov_path_hash(idx->nodes[cur].hash, name,
+                                                len);
+        cur = i;
+        break;
+
+      case FDT_END_NODE:
+        if (cur < 0) return -FDT_ERR_BADSTRUCTURE;
+        idx->nodes[cur].end = next;
+        idx->nodes[cur].next = idx->count;
+        cur = idx->nodes[cur].parent;
+        break;
+
+      case FDT_PROP:
+        if (cur < 0 || next + 2 * (int)FDT_TAGSIZE > size)
+          return -FDT_ERR_BADSTRUCTURE;
+        prop = (const struct fdt_property *)(blk + offset);
+        len = fdt32_to_cpu(prop->len);
+        if (len < 0 || len > size) return -FDT_ERR_BADSTRUCTURE;
+        next = FDT_TAGALIGN(offset + sizeof(*prop) + len);
+        if (next > size) return -FDT_ERR_TRUNCATED;
+
+        if (len != sizeof(fdt32_t) ||
+            !fdt_ov_is_phandle(fdt_string(fdt, fdt32_to_cpu(prop->nameoff))))
+          break;
+        phandle = fdt32_to_cpu(*(const fdt32_t *)prop->data);
+        idx->nodes[cur].phandle = phandle;
+        if (phandle != (uint32_t)-1 && phandle > idx->max_phandle)
+          idx->max_phandle = phandle;
+        break;
+
+      case FDT_NOP:
+      case FDT_END:
+        break;
+
+      default:
+        return -FDT_ERR_BADSTRUCTURE;
+    }
+    offset = next;
+  } while (tag != FDT_END);
+
+  if (cur >= 0 || idx->count == 0) return -FDT_ERR_BADSTRUCTURE;
+
+  idx->hashes = dto_malloc(idx->count * sizeof(*idx->hashes));
+  idx->phandles = dto_malloc(idx->count * sizeof(*idx->phandles));
+  if (idx->hashes == NULL || idx->phandles == NULL) return -FDT_ERR_NOSPACE;
+  for (i = 0; i < idx->count; i++) {
+    idx->hashes[i].hash = idx->nodes[i].hash;
+    idx->hashes[i].index = i;
+
+    phandle = idx->nodes[i].phandle;
+    if (phandle == 0 || phandle == (uint32_t)-1) continue;
+    idx->phandles[idx->phandle_count].hash = phandle;
+    idx->phandles[idx->phandle_count].index = i;
+    idx->phandle_count++;
+  }
+  dto_qsort(idx->hashes, idx->count, sizeof(*idx->hashes), fdt_ov_hash_cmp);
+  dto_qsort(idx->phandles, idx->phandle_count, sizeof(*idx->phandles),
+            fdt_ov_hash_cmp);
+  return 0;
+}
+
+static void fdt_ov_index_free(struct fdt_ov_index *idx) {
+  dto_free(idx->nodes);
+  dto_free(idx->hashes);
+  dto_free(idx->phandles);
+}
+
+/* Returns the first entry of a sorted @table whose key is not below @key. */
+static int fdt_ov_lower_bound(const struct fdt_ov_hash *table, int count,
+                              uint32_t key) {
+  int s = 0, e = count;
+
+  while (s < e) {
+    int mid = s + ((e - s) >> 1);
+    if (table[mid].hash < key)
+      s = mid + 1;
+    else
+      e = mid;
+  }
+  return s;
+}
+
+/* Returns the index of the subnode @name of node @parent, or -1. */
+static int fdt_ov_find_child(const struct fdt_ov_index *idx, int parent,
+                             const char *name, int len) {
+  uint32_t hash = fdt_ov_path_hash(idx->nodes[parent].hash, name, len);
+  int s = fdt_ov_lower_bound(idx->hashes, idx->count, hash), i;
+
+  for (; s < idx->count && idx->hashes[s].hash == hash; s++) {
+    i = idx->hashes[s].index;
+    if (idx->nodes[i].parent == parent &&
+        fdt_ov_name_eq(fdt_ov_node_name(idx, i), name, len))
+      return i;
+  }
+  return -1;
+}
+
+/* Resolves an absolute path of @len bytes, or returns -1. */
+static int fdt_ov_find_path(const struct fdt_ov_index *idx, const char *path,
+                            int len) {
+  const char *end = path + len;
+  const char *next_slash;
+  int cur = 0;
+
+  if (len <= 0 || path[0] != '/') return -1;
+
+  while (path < end) {
+    while (path < end && path[0] == '/') path++;
+    if (path == end) return cur;
+
+    next_slash = dto_memchr(path, '/', end - path);
+    if (!next_slash) next_slash = end;
+
+    cur = fdt_ov_find_child(idx, cur, path, next_slash - path);
+    if (cur < 0) return -1;
+    path = next_slash;
+  }
+  return cur;
+}
+
+static int fdt_ov_find_phandle(const struct fdt_ov_index *idx,
+                               uint32_t phandle) {
+  int s = fdt_ov_lower_bound(idx->phandles, idx->phandle_count, phandle);
+
+  if (s < idx->phandle_count && idx->phandles[s].hash == phandle)
+    return idx->phandles[s].index;
+  return -1;
+}
+
+/* END of the node index. */
+
+/* BEGIN of the strings table. */
+
+static const char *fdt_ov_string(const struct fdt_ov_ctx *ctx, uint32_t off) {
+  if (off < (uint32_t)ctx->base_strings_len) return ctx->base_strings + off;
+  return ctx->new_strings + (off - ctx->base_strings_len);
+}
+
+/* Returns the slot holding @s, or the empty slot where it belongs. */
+static uint32_t *fdt_ov_string_slot(const struct fdt_ov_ctx *ctx,
+                                    const char *s, int len) {
+  uint32_t i = fdt_ov_hash_bytes(FDT_OV_HASH_SEED, s, len) & ctx->strtab_mask;
+
+  while (ctx->strtab[i] &&
+         !fdt_ov_name_eq(fdt_ov_string(ctx, ctx->strtab[i] - 1), s, len))
+    i = (i + 1) & ctx->strtab_mask;
+  return &ctx->strtab[i];
+}
+
+static int fdt_ov_count_strings(const char *s, int len) {
+  const char *end = s + len, *p;
+  int count = 0;
+
+  for (; s < end; s = p + 1, count++) {
+    p = dto_memchr(s, '\0', end - s);
+    if (!p) break;
+  }
+  return count;
+}
+
+/*
+ * Hashes the base strings so that overlay property names can reuse them.
+ * Names the base lacks are collected in new_strings, which can never grow
+ * past the overlay strings block.
+ */
+static int fdt_ov_init_strings(struct fdt_ov_ctx *ctx) {
+  const char *s = ctx->base_strings, *end = s + ctx->base_strings_len, *p;
+  const char *ov_strings =
+      (const char *)ctx->fdto + fdt_off_dt_strings(ctx->fdto);
+  int ov_len = fdt_size_dt_strings(ctx->fdto);
+  uint32_t size = 64, *slot;
+  int count;
+
+  count = fdt_ov_count_strings(s, ctx->base_strings_len) +
+          fdt_ov_count_strings(ov_strings, ov_len);
+  while (size < 2 * (uint32_t)count) size <<= 1;
+
+  ctx->strtab = dto_malloc(size * sizeof(*ctx->strtab));
+  ctx->new_strings_max = ov_len;
+  ctx->new_strings = dto_malloc(ov_len ? ov_len : 1);
+  if (ctx->strtab == NULL || ctx->new_strings == NULL) return -FDT_ERR_NOSPACE;
+  dto_memset(ctx->strtab, 0, size * sizeof(*ctx->strtab));
+  ctx->strtab_mask = size - 1;
+
+  for (; s < end; s = p + 1) {
+    p = dto_memchr(s, '\0', end - s);
+    if (!p) break;
+    slot = fdt_ov_string_slot(ctx, s, p - s);
+    if (*slot == 0) *slot = (s - ctx->base_strings) + 1;
+  }
+  return 0;
+}
+
+static int fdt_ov_add_string(struct fdt_ov_ctx *ctx, const char *s, int len) {
+  uint32_t *slot = fdt_ov_string_slot(ctx, s, len);
+  int off;
+
+  if (*slot) return *slot - 1;
+
+  if (len + 1 > ctx->new_strings_max - ctx->new_strings_len)
+    return -FDT_ERR_NOSPACE;
+  off = ctx->base_strings_len + ctx->new_strings_len;
+  dto_memcpy(ctx->new_strings + ctx->new_strings_len, s, len);
+  ctx->new_strings[ctx->new_strings_len + len] = '\0';
+  ctx->new_strings_len += len + 1;
+  *slot = off + 1;
+  return off;
+}
+
+/* END of the strings table. */
+
+/* BEGIN of fixing up the overlay in place. */
+
+static void fdt_ov_add_u32(void *pos, uint32_t delta) {
+  fdt32_t val;
+
+  dto_memcpy(&val, pos, sizeof(val));
+  val = cpu_to_fdt32(fdt32_to_cpu(val) + delta);
+  dto_memcpy(pos, &val, sizeof(val));
+}
+
+/*
+ * Hashes the properties of the base __symbols__ node, which easily has
+ * thousands of labels while an overlay looks up a few hundred of them.
+ */
+static int fdt_ov_index_symbols(struct fdt_ov_ctx *ctx, int symbols) {
+  const void *base = ctx->base;
+  const struct fdt_property *prop;
+  const char *name;
+  uint32_t size = 64, i;
+  int offset = ctx->base_index.nodes[symbols].offset, poff, count = 0;
+
+  for (poff = fdt_first_property_offset(base, offset); poff >= 0;
+       poff = fdt_next_property_offset(base, poff))
+    count++;
+  while (size < 2 * (uint32_t)count) size <<= 1;
+
+  ctx->symtab = dto_malloc(size * sizeof(*ctx->symtab));
+  if (ctx->symtab == NULL) return -FDT_ERR_NOSPACE;
+  dto_memset(ctx->symtab, 0, size * sizeof(*ctx->symtab));
+  ctx->symtab_mask = size - 1;
+
+  for (poff = fdt_first_property_offset(base, offset); poff >= 0;
+       poff = fdt_next_property_offset(base, poff)) {
+    prop = _fdt_offset_ptr(base, poff);
+    name = fdt_string(base, fdt32_to_cpu(prop->nameoff));
+    i = fdt_ov_hash_bytes(FDT_OV_HASH_SEED, name, dto_strlen(name)) &
+        ctx->symtab_mask;
+    while (ctx->symtab[i]) i = (i + 1) & ctx->symtab_mask;
+    ctx->symtab[i] = poff + 1;
+  }
+  return 0;
+}
+
+/* Returns the path the base __symbols__ node holds for @name, or NULL. */
+static const char *fdt_ov_find_symbol(const struct fdt_ov_ctx *ctx,
+                                      const char *name, int *lenp) {
+  const struct fdt_property *prop;
+  uint32_t i;
+
+  i = fdt_ov_hash_bytes(FDT_OV_HASH_SEED, name, dto_strlen(name)) &
+      ctx->symtab_mask;
+  for (; ctx->symtab[i]; i = (i + 1) & ctx->symtab_mask) {
+    prop = _fdt_offset_ptr(ctx->base, ctx->symtab[i] - 1);
+    if (dto_strcmp(fdt_string(ctx->base, fdt32_to_cpu(prop->nameoff)),
+                   name) == 0) {
+      *lenp = fdt32_to_cpu(prop->len);
+      return prop->data;
+    }
+  }
+  return NULL;
+}
+
+/*
+ * Writes @phandle into every "/path/to/node:property:offset" location listed
+ * in one __fixups__ property.
+ */
+static int fdt_ov_fixup_one(struct fdt_ov_ctx *ctx, const char *fixups,
+                            int len, uint32_t phandle) {
+  const struct fdt_ov_index *ov = &ctx->ov_index;
+  const char *end = fixups + len;
+  const char *fixup_end, *prop, *off_str;
+  const struct fdt_property *p;
+  char *end_ptr;
+  fdt32_t val = cpu_to_fdt32(phandle);
+  unsigned long off;
+  int node, prop_len;
+
+  for (; fixups < end; fixups = fixup_end + 1) {
+    fixup_end = dto_memchr(fixups, '\0', end - fixups);
+    if (!fixup_end) return -FDT_ERR_BADSTRUCTURE;
+
+    prop = dto_memchr(fixups, ':', fixup_end - fixups);
+    if (!prop) {
+      dto_error("Missing property part in '%s'\n", fixups);
+      return -FDT_ERR_BADSTRUCTURE;
+    }
+    off_str = dto_memchr(prop + 1, ':', fixup_end - prop - 1);
+    if (!off_str) {
+      dto_error("Missing offset part in '%s'\n", fixups);
+      return -FDT_ERR_BADSTRUCTURE;
+    }
+    off = dto_strtoul(off_str + 1, &end_ptr, 10 /* base */);
+    if (*end_ptr != '\0') {
+      dto_error("'%s' is not valid number\n", off_str + 1);
+      return -FDT_ERR_BADSTRUCTURE;
+    }
+
+    node = fdt_ov_find_path(ov, fixups, prop - fixups);
+    if (node < 0) {
+      dto_error("Path '%s' not found\n", fixups);
+      return -FDT_ERR_NOTFOUND;
+    }
+    p = fdt_get_property_namelen(ctx->fdto, ov->nodes[node].offset, prop + 1,
+                                 off_str - prop - 1, &prop_len);
+    if (p == NULL) {
+      dto_error("Property not found for fixup '%s'\n", fixups);
+      return prop_len;
+    }
+    if ((unsigned long)prop_len < off + sizeof(val)) {
+      dto_error("%s: property length is too small for fixup\n", fixups);
+      return -FDT_ERR_BADSTRUCTURE;
+    }
+    dto_memcpy((char *)p->data + off, &val, sizeof(val));
+  }
+  return 0;
+}
+
+/* Resolves __fixups__ of the overlay against the base __symbols__. */
+static int fdt_ov_do_fixups(struct fdt_ov_ctx *ctx) {
+  const struct fdt_ov_index *base = &ctx->base_index;
+  void *fdto = ctx->fdto;
+  const char *name, *path;
+  const void *fixups_val;
+  int fixups, symbols, prop, target, len, path_len, err;
+
+  fixups = fdt_ov_find_child(&ctx->ov_index, 0, "__fixups__", 10);
+  if (fixups < 0) return 0;
+
+  symbols = fdt_ov_find_child(base, 0, "__symbols__", 11);
+  if (symbols < 0) {
+    dto_error("Bad main_symbols in fdt_ov_do_fixups\n");
+    return -FDT_ERR_NOTFOUND;
+  }
+  err = fdt_ov_index_symbols(ctx, symbols);
+  if (err < 0) return err;
+
+  fixups = ctx->ov_index.nodes[fixups].offset;
+  for (prop = fdt_first_property_offset(fdto, fixups); prop >= 0;
+       prop = fdt_next_property_offset(fdto, prop)) {
+    fixups_val = fdt_getprop_by_offset(fdto, prop, &name, &len);
+    if (fixups_val == NULL) return len;
+
+    path = fdt_ov_find_symbol(ctx, name, &path_len);
+    if (path == NULL) {
+      dto_error("Couldn't find '%s' symbol in main dtb\n", name);
+      return -FDT_ERR_NOTFOUND;
+    }
+    /* The symbol value is a NUL terminated path */
+    target = fdt_ov_find_path(base, path, path_len > 0 ? path_len - 1 : 0);
+    if (target < 0) {
+      dto_error("Couldn't find '%s' path in main dtb\n", path);
+      return -FDT_ERR_NOTFOUND;
+    }
+
+    err = fdt_ov_fixup_one(ctx, fixups_val, len, base->nodes[target].phandle);
+    if (err < 0) {
+      dto_error("Failed one fixup in fdt_ov_fixup_one\n");
+      return err;
+    }
+  }
+  return prop == -FDT_ERR_NOTFOUND ? 0 : prop;
+}
+
+/* Moves every phandle of the overlay past the phandles of the base. */
+static void fdt_ov_increase_phandles(struct fdt_ov_ctx *ctx, uint32_t delta) {
+  const struct fdt_ov_index *ov = &ctx->ov_index;
+  void *val;
+  int i, len;
+
+  for (i = 0; i < ov->count; i++) {
+    if (ov->nodes[i].phandle == 0) continue;
+
+    val = fdt_getprop_w(ctx->fdto, ov->nodes[i].offset, "phandle", &len);
+    if (val != NULL && len == sizeof(fdt32_t)) fdt_ov_add_u32(val, delta);
+    val = fdt_getprop_w(ctx->fdto, ov->nodes[i].offset, "linux,phandle", &len);
+    if (val != NULL && len == sizeof(fdt32_t)) fdt_ov_add_u32(val, delta);
+  }
+}
+
+static int fdt_ov_local_fixup_node(struct fdt_ov_ctx *ctx, int node,
+                                   int fixups, uint32_t delta) {
+  const struct fdt_ov_index *ov = &ctx->ov_index;
+  void *fdto = ctx->fdto;
+  const fdt32_t *offsets;
+  const char *name;
+  char *val;
+  int prop, sub, target, len, val_len, i, off, err;
+
+  for (prop = fdt_first_property_offset(fdto, ov->nodes[fixups].offset);
+       prop >= 0; prop = fdt_next_property_offset(fdto, prop)) {
+    offsets = fdt_getprop_by_offset(fdto, prop, &name, &len);
+    if (offsets == NULL) return len;
+
+    val = fdt_getprop_w(fdto, ov->nodes[node].offset, name, &val_len);
+    if (val == NULL) return -FDT_ERR_NOTFOUND;
+
+    for (i = 0; i + (int)sizeof(fdt32_t) <= len; i += sizeof(fdt32_t)) {
+      off = fdt32_to_cpu(offsets[i / sizeof(fdt32_t)]);
+      if (off < 0 || off + (int)sizeof(fdt32_t) > val_len)
+        return -FDT_ERR_BADSTRUCTURE;
+      fdt_ov_add_u32(val + off, delta);
+    }
+  }
+  if (prop != -FDT_ERR_NOTFOUND) return prop;
+
+  for (sub = fixups + 1; sub < ov->nodes[fixups].next;
+       sub = ov->nodes[sub].next) {
+    name = fdt_ov_node_name(ov, sub);
+    target = fdt_ov_find_child(ov, node, name, dto_strlen(name));
+    if (target < 0) return -FDT_ERR_NOTFOUND;
+
+    err = fdt_ov_local_fixup_node(ctx, target, sub, delta);
+    if (err < 0) return err;
+  }
+  return 0;
+}
+
+static int fdt_ov_local_fixups(struct fdt_ov_ctx *ctx) {
+  uint32_t delta = ctx->base_index.max_phandle;
+  int fixups, err;
+
+  if (delta > 0) fdt_ov_increase_phandles(ctx, delta);
+
+  fixups = fdt_ov_find_child(&ctx->ov_index, 0, "__local_fixups__", 16);
+  if (fixups < 0) return 0;
+
+  err = fdt_ov_local_fixup_node(ctx, 0, fixups, delta);
+  if (err < 0) dto_error("failed to perform local fixups in overlay\n");
+  return err;
+}
+
+/* END of fixing up the overlay in place. */
+
+/* BEGIN of collecting fragments. */
+
+static int fdt_ov_item_cmp(const void *a, const void *b) {
+  const struct fdt_ov_item *ia = a, *ib = b;
+
+  if (ia->base != ib->base) return ia->base - ib->base;
+  if (ia->frag != ib->frag) return ia->frag - ib->frag;
+  return ia->node - ib->node;
+}
+
+static int fdt_ov_collect_fragments(struct fdt_ov_ctx *ctx) {
+  const struct fdt_ov_index *ov = &ctx->ov_index;
+  const void *fdto = ctx->fdto;
+  const fdt32_t *target_phandle;
+  const char *target_path;
+  int frag, offset, count = 0, target, overlay, len;
+
+  for (frag = 1; frag < ov->count; frag = ov->nodes[frag].next) count++;
+  if (count == 0) return 0;
+
+  ctx->frags = dto_malloc(count * sizeof(*ctx->frags));
+  if (ctx->frags == NULL) return -FDT_ERR_NOSPACE;
+
+  for (frag = 1; frag < ov->count; frag = ov->nodes[frag].next) {
+    offset = ov->nodes[frag].offset;
+    target_phandle = fdt_getprop(fdto, offset, "target", &len);
+    if (target_phandle != NULL) {
+      if (len != sizeof(*target_phandle)) continue;
+      target = fdt_ov_find_phandle(&ctx->base_index,
+                                   fdt32_to_cpu(*target_phandle));
+      if (target < 0) {
+        dto_error("failed to find target %04x\n",
+                  fdt32_to_cpu(*target_phandle));
+        continue;
+      }
+    } else {
+      target_path = fdt_getprop(fdto, offset, "target-path", &len);
+      if (target_path == NULL) continue;
+
+      target = fdt_ov_find_path(&ctx->base_index, target_path,
+                                len > 0 ? len - 1 : 0);
+      if (target < 0) {
+        dto_error("failed to find target-path %s\n", target_path);
+        continue;
+      }
+    }
+
+    overlay = fdt_ov_find_child(ov, frag, "__overlay__", 11);
+    if (overlay < 0) {
+      dto_error("missing __overlay__ sub-node\n");
+      continue;
+    }
+
+    /* The overlay index is in document order, so it orders fragments too */
+    ctx->frags[ctx->frag_count].base = target;
+    ctx->frags[ctx->frag_count].frag = frag;
+    ctx->frags[ctx->frag_count].node = overlay;
+    ctx->frag_count++;
+  }
+
+  dto_qsort(ctx->frags, ctx->frag_count, sizeof(*ctx->frags),
+            fdt_ov_item_cmp);
+  return 0;
+}
+
+/* Returns the first fragment whose target index is not below @index. */
+static int fdt_ov_first_fragment(const struct fdt_ov_ctx *ctx, int index) {
+  int s = 0, e = ctx->frag_count;
+
+  while (s < e) {
+    int mid = s + ((e - s) >> 1);
+    if (ctx->frags[mid].base < index)
+      s = mid + 1;
+    else
+      e = mid;
+  }
+  return s;
+}
+
+/* Tells whether a fragment targets base node @index or a node below it. */
+static int fdt_ov_subtree_targeted(const struct fdt_ov_ctx *ctx, int index) {
+  int i = fdt_ov_first_fragment(ctx, index);
+
+  return i < ctx->frag_count &&
+         ctx->frags[i].base < ctx->base_index.nodes[index].next;
+}
+
+/* END of collecting fragments. */
+
+/* BEGIN of writing the merged tree. */
+
+static void *fdt_ov_grab(struct fdt_ov_ctx *ctx, int len) {
+  void *p;
+
+  if (len > ctx->out_max - ctx->out_len) return NULL;
+  p = ctx->out + ctx->out_len;
+  ctx->out_len += len;
+  return p;
+}
+
+static int fdt_ov_emit(struct fdt_ov_ctx *ctx, const void *data, int len) {
+  void *p = fdt_ov_grab(ctx, len);
+
+  if (p == NULL) return -FDT_ERR_NOSPACE;
+  dto_memcpy(p, data, len);
+  return 0;
+}
+
+static int fdt_ov_emit_tag(struct fdt_ov_ctx *ctx, uint32_t tag) {
+  fdt32_t val = cpu_to_fdt32(tag);
+
+  return fdt_ov_emit(ctx, &val, sizeof(val));
+}
+
+static int fdt_ov_emit_prop(struct fdt_ov_ctx *ctx, int nameoff,
+                            const void *val, int len) {
+  struct fdt_property *prop =
+      fdt_ov_grab(ctx, sizeof(*prop) + FDT_TAGALIGN(len));
+
+  if (prop == NULL) return -FDT_ERR_NOSPACE;
+  prop->tag = cpu_to_fdt32(FDT_PROP);
+  prop->nameoff = cpu_to_fdt32(nameoff);
+  prop->len = cpu_to_fdt32(len);
+  dto_memcpy(prop->data, val, len);
+  dto_memset(prop->data + len, 0, FDT_TAGALIGN(len) - len);
+  return 0;
+}
+
+/* Emits an overlay property under a name from the merged strings block. */
+static int fdt_ov_emit_overlay_prop(struct fdt_ov_ctx *ctx,
+                                    const struct fdt_property *prop) {
+  const char *name = fdt_string(ctx->fdto, fdt32_to_cpu(prop->nameoff));
+  int nameoff = fdt_ov_add_string(ctx, name, dto_strlen(name));
+
+  if (nameoff < 0) return nameoff;
+  return fdt_ov_emit_prop(ctx, nameoff, prop->data, fdt32_to_cpu(prop->len));
+}
+
+/* Copies a new overlay subtree that nothing else merges into. */
+static int fdt_ov_copy_overlay(struct fdt_ov_ctx *ctx, int node) {
+  const void *fdto = ctx->fdto;
+  int offset = ctx->ov_index.nodes[node].offset, next, depth = 0, err;
+  uint32_t tag;
+
+  do {
+    tag = fdt_next_tag(fdto, offset, &next);
+    if (next < 0) return next;
+
+    switch (tag) {
+      case FDT_BEGIN_NODE:
+        depth++;
+        err = fdt_ov_emit(ctx, _fdt_offset_ptr(fdto, offset), next - offset);
+        break;
+      case FDT_END_NODE:
+        depth--;
+        err = fdt_ov_emit_tag(ctx, FDT_END_NODE);
+        break;
+      case FDT_PROP:
+        err = fdt_ov_emit_overlay_prop(ctx, _fdt_offset_ptr(fdto, offset));
+        break;
+      case FDT_NOP:
+        err = 0;
+        break;
+      default:
+        return -FDT_ERR_BADSTRUCTURE;
+    }
+    if (err < 0) return err;
+    offset = next;
+  } while (depth > 0);
+
+  return 0;
+}
+
+static int fdt_ov_flush(struct fdt_ov_ctx *ctx, int *from, int to) {
+  int err = 0;
+
+  if (*from >= 0)
+    err = fdt_ov_emit(ctx, _fdt_offset_ptr(ctx->base, *from), to - *from);
+  *from = -1;
+  return err;
+}
+
+static int fdt_ov_merge_node(struct fdt_ov_ctx *ctx, int index,
+                             const struct fdt_ov_item *items, int count);
+
+/*
+ * Writes the subnodes of base node @index (-1 for a new node) merged with
+ * the subnodes of @items and with the fragments targeting its children.
+ */
+static int fdt_ov_merge_subnodes(struct fdt_ov_ctx *ctx, int index,
+                                 const struct fdt_ov_item *items, int count) {
+  const struct fdt_ov_index *base = &ctx->base_index;
+  const struct fdt_ov_index *ov = &ctx->ov_index;
+  struct fdt_ov_item *pairs = NULL, *group = NULL;
+  const char *name;
+  int n = 0, np = 0, first = 0, end = 0, k, i, j, g, c, sub, len;
+  int copy_from = -1, copy_to = 0, err = 0;
+
+  for (k = 0; k < count; k++) {
+    for (sub = items[k].node + 1; sub < ov->nodes[items[k].node].next;
+         sub = ov->nodes[sub].next)
+      n++;
+  }
+  if (index >= 0) {
+    first = fdt_ov_first_fragment(ctx, index + 1);
+    end = fdt_ov_first_fragment(ctx, base->nodes[index].next);
+    n += end - first;
+  }
+
+  if (n > 0) {
+    pairs = dto_malloc(n * sizeof(*pairs));
+    if (count > 0) group = dto_malloc(count * sizeof(*group));
+    if (pairs == NULL || (count > 0 && group == NULL)) {
+      err = -FDT_ERR_NOSPACE;
+      goto out;
+    }
+  }
+
+  for (k = 0; k < count; k++) {
+    for (sub = items[k].node + 1; sub < ov->nodes[items[k].node].next;
+         sub = ov->nodes[sub].next) {
+      name = fdt_ov_node_name(ov, sub);
+      pairs[np].base =
+          index >= 0 ? fdt_ov_find_child(base, index, name, dto_strlen(name))
+                     : -1;
+      pairs[np].frag = items[k].frag;
+      pairs[np].node = sub;
+      np++;
+    }
+  }
+  for (i = first; i < end; i++) {
+    if (base->nodes[ctx->frags[i].base].parent == index)
+      pairs[np++] = ctx->frags[i];
+  }
+  if (np > 1) dto_qsort(pairs, np, sizeof(*pairs), fdt_ov_item_cmp);
+
+  /* New nodes sort first; the base children follow in document order */
+  for (i = 0; i < np && pairs[i].base < 0; i++)
+    ;
+
+  if (index >= 0) {
+    for (c = index + 1; c < base->nodes[index].next; c = base->nodes[c].next) {
+      for (j = i; j < np && pairs[j].base == c; j++)
+        ;
+      if (j == i && !fdt_ov_subtree_targeted(ctx, c)) {
+        /* Untouched siblings are copied in one go */
+        if (copy_from < 0) copy_from = base->nodes[c].offset;
+        copy_to = base->nodes[c].end;
+        continue;
+      }
+      err = fdt_ov_flush(ctx, &copy_from, copy_to);
+      if (err < 0) goto out;
+      err = fdt_ov_merge_node(ctx, c, pairs + i, j - i);
+      if (err < 0) goto out;
+      i = j;
+    }
+    err = fdt_ov_flush(ctx, &copy_from, copy_to);
+    if (err < 0) goto out;
+  }
+
+  /* Nodes the base does not have, merged by name across the overlay nodes */
+  for (i = 0; i < np && pairs[i].base < 0; i++) {
+    if (pairs[i].node < 0) continue;
+    group[0] = pairs[i];
+    g = 1;
+    if (count > 1) {
+      name = fdt_ov_node_name(ov, pairs[i].node);
+      len = dto_strlen(name);
+      for (j = i + 1; j < np && pairs[j].base < 0; j++) {
+        if (pairs[j].node >= 0 &&
+            fdt_ov_name_eq(fdt_ov_node_name(ov, pairs[j].node), name, len)) {
+          group[g++] = pairs[j];
+          pairs[j].node = -1;
+        }
+      }
+    }
+    err = fdt_ov_merge_node(ctx, -1, group, g);
+    if (err < 0) goto out;
+  }
+
+out:
+  dto_free(group);
+  dto_free(pairs);
+  return err;
+}
+
+/*
+ * Writes base node @index (-1 for a node the base lacks) with @items merged
+ * into it. @items are sorted by fragment, so later entries win.
+ */
+static int fdt_ov_merge_node(struct fdt_ov_ctx *ctx, int index,
+                             const struct fdt_ov_item *items, int count) {
+  const void *base = ctx->base;
+  const void *fdto = ctx->fdto;
+  const struct fdt_ov_node *ov_nodes = ctx->ov_index.nodes;
+  const struct fdt_property *prop, *ov_prop;
+  const char *name;
+  int offset = -1, poff, len, k, j, err;
+
+  if (index < 0 && count == 1) return fdt_ov_copy_overlay(ctx, items[0].node);
+
+  if (index >= 0) {
+    offset = ctx->base_index.nodes[index].offset;
+    name = fdt_ov_node_name(&ctx->base_index, index);
+  } else {
+    name = fdt_ov_node_name(&ctx->ov_index, items[0].node);
+  }
+  len = dto_strlen(name);
+  prop = fdt_ov_grab(ctx, FDT_TAGSIZE + FDT_TAGALIGN(len + 1));
+  if (prop == NULL) return -FDT_ERR_NOSPACE;
+  dto_memset((void *)prop, 0, FDT_TAGSIZE + FDT_TAGALIGN(len + 1));
+  *(fdt32_t *)prop = cpu_to_fdt32(FDT_BEGIN_NODE);
+  dto_memcpy((char *)prop + FDT_TAGSIZE, name, len);
+
+  /* Base properties, replaced by the last overlay node that has them */
+  if (index >= 0) {
+    for (poff = fdt_first_property_offset(base, offset); poff >= 0;
+         poff = fdt_next_property_offset(base, poff)) {
+      prop = _fdt_offset_ptr(base, poff);
+      name = fdt_string(base, fdt32_to_cpu(prop->nameoff));
+      len = dto_strlen(name);
+
+      ov_prop = NULL;
+      for (k = count - 1; k >= 0 && ov_prop == NULL; k--)
+        ov_prop = fdt_get_property_namelen(fdto, ov_nodes[items[k].node].offset,
+                                           name, len, NULL);
+      if (ov_prop == NULL && index == 0)
+        ov_prop = fdt_get_property_namelen(fdto, 0, name, len, NULL);
+
+      if (ov_prop != NULL)
+        err = fdt_ov_emit_prop(ctx, fdt32_to_cpu(prop->nameoff), ov_prop->data,
+                               fdt32_to_cpu(ov_prop->len));
+      else
+        err = fdt_ov_emit(ctx, prop,
+                          sizeof(*prop) + FDT_TAGALIGN(fdt32_to_cpu(prop->len)));
+      if (err < 0) return err;
+    }
+    if (poff != -FDT_ERR_NOTFOUND) return poff;
+  }
+
+  /* Properties only the overlay nodes have */
+  for (k = 0; k < count; k++) {
+    for (poff = fdt_first_property_offset(fdto, ov_nodes[items[k].node].offset);
+         poff >= 0; poff = fdt_next_property_offset(fdto, poff)) {
+      prop = _fdt_offset_ptr(fdto, poff);
+      name = fdt_string(fdto, fdt32_to_cpu(prop->nameoff));
+      len = dto_strlen(name);
+
+      if (index >= 0 && fdt_get_property_namelen(base, offset, name, len, NULL))
+        continue;
+      for (j = k + 1; j < count; j++) {
+        if (fdt_get_property_namelen(fdto, ov_nodes[items[j].node].offset,
+                                     name, len, NULL))
+          break;
+      }
+      if (j < count) continue;
+
+      err = fdt_ov_emit_overlay_prop(ctx, prop);
+      if (err < 0) return err;
+    }
+    if (poff != -FDT_ERR_NOTFOUND) return poff;
+  }
+
+  err = fdt_ov_merge_subnodes(ctx, index, items, count);
+  if (err < 0) return err;
+
+  return fdt_ov_emit_tag(ctx, FDT_END_NODE);
+}
+
+/* END of writing the merged tree. */
+
+static void fdt_ov_ctx_free(struct fdt_ov_ctx *ctx) {
+  fdt_ov_index_free(&ctx->base_index);
+  fdt_ov_index_free(&ctx->ov_index);
+  dto_free(ctx->symtab);
+  dto_free(ctx->frags);
+  dto_free(ctx->strtab);
+  dto_free(ctx->new_strings);
+}
+
+/*
+ * Merges @fdto into @base and writes the result to @out, which must not
+ * overlap @base. @fdto is fixed up in place. The result has the layout
+ * fdt_open_into() produces with a totalsize of @out_size.
+ */
+static int fdt_overlay_merge(const void *base, void *fdto, void *out,
+                             int out_size) {
+  struct fdt_ov_ctx ctx;
+  int rsv_off, rsv_size, struct_off, strings_off, roots, err;
+
+  dto_memset(&ctx, 0, sizeof(ctx));
+
+  err = fdt_check_header(base);
+  if (err < 0) goto out;
+  err = fdt_check_header(fdto);
+  if (err < 0) goto out;
+  if (fdt_version(base) < 17 || fdt_version(fdto) < 17) {
+    err = -FDT_ERR_BADVERSION;
+    goto out;
+  }
+
+  ctx.base = base;
+  ctx.fdto = fdto;
+  ctx.base_strings = (const char *)base + fdt_off_dt_strings(base);
+  ctx.base_strings_len = fdt_size_dt_strings(base);
+
+  err = fdt_ov_index_build(&ctx.base_index, base);
+  if (err < 0) goto out;
+  err = fdt_ov_index_build(&ctx.ov_index, fdto);
+  if (err < 0) goto out;
+  err = fdt_ov_init_strings(&ctx);
+  if (err < 0) goto out;
+
+  err = fdt_ov_local_fixups(&ctx);
+  if (err < 0) goto out;
+  err = fdt_ov_do_fixups(&ctx);
+  if (err < 0) goto out;
+  err = fdt_ov_collect_fragments(&ctx);
+  if (err < 0) goto out;
+
+  rsv_off = FDT_ALIGN(sizeof(struct fdt_header), 8);
+  rsv_size = (fdt_num_mem_rsv(base) + 1) * sizeof(struct fdt_reserve_entry);
+  struct_off = rsv_off + rsv_size;
+  if (struct_off + ctx.base_strings_len > out_size) {
+    err = -FDT_ERR_NOSPACE;
+    goto out;
+  }
+  ctx.out = (char *)out + struct_off;
+  ctx.out_max = out_size - struct_off - ctx.base_strings_len;
+
+  /* Fragments targeting the root sort first */
+  for (roots = 0; roots < ctx.frag_count && ctx.frags[roots].base == 0; roots++)
+    ;
+  err = fdt_ov_merge_node(&ctx, 0, ctx.frags, roots);
+  if (err < 0) goto out;
+  err = fdt_ov_emit_tag(&ctx, FDT_END);
+  if (err < 0) goto out;
+
+  strings_off = struct_off + ctx.out_len;
+  if (ctx.new_strings_len > ctx.out_max - ctx.out_len) {
+    err = -FDT_ERR_NOSPACE;
+    goto out;
+  }
+  dto_memcpy((char *)out + strings_off, ctx.base_strings,
+             ctx.base_strings_len);
+  dto_memcpy((char *)out + strings_off + ctx.base_strings_len,
+             ctx.new_strings, ctx.new_strings_len);
+  dto_memcpy((char *)out + rsv_off,
+             (const char *)base + fdt_off_mem_rsvmap(base), rsv_size);
+
+  dto_memset(out, 0, rsv_off);
+  fdt_set_magic(out, FDT_MAGIC);
+  fdt_set_totalsize(out, out_size);
+  fdt_set_off_dt_struct(out, struct_off);
+  fdt_set_off_dt_strings(out, strings_off);
+  fdt_set_off_mem_rsvmap(out, rsv_off);
+  fdt_set_version(out, 17);
+  fdt_set_last_comp_version(out, 16);
+  fdt_set_boot_cpuid_phys(out, fdt_boot_cpuid_phys(base));
+  fdt_set_size_dt_strings(out, ctx.base_strings_len + ctx.new_strings_len);
+  fdt_set_size_dt_struct(out, ctx.out_len);
+
+out:
+  fdt_ov_ctx_free(&ctx);
+  return err;
+}
+
+int ufdt_fdt_overlay_apply(void *fdt, void *fdto) {
+  int size = fdt_totalsize(fdt);
+  void *out;
+  int err;
+
+  out = dto_malloc(size);
+  if (out == NULL) return -FDT_ERR_NOSPACE;
+
+  err = fdt_overlay_merge(fdt, fdto, out, size);
+  if (err == 0) dto_memcpy(fdt, out, size);
+
+  dto_free(out);
+  return err;
+}
+
+struct fdt_header *ufdt_fdt_apply_multi_overlay(
+    struct fdt_header *main_fdt_header, size_t main_fdt_size,
+    struct fdt_entry_node *overlay_dt_list) {
+  struct fdt_entry_node *it;
+  const void *cur = main_fdt_header;
+  void *bufs[2] = {NULL, NULL};
+  size_t out_fdt_size;
+  int err, i = 0;
+
+  if (main_fdt_header == NULL ||
+      main_fdt_size < 8 ||
+      main_fdt_size != fdt_totalsize(main_fdt_header)) {
+    dto_error("Bad main fdt!\n");
+    return NULL;
+  }
+  if (overlay_dt_list == NULL) {
+    dto_error("Dts list is invalid: NULL!\n");
+    return NULL;
+  }
+
+  out_fdt_size = main_fdt_size;
+  for (it = overlay_dt_list; it != NULL; it = it->next, i++) {
+    if ((void *)it->address == NULL ||
+        it->size < 8 ||
+        it->size != fdt_totalsize((void *)it->address)) {
+      dto_error("Bad overlay fdt! index: %d\n", i);
+      return NULL;
+    }
+    out_fdt_size += it->size;
+  }
+
+  /* Each overlay reads the previous result and writes the other buffer */
+  bufs[0] = dto_malloc(out_fdt_size);
+  if (overlay_dt_list->next != NULL) bufs[1] = dto_malloc(out_fdt_size);
+  if (bufs[0] == NULL || (overlay_dt_list->next != NULL && bufs[1] == NULL)) {
+    dto_error("failed to allocate memory for DTB blob with overlays\n");
+    goto fail;
+  }
+
+  for (it = overlay_dt_list, i = 0; it != NULL; it = it->next, i++) {
+    err = fdt_overlay_merge(cur, (void *)it->address, bufs[i & 1],
+                            out_fdt_size);
+    if (err < 0) {
+      dto_error("Failed to apply device tree, index: %d (%s)\n", i,
+                fdt_strerror(err));
+      goto fail;
+    }
+    cur = bufs[i & 1];
+  }
+
+  dto_free(bufs[i & 1]);
+  return (struct fdt_header *)cur;
+
+fail:
+  dto_free(bufs[0]);
+  dto_free(bufs[1]);
+  return NULL;
+}
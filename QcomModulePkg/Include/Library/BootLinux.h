@@ -92,6 +92,9 @@
 // Size reserved for DT image
 #define DT_SIZE_2MB      (2 * 1024 * 1024)
 
+/* Ramdisks smaller than this are read along with the boot image and copied */
+#define RAMDISK_DEFER_MIN_SIZE (1024 * 1024)
+
 #define KERNEL_32BIT_LOAD_OFFSET 0x8000
 #define KERNEL_64BIT_LOAD_OFFSET 0x80000
 
@@ -100,6 +103,14 @@ typedef enum {
   KERNEL_64BIT
 } KernelMode;
 
+typedef enum {
+  KERNEL_COMP_NONE = 0,
+  KERNEL_COMP_GZIP,
+  KERNEL_COMP_LZ4,
+  KERNEL_COMP_ZSTD,
+  KERNEL_COMP_MAX
+} KernelCompression;
+
 typedef enum {
  LOAD_ADDR_NONE = 0,
  LOAD_ADDR_KERNEL,
@@ -142,6 +153,8 @@ typedef struct BootInfo {
   UINT32 VBCmdLineFilledLen;
   VOID *VBData;
   UINT32 HeaderVersion;
+  /* Ramdisk of Images[0] was left on Pname, see LoadImage */
+  BOOLEAN RamdiskDeferred;
 } BootInfo;
 
 typedef struct BootLinuxParamlist {
@@ -174,9 +187,11 @@ typedef struct BootLinuxParamlist {
 
   CHAR8 *FinalCmdLine;
   CHAR8 *CmdLine;
+  /* Partition to read the ramdisk from, NULL if it is in ImageBuffer */
+  CHAR16 *RamdiskPname;
   BOOLEAN BootingWith32BitKernel;
   BOOLEAN BootingWithPatchedKernel;
-  BOOLEAN BootingWithGzipPkgKernel;
+  KernelCompression KernelComp;
 } BootParamlist;
 
 EFI_STATUS
@@ -189,7 +204,8 @@ CheckImageHeader (VOID *ImageHdrBuffer,
                   BOOLEAN BootIntoRecovery);
 EFI_STATUS
 LoadImage (BOOLEAN BootIntoRecovery, CHAR16 *Pname,
-           VOID **ImageBuffer, UINT32 *ImageSizeActual);
+           VOID **ImageBuffer, UINT32 *ImageSizeActual,
+           BOOLEAN *RamdiskDeferred);
 EFI_STATUS
 LaunchApp (IN UINT32 Argc, IN CHAR8 **Argv);
 BOOLEAN TargetBuildVariantUser (VOID);
@@ -30,6 +30,8 @@
 #ifndef __BOOT_STATS_H
 #define __BOOT_STATS_H
 
+#include <Library/FdtEdit.h>
+
 typedef enum {
   BS_BL_START = 0,
   BS_KERNEL_ENTRY,
@@ -40,6 +42,33 @@ typedef enum {
   BS_MAX,
 } BS_ENTRY;
 
+/* Named spans of bootloader time, kept in a ring and handed to the kernel
+ * under /chosen along with a few named values. Names must be static
+ * strings. */
+#define BS_SPAN_MAX 64
+#define BS_SPAN_CELLS 3 /* start_us, end_us, depth */
+#define BS_VALUE_MAX 16
+
+typedef struct {
+  CONST CHAR8 *Name;
+  UINT32 StartUs;
+  UINT32 EndUs;
+  UINT32 Depth;
+} BS_SPAN;
+
+typedef struct {
+  CONST CHAR8 *Name;
+  UINT32 Value;
+} BS_VALUE;
+
 void
 BootStatsSetTimeStamp (BS_ENTRY BootStatId);
+UINT32
+BootStatsSpanBegin (CONST CHAR8 *Name);
+VOID
+BootStatsSpanEnd (UINT32 SpanId);
+VOID
+BootStatsSetValue (CONST CHAR8 *Name, UINT32 Value);
+INT32
+BootStatsExport (FDT_EDIT_LIST *Edits, INT32 Offset);
 #endif
@@ -0,0 +1,53 @@
+/* Copyright (c) 2026, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimer in the documentation and/or other materials provided
+ *  with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __CRC32_H__
+#define __CRC32_H__
+
+#include <Uefi.h>
+
+/* CRC-32 as used by GPT, zlib and sparse images (IEEE 802.3, reflected).
+ * Crc is the CRC of the data before, 0 to start; Crc32Update (0, Data, Len)
+ * gives the same value as gBS->CalculateCrc32 ().
+ */
+UINT32
+Crc32Update (UINT32 Crc, CONST VOID *Data, UINTN Len);
+
+/* CRC of Len bytes of Pattern repeated, as written by a sparse fill chunk.
+ * Takes O(log Len) time, so whole partitions of fill cost nothing.
+ */
+UINT32
+Crc32Fill (UINT32 Crc, UINT32 Pattern, UINT64 Len);
+
+/* CRC of data A followed by LenB bytes of data B, from their CRCs alone.
+ * Lets one pass over B extend several running CRCs.
+ */
+UINT32
+Crc32Combine (UINT32 CrcA, UINT32 CrcB, UINT64 LenB);
+
+#endif
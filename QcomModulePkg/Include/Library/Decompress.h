@@ -39,4 +39,41 @@ decompress (unsigned char *,
             unsigned int,
             unsigned int *,
             unsigned int *);
+
+/* Scratch memory decompress_scratch () needs: the inflate state and its
+ * 32 KB window.
+ */
+#define GZIP_SCRATCH_SIZE (64 * 1024)
+
+int
+decompress_scratch (unsigned char *,
+                    unsigned int,
+                    unsigned char *,
+                    unsigned int,
+                    unsigned int *,
+                    unsigned int *,
+                    void *,
+                    const char **);
+
+int
+is_lz4_package (unsigned char *, unsigned int);
+
+int
+lz4_decompress (unsigned char *,
+                unsigned int,
+                unsigned char *,
+                unsigned int,
+                unsigned int *,
+                unsigned int *);
+
+int
+is_zstd_package (unsigned char *, unsigned int);
+
+int
+zstd_decompress (unsigned char *,
+                 unsigned int,
+                 unsigned char *,
+                 unsigned int,
+                 unsigned int *,
+                 unsigned int *);
 #endif /* __PLATFORM_MSM_SHARED_DECOMPRESS_H */
@@ -0,0 +1,118 @@
+/* Copyright (c) 2026, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimer in the documentation and/or other materials provided
+ *  with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __FDTEDIT_H__
+#define __FDTEDIT_H__
+
+#include <Uefi.h>
+#include "libfdt.h"
+
+/* Batched device tree property edits.
+ *
+ * Every fdt_setprop/fdt_appendprop on a live blob memmoves everything behind
+ * the property. An edit list instead records the edits against node offsets
+ * of the unmodified blob and FdtEditApply then writes the whole result in one
+ * pass over the struct block. Edits to the same property are applied in the
+ * order they were added. */
+
+typedef enum {
+  FDT_EDIT_SET,
+  FDT_EDIT_DELETE,
+  FDT_EDIT_APPEND,
+  FDT_EDIT_APPEND_STRING,
+} FDT_EDIT_OP;
+
+typedef struct {
+  INT32 Node;
+  CONST CHAR8 *Name; /* Must stay valid until FdtEditApply */
+  FDT_EDIT_OP Op;
+  UINT32 ValOffset; /* Into FDT_EDIT_LIST.Data */
+  UINT32 Len;
+} FDT_EDIT;
+
+typedef struct {
+  FDT_EDIT *Edits;
+  UINT32 Count;
+  UINT32 MaxCount;
+  UINT8 *Data;
+  UINT32 DataLen;
+  UINT32 MaxDataLen;
+} FDT_EDIT_LIST;
+
+VOID
+FdtEditInit (FDT_EDIT_LIST *List);
+VOID
+FdtEditFree (FDT_EDIT_LIST *List);
+
+INT32
+FdtEditSetProp (FDT_EDIT_LIST *List,
+                INT32 Node,
+                CONST CHAR8 *Name,
+                CONST VOID *Val,
+                UINT32 Len);
+INT32
+FdtEditAppendProp (FDT_EDIT_LIST *List,
+                   INT32 Node,
+                   CONST CHAR8 *Name,
+                   CONST VOID *Val,
+                   UINT32 Len);
+INT32
+FdtEditDelProp (FDT_EDIT_LIST *List, INT32 Node, CONST CHAR8 *Name);
+
+INT32
+FdtEditSetPropU32 (FDT_EDIT_LIST *List,
+                   INT32 Node,
+                   CONST CHAR8 *Name,
+                   UINT32 Val);
+INT32
+FdtEditAppendPropU32 (FDT_EDIT_LIST *List,
+                      INT32 Node,
+                      CONST CHAR8 *Name,
+                      UINT32 Val);
+INT32
+FdtEditSetPropU64 (FDT_EDIT_LIST *List,
+                   INT32 Node,
+                   CONST CHAR8 *Name,
+                   UINT64 Val);
+INT32
+FdtEditAppendPropU64 (FDT_EDIT_LIST *List,
+                      INT32 Node,
+                      CONST CHAR8 *Name,
+                      UINT64 Val);
+/* Like fdt_appendprop_string, joins onto an existing string with a space */
+INT32
+FdtEditAppendPropString (FDT_EDIT_LIST *List,
+                         INT32 Node,
+                         CONST CHAR8 *Name,
+                         CONST CHAR8 *Str);
+
+UINT32
+FdtEditSize (CONST VOID *Fdt, CONST FDT_EDIT_LIST *List);
+INT32
+FdtEditApply (VOID *Fdt, UINT32 BufSize, CONST FDT_EDIT_LIST *List);
+#endif
@@ -51,6 +51,7 @@
 #include <Library/UefiRuntimeServicesTableLib.h>
 #include <PiDxe.h>
 #include <Protocol/BlockIo.h>
+#include <Protocol/BlockIo2.h>
 #include <Protocol/DevicePath.h>
 #include <Protocol/EFIEraseBlock.h>
 #include <Protocol/EFIMdtp.h>
@@ -141,6 +142,10 @@ typedef struct {
 EFI_STATUS
 LoadImageFromPartition (VOID *ImageBuffer, UINT32 *ImageSize, CHAR16 *Pname);
 
+/* Load a block aligned byte range of a partition to buffer */
+EFI_STATUS
+LoadPartitionRange (CHAR16 *Pname, UINT64 Offset, VOID *Buffer, UINT32 Size);
+
 EFI_STATUS
 ReadWriteDeviceInfo (vb_device_state_op_t Mode, void *DevInfo, UINT32 Sz);
 
@@ -138,6 +138,43 @@ typedef struct DtInfo {
   VOID *Dtb;
 } DtInfo;
 
+typedef struct DtbMatchProps {
+  CONST CHAR8 *PlatProp;
+  CONST CHAR8 *BoardProp;
+  CONST CHAR8 *PmicProp;
+  INT32 LenPlatId;
+  INT32 LenBoardId;
+  INT32 LenPmicId;
+} DtbMatchProps;
+
+/*
+ * Index of the DTBs appended to a boot image, cached in a UEFI variable and
+ * keyed by the image id from the boot image header. Each entry holds the raw
+ * qcom,msm-id, qcom,board-id and qcom,pmic-id values (in that order, padded
+ * to 4 bytes) so the board match runs without parsing every blob.
+ */
+#define DTB_INDEX_VERSION 1
+#define DTB_INDEX_MAX_SIZE (16 * 1024)
+#define DTB_INDEX_ID_WORDS 8
+#define DTB_INDEX_FLAG_RTIC BIT0
+
+typedef struct DtbIndexHdr {
+  UINT32 Version;
+  UINT32 ImageId[DTB_INDEX_ID_WORDS];
+  UINT32 DtbOffset;
+  UINT32 Count;
+  UINT32 Size;
+} DtbIndexHdr;
+
+typedef struct DtbIndexEntry {
+  UINT32 Offset; /* from the first DTB */
+  UINT32 Size;
+  UINT16 LenPlatId;
+  UINT16 LenBoardId;
+  UINT16 LenPmicId;
+  UINT16 Flags;
+} DtbIndexEntry;
+
 /*
  * For DTB V1: The DTB entries would be of the format
  * qcom,msm-id = <msm8974, CDP, rev_1>; (3 * sizeof(uint32_t))
@@ -259,7 +296,11 @@ DeviceTreeAppended (void *kernel,
                     UINT32 dtb_offset,
                     void *tags);
 VOID *
-GetSocDtb (void *kernel, UINT32 kernel_size, UINT32 dtb_offset, void *tags);
+GetSocDtb (void *kernel,
+           UINT32 kernel_size,
+           UINT32 dtb_offset,
+           void *tags,
+           CONST UINT32 *image_id);
 BOOLEAN GetDtboNeeded (VOID);
 VOID *
 GetBoardDtb (BootInfo *Info, VOID *DtboImgBuffer);
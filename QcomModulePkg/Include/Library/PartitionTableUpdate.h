@@ -204,6 +204,10 @@ INT32
 GetPartitionIdxInLun (CHAR16 *Pname, UINT32 Lun);
 INT32
 GetPartitionIndex (CHAR16 *PartitionName);
+INT32
+GetPartitionIndexWithSuffix (CONST CHAR16 *Pname, CONST CHAR16 *Suffix);
+EFI_STATUS
+GetPartitionHandleInfo (CONST CHAR16 *Pname, HandleInfo **Info);
 BOOLEAN
 PartitionHasMultiSlot (CONST CHAR16 *Pname);
 EFI_STATUS EnumeratePartitions (VOID);
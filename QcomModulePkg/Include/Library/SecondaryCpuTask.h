@@ -0,0 +1,53 @@
+/* Copyright (c) 2026, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimer in the documentation and/or other materials provided
+ *  with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __SECONDARY_CPU_TASK_H__
+#define __SECONDARY_CPU_TASK_H__
+
+#include <Uefi.h>
+
+typedef VOID (*SECONDARY_CPU_FUNC) (VOID *Context);
+
+typedef struct {
+  SECONDARY_CPU_FUNC Func;
+  VOID *Context;
+} SECONDARY_CPU_TASK;
+
+/* Runs Task->Func (Task->Context) on a secondary CPU, powering one on
+ * through the AVB hash workers if none is up. Func must not call UEFI
+ * services, allocate memory or print. Returns an error if no CPU could take
+ * the task; the caller then runs it itself.
+ */
+EFI_STATUS
+SecondaryCpuTaskStart (SECONDARY_CPU_TASK *Task);
+
+/* Waits for a started task to finish and powers off the CPU it brought up */
+VOID
+SecondaryCpuTaskWait (SECONDARY_CPU_TASK *Task);
+
+#endif /* __SECONDARY_CPU_TASK_H__ */
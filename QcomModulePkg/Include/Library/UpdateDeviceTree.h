@@ -32,6 +32,7 @@
 #include "libfdt.h"
 #include <Library/Board.h>
 #include <Library/DebugLib.h>
+#include <Library/FdtEdit.h>
 #include <Library/LinuxLoaderLib.h>
 #include <Library/MemoryAllocationLib.h>
 #include <Library/UefiBootServicesTableLib.h>
@@ -69,10 +70,16 @@ struct DisplaySplashBufferInfo {
 };
 
 INT32
-dev_tree_add_mem_info (VOID *fdt, UINT32 offset, UINT32 addr, UINT32 size);
+dev_tree_add_mem_info (FDT_EDIT_LIST *Edits,
+                       UINT32 offset,
+                       UINT32 addr,
+                       UINT32 size);
 
 INT32
-dev_tree_add_mem_infoV64 (VOID *fdt, UINT32 offset, UINT64 addr, UINT64 size);
+dev_tree_add_mem_infoV64 (FDT_EDIT_LIST *Edits,
+                          UINT32 offset,
+                          UINT64 addr,
+                          UINT64 size);
 
 EFI_STATUS
 UpdateDeviceTree (VOID *DeviceTreeLoadAddr,
@@ -82,7 +89,7 @@ UpdateDeviceTree (VOID *DeviceTreeLoadAddr,
                   BOOLEAN BootingWith32BitKernel);
 
 EFI_STATUS
-UpdateFstabNode (VOID *fdt);
+UpdateFstabNode (VOID *fdt, FDT_EDIT_LIST *Edits);
 
 UINT32
 fdt_check_header_ext (VOID *fdt);
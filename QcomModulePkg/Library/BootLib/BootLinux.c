@@ -33,6 +33,7 @@
 #include <Library/DeviceInfo.h>
 #include <Library/DrawUI.h>
 #include <Library/PartitionTableUpdate.h>
+#include <Library/SecondaryCpuTask.h>
 #include <Library/ShutdownServices.h>
 #include <Library/VerifiedBootMenu.h>
 #include <Library/HypervisorMvCalls.h>
@@ -194,6 +195,7 @@ STATIC EFI_STATUS
 UpdateKernelModeAndPkg (BootParamlist *BootParamlistPtr)
 {
   Kernel64Hdr *Kptr = NULL;
+  UINT8 *KernelImage = NULL;
 
   if (BootParamlistPtr == NULL ) {
     DEBUG ((EFI_D_ERROR, "Invalid input parameters\n"));
@@ -204,11 +206,18 @@ UpdateKernelModeAndPkg (BootParamlist *BootParamlistPtr)
   Kptr = (Kernel64Hdr *) (BootParamlistPtr->ImageBuffer +
                             BootParamlistPtr->PageSize);
 
-  if (is_gzip_package ((BootParamlistPtr->ImageBuffer +
-                 BootParamlistPtr->PageSize), BootParamlistPtr->KernelSize)) {
-      BootParamlistPtr->BootingWithGzipPkgKernel = TRUE;
+  KernelImage = BootParamlistPtr->ImageBuffer + BootParamlistPtr->PageSize;
+
+  BootParamlistPtr->KernelComp = KERNEL_COMP_NONE;
+  if (is_gzip_package (KernelImage, BootParamlistPtr->KernelSize)) {
+    BootParamlistPtr->KernelComp = KERNEL_COMP_GZIP;
+  } else if (is_lz4_package (KernelImage, BootParamlistPtr->KernelSize)) {
+    BootParamlistPtr->KernelComp = KERNEL_COMP_LZ4;
+  } else if (is_zstd_package (KernelImage, BootParamlistPtr->KernelSize)) {
+    BootParamlistPtr->KernelComp = KERNEL_COMP_ZSTD;
   }
-  else {
+
+  if (BootParamlistPtr->KernelComp == KERNEL_COMP_NONE) {
     if (!AsciiStrnCmp ((CHAR8 *) Kptr, PATCHED_KERNEL_MAGIC,
                        sizeof (PATCHED_KERNEL_MAGIC) - 1)) {
       BootParamlistPtr->BootingWithPatchedKernel = TRUE;
@@ -315,6 +324,8 @@ ApplyOverlay (BootParamlist *BootParamlistPtr,
 {
   VOID *FinalDtbHdr = AppendedDtHdr;
   VOID *TmpDtbHdr = NULL;
+  struct dto_mem_stats MemStats;
+  EFI_STATUS Status = EFI_SUCCESS;
 
   if (BootParamlistPtr == NULL ||
       AppendedDtHdr == NULL) {
@@ -335,16 +346,32 @@ ApplyOverlay (BootParamlist *BootParamlistPtr,
   TmpDtbHdr = ufdt_install_blob (AppendedDtHdr, fdt_totalsize (AppendedDtHdr));
   if (!TmpDtbHdr) {
     DEBUG ((EFI_D_ERROR, "ApplyOverlay: Install blob failed\n"));
-    return EFI_NOT_FOUND;
+    Status = EFI_NOT_FOUND;
+    goto exit;
   }
 
+#ifdef FDT_DIRECT_OVERLAY
+  /* Merges the flattened blobs directly, without unflattening the base */
+  FinalDtbHdr = ufdt_fdt_apply_multi_overlay (TmpDtbHdr,
+                                              fdt_totalsize (TmpDtbHdr),
+                                              DtsList);
+#else
   FinalDtbHdr = ufdt_apply_multi_overlay (TmpDtbHdr,
                                     fdt_totalsize (TmpDtbHdr),
                                     DtsList);
+#endif
   DeleteDtList (&DtsList);
+
+  dto_get_mem_stats (&MemStats);
+  DEBUG ((EFI_D_INFO, "ApplyOverlay: peak %u KB, %u KB in %u chunks\n",
+          (UINT32)(MemStats.peak / 1024), (UINT32)(MemStats.reserved / 1024),
+          (UINT32)MemStats.chunks));
+  BootStatsSetValue ("overlay_peak_bytes", (UINT32)MemStats.peak);
+
   if (!FinalDtbHdr) {
     DEBUG ((EFI_D_ERROR, "ApplyOverlay: ufdt apply overlay failed\n"));
-    return EFI_NOT_FOUND;
+    Status = EFI_NOT_FOUND;
+    goto exit;
   }
 
 out:
@@ -353,7 +380,8 @@ out:
             fdt_totalsize (FinalDtbHdr)) {
     DEBUG ((EFI_D_ERROR,
            "ApplyOverlay: After overlay DTB size exceeded than supported\n"));
-    return EFI_UNSUPPORTED;
+    Status = EFI_UNSUPPORTED;
+    goto exit;
   }
   /* If DeviceTreeLoadAddr == AppendedDtHdr
      CopyMem will not copy Source Buffer to Destination Buffer
@@ -362,8 +390,11 @@ out:
   gBS->CopyMem ((VOID *)BootParamlistPtr->DeviceTreeLoadAddr,
                 FinalDtbHdr,
                 fdt_totalsize (FinalDtbHdr));
+
+exit:
+  /* Releases the whole overlay arena, FinalDtbHdr included */
   post_overlay_free ();
-  return EFI_SUCCESS;
+  return Status;
 }
 
 STATIC UINT32
@@ -385,6 +416,7 @@ DTBImgCheckAndAppendDT (BootInfo *Info, BootParamlist *BootParamlistPtr)
   BOOLEAN DtboImgInvalid = FALSE;
   struct fdt_entry_node *DtsList = NULL;
   EFI_STATUS Status;
+  UINT32 Span;
   UINT32 HeaderVersion = 0;
   struct boot_img_hdr_v1 *BootImgHdrV1;
   struct boot_img_hdr_v2 *BootImgHdrV2;
@@ -488,7 +520,8 @@ DTBImgCheckAndAppendDT (BootInfo *Info, BootParamlist *BootParamlistPtr)
     SocDtb = GetSocDtb (ImageBuffer,
          DtbSize,
          BootParamlistPtr->DtbOffset,
-         (VOID *)BootParamlistPtr->DeviceTreeLoadAddr);
+         (VOID *)BootParamlistPtr->DeviceTreeLoadAddr,
+         ((boot_img_hdr *)BootParamlistPtr->ImageBuffer)->id);
 
     if (!SocDtb) {
       DEBUG ((EFI_D_ERROR,
@@ -546,9 +579,11 @@ DTBImgCheckAndAppendDT (BootInfo *Info, BootParamlist *BootParamlistPtr)
       }
     }
 
+    Span = BootStatsSpanBegin ("ApplyOverlay");
     Status = ApplyOverlay (BootParamlistPtr,
                            SocDtb,
                            DtsList);
+    BootStatsSpanEnd (Span);
     if (Status != EFI_SUCCESS) {
       DEBUG ((EFI_D_ERROR, "Error: Dtb overlay failed\n"));
       return Status;
@@ -557,11 +592,127 @@ DTBImgCheckAndAppendDT (BootInfo *Info, BootParamlist *BootParamlistPtr)
   return EFI_SUCCESS;
 }
 
+typedef int (*KernelDecompress) (unsigned char *,
+                                 unsigned int,
+                                 unsigned char *,
+                                 unsigned int,
+                                 unsigned int *,
+                                 unsigned int *);
+
+STATIC CONST struct {
+  CHAR8 *Name;
+  KernelDecompress Decompress;
+} KernelDecompressors[KERNEL_COMP_MAX] = {
+    [KERNEL_COMP_GZIP] = {"gzip", decompress},
+    [KERNEL_COMP_LZ4] = {"lz4", lz4_decompress},
+    [KERNEL_COMP_ZSTD] = {"zstd", zstd_decompress},
+};
+
+/* A gzip kernel inflating on a secondary CPU, see AsyncDecompressStart () */
+typedef struct {
+  SECONDARY_CPU_TASK Task;
+  BOOLEAN Started;
+  UINT8 *In;
+  UINT32 InLen;
+  UINT8 *Out;
+  UINT32 OutAvaiLen;
+  UINT32 Pos;
+  UINT32 OutLen;
+  INT32 Rc;
+  CONST CHAR8 *Error;
+  VOID *Scratch;
+  UINT64 StartMs;
+} ASYNC_DECOMPRESS;
+
+/* Compute VM kernel, inflated while the boot CPU prepares HLOS */
+STATIC ASYNC_DECOMPRESS CvmDecompress;
+
+#ifdef CVM_PARALLEL_LOAD
+/* Runs on the secondary CPU */
+STATIC VOID
+AsyncDecompressRun (VOID *Context)
+{
+  ASYNC_DECOMPRESS *Async = Context;
+
+  Async->Rc = decompress_scratch (Async->In, Async->InLen, Async->Out,
+                                  Async->OutAvaiLen, &Async->Pos,
+                                  &Async->OutLen, Async->Scratch,
+                                  &Async->Error);
+}
+
+/* Hands the gzip kernel of BootParamlistPtr to a secondary CPU. Leaves
+ * Async->Started clear if that is not possible, CompressedPkgCheck () then
+ * decompresses on the boot CPU as usual.
+ */
+STATIC VOID
+AsyncDecompressStart (BootParamlist *BootParamlistPtr,
+                      ASYNC_DECOMPRESS *Async)
+{
+  UINT64 OutAvaiLen = BootParamlistPtr->DeviceTreeLoadAddr -
+                      BootParamlistPtr->KernelLoadAddr;
+
+  SetMem (Async, sizeof (*Async), 0);
+  if (BootParamlistPtr->KernelComp != KERNEL_COMP_GZIP ||
+      OutAvaiLen > MAX_UINT32) {
+    return;
+  }
+
+  Async->Scratch = AllocatePool (GZIP_SCRATCH_SIZE);
+  if (Async->Scratch == NULL) {
+    return;
+  }
+  Async->In = (UINT8 *)(BootParamlistPtr->ImageBuffer +
+                        BootParamlistPtr->PageSize);
+  Async->InLen = BootParamlistPtr->KernelSize;
+  Async->Out = (UINT8 *)BootParamlistPtr->KernelLoadAddr;
+  Async->OutAvaiLen = (UINT32)OutAvaiLen;
+  Async->Task.Func = AsyncDecompressRun;
+  Async->Task.Context = Async;
+  Async->StartMs = GetTimerCountms ();
+
+  if (SecondaryCpuTaskStart (&Async->Task) != EFI_SUCCESS) {
+    FreePool (Async->Scratch);
+    Async->Scratch = NULL;
+    return;
+  }
+  Async->Started = TRUE;
+  DEBUG ((EFI_D_INFO, "Decompressing gzip kernel image on a secondary CPU "
+                      "start: %lu ms\n", Async->StartMs));
+}
+
+#endif
+
+/* Joins AsyncDecompressStart (), returns the result of the decompressor */
+STATIC INT32
+AsyncDecompressWait (ASYNC_DECOMPRESS *Async)
+{
+  UINT64 WaitMs = GetTimerCountms ();
+
+  SecondaryCpuTaskWait (&Async->Task);
+  Async->Started = FALSE;
+  FreePool (Async->Scratch);
+  Async->Scratch = NULL;
+
+  DEBUG ((EFI_D_INFO, "Secondary CPU decompression joined after %lu ms\n",
+          GetTimerCountms () - WaitMs));
+  if (Async->Rc != 0) {
+    DEBUG ((EFI_D_ERROR, "%a\n", Async->Error));
+  }
+  return Async->Rc;
+}
+
+/* Async, if not NULL, may hold the kernel already inflating on a secondary
+ * CPU; it is joined instead of decompressing again.
+ */
 STATIC EFI_STATUS
-GZipPkgCheck (BootParamlist *BootParamlistPtr)
+CompressedPkgCheck (BootParamlist *BootParamlistPtr,
+                    ASYNC_DECOMPRESS *Async)
 {
   UINT32 OutLen = 0;
   UINT64 OutAvaiLen = 0;
+  UINT64 StartMs = 0;
+  UINT64 DoneMs = 0;
+  INT32 Rc;
   struct kernel64_hdr *Kptr = NULL;
 
   if (BootParamlistPtr == NULL) {
@@ -570,7 +721,7 @@ GZipPkgCheck (BootParamlist *BootParamlistPtr)
     return EFI_INVALID_PARAMETER;
   }
 
-  if (BootParamlistPtr->BootingWithGzipPkgKernel) {
+  if (BootParamlistPtr->KernelComp != KERNEL_COMP_NONE) {
     OutAvaiLen = BootParamlistPtr->DeviceTreeLoadAddr -
                  BootParamlistPtr->KernelLoadAddr;
 
@@ -581,15 +732,26 @@ GZipPkgCheck (BootParamlist *BootParamlistPtr)
       return EFI_BAD_BUFFER_SIZE;
     }
 
-    DEBUG ((EFI_D_INFO, "Decompressing kernel image start: %lu ms\n",
-                         GetTimerCountms ()));
-    if (decompress (
-        (UINT8 *)(BootParamlistPtr->ImageBuffer +
-        BootParamlistPtr->PageSize),               // Read blob using BlockIo
-        BootParamlistPtr->KernelSize,              // Blob size
-        (UINT8 *)BootParamlistPtr->KernelLoadAddr, // Load address, allocated
-        (UINT32)OutAvaiLen,                        // Allocated Size
-        &BootParamlistPtr->DtbOffset, &OutLen)) {
+    if (Async != NULL &&
+        Async->Started) {
+      StartMs = Async->StartMs;
+      Rc = AsyncDecompressWait (Async);
+      BootParamlistPtr->DtbOffset = Async->Pos;
+      OutLen = Async->OutLen;
+    } else {
+      StartMs = GetTimerCountms ();
+      DEBUG ((EFI_D_INFO, "Decompressing %a kernel image start: %lu ms\n",
+              KernelDecompressors[BootParamlistPtr->KernelComp].Name,
+              StartMs));
+      Rc = KernelDecompressors[BootParamlistPtr->KernelComp].Decompress (
+          (UINT8 *)(BootParamlistPtr->ImageBuffer +
+          BootParamlistPtr->PageSize),               // Read blob using BlockIo
+          BootParamlistPtr->KernelSize,              // Blob size
+          (UINT8 *)BootParamlistPtr->KernelLoadAddr, // Load address, allocated
+          (UINT32)OutAvaiLen,                        // Allocated Size
+          &BootParamlistPtr->DtbOffset, &OutLen);
+    }
+    if (Rc) {
           DEBUG ((EFI_D_ERROR, "Decompressing kernel image failed!!!\n"));
           return RETURN_OUT_OF_RESOURCES;
     }
@@ -600,8 +762,20 @@ GZipPkgCheck (BootParamlist *BootParamlistPtr)
       return RETURN_OUT_OF_RESOURCES;
     }
     Kptr = (Kernel64Hdr *) BootParamlistPtr->KernelLoadAddr;
-    DEBUG ((EFI_D_INFO, "Decompressing kernel image done: %lu ms\n",
-                         GetTimerCountms ()));
+    DoneMs = GetTimerCountms ();
+    DEBUG ((EFI_D_INFO, "Decompressing %a kernel image done: %lu ms "
+                        "(%lu ms, %u -> %u bytes)\n",
+            KernelDecompressors[BootParamlistPtr->KernelComp].Name, DoneMs,
+            DoneMs - StartMs, BootParamlistPtr->KernelSize, OutLen));
+
+    /* The compute VM kernel is only timed by its CompressedPkgCheck:cvm
+     * span, the values stand for the HLOS kernel
+     */
+    if (Async == NULL) {
+      BootStatsSetValue ("kernel_decomp_ms", (UINT32)(DoneMs - StartMs));
+      BootStatsSetValue ("kernel_comp_bytes", BootParamlistPtr->KernelSize);
+      BootStatsSetValue ("kernel_decomp_bytes", OutLen);
+    }
   } else {
     Kptr = (struct kernel64_hdr *)(BootParamlistPtr->ImageBuffer
                          + BootParamlistPtr->PageSize);
@@ -639,7 +813,7 @@ GZipPkgCheck (BootParamlist *BootParamlistPtr)
   }
 
   if (Kptr->magic_64 != KERNEL64_HDR_MAGIC) {
-    /* For GZipped 32-bit Kernel */
+    /* For compressed 32-bit Kernel */
     BootParamlistPtr->BootingWith32BitKernel = TRUE;
   } else {
     if (Kptr->ImageSize >
@@ -653,10 +827,59 @@ GZipPkgCheck (BootParamlist *BootParamlistPtr)
   return EFI_SUCCESS;
 }
 
+/* Place the ramdisk at RamdiskLoadAddr. A ramdisk that LoadImage left on
+ * the partition is read there directly, otherwise it is copied out of the
+ * boot image buffer. Either way the time taken goes to the boot stats as
+ * ramdisk_place_ms, so a deferred boot can be held against a copying one.
+ */
+STATIC EFI_STATUS
+LoadRamdisk (BootParamlist *BootParamlistPtr)
+{
+  EFI_STATUS Status;
+  UINT64 StartMs = GetTimerCountms ();
+  VOID *RamdiskBuffer = BootParamlistPtr->ImageBuffer +
+                        BootParamlistPtr->RamdiskOffset;
+
+  if (BootParamlistPtr->RamdiskPname != NULL) {
+    Status = LoadPartitionRange (BootParamlistPtr->RamdiskPname,
+                                 BootParamlistPtr->RamdiskOffset,
+                                 (VOID *)BootParamlistPtr->RamdiskLoadAddr,
+                                 BootParamlistPtr->RamdiskSize);
+    if (Status == EFI_SUCCESS) {
+      DEBUG ((EFI_D_INFO, "Ramdisk read to load address, %u bytes not "
+              "copied\n", BootParamlistPtr->RamdiskSize));
+      BootStatsSetValue ("ramdisk_copy_saved_bytes",
+                         BootParamlistPtr->RamdiskSize);
+      BootStatsSetValue ("ramdisk_place_ms",
+                         (UINT32)(GetTimerCountms () - StartMs));
+      return EFI_SUCCESS;
+    }
+
+    /* Load address does not suit the BlockIo, fill the hole instead */
+    Status = LoadPartitionRange (BootParamlistPtr->RamdiskPname,
+                                 BootParamlistPtr->RamdiskOffset,
+                                 RamdiskBuffer,
+                                 BootParamlistPtr->RamdiskSize);
+    if (Status != EFI_SUCCESS) {
+      DEBUG ((EFI_D_ERROR, "Failed to read ramdisk: %r\n", Status));
+      return Status;
+    }
+  }
+
+  gBS->CopyMem ((CHAR8 *)BootParamlistPtr->RamdiskLoadAddr,
+                RamdiskBuffer,
+                BootParamlistPtr->RamdiskSize);
+  BootStatsSetValue ("ramdisk_place_ms",
+                     (UINT32)(GetTimerCountms () - StartMs));
+
+  return EFI_SUCCESS;
+}
+
 STATIC EFI_STATUS
 LoadAddrAndDTUpdate (BootParamlist *BootParamlistPtr)
 {
   EFI_STATUS Status;
+  UINT32 Span;
   UINT64 RamdiskEndAddr = 0;
 
   if (BootParamlistPtr == NULL) {
@@ -680,20 +903,22 @@ LoadAddrAndDTUpdate (BootParamlist *BootParamlistPtr)
     return EFI_BAD_BUFFER_SIZE;
   }
 
+  Span = BootStatsSpanBegin ("UpdateDeviceTree");
   Status = UpdateDeviceTree ((VOID *)BootParamlistPtr->DeviceTreeLoadAddr,
                              BootParamlistPtr->FinalCmdLine,
                              (VOID *)BootParamlistPtr->RamdiskLoadAddr,
                              BootParamlistPtr->RamdiskSize,
                              BootParamlistPtr->BootingWith32BitKernel);
+  BootStatsSpanEnd (Span);
   if (Status != EFI_SUCCESS) {
     DEBUG ((EFI_D_ERROR, "Device Tree update failed Status:%r\n", Status));
     return Status;
   }
 
-  gBS->CopyMem ((CHAR8 *)BootParamlistPtr->RamdiskLoadAddr,
-                BootParamlistPtr->ImageBuffer +
-                BootParamlistPtr->RamdiskOffset,
-                BootParamlistPtr->RamdiskSize);
+  Status = LoadRamdisk (BootParamlistPtr);
+  if (Status != EFI_SUCCESS) {
+    return Status;
+  }
 
   if (BootParamlistPtr->BootingWith32BitKernel) {
     if (CHECK_ADD64 (BootParamlistPtr->KernelLoadAddr,
@@ -836,16 +1061,18 @@ UpdateMemRegions (BootParamlist *BootParamlistPtr,
   return EFI_SUCCESS;
 }
 
+/* First half of loading the compute VM: find its image and, with
+ * CVM_PARALLEL_LOAD, start inflating its kernel on a secondary CPU. Called
+ * before the HLOS kernel and DT are prepared so the two overlap;
+ * CheckAndLoadComputeVM () finishes the job.
+ */
 STATIC
 EFI_STATUS
-CheckAndLoadComputeVM (BootInfo *Info,
-                       BootParamlist *CvmBootParamList)
+CvmLoadStart (BootInfo *Info,
+              BootParamlist *CvmBootParamList)
 {
   EFI_STATUS Status;
   UINTN CvmImageSize;
-  VOID *SingleDtHdr = NULL;
-  VOID *MlVmDtHdr = (VOID *)CvmBootParamList->HypDtboAddr;
-  struct fdt_entry_node *DtsList = NULL;
   IsVmComputed = FALSE;
   CHAR16 VmPartName[MAX_GPT_NAME_SIZE];
   CHAR8 VmPartNameAscii[MAX_GPT_NAME_SIZE] = {0};
@@ -885,7 +1112,25 @@ CheckAndLoadComputeVM (BootInfo *Info,
     return Status;
   }
 
-  Status = GZipPkgCheck (CvmBootParamList);
+#ifdef CVM_PARALLEL_LOAD
+  AsyncDecompressStart (CvmBootParamList, &CvmDecompress);
+#endif
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+CheckAndLoadComputeVM (BootParamlist *CvmBootParamList)
+{
+  EFI_STATUS Status;
+  UINT32 Span;
+  VOID *SingleDtHdr = NULL;
+  VOID *MlVmDtHdr = (VOID *)CvmBootParamList->HypDtboAddr;
+  struct fdt_entry_node *DtsList = NULL;
+
+  Span = BootStatsSpanBegin ("CompressedPkgCheck:cvm");
+  Status = CompressedPkgCheck (CvmBootParamList, &CvmDecompress);
+  BootStatsSpanEnd (Span);
   if (Status != EFI_SUCCESS) {
     return Status;
   }
@@ -954,9 +1199,11 @@ CheckAndLoadComputeVM (BootInfo *Info,
         return EFI_OUT_OF_RESOURCES;
       }
     }
+    Span = BootStatsSpanBegin ("ApplyOverlay:cvm");
     Status = ApplyOverlay (CvmBootParamList,
                            SingleDtHdr,
                            DtsList);
+    BootStatsSpanEnd (Span);
     if (Status != EFI_SUCCESS) {
       DEBUG ((EFI_D_ERROR, "VM DT Overlay Failed: %r\n", Status));
       return Status;
@@ -970,11 +1217,12 @@ CheckAndLoadComputeVM (BootInfo *Info,
   return Status;
 }
 
-EFI_STATUS
-BootLinux (BootInfo *Info)
+STATIC EFI_STATUS
+BootLinuxImage (BootInfo *Info)
 {
 
   EFI_STATUS Status;
+  UINT32 Span;
   CHAR16 *PartitionName = NULL;
   BOOLEAN Recovery = FALSE;
   BOOLEAN AlarmBoot = FALSE;
@@ -992,6 +1240,7 @@ BootLinux (BootInfo *Info)
   BootParamlist CvmBootParamList = {0};
   HypMsg Msg = {0};
   UINT32 RetVal;
+  EFI_STATUS CvmStatus = EFI_NOT_STARTED;
 
   HypBootInfo *HypInfo = GetVmData ();
   if (IsVmEnabled () &&
@@ -1049,6 +1298,9 @@ BootLinux (BootInfo *Info)
                ((boot_img_hdr *)(BootParamlistPtr.ImageBuffer))->page_size;
   BootParamlistPtr.CmdLine = (CHAR8 *)&(((boot_img_hdr *)
                              (BootParamlistPtr.ImageBuffer))->cmdline[0]);
+  if (Info->RamdiskDeferred) {
+    BootParamlistPtr.RamdiskPname = Info->Pname;
+  }
 
   if (IsVmEnabled ()) {
     Status = UpdateMemRegions (&BootParamlistPtr,
@@ -1068,6 +1320,11 @@ BootLinux (BootInfo *Info)
     }
   }
 
+  if ((!Recovery) &&
+      (IsVmEnabled ())) {
+    CvmStatus = CvmLoadStart (Info, &CvmBootParamList);
+  }
+
   Status = UpdateKernelModeAndPkg (&BootParamlistPtr);
   if (Status != EFI_SUCCESS) {
     return Status;
@@ -1078,7 +1335,9 @@ BootLinux (BootInfo *Info)
     return Status;
   }
   SetandGetLoadAddr (&BootParamlistPtr, LOAD_ADDR_NONE);
-  Status = GZipPkgCheck (&BootParamlistPtr);
+  Span = BootStatsSpanBegin ("CompressedPkgCheck");
+  Status = CompressedPkgCheck (&BootParamlistPtr, NULL);
+  BootStatsSpanEnd (Span);
   if (Status != EFI_SUCCESS) {
     return Status;
   }
@@ -1132,7 +1391,9 @@ BootLinux (BootInfo *Info)
 
   Info->HeaderVersion = ((boot_img_hdr *)
                          (BootParamlistPtr.ImageBuffer))->header_version;
+  Span = BootStatsSpanBegin ("DTBImgCheckAndAppendDT");
   Status = DTBImgCheckAndAppendDT (Info, &BootParamlistPtr);
+  BootStatsSpanEnd (Span);
   if (Status != EFI_SUCCESS) {
     return Status;
   }
@@ -1151,7 +1412,10 @@ BootLinux (BootInfo *Info)
 
   if ((!Recovery) &&
       (IsVmEnabled ())) {
-    Status = CheckAndLoadComputeVM (Info, &CvmBootParamList);
+    Status = CvmStatus;
+    if (Status == EFI_SUCCESS) {
+      Status = CheckAndLoadComputeVM (&CvmBootParamList);
+    }
     if (EFI_ERROR (Status)) {
       DEBUG ((EFI_D_ERROR, "Compute VM Not Loaded - %r\n", Status));
     }
@@ -1271,6 +1535,25 @@ Exit:
   return EFI_NOT_STARTED;
 }
 
+EFI_STATUS
+BootLinux (BootInfo *Info)
+{
+  EFI_STATUS Status;
+  UINT32 Span;
+
+  /* Only comes back if the image could not be booted */
+  Span = BootStatsSpanBegin ("BootLinux");
+  Status = BootLinuxImage (Info);
+  BootStatsSpanEnd (Span);
+
+  /* Do not leave the compute VM kernel inflating behind a failed boot */
+  if (CvmDecompress.Started) {
+    AsyncDecompressWait (&CvmDecompress);
+  }
+
+  return Status;
+}
+
 /**
   Check image header
   @param[in]  ImageHdrBuffer  Supplies the address where a pointer to the image
@@ -1440,6 +1723,20 @@ CheckImageHeader (VOID *ImageHdrBuffer,
   return Status;
 }
 
+/* Read [Start, End) of the boot image on Pname to the same offset in
+ * ImageBuffer
+ */
+STATIC EFI_STATUS
+LoadImageRange (CHAR16 *Pname, VOID *ImageBuffer, UINT32 Start, UINT32 End)
+{
+  if (Start >= End) {
+    return EFI_SUCCESS;
+  }
+
+  return LoadPartitionRange (Pname, Start, (UINT8 *)ImageBuffer + Start,
+                             End - Start);
+}
+
 /**
   Load image from partition
   @param[in]  Pname           Partition name.
@@ -1451,7 +1748,8 @@ buffer.
 **/
 EFI_STATUS
 LoadImage (BOOLEAN BootIntoRecovery, CHAR16 *Pname,
-           VOID **ImageBuffer, UINT32 *ImageSizeActual)
+           VOID **ImageBuffer, UINT32 *ImageSizeActual,
+           BOOLEAN *RamdiskDeferred)
 {
   EFI_STATUS Status = EFI_SUCCESS;
   VOID *ImageHdrBuffer;
@@ -1459,6 +1757,9 @@ LoadImage (BOOLEAN BootIntoRecovery, CHAR16 *Pname,
   UINT32 ImageSize = 0;
   UINT32 PageSize = 0;
   UINT32 tempImgSize = 0;
+  UINT32 RamdiskOffset = 0;
+  UINT32 RamdiskEnd = 0;
+  UINT32 HdrCopySize = 0;
 
   // Check for invalid ImageBuffer
   if (ImageBuffer == NULL)
@@ -1466,6 +1767,9 @@ LoadImage (BOOLEAN BootIntoRecovery, CHAR16 *Pname,
   else
     *ImageBuffer = NULL;
 
+  if (RamdiskDeferred != NULL)
+    *RamdiskDeferred = FALSE;
+
   if (!ADD_OF (ImageHdrSize, ALIGNMENT_MASK_4KB - 1)) {
     DEBUG ((EFI_D_ERROR, "Integer Overflow: in ALIGNMENT_MASK_4KB addition\n"));
     return EFI_BAD_BUFFER_SIZE;
@@ -1511,8 +1815,50 @@ LoadImage (BOOLEAN BootIntoRecovery, CHAR16 *Pname,
     return EFI_OUT_OF_RESOURCES;
   }
 
+  /* When the caller does not hash the whole image, the ramdisk is left on
+   * the partition and read straight to its load address later on, see
+   * LoadRamdisk. The buffer keeps a hole at the ramdisk offset.
+   */
+  if (RamdiskDeferred != NULL &&
+      ((boot_img_hdr *)ImageHdrBuffer)->ramdisk_size >=
+          RAMDISK_DEFER_MIN_SIZE &&
+      !(PageSize % ALIGNMENT_MASK_4KB)) {
+    RamdiskOffset = PageSize +
+        ROUND_TO_PAGE (((boot_img_hdr *)ImageHdrBuffer)->kernel_size,
+                       PageSize - 1);
+    RamdiskEnd = RamdiskOffset +
+        ROUND_TO_PAGE (((boot_img_hdr *)ImageHdrBuffer)->ramdisk_size,
+                       PageSize - 1);
+  }
+
+  /* The header pages are already read, continue the image after them */
+  HdrCopySize = MIN (ImageHdrSize, ImageSize);
+  gBS->CopyMem (*ImageBuffer, ImageHdrBuffer, HdrCopySize);
+  FreePages (ImageHdrBuffer, ALIGN_PAGES (ImageHdrSize, ALIGNMENT_MASK_4KB));
+
   BootStatsSetTimeStamp (BS_KERNEL_LOAD_START);
-  Status = LoadImageFromPartition (*ImageBuffer, &ImageSize, Pname);
+  if (RamdiskEnd) {
+    Status = LoadImageRange (Pname, *ImageBuffer, HdrCopySize, RamdiskOffset);
+    if (Status == EFI_SUCCESS) {
+      Status = LoadImageRange (Pname, *ImageBuffer, RamdiskEnd, ImageSize);
+    }
+
+    if (Status == EFI_SUCCESS) {
+      *RamdiskDeferred = TRUE;
+    } else {
+      DEBUG ((EFI_D_INFO, "Split image load failed: %r, loading whole image\n",
+              Status));
+    }
+  }
+
+  if (!RamdiskDeferred ||
+      !*RamdiskDeferred) {
+    Status = LoadImageRange (Pname, *ImageBuffer, HdrCopySize, ImageSize);
+    if (Status == EFI_UNSUPPORTED) {
+      /* Header size is not a multiple of the block size */
+      Status = LoadImageFromPartition (*ImageBuffer, &ImageSize, Pname);
+    }
+  }
   BootStatsSetTimeStamp (BS_KERNEL_LOAD_DONE);
 
   if (Status != EFI_SUCCESS) {
@@ -38,6 +38,17 @@ STATIC UINT32 KernelLoadStart;
 STATIC UINT64 SharedImemAddress;
 STATIC UINT64 MpmTimerBase;
 STATIC UINT64 BsImemAddress;
+STATIC BOOLEAN BsImemUnavailable;
+
+STATIC BS_SPAN Spans[BS_SPAN_MAX];
+STATIC UINT32 SpanCount;
+STATIC UINT32 SpanDepth;
+/* Ids of the open spans, outermost first. Spans nested deeper than
+ * BS_SPAN_MAX are only counted in SpanDepth. */
+STATIC UINT32 OpenSpans[BS_SPAN_MAX];
+
+STATIC BS_VALUE Values[BS_VALUE_MAX];
+STATIC UINT32 ValueCount;
 
 void
 BootStatsSetTimeStamp (BS_ENTRY BootStatId)
@@ -47,12 +58,18 @@ BootStatsSetTimeStamp (BS_ENTRY BootStatId)
 
   UINTN DataSize = sizeof (SharedImemAddress);
 
+  /* Don't keep asking for variables that are not there */
+  if (BsImemUnavailable) {
+    return;
+  }
+
   if (!SharedImemAddress) {
     Status =
         gRT->GetVariable ((CHAR16 *)L"Shared_IMEM_Base", &gQcomTokenSpaceGuid,
                           NULL, &DataSize, &SharedImemAddress);
     if (Status != EFI_SUCCESS) {
       DEBUG ((EFI_D_ERROR, "Failed to get Shared IMEM base, %r\n", Status));
+      BsImemUnavailable = TRUE;
       return;
     }
   }
@@ -65,6 +82,7 @@ BootStatsSetTimeStamp (BS_ENTRY BootStatId)
     if (Status != EFI_SUCCESS) {
       DEBUG (
           (EFI_D_ERROR, "Failed to get MPM Sleep counter base, %r\n", Status));
+      BsImemUnavailable = TRUE;
       return;
     }
   }
@@ -106,3 +124,157 @@ BootStatsSetTimeStamp (BS_ENTRY BootStatId)
     }
   }
 }
+
+STATIC UINT32
+SpanNowUs (VOID)
+{
+  return (UINT32) (GetTimeInNanoSecond (GetPerformanceCounter ()) / 1000);
+}
+
+/* Open a span nested under whatever span is currently open. The returned
+ * id is only meaningful to BootStatsSpanEnd. */
+UINT32
+BootStatsSpanBegin (CONST CHAR8 *Name)
+{
+  BS_SPAN *Span = &Spans[SpanCount % BS_SPAN_MAX];
+
+  Span->Name = Name;
+  Span->StartUs = SpanNowUs ();
+  Span->EndUs = 0;
+  Span->Depth = SpanDepth;
+  if (SpanDepth < BS_SPAN_MAX) {
+    OpenSpans[SpanDepth] = SpanCount;
+  }
+  SpanDepth++;
+
+  return SpanCount++;
+}
+
+STATIC UINT32
+SpanFirst (VOID)
+{
+  return SpanCount > BS_SPAN_MAX ? SpanCount - BS_SPAN_MAX : 0;
+}
+
+/* Close a span. Spans opened after it and left open by an early return are
+ * closed along with it so the nesting stays consistent. The depth is taken
+ * from the open span list, so it is restored even once the span itself has
+ * been overwritten in the ring. */
+VOID
+BootStatsSpanEnd (UINT32 SpanId)
+{
+  UINT32 Now = SpanNowUs ();
+  UINT32 Depth;
+  UINT32 Id;
+
+  if (SpanId >= SpanCount) {
+    return;
+  }
+
+  if (SpanDepth > BS_SPAN_MAX &&
+      SpanId > OpenSpans[BS_SPAN_MAX - 1]) {
+    /* Nested too deep to be listed, it is the innermost one */
+    Depth = SpanDepth - 1;
+  } else {
+    for (Depth = MIN (SpanDepth, BS_SPAN_MAX); Depth > 0; Depth--) {
+      if (OpenSpans[Depth - 1] <= SpanId) {
+        break;
+      }
+    }
+    if (!Depth ||
+        OpenSpans[Depth - 1] != SpanId) {
+      /* Already closed */
+      return;
+    }
+    Depth--;
+  }
+  SpanDepth = Depth;
+
+  for (Id = MAX (SpanId, SpanFirst ()); Id < SpanCount; Id++) {
+    if (!Spans[Id % BS_SPAN_MAX].EndUs) {
+      Spans[Id % BS_SPAN_MAX].EndUs = Now;
+    }
+  }
+
+  if (SpanId >= SpanFirst ()) {
+    DEBUG ((EFI_D_VERBOSE, "BootStats: %a: %u us\n",
+            Spans[SpanId % BS_SPAN_MAX].Name,
+            Now - Spans[SpanId % BS_SPAN_MAX].StartUs));
+  }
+}
+
+/* Record a named value, replacing any earlier value of the same name */
+VOID
+BootStatsSetValue (CONST CHAR8 *Name, UINT32 Value)
+{
+  UINT32 Idx;
+
+  for (Idx = 0; Idx < ValueCount; Idx++) {
+    if (!AsciiStrCmp (Values[Idx].Name, Name)) {
+      break;
+    }
+  }
+
+  if (Idx == BS_VALUE_MAX) {
+    DEBUG ((EFI_D_ERROR, "BootStats: no room for %a\n", Name));
+    return;
+  }
+  if (Idx == ValueCount) {
+    Values[ValueCount++].Name = Name;
+  }
+
+  Values[Idx].Value = Value;
+  DEBUG ((EFI_D_VERBOSE, "BootStats: %a: %u\n", Name, Value));
+}
+
+/* Add the recorded spans and values to the node at Offset (normally
+ * /chosen):
+ *   qcom,bl-span-names     stringlist, oldest first
+ *   qcom,bl-spans          <start_us end_us depth> per name, end_us is 0 for
+ *                          spans still open at handoff
+ *   qcom,bl-span-handoff   time of the export in us
+ *   qcom,bl-stat-names     stringlist
+ *   qcom,bl-stats          one u32 per name
+ */
+INT32
+BootStatsExport (FDT_EDIT_LIST *Edits, INT32 Offset)
+{
+  fdt32_t Cells[BS_SPAN_CELLS];
+  UINT32 Id;
+  INT32 Ret = 0;
+
+  if (ValueCount) {
+    Ret = FdtEditDelProp (Edits, Offset, "qcom,bl-stat-names");
+    Ret |= FdtEditDelProp (Edits, Offset, "qcom,bl-stats");
+  }
+  for (Id = 0; Id < ValueCount && !Ret; Id++) {
+    Ret = FdtEditAppendProp (Edits, Offset, "qcom,bl-stat-names",
+                             Values[Id].Name, AsciiStrSize (Values[Id].Name));
+    Ret |= FdtEditAppendPropU32 (Edits, Offset, "qcom,bl-stats",
+                                 Values[Id].Value);
+  }
+  if (Ret ||
+      !SpanCount) {
+    return Ret;
+  }
+
+  Ret = FdtEditDelProp (Edits, Offset, "qcom,bl-span-names");
+  Ret |= FdtEditDelProp (Edits, Offset, "qcom,bl-spans");
+  for (Id = SpanFirst (); Id < SpanCount && !Ret; Id++) {
+    BS_SPAN *Span = &Spans[Id % BS_SPAN_MAX];
+
+    Cells[0] = cpu_to_fdt32 (Span->StartUs);
+    Cells[1] = cpu_to_fdt32 (Span->EndUs);
+    Cells[2] = cpu_to_fdt32 (Span->Depth);
+    Ret = FdtEditAppendProp (Edits, Offset, "qcom,bl-span-names", Span->Name,
+                             AsciiStrSize (Span->Name));
+    Ret |= FdtEditAppendProp (Edits, Offset, "qcom,bl-spans", Cells,
+                              sizeof (Cells));
+  }
+  if (Ret) {
+    return Ret;
+  }
+
+  return FdtEditSetPropU32 (Edits, Offset, "qcom,bl-span-handoff",
+                            SpanNowUs ());
+}
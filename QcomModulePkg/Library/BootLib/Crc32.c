@@ -0,0 +1,201 @@
+/* Copyright (c) 2026, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimer in the documentation and/or other materials provided
+ *  with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <Library/ArmLib.h>
+#include <Library/BaseLib.h>
+#include <Library/Crc32.h>
+#include <Library/DebugLib.h>
+
+#define CRC32_POLY 0xEDB88320
+
+/* Slice-by-8 tables, built on first use */
+STATIC UINT32 Crc32Table[8][256];
+STATIC BOOLEAN Crc32TableReady;
+
+#if defined(MDE_CPU_AARCH64)
+/* Raw register update with the CRC32 instructions, see AArch64/Crc32Ce.S */
+UINT32
+Crc32CeUpdate (UINT32 Crc, CONST UINT8 *Data, UINTN Len);
+
+/* ID_AA64ISAR0_EL1.CRC32, read once; MAX_UINTN until then */
+STATIC UINTN Crc32CeLevel = MAX_UINTN;
+
+STATIC BOOLEAN
+Crc32CeAvailable (VOID)
+{
+  if (Crc32CeLevel == MAX_UINTN) {
+    Crc32CeLevel = (ArmReadIdAa64Isar0 () & AARCH64_ISAR0_CRC32_MASK) >>
+                   AARCH64_ISAR0_CRC32_SHIFT;
+    DEBUG ((EFI_D_VERBOSE, "CRC32 instructions: %u\n", (UINT32)Crc32CeLevel));
+  }
+  return Crc32CeLevel != 0;
+}
+#endif
+
+STATIC VOID
+Crc32InitTable (VOID)
+{
+  UINT32 Crc;
+  UINT32 Index;
+  UINT32 Bit;
+  UINT32 Slice;
+
+  for (Index = 0; Index < 256; Index++) {
+    Crc = Index;
+    for (Bit = 0; Bit < 8; Bit++) {
+      Crc = (Crc & 1) ? (Crc >> 1) ^ CRC32_POLY : Crc >> 1;
+    }
+    Crc32Table[0][Index] = Crc;
+  }
+
+  for (Index = 0; Index < 256; Index++) {
+    Crc = Crc32Table[0][Index];
+    for (Slice = 1; Slice < 8; Slice++) {
+      Crc = (Crc >> 8) ^ Crc32Table[0][Crc & 0xFF];
+      Crc32Table[Slice][Index] = Crc;
+    }
+  }
+  Crc32TableReady = TRUE;
+}
+
+/* Raw register update, eight bytes per step */
+STATIC UINT32
+Crc32SwUpdate (UINT32 Crc, CONST UINT8 *Data, UINTN Len)
+{
+  UINT32 Lo;
+  UINT32 Hi;
+
+  if (!Crc32TableReady) {
+    Crc32InitTable ();
+  }
+
+  while (Len && ((UINTN)Data & 7)) {
+    Crc = (Crc >> 8) ^ Crc32Table[0][(Crc ^ *Data++) & 0xFF];
+    Len--;
+  }
+
+  for (; Len >= 8; Len -= 8, Data += 8) {
+    Lo = Crc ^ ((UINT32)Data[0] | ((UINT32)Data[1] << 8) |
+                ((UINT32)Data[2] << 16) | ((UINT32)Data[3] << 24));
+    Hi = (UINT32)Data[4] | ((UINT32)Data[5] << 8) |
+         ((UINT32)Data[6] << 16) | ((UINT32)Data[7] << 24);
+    Crc = Crc32Table[7][Lo & 0xFF] ^ Crc32Table[6][(Lo >> 8) & 0xFF] ^
+          Crc32Table[5][(Lo >> 16) & 0xFF] ^ Crc32Table[4][Lo >> 24] ^
+          Crc32Table[3][Hi & 0xFF] ^ Crc32Table[2][(Hi >> 8) & 0xFF] ^
+          Crc32Table[1][(Hi >> 16) & 0xFF] ^ Crc32Table[0][Hi >> 24];
+  }
+
+  while (Len--) {
+    Crc = (Crc >> 8) ^ Crc32Table[0][(Crc ^ *Data++) & 0xFF];
+  }
+  return Crc;
+}
+
+UINT32
+Crc32Update (UINT32 Crc, CONST VOID *Data, UINTN Len)
+{
+  Crc = ~Crc;
+#if defined(MDE_CPU_AARCH64)
+  if (Crc32CeAvailable ()) {
+    return ~Crc32CeUpdate (Crc, Data, Len);
+  }
+#endif
+  return ~Crc32SwUpdate (Crc, Data, Len);
+}
+
+/* Product of two polynomials modulo the CRC polynomial, bit reflected so
+ * that 0x80000000 is x^0. A must not be zero.
+ */
+STATIC UINT32
+Crc32MultModP (UINT32 A, UINT32 B)
+{
+  UINT32 Mask = 1U << 31;
+  UINT32 Product = 0;
+
+  for (;;) {
+    if (A & Mask) {
+      Product ^= B;
+      if (!(A & (Mask - 1))) {
+        break;
+      }
+    }
+    Mask >>= 1;
+    B = (B & 1) ? (B >> 1) ^ CRC32_POLY : B >> 1;
+  }
+  return Product;
+}
+
+/* The CRC of A followed by B is Crc32MultModP (x^(8 * Len (B)), A) ^ B.
+ * Blocks of the pattern are doubled that way until they add up to Len.
+ */
+UINT32
+Crc32Fill (UINT32 Crc, UINT32 Pattern, UINT64 Len)
+{
+  UINT32 BlockCrc;
+  UINT32 Shift = 1U << 31;
+  UINT64 Count = Len / sizeof (Pattern);
+  UINT32 Bit;
+
+  /* x^32, the shift over one pattern */
+  for (Bit = 0; Bit < 32; Bit++) {
+    Shift = (Shift & 1) ? (Shift >> 1) ^ CRC32_POLY : Shift >> 1;
+  }
+  BlockCrc = Crc32Update (0, &Pattern, sizeof (Pattern));
+
+  while (Count) {
+    if (Count & 1) {
+      Crc = Crc32MultModP (Shift, Crc) ^ BlockCrc;
+    }
+    Count >>= 1;
+    if (Count) {
+      BlockCrc = Crc32MultModP (Shift, BlockCrc) ^ BlockCrc;
+      Shift = Crc32MultModP (Shift, Shift);
+    }
+  }
+
+  return Crc32Update (Crc, &Pattern, Len % sizeof (Pattern));
+}
+
+UINT32
+Crc32Combine (UINT32 CrcA, UINT32 CrcB, UINT64 LenB)
+{
+  UINT32 Shift = 1U << 23; /* x^8, the shift over one byte */
+  UINT32 Power = 1U << 31; /* x^0 */
+
+  while (LenB) {
+    if (LenB & 1) {
+      Power = Crc32MultModP (Shift, Power);
+    }
+    LenB >>= 1;
+    if (LenB) {
+      Shift = Crc32MultModP (Shift, Shift);
+    }
+  }
+
+  return Crc32MultModP (Power, CrcA) ^ CrcB;
+}
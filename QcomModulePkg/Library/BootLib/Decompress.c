@@ -65,6 +65,102 @@ zlib_alloc (voidpf qpaque, uInt items, uInt size)
   return AllocateZeroPool (items * size);
 }
 
+/* Bump allocator over the caller's scratch buffer for decompress_scratch ().
+ * Nothing is freed before the whole buffer goes away.
+ */
+typedef struct {
+  unsigned char *next;
+  unsigned int left;
+} gzip_scratch;
+
+static void *
+scratch_alloc (voidpf opaque, uInt items, uInt size)
+{
+  gzip_scratch *scratch = opaque;
+  UINT64 len = ALIGN_VALUE ((UINT64)items * size, 16);
+  void *addr;
+
+  if (len > scratch->left) {
+    return NULL;
+  }
+  addr = scratch->next;
+  scratch->next += len;
+  scratch->left -= len;
+  zmemzero (addr, len);
+  return addr;
+}
+
+static void
+scratch_free (voidpf opaque, void *addr)
+{
+}
+
+/* Inflate the gzip package behind a prepared stream, which only needs its
+ * allocator and output buffer set. Returns NULL on success, otherwise a
+ * description of the failure; prints nothing itself.
+ */
+static const char *
+gunzip (struct z_stream_s *stream,
+        unsigned char *in_buf,
+        unsigned int in_len,
+        unsigned int *pos,
+        unsigned int *out_len)
+{
+  const char *err = NULL;
+  int rc;
+  int i;
+
+  /* skip over gzip header */
+  stream->next_in = in_buf + GZIP_HEADER_LEN;
+  stream->avail_in = in_len - GZIP_HEADER_LEN;
+  /* skip over ascii filename */
+  if (in_buf[3] & 0x8) {
+    for (i = 0; i < GZIP_FILENAME_LIMIT && *stream->next_in++; i++) {
+      if (stream->avail_in == 0) {
+        return "header error";
+      }
+      --stream->avail_in;
+    }
+  }
+
+  rc = inflateInit2 (stream, -MAX_WBITS);
+  if (rc != Z_OK) {
+    return "inflateInit2 failed!";
+  }
+
+  /* If inflate() returns
+   * Z_OK and with zero avail_out: O/P buffer is full
+   * Z_STREAM_END: we uncompressed it all
+   */
+  rc = inflate (stream, Z_NO_FLUSH);
+  if (stream->avail_out == 0 && rc == Z_OK) {
+    err = "Error in decompression: Output buffer full";
+  } else if (rc != Z_STREAM_END) {
+    err = "Error in decompression: Something went wrong while decompression";
+  }
+
+  inflateEnd (stream);
+  if (err != NULL) {
+    return err;
+  }
+
+  if (pos)
+    /* alculation the length of the compressed package */
+    *pos = stream->next_in - in_buf + 8;
+
+  if (out_len)
+    *out_len = stream->total_out;
+
+  return NULL;
+}
+
+/* A kernel Image.gz is a single deflate stream: every block may refer back
+ * 32 KB into the output of the ones before it and nothing records where a
+ * block starts, so one stream can't be split across CPUs. Only whole streams
+ * run on a secondary CPU, see decompress_scratch () and
+ * AsyncDecompressStart () in BootLinux.c.
+ */
+
 /* decompress gzip file "in_buf", return 0 if decompressed successful,
  * return -1 if decompressed failed.
  * in_buf - input gzip file
@@ -83,25 +179,24 @@ decompress (unsigned char *in_buf,
             unsigned int *out_len)
 {
   struct z_stream_s *stream;
-  int rc = -1;
-  int i;
+  const char *err;
 
   if (in_len <= GZIP_HEADER_LEN) {
     DEBUG ((EFI_D_ERROR, "the input data is not a gzip package.\n"));
-    return rc;
+    return -1;
   }
 
   if (out_buf_len <= in_len) {
     DEBUG ((EFI_D_ERROR,
             "the available length: %u of out_buf is not enough, need %u.\n",
             out_buf_len, in_len));
-    return rc;
+    return -1;
   }
 
   stream = AllocateZeroPool (sizeof (*stream));
   if (stream == NULL) {
     DEBUG ((EFI_D_ERROR, "allocating z_stream failed.\n"));
-    return rc;
+    return -1;
   }
 
   stream->zalloc = zlib_alloc;
@@ -109,57 +204,55 @@ decompress (unsigned char *in_buf,
   stream->next_out = out_buf;
   stream->avail_out = out_buf_len;
 
-  /* skip over gzip header */
-  stream->next_in = in_buf + GZIP_HEADER_LEN;
-  stream->avail_in = in_len - GZIP_HEADER_LEN;
-  /* skip over ascii filename */
-  if (in_buf[3] & 0x8) {
-    for (i = 0; i < GZIP_FILENAME_LIMIT && *stream->next_in++; i++) {
-      if (stream->avail_in == 0) {
-        DEBUG ((EFI_D_ERROR, "header error\n"));
-        goto gunzip_end;
-      }
-      --stream->avail_in;
-    }
+  err = gunzip (stream, in_buf, in_len, pos, out_len);
+  if (err != NULL) {
+    DEBUG ((EFI_D_ERROR, "%a\n", err));
   }
 
-  rc = inflateInit2 (stream, -MAX_WBITS);
-  if (rc != Z_OK) {
-    DEBUG ((EFI_D_ERROR, "inflateInit2 failed!\n"));
-    goto gunzip_end;
-  }
+  FreePool (stream);
+  stream = NULL;
+  return err == NULL ? 0 : -1; /* returns 0 if decompressed successful */
+}
 
-  /* If inflate() returns
-   * Z_OK and with zero avail_out: O/P buffer is full
-   * Z_STREAM_END: we uncompressed it all
-   */
-  rc = inflate (stream, Z_NO_FLUSH);
-  if (stream->avail_out == 0 && rc == Z_OK) {
-    rc = -1;
-    DEBUG ((EFI_D_ERROR, "Error in decompression: Output buffer full\n"));
-    goto gunzip_end;
-  } else if (rc == Z_STREAM_END) {
-    rc = 0;
-  } else {
-    DEBUG (
-        (EFI_D_ERROR,
-         "Error in decompression: Something went wrong while decompression\n"));
-    rc = -1;
-    goto gunzip_end;
+/* Same as decompress (), but takes zlib's memory from "scratch", which must
+ * hold GZIP_SCRATCH_SIZE bytes, and hands back what went wrong in "err"
+ * instead of printing it. It makes no UEFI calls, so it may run on a
+ * secondary CPU.
+ */
+int
+decompress_scratch (unsigned char *in_buf,
+                    unsigned int in_len,
+                    unsigned char *out_buf,
+                    unsigned int out_buf_len,
+                    unsigned int *pos,
+                    unsigned int *out_len,
+                    void *scratch,
+                    const char **err)
+{
+  struct z_stream_s stream;
+  gzip_scratch arena;
+
+  if (in_len <= GZIP_HEADER_LEN) {
+    *err = "the input data is not a gzip package.";
+    return -1;
   }
 
-  inflateEnd (stream);
-  if (pos)
-    /* alculation the length of the compressed package */
-    *pos = stream->next_in - in_buf + 8;
+  if (out_buf_len <= in_len) {
+    *err = "the available length of out_buf is not enough.";
+    return -1;
+  }
 
-  if (out_len)
-    *out_len = stream->total_out;
+  zmemzero (&stream, sizeof (stream));
+  arena.next = scratch;
+  arena.left = GZIP_SCRATCH_SIZE;
+  stream.zalloc = scratch_alloc;
+  stream.zfree = scratch_free;
+  stream.opaque = &arena;
+  stream.next_out = out_buf;
+  stream.avail_out = out_buf_len;
 
-gunzip_end:
-  FreePool (stream);
-  stream = NULL;
-  return rc; /* returns 0 if decompressed successful */
+  *err = gunzip (&stream, in_buf, in_len, pos, out_len);
+  return *err == NULL ? 0 : -1;
 }
 
 /* check if the input "buf" file was a gzip package.
@@ -0,0 +1,563 @@
+/* Copyright (c) 2026, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimer in the documentation and/or other materials provided
+ *  with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/FdtEdit.h>
+#include <Library/MemoryAllocationLib.h>
+
+#define FDT_EDIT_GROW 32
+#define FDT_EDIT_DATA_GROW 1024
+
+typedef struct {
+  CONST VOID *Fdt;
+  CONST FDT_EDIT_LIST *List;
+  CONST UINT32 *Order;
+  UINT8 *Struct;     /* Output struct block */
+  UINT32 StructLen;
+  CHAR8 *NewStrings; /* Names not yet in the strings block */
+  UINT32 NewStringsLen;
+} FDT_EDIT_STATE;
+
+VOID
+FdtEditInit (FDT_EDIT_LIST *List)
+{
+  SetMem (List, sizeof (*List), 0);
+}
+
+VOID
+FdtEditFree (FDT_EDIT_LIST *List)
+{
+  if (List->Edits) {
+    FreePool (List->Edits);
+  }
+  if (List->Data) {
+    FreePool (List->Data);
+  }
+  FdtEditInit (List);
+}
+
+STATIC INT32
+FdtEditAdd (FDT_EDIT_LIST *List,
+            INT32 Node,
+            CONST CHAR8 *Name,
+            FDT_EDIT_OP Op,
+            CONST VOID *Val,
+            UINT32 Len)
+{
+  FDT_EDIT *Edit;
+  VOID *Tmp;
+
+  if (Node < 0 ||
+      Name == NULL) {
+    return -FDT_ERR_BADOFFSET;
+  }
+
+  if (List->Count == List->MaxCount) {
+    Tmp = ReallocatePool (List->MaxCount * sizeof (FDT_EDIT),
+                          (List->MaxCount + FDT_EDIT_GROW) * sizeof (FDT_EDIT),
+                          List->Edits);
+    if (Tmp == NULL) {
+      return -FDT_ERR_NOSPACE;
+    }
+    List->Edits = Tmp;
+    List->MaxCount += FDT_EDIT_GROW;
+  }
+
+  if (Len > List->MaxDataLen - List->DataLen) {
+    UINT32 NewMax = List->DataLen + MAX (Len, FDT_EDIT_DATA_GROW);
+
+    if (NewMax < List->DataLen) {
+      return -FDT_ERR_NOSPACE;
+    }
+    Tmp = ReallocatePool (List->MaxDataLen, NewMax, List->Data);
+    if (Tmp == NULL) {
+      return -FDT_ERR_NOSPACE;
+    }
+    List->Data = Tmp;
+    List->MaxDataLen = NewMax;
+  }
+
+  Edit = &List->Edits[List->Count++];
+  Edit->Node = Node;
+  Edit->Name = Name;
+  Edit->Op = Op;
+  Edit->ValOffset = List->DataLen;
+  Edit->Len = Len;
+  if (Len) {
+    CopyMem (List->Data + List->DataLen, Val, Len);
+    List->DataLen += Len;
+  }
+
+  return 0;
+}
+
+INT32
+FdtEditSetProp (FDT_EDIT_LIST *List,
+                INT32 Node,
+                CONST CHAR8 *Name,
+                CONST VOID *Val,
+                UINT32 Len)
+{
+  return FdtEditAdd (List, Node, Name, FDT_EDIT_SET, Val, Len);
+}
+
+INT32
+FdtEditAppendProp (FDT_EDIT_LIST *List,
+                   INT32 Node,
+                   CONST CHAR8 *Name,
+                   CONST VOID *Val,
+                   UINT32 Len)
+{
+  return FdtEditAdd (List, Node, Name, FDT_EDIT_APPEND, Val, Len);
+}
+
+INT32
+FdtEditDelProp (FDT_EDIT_LIST *List, INT32 Node, CONST CHAR8 *Name)
+{
+  return FdtEditAdd (List, Node, Name, FDT_EDIT_DELETE, NULL, 0);
+}
+
+INT32
+FdtEditSetPropU32 (FDT_EDIT_LIST *List,
+                   INT32 Node,
+                   CONST CHAR8 *Name,
+                   UINT32 Val)
+{
+  fdt32_t Tmp = cpu_to_fdt32 (Val);
+
+  return FdtEditSetProp (List, Node, Name, &Tmp, sizeof (Tmp));
+}
+
+INT32
+FdtEditAppendPropU32 (FDT_EDIT_LIST *List,
+                      INT32 Node,
+                      CONST CHAR8 *Name,
+                      UINT32 Val)
+{
+  fdt32_t Tmp = cpu_to_fdt32 (Val);
+
+  return FdtEditAppendProp (List, Node, Name, &Tmp, sizeof (Tmp));
+}
+
+INT32
+FdtEditSetPropU64 (FDT_EDIT_LIST *List,
+                   INT32 Node,
+                   CONST CHAR8 *Name,
+                   UINT64 Val)
+{
+  fdt64_t Tmp = cpu_to_fdt64 (Val);
+
+  return FdtEditSetProp (List, Node, Name, &Tmp, sizeof (Tmp));
+}
+
+INT32
+FdtEditAppendPropU64 (FDT_EDIT_LIST *List,
+                      INT32 Node,
+                      CONST CHAR8 *Name,
+                      UINT64 Val)
+{
+  fdt64_t Tmp = cpu_to_fdt64 (Val);
+
+  return FdtEditAppendProp (List, Node, Name, &Tmp, sizeof (Tmp));
+}
+
+INT32
+FdtEditAppendPropString (FDT_EDIT_LIST *List,
+                         INT32 Node,
+                         CONST CHAR8 *Name,
+                         CONST CHAR8 *Str)
+{
+  return FdtEditAdd (List, Node, Name, FDT_EDIT_APPEND_STRING, Str,
+                     AsciiStrSize (Str));
+}
+
+/* Older blobs carry no struct block size, walk it like fdt_open_into */
+STATIC UINT32
+FdtStructSize (CONST VOID *Fdt)
+{
+  INT32 Offset = 0;
+
+  if (fdt_version (Fdt) >= 17) {
+    return fdt_size_dt_struct (Fdt);
+  }
+
+  while (fdt_next_tag (Fdt, Offset, &Offset) != FDT_END) {
+  }
+
+  return Offset < 0 ? 0 : Offset;
+}
+
+STATIC UINT32
+FdtBlobSize (CONST VOID *Fdt)
+{
+  return sizeof (struct fdt_header) +
+         (fdt_num_mem_rsv (Fdt) + 1) * sizeof (struct fdt_reserve_entry) +
+         FdtStructSize (Fdt) + fdt_size_dt_strings (Fdt);
+}
+
+/* Upper bound on the size of the blob FdtEditApply produces */
+UINT32
+FdtEditSize (CONST VOID *Fdt, CONST FDT_EDIT_LIST *List)
+{
+  UINT32 Size = FdtBlobSize (Fdt);
+  UINT32 Idx;
+
+  for (Idx = 0; Idx < List->Count; Idx++) {
+    Size += sizeof (struct fdt_property) +
+            ALIGN_VALUE (List->Edits[Idx].Len, FDT_TAGSIZE) +
+            AsciiStrSize (List->Edits[Idx].Name);
+  }
+
+  return Size;
+}
+
+/* Name offset for a property added by an edit, new names go after the
+ * existing strings block. */
+STATIC UINT32
+FdtEditNameOffset (FDT_EDIT_STATE *State, CONST CHAR8 *Name)
+{
+  CONST CHAR8 *Strings = (CONST CHAR8 *)State->Fdt +
+                         fdt_off_dt_strings (State->Fdt);
+  UINT32 StringsLen = fdt_size_dt_strings (State->Fdt);
+  UINT32 Size = AsciiStrSize (Name);
+  UINT32 Off;
+
+  for (Off = 0; Off + Size <= StringsLen; Off++) {
+    if (Strings[Off] == Name[0] &&
+        !CompareMem (Strings + Off, Name, Size)) {
+      return Off;
+    }
+  }
+
+  for (Off = 0; Off + Size <= State->NewStringsLen; Off++) {
+    if (!CompareMem (State->NewStrings + Off, Name, Size)) {
+      return StringsLen + Off;
+    }
+  }
+
+  CopyMem (State->NewStrings + State->NewStringsLen, Name, Size);
+  State->NewStringsLen += Size;
+  return StringsLen + State->NewStringsLen - Size;
+}
+
+/* Write the final value of property Name of the current node. Base/BaseLen
+ * is its value in the source blob, if it has one. Returns FALSE if the
+ * property ends up deleted. */
+STATIC BOOLEAN
+FdtEditEmitProp (FDT_EDIT_STATE *State,
+                 UINT32 First,
+                 UINT32 End,
+                 CONST CHAR8 *Name,
+                 UINT32 NameOff,
+                 CONST VOID *Base,
+                 UINT32 BaseLen)
+{
+  CONST FDT_EDIT_LIST *List = State->List;
+  struct fdt_property *Prop;
+  BOOLEAN Present = (Base != NULL);
+  CONST FDT_EDIT *Edit;
+  UINT32 Start = First;
+  UINT32 Len;
+  UINT32 Idx;
+  UINT8 *Val;
+
+  /* Only edits after the last set or delete contribute */
+  for (Idx = First; Idx < End; Idx++) {
+    Edit = &List->Edits[State->Order[Idx]];
+    if ((Edit->Op == FDT_EDIT_SET ||
+         Edit->Op == FDT_EDIT_DELETE) &&
+        !AsciiStrCmp (Edit->Name, Name)) {
+      Start = Idx + 1;
+      Present = (Edit->Op == FDT_EDIT_SET);
+      Base = List->Data + Edit->ValOffset;
+      BaseLen = Present ? Edit->Len : 0;
+    }
+  }
+
+  Len = BaseLen;
+  for (Idx = Start; Idx < End; Idx++) {
+    Edit = &List->Edits[State->Order[Idx]];
+    if (Edit->Op >= FDT_EDIT_APPEND &&
+        !AsciiStrCmp (Edit->Name, Name)) {
+      Present = TRUE;
+      Len += Edit->Len;
+    }
+  }
+
+  if (!Present) {
+    return FALSE;
+  }
+
+  Prop = (struct fdt_property *)(State->Struct + State->StructLen);
+  Prop->tag = cpu_to_fdt32 (FDT_PROP);
+  Prop->len = cpu_to_fdt32 (Len);
+  Prop->nameoff = cpu_to_fdt32 (NameOff);
+
+  Val = (UINT8 *)Prop->data;
+  if (BaseLen) {
+    CopyMem (Val, Base, BaseLen);
+    Val += BaseLen;
+  }
+  for (Idx = Start; Idx < End; Idx++) {
+    Edit = &List->Edits[State->Order[Idx]];
+    if (Edit->Op >= FDT_EDIT_APPEND &&
+        !AsciiStrCmp (Edit->Name, Name)) {
+      /* Same as fdt_appendprop_string: join the strings with a space */
+      if (Edit->Op == FDT_EDIT_APPEND_STRING &&
+          Val > (UINT8 *)Prop->data) {
+        Val[-1] = ' ';
+      }
+      CopyMem (Val, List->Data + Edit->ValOffset, Edit->Len);
+      Val += Edit->Len;
+    }
+  }
+  SetMem (Val, ALIGN_VALUE (Len, FDT_TAGSIZE) - Len, 0);
+
+  State->StructLen += sizeof (*Prop) + ALIGN_VALUE (Len, FDT_TAGSIZE);
+  return TRUE;
+}
+
+/* Properties the edits create go right after the node name, ahead of the
+ * node's existing properties and subnodes. */
+STATIC VOID
+FdtEditEmitNewProps (FDT_EDIT_STATE *State, UINT32 First, UINT32 End)
+{
+  CONST FDT_EDIT *Edit;
+  UINT32 Idx;
+  UINT32 Prev;
+
+  for (Idx = First; Idx < End; Idx++) {
+    Edit = &State->List->Edits[State->Order[Idx]];
+
+    for (Prev = First; Prev < Idx; Prev++) {
+      if (!AsciiStrCmp (State->List->Edits[State->Order[Prev]].Name,
+                        Edit->Name)) {
+        break;
+      }
+    }
+    if (Prev < Idx ||
+        fdt_get_property (State->Fdt, Edit->Node, Edit->Name, NULL)) {
+      continue;
+    }
+
+    FdtEditEmitProp (State, First, End, Edit->Name,
+                     FdtEditNameOffset (State, Edit->Name), NULL, 0);
+  }
+}
+
+STATIC VOID
+FdtEditCopyStruct (FDT_EDIT_STATE *State, INT32 Start, INT32 End)
+{
+  CopyMem (State->Struct + State->StructLen,
+           (CONST UINT8 *)State->Fdt + fdt_off_dt_struct (State->Fdt) + Start,
+           End - Start);
+  State->StructLen += End - Start;
+}
+
+/* Copy the struct block, stopping only at the nodes that have edits */
+STATIC INT32
+FdtEditWriteStruct (FDT_EDIT_STATE *State)
+{
+  CONST FDT_EDIT_LIST *List = State->List;
+  CONST struct fdt_property *Prop;
+  CONST CHAR8 *Name;
+  UINT32 First;
+  UINT32 End = 0;
+  INT32 Offset = 0;
+  INT32 Node;
+  INT32 Next;
+  INT32 PropLen;
+  UINT32 Tag;
+  UINT32 Idx;
+
+  while (End < List->Count) {
+    First = End;
+    Node = List->Edits[State->Order[First]].Node;
+    while (End < List->Count &&
+           List->Edits[State->Order[End]].Node == Node) {
+      End++;
+    }
+
+    /* Edits are sorted by node, so a node before Offset is a bad offset */
+    if (Node < Offset ||
+        fdt_next_tag (State->Fdt, Node, &Next) != FDT_BEGIN_NODE ||
+        Next < 0) {
+      return -FDT_ERR_BADOFFSET;
+    }
+
+    FdtEditCopyStruct (State, Offset, Next);
+    FdtEditEmitNewProps (State, First, End);
+    Offset = Next;
+
+    /* Properties come before subnodes, so this walks just the node's own */
+    for (;;) {
+      Tag = fdt_next_tag (State->Fdt, Offset, &Next);
+      if (Next < 0) {
+        return Next;
+      }
+      if (Tag == FDT_NOP) {
+        FdtEditCopyStruct (State, Offset, Next);
+        Offset = Next;
+        continue;
+      }
+      if (Tag != FDT_PROP) {
+        break;
+      }
+
+      Prop = fdt_get_property_by_offset (State->Fdt, Offset, &PropLen);
+      if (Prop == NULL) {
+        return PropLen;
+      }
+      Name = fdt_string (State->Fdt, fdt32_to_cpu (Prop->nameoff));
+
+      for (Idx = First; Idx < End; Idx++) {
+        if (!AsciiStrCmp (List->Edits[State->Order[Idx]].Name, Name)) {
+          break;
+        }
+      }
+      if (Idx < End) {
+        FdtEditEmitProp (State, First, End, Name,
+                         fdt32_to_cpu (Prop->nameoff), Prop->data, PropLen);
+      } else {
+        FdtEditCopyStruct (State, Offset, Next);
+      }
+      Offset = Next;
+    }
+  }
+
+  FdtEditCopyStruct (State, Offset, fdt_size_dt_struct (State->Fdt));
+  return 0;
+}
+
+/* Apply all edits to Fdt, which has BufSize bytes of room. The result is
+ * laid out the way fdt_open_into leaves a blob: packed blocks with the free
+ * space at the end and totalsize set to BufSize. */
+INT32
+FdtEditApply (VOID *Fdt, UINT32 BufSize, CONST FDT_EDIT_LIST *List)
+{
+  FDT_EDIT_STATE State;
+  UINT32 *Order = NULL;
+  CHAR8 *NewStrings = NULL;
+  UINT32 NewStringsMax = 1;
+  UINT8 *Blob = NULL;
+  UINT32 RsvOff;
+  UINT32 RsvLen;
+  UINT32 StructOff;
+  UINT32 StringsOff;
+  UINT32 Idx;
+  UINT32 Pos;
+  INT32 Ret;
+
+  Ret = fdt_check_header (Fdt);
+  if (Ret) {
+    return Ret;
+  }
+  if (fdt_version (Fdt) < 17) {
+    /* Older blobs carry no struct block size, have libfdt convert them */
+    Ret = fdt_open_into (Fdt, Fdt, BufSize);
+    if (Ret) {
+      return Ret;
+    }
+  }
+  if (FdtEditSize (Fdt, List) > BufSize) {
+    return -FDT_ERR_NOSPACE;
+  }
+
+  for (Idx = 0; Idx < List->Count; Idx++) {
+    NewStringsMax += AsciiStrSize (List->Edits[Idx].Name);
+  }
+
+  Blob = AllocatePool (BufSize);
+  Order = AllocatePool ((List->Count + 1) * sizeof (UINT32));
+  NewStrings = AllocatePool (NewStringsMax);
+  if (Blob == NULL ||
+      Order == NULL ||
+      NewStrings == NULL) {
+    Ret = -FDT_ERR_NOSPACE;
+    goto Out;
+  }
+
+  /* Stable sort by node so each node's edits form one group */
+  for (Idx = 0; Idx < List->Count; Idx++) {
+    for (Pos = Idx; Pos > 0 &&
+         List->Edits[Order[Pos - 1]].Node > List->Edits[Idx].Node; Pos--) {
+      Order[Pos] = Order[Pos - 1];
+    }
+    Order[Pos] = Idx;
+  }
+
+  RsvOff = ALIGN_VALUE (sizeof (struct fdt_header), 8);
+  RsvLen = (fdt_num_mem_rsv (Fdt) + 1) * sizeof (struct fdt_reserve_entry);
+  StructOff = RsvOff + RsvLen;
+
+  SetMem (&State, sizeof (State), 0);
+  State.Fdt = Fdt;
+  State.List = List;
+  State.Order = Order;
+  State.Struct = Blob + StructOff;
+  State.NewStrings = NewStrings;
+
+  Ret = FdtEditWriteStruct (&State);
+  if (Ret) {
+    goto Out;
+  }
+
+  StringsOff = StructOff + State.StructLen;
+  CopyMem (Blob, Fdt, sizeof (struct fdt_header));
+  CopyMem (Blob + RsvOff, (UINT8 *)Fdt + fdt_off_mem_rsvmap (Fdt), RsvLen);
+  CopyMem (Blob + StringsOff, (UINT8 *)Fdt + fdt_off_dt_strings (Fdt),
+           fdt_size_dt_strings (Fdt));
+  CopyMem (Blob + StringsOff + fdt_size_dt_strings (Fdt), NewStrings,
+           State.NewStringsLen);
+
+  fdt_set_version (Blob, 17);
+  fdt_set_last_comp_version (Blob, 16);
+  fdt_set_totalsize (Blob, BufSize);
+  fdt_set_off_mem_rsvmap (Blob, RsvOff);
+  fdt_set_off_dt_struct (Blob, StructOff);
+  fdt_set_size_dt_struct (Blob, State.StructLen);
+  fdt_set_off_dt_strings (Blob, StringsOff);
+  fdt_set_size_dt_strings (Blob, fdt_size_dt_strings (Fdt) +
+                                State.NewStringsLen);
+
+  CopyMem (Fdt, Blob, StringsOff + fdt_size_dt_strings (Blob));
+
+Out:
+  if (NewStrings) {
+    FreePool (NewStrings);
+  }
+  if (Order) {
+    FreePool (Order);
+  }
+  if (Blob) {
+    FreePool (Blob);
+  }
+  return Ret;
+}
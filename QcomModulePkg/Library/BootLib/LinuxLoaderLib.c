@@ -268,17 +268,22 @@ ToLower (CHAR8 *Str)
   }
 }
 
-/* Load image from partition to buffer */
-EFI_STATUS
-LoadImageFromPartition (VOID *ImageBuffer, UINT32 *ImageSize, CHAR16 *Pname)
+/* Find the single BlockIo handle backing partition Pname */
+STATIC EFI_STATUS
+GetPartitionBlkIo (CHAR16 *Pname, EFI_BLOCK_IO_PROTOCOL **BlkIo)
 {
   EFI_STATUS Status;
-  EFI_BLOCK_IO_PROTOCOL *BlkIo;
   PartiSelectFilter HandleFilter;
   HandleInfo HandleInfoList[1];
+  HandleInfo *CachedInfo;
   STATIC UINT32 MaxHandles;
   STATIC UINT32 BlkIOAttrib = 0;
 
+  if (GetPartitionHandleInfo (Pname, &CachedInfo) == EFI_SUCCESS) {
+    *BlkIo = CachedInfo->BlkIo;
+    return EFI_SUCCESS;
+  }
+
   BlkIOAttrib = BLK_IO_SEL_PARTITIONED_MBR;
   BlkIOAttrib |= BLK_IO_SEL_PARTITIONED_GPT;
   BlkIOAttrib |= BLK_IO_SEL_MEDIA_TYPE_NON_REMOVABLE;
@@ -288,8 +293,6 @@ LoadImageFromPartition (VOID *ImageBuffer, UINT32 *ImageSize, CHAR16 *Pname)
   HandleFilter.PartitionLabel = Pname;
   HandleFilter.VolumeName = NULL;
 
-  DEBUG ((DEBUG_INFO, "Loading Image Start : %u ms\n", GetTimerCountms ()));
-
   MaxHandles = sizeof (HandleInfoList) / sizeof (*HandleInfoList);
 
   Status =
@@ -311,7 +314,24 @@ LoadImageFromPartition (VOID *ImageBuffer, UINT32 *ImageSize, CHAR16 *Pname)
     return Status;
   }
 
-  BlkIo = HandleInfoList[0].BlkIo;
+  *BlkIo = HandleInfoList[0].BlkIo;
+
+  return EFI_SUCCESS;
+}
+
+/* Load image from partition to buffer */
+EFI_STATUS
+LoadImageFromPartition (VOID *ImageBuffer, UINT32 *ImageSize, CHAR16 *Pname)
+{
+  EFI_STATUS Status;
+  EFI_BLOCK_IO_PROTOCOL *BlkIo;
+
+  DEBUG ((DEBUG_INFO, "Loading Image Start : %u ms\n", GetTimerCountms ()));
+
+  Status = GetPartitionBlkIo (Pname, &BlkIo);
+  if (Status != EFI_SUCCESS) {
+    return Status;
+  }
 
   Status = BlkIo->ReadBlocks (
       BlkIo, BlkIo->Media->MediaId, 0,
@@ -325,6 +345,69 @@ LoadImageFromPartition (VOID *ImageBuffer, UINT32 *ImageSize, CHAR16 *Pname)
   return Status;
 }
 
+/* Read Size bytes starting at byte Offset of partition Pname into Buffer.
+ * Offset must be block aligned. Unlike LoadImageFromPartition nothing past
+ * Buffer + Size is written, a partial last block goes through a bounce
+ * buffer, so Buffer can be the final load address of an image section.
+ */
+EFI_STATUS
+LoadPartitionRange (CHAR16 *Pname, UINT64 Offset, VOID *Buffer, UINT32 Size)
+{
+  EFI_STATUS Status;
+  EFI_BLOCK_IO_PROTOCOL *BlkIo;
+  UINT32 BlockSize;
+  UINT32 HeadSize;
+  VOID *Bounce;
+
+  if (Buffer == NULL ||
+      Size == 0) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Status = GetPartitionBlkIo (Pname, &BlkIo);
+  if (Status != EFI_SUCCESS) {
+    return Status;
+  }
+
+  BlockSize = BlkIo->Media->BlockSize;
+  if (Offset % BlockSize) {
+    return EFI_UNSUPPORTED;
+  }
+
+  if (BlkIo->Media->IoAlign > 1 &&
+      ((UINTN)Buffer & (BlkIo->Media->IoAlign - 1))) {
+    return EFI_UNSUPPORTED;
+  }
+
+  HeadSize = Size - (Size % BlockSize);
+  if (HeadSize) {
+    Status = BlkIo->ReadBlocks (BlkIo, BlkIo->Media->MediaId,
+                                Offset / BlockSize, HeadSize, Buffer);
+    if (Status != EFI_SUCCESS) {
+      return Status;
+    }
+  }
+
+  if (HeadSize == Size) {
+    return EFI_SUCCESS;
+  }
+
+  Bounce = AllocatePages (EFI_SIZE_TO_PAGES (BlockSize));
+  if (Bounce == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = BlkIo->ReadBlocks (BlkIo, BlkIo->Media->MediaId,
+                              (Offset + HeadSize) / BlockSize, BlockSize,
+                              Bounce);
+  if (Status == EFI_SUCCESS) {
+    gBS->CopyMem ((UINT8 *)Buffer + HeadSize, Bounce, Size - HeadSize);
+  }
+
+  FreePages (Bounce, EFI_SIZE_TO_PAGES (BlockSize));
+  return Status;
+}
+
 /**
   Start an EFI image (PE32+ with EFI defined entry point).
 
@@ -490,6 +573,100 @@ GetNandMiscPartiGuid (EFI_GUID *Ptype)
   return Status;
 }
 
+/* Poll a queued BlockIo2 request until the device completes it */
+STATIC EFI_STATUS
+WaitBlockIo2Token (EFI_BLOCK_IO2_TOKEN *Token)
+{
+  while (gBS->CheckEvent (Token->Event) == EFI_NOT_READY) {
+  }
+
+  return Token->TransactionStatus;
+}
+
+/* Write Size bytes, a multiple of the block size, starting at Lba through
+ * BlockIo2, keeping up to ASYNC_WRITE_DEPTH requests queued on the device.
+ * Completion is polled so timer events such as the USB poll keep running
+ * while the storage is busy.
+ */
+STATIC EFI_STATUS
+WriteBlocksAsync (EFI_BLOCK_IO2_PROTOCOL *BlockIo2,
+                  EFI_LBA Lba,
+                  UINT64 Size,
+                  UINT8 *Buffer)
+{
+  EFI_STATUS Status = EFI_SUCCESS;
+  EFI_STATUS TokenStatus;
+  EFI_BLOCK_IO2_TOKEN Tokens[ASYNC_WRITE_DEPTH];
+  BOOLEAN InFlight[ASYNC_WRITE_DEPTH];
+  UINT32 BlockSize = BlockIo2->Media->BlockSize;
+  UINT64 UnitSize;
+  UINT64 WriteSize;
+  UINT64 Done = 0;
+  UINT32 Slot = 0;
+  UINT32 i;
+
+  gBS->SetMem ((VOID *)Tokens, sizeof (Tokens), 0);
+  gBS->SetMem ((VOID *)InFlight, sizeof (InFlight), 0);
+
+  for (i = 0; i < ASYNC_WRITE_DEPTH; i++) {
+    Status = gBS->CreateEvent (0, TPL_CALLBACK, NULL, NULL, &Tokens[i].Event);
+    if (Status != EFI_SUCCESS) {
+      DEBUG ((EFI_D_ERROR, "Failed to create BlockIo2 event: %r\n", Status));
+      goto Out;
+    }
+  }
+
+  UnitSize = ROUND_TO_PAGE (ASYNC_WRITE_UNIT_SIZE, BlockSize - 1);
+  while (Done < Size) {
+    if (InFlight[Slot]) {
+      InFlight[Slot] = FALSE;
+      Status = WaitBlockIo2Token (&Tokens[Slot]);
+      if (Status != EFI_SUCCESS) {
+        DEBUG ((EFI_D_ERROR, "BlockIo2 write failed: %r\n", Status));
+        break;
+      }
+    }
+
+    WriteSize = MIN (UnitSize, Size - Done);
+    Tokens[Slot].TransactionStatus = EFI_SUCCESS;
+    Status = BlockIo2->WriteBlocksEx (BlockIo2, BlockIo2->Media->MediaId,
+                                      Lba + Done / BlockSize, &Tokens[Slot],
+                                      WriteSize, Buffer + Done);
+    if (Status != EFI_SUCCESS) {
+      DEBUG ((EFI_D_ERROR, "BlockIo2 write submit failed: %r\n", Status));
+      break;
+    }
+
+    InFlight[Slot] = TRUE;
+    Done += WriteSize;
+    Slot = (Slot + 1) % ASYNC_WRITE_DEPTH;
+  }
+
+  /* Drain whatever is still queued, even after an error the buffers and
+   * events must not be released under the device */
+  for (i = 0; i < ASYNC_WRITE_DEPTH; i++) {
+    if (!InFlight[i]) {
+      continue;
+    }
+
+    TokenStatus = WaitBlockIo2Token (&Tokens[i]);
+    if (Status == EFI_SUCCESS &&
+        TokenStatus != EFI_SUCCESS) {
+      DEBUG ((EFI_D_ERROR, "BlockIo2 write failed: %r\n", TokenStatus));
+      Status = TokenStatus;
+    }
+  }
+
+Out:
+  for (i = 0; i < ASYNC_WRITE_DEPTH; i++) {
+    if (Tokens[i].Event != NULL) {
+      gBS->CloseEvent (Tokens[i].Event);
+    }
+  }
+
+  return Status;
+}
+
 EFI_STATUS
 WriteBlockToPartition (EFI_BLOCK_IO_PROTOCOL *BlockIo,
                    IN EFI_HANDLE *Handle,
@@ -504,6 +681,7 @@ WriteBlockToPartition (EFI_BLOCK_IO_PROTOCOL *BlockIo,
   UINT64 WriteUnitSize = MAX_WRITE_SIZE;
   INT64 LeftSize = 0;
   UINT32 WriteSize = 0;
+  EFI_BLOCK_IO2_PROTOCOL *BlockIo2 = NULL;
 
   if ((BlockIo == NULL) ||
     (Image == NULL)) {
@@ -541,7 +719,21 @@ WriteBlockToPartition (EFI_BLOCK_IO_PROTOCOL *BlockIo,
 
   DivMsgBufSize = (Size / WriteBlockSize) * WriteBlockSize;
   WriteUnitSize = ROUND_TO_PAGE (WriteUnitSize, WriteBlockSize - 1);
-  if (DivMsgBufSize) {
+
+  if (DivMsgBufSize &&
+      Handle != NULL) {
+    gBS->HandleProtocol (Handle, &gEfiBlockIo2ProtocolGuid,
+                         (VOID **)&BlockIo2);
+  }
+
+  if (DivMsgBufSize &&
+      BlockIo2 != NULL) {
+    Status = WriteBlocksAsync (BlockIo2, Offset, DivMsgBufSize, Image);
+    if (Status != EFI_SUCCESS) {
+      return Status;
+    }
+    Offset += DivMsgBufSize / BlockIo->Media->BlockSize;
+  } else if (DivMsgBufSize) {
     /* The big image buffer may take a long flashing time which will block
        parallel usb image download. It will cause the fastboot  protocol host
        side timeout. So split the image into small writing units  to let usb
@@ -760,6 +760,30 @@ STATIC EFI_STATUS GetBoardMatchDtb (DtInfo *CurDtbInfo,
   return EFI_SUCCESS;
 }
 
+/* Reads the root node properties used for DTB selection */
+STATIC BOOLEAN
+ReadDtbMatchProps (VOID *Dtb, DtbMatchProps *Props)
+{
+  INT32 RootOffset = 0;
+
+  RootOffset = fdt_path_offset (Dtb, "/");
+  if (RootOffset < 0) {
+    DEBUG ((EFI_D_ERROR, "Unable to locate root node\n"));
+    return FALSE;
+  }
+
+  Props->PlatProp = (CONST CHAR8 *)fdt_getprop (Dtb, RootOffset,
+                                                "qcom,msm-id",
+                                                &Props->LenPlatId);
+  Props->BoardProp = (CONST CHAR8 *)fdt_getprop (Dtb, RootOffset,
+                                                 "qcom,board-id",
+                                                 &Props->LenBoardId);
+  Props->PmicProp = (CONST CHAR8 *)fdt_getprop (Dtb, RootOffset,
+                                                "qcom,pmic-id",
+                                                &Props->LenPmicId);
+  return TRUE;
+}
+
 /* Dt selection table for quick reference
   | SNO | Dt Property   | CDT Property    | Exact | Best | Default |
   |-----+---------------+-----------------+-------+------+---------+
@@ -779,18 +803,19 @@ STATIC EFI_STATUS GetBoardMatchDtb (DtInfo *CurDtbInfo,
   |     |               | PmicVariantRev  | N     | Y    | N       |
 */
 STATIC BOOLEAN
-ReadDtbFindMatch (DtInfo *CurDtbInfo, DtInfo *BestDtbInfo, UINT32 ExactMatch)
+FindMatchFromProps (DtInfo *CurDtbInfo,
+                    DtInfo *BestDtbInfo,
+                    UINT32 ExactMatch,
+                    CONST DtbMatchProps *Props)
 {
   EFI_STATUS Status;
-  CONST CHAR8 *PlatProp = NULL;
-  CONST CHAR8 *BoardProp = NULL;
-  CONST CHAR8 *PmicProp = NULL;
-  INT32 LenBoardId;
-  INT32 LenPlatId;
-  INT32 LenPmicId;
+  CONST CHAR8 *PlatProp = Props->PlatProp;
+  CONST CHAR8 *BoardProp = Props->BoardProp;
+  CONST CHAR8 *PmicProp = Props->PmicProp;
+  INT32 LenBoardId = Props->LenBoardId;
+  INT32 LenPlatId = Props->LenPlatId;
+  INT32 LenPmicId = Props->LenPmicId;
   INT32 MinPlatIdLen = PLAT_ID_SIZE;
-  INT32 RootOffset = 0;
-  VOID *Dtb = CurDtbInfo->Dtb;
   UINT32 Idx;
   UINT32 PmicEntCount;
   UINT32 MsmDataCount;
@@ -801,15 +826,8 @@ ReadDtbFindMatch (DtInfo *CurDtbInfo, DtInfo *BestDtbInfo, UINT32 ExactMatch)
   memset (&BestPmicInfo, 0, sizeof (PmicIdInfo));
   /*Ensure MatchVal to 0 initially*/
   CurDtbInfo->DtMatchVal = 0;
-  RootOffset = fdt_path_offset (Dtb, "/");
-  if (RootOffset < 0) {
-    DEBUG ((EFI_D_ERROR, "Unable to locate root node\n"));
-    return FALSE;
-  }
 
-  /* Get the msm-id prop from DTB */
-  PlatProp = (CONST CHAR8 *)fdt_getprop (Dtb, RootOffset, "qcom,msm-id",
-                                         &LenPlatId);
+  /* Match the msm-id prop of the DTB */
   if (PlatProp &&
       (LenPlatId > 0) &&
       (!(LenPlatId % MinPlatIdLen))) {
@@ -850,19 +868,14 @@ ReadDtbFindMatch (DtInfo *CurDtbInfo, DtInfo *BestDtbInfo, UINT32 ExactMatch)
             LenPlatId, MinPlatIdLen));
   }
 
-  /* Get the properties like variant id, subtype from Dtb then compare the
-     * dtb vs Board*/
-  BoardProp = (CONST CHAR8 *)fdt_getprop (Dtb, RootOffset, "qcom,board-id",
-                                          &LenBoardId);
+  /* Compare the properties like variant id, subtype of the dtb vs Board*/
   Status = GetBoardMatchDtb (CurDtbInfo, BoardProp, LenBoardId);
   if (Status != EFI_SUCCESS) {
     DEBUG ((EFI_D_VERBOSE, "Board dt prop search failed.\n"));
     goto cleanup;
   }
 
-  /*Get the pmic property from Dtb then compare the dtb vs Board*/
-  PmicProp =
-      (CONST CHAR8 *)fdt_getprop (Dtb, RootOffset, "qcom,pmic-id", &LenPmicId);
+  /*Compare the pmic property of the dtb vs Board*/
   if ((PmicProp) && (LenPmicId > 0) && (!(LenPmicId % PMIC_ID_SIZE))) {
     PmicEntCount = LenPmicId / PMIC_ID_SIZE;
     /* Get the best match pmic */
@@ -911,20 +924,289 @@ cleanup:
 
   return FindBestMatch;
 }
+
+STATIC BOOLEAN
+ReadDtbFindMatch (DtInfo *CurDtbInfo, DtInfo *BestDtbInfo, UINT32 ExactMatch)
+{
+  DtbMatchProps Props;
+
+  /*Ensure MatchVal to 0 initially*/
+  CurDtbInfo->DtMatchVal = 0;
+  if (!ReadDtbMatchProps (CurDtbInfo->Dtb, &Props)) {
+    return FALSE;
+  }
+
+  return FindMatchFromProps (CurDtbInfo, BestDtbInfo, ExactMatch, &Props);
+}
+
+STATIC VOID
+SocDtbMatchDone (DtInfo *CurDtbInfo, BOOLEAN CheckRtic)
+{
+  if (CurDtbInfo->DtMatchVal) {
+    if (CurDtbInfo->DtMatchVal & BIT (SOC_MATCH)) {
+      if (CheckAllBitsSet (CurDtbInfo->DtMatchVal)) {
+        DEBUG ((EFI_D_VERBOSE, "Exact DTB match"
+                               " found. DTBO search is not "
+                               "required\n"));
+        DtboNeed = FALSE;
+      }
+    }
+  } else if (CheckRtic) {
+    if (!GetRticDtb (CurDtbInfo->Dtb)) {
+      DEBUG ((EFI_D_VERBOSE, "Error while DTB parsing"
+                             " RTIC prop continue with next DTB\n"));
+    }
+  }
+}
+
+STATIC BOOLEAN
+IsImageIdValid (CONST UINT32 *ImageId)
+{
+  UINT32 Idx;
+
+  if (ImageId == NULL) {
+    return FALSE;
+  }
+
+  for (Idx = 0; Idx < DTB_INDEX_ID_WORDS; Idx++) {
+    if (ImageId[Idx]) {
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+STATIC UINT32
+DtbIndexEntrySize (CONST DtbIndexEntry *Entry)
+{
+  return sizeof (DtbIndexEntry) +
+         ALIGN_VALUE (Entry->LenPlatId + Entry->LenBoardId +
+                      Entry->LenPmicId, sizeof (UINT32));
+}
+
+STATIC BOOLEAN
+DtbIndexAdd (DtbIndexHdr *Index,
+             VOID *Dtb,
+             UINT32 Offset,
+             UINT32 Size,
+             CONST DtbMatchProps *Props)
+{
+  DtbIndexEntry *Entry;
+  UINT8 *Data;
+  INT32 RootOffset;
+  INT32 Len;
+
+  if (Index->Size + sizeof (DtbIndexEntry) > DTB_INDEX_MAX_SIZE) {
+    return FALSE;
+  }
+
+  Entry = (DtbIndexEntry *)((UINT8 *)Index + Index->Size);
+  SetMem (Entry, sizeof (DtbIndexEntry), 0);
+  Entry->Offset = Offset;
+  Entry->Size = Size;
+
+  /* Absent and empty properties are treated alike by the match */
+  if (Props) {
+    if (Props->LenPlatId > MAX_UINT16 ||
+        Props->LenBoardId > MAX_UINT16 ||
+        Props->LenPmicId > MAX_UINT16) {
+      return FALSE;
+    }
+    if (Props->PlatProp &&
+        Props->LenPlatId > 0) {
+      Entry->LenPlatId = Props->LenPlatId;
+    }
+    if (Props->BoardProp &&
+        Props->LenBoardId > 0) {
+      Entry->LenBoardId = Props->LenBoardId;
+    }
+    if (Props->PmicProp &&
+        Props->LenPmicId > 0) {
+      Entry->LenPmicId = Props->LenPmicId;
+    }
+  }
+
+  if (Index->Size + DtbIndexEntrySize (Entry) > DTB_INDEX_MAX_SIZE) {
+    return FALSE;
+  }
+
+  Data = (UINT8 *)(Entry + 1);
+  if (Entry->LenPlatId) {
+    gBS->CopyMem (Data, (VOID *)Props->PlatProp, Entry->LenPlatId);
+    Data += Entry->LenPlatId;
+  }
+  if (Entry->LenBoardId) {
+    gBS->CopyMem (Data, (VOID *)Props->BoardProp, Entry->LenBoardId);
+    Data += Entry->LenBoardId;
+  }
+  if (Entry->LenPmicId) {
+    gBS->CopyMem (Data, (VOID *)Props->PmicProp, Entry->LenPmicId);
+  }
+
+  RootOffset = fdt_path_offset (Dtb, "/");
+  if (RootOffset >= 0 &&
+      fdt_getprop (Dtb, RootOffset, "qcom,rtic-id", &Len)) {
+    Entry->Flags |= DTB_INDEX_FLAG_RTIC;
+  }
+
+  Index->Size += DtbIndexEntrySize (Entry);
+  Index->Count++;
+  return TRUE;
+}
+
+STATIC DtbIndexHdr *
+LoadDtbIndex (CONST UINT32 *ImageId, UINT32 DtbOffset)
+{
+  EFI_STATUS Status;
+  DtbIndexHdr *Index;
+  DtbIndexEntry *Entry;
+  UINTN Size = DTB_INDEX_MAX_SIZE;
+  UINT32 Pos;
+  UINT32 Idx;
+
+  Index = AllocateZeroPool (DTB_INDEX_MAX_SIZE);
+  if (!Index) {
+    return NULL;
+  }
+
+  Status = gRT->GetVariable ((CHAR16 *)L"DtbIndex", &gQcomTokenSpaceGuid,
+                             NULL, &Size, Index);
+  if (Status != EFI_SUCCESS ||
+      Size < sizeof (DtbIndexHdr) ||
+      Index->Size != Size ||
+      Index->Version != DTB_INDEX_VERSION ||
+      Index->DtbOffset != DtbOffset ||
+      CompareMem (Index->ImageId, ImageId, sizeof (Index->ImageId))) {
+    goto Invalid;
+  }
+
+  Pos = sizeof (DtbIndexHdr);
+  for (Idx = 0; Idx < Index->Count; Idx++) {
+    Entry = (DtbIndexEntry *)((UINT8 *)Index + Pos);
+    if (Size - Pos < sizeof (DtbIndexEntry) ||
+        Size - Pos < DtbIndexEntrySize (Entry)) {
+      goto Invalid;
+    }
+    Pos += DtbIndexEntrySize (Entry);
+  }
+  if (Pos != Size) {
+    goto Invalid;
+  }
+  return Index;
+
+Invalid:
+  FreePool (Index);
+  return NULL;
+}
+
+/* The index is written once per new boot image id, i.e. after a boot
+ * image is flashed or updated, and at most DTB_INDEX_MAX_SIZE bytes go to
+ * NV storage. The flash that changed the id already rewrote the whole boot
+ * partition, so this write adds little wear, and its time is spent only on
+ * that first boot. Boots of an unchanged image never write.
+ */
+STATIC VOID
+SaveDtbIndex (DtbIndexHdr *Index)
+{
+  EFI_STATUS Status;
+
+  Status = gRT->SetVariable ((CHAR16 *)L"DtbIndex", &gQcomTokenSpaceGuid,
+                             EFI_VARIABLE_NON_VOLATILE |
+                             EFI_VARIABLE_BOOTSERVICE_ACCESS,
+                             Index->Size, Index);
+  if (Status != EFI_SUCCESS) {
+    DEBUG ((EFI_D_VERBOSE, "Unable to save DTB index: %r\n", Status));
+  }
+}
+
+/* Picks the SoC DTB using a cached index. Returns NULL if the index does
+ * not describe the DTBs in the image, before any selection side effects.
+ */
+STATIC VOID *
+GetSocDtbFromIndex (DtbIndexHdr *Index, VOID *Dtbs, UINT32 DtbsSize)
+{
+  struct fdt_header DtbHdr;
+  DtInfo CurDtbInfo = {0};
+  DtInfo BestDtbInfo = {0};
+  DtbMatchProps Props;
+  DtbIndexEntry *Entry;
+  UINT8 *Data;
+  UINT32 Pos;
+  UINT32 Idx;
+
+  /* Only the headers are read to check that the index is current. Every
+   * entry gets the same header and bounds checks as the full scan, so the
+   * DTB picked below is valid before any selection side effects.
+   */
+  Pos = sizeof (DtbIndexHdr);
+  for (Idx = 0; Idx < Index->Count; Idx++) {
+    Entry = (DtbIndexEntry *)((UINT8 *)Index + Pos);
+    if (Entry->Offset > DtbsSize ||
+        DtbsSize - Entry->Offset < sizeof (struct fdt_header) ||
+        DtbsSize - Entry->Offset < Entry->Size) {
+      return NULL;
+    }
+    gBS->CopyMem (&DtbHdr, Dtbs + Entry->Offset, sizeof (struct fdt_header));
+    if (fdt_check_header ((CONST VOID *)&DtbHdr) != 0 ||
+        fdt_check_header_ext ((VOID *)&DtbHdr) != 0 ||
+        fdt_totalsize ((CONST VOID *)&DtbHdr) != Entry->Size) {
+      return NULL;
+    }
+    Pos += DtbIndexEntrySize (Entry);
+  }
+
+  Pos = sizeof (DtbIndexHdr);
+  for (Idx = 0; Idx < Index->Count; Idx++) {
+    Entry = (DtbIndexEntry *)((UINT8 *)Index + Pos);
+    Data = (UINT8 *)(Entry + 1);
+    Props.PlatProp = Entry->LenPlatId ? (CONST CHAR8 *)Data : NULL;
+    Props.LenPlatId = Entry->LenPlatId;
+    Data += Entry->LenPlatId;
+    Props.BoardProp = Entry->LenBoardId ? (CONST CHAR8 *)Data : NULL;
+    Props.LenBoardId = Entry->LenBoardId;
+    Data += Entry->LenBoardId;
+    Props.PmicProp = Entry->LenPmicId ? (CONST CHAR8 *)Data : NULL;
+    Props.LenPmicId = Entry->LenPmicId;
+
+    CurDtbInfo.Dtb = Dtbs + Entry->Offset;
+    if (FindMatchFromProps (&CurDtbInfo, &BestDtbInfo, SOC_MATCH, &Props)) {
+      DtbIdx = Idx;
+    }
+    SocDtbMatchDone (&CurDtbInfo, Entry->Flags & DTB_INDEX_FLAG_RTIC);
+
+    DEBUG ((EFI_D_VERBOSE, "Bestmatch = %x\n", BestDtbInfo.DtMatchVal));
+    Pos += DtbIndexEntrySize (Entry);
+  }
+
+  return BestDtbInfo.Dtb;
+}
+
 /*
  * For Header Version 2, the arguments Kernel and KernelSize will be
  * the entire bootimage and the bootimage size.
+ * ImageId is the id of the boot image header, used as the key of the DTB
+ * index cache. Pass NULL to always scan the appended DTBs.
  */
 VOID *
-GetSocDtb (VOID *Kernel, UINT32 KernelSize, UINT32 DtbOffset, VOID *DtbLoadAddr)
+GetSocDtb (VOID *Kernel,
+           UINT32 KernelSize,
+           UINT32 DtbOffset,
+           VOID *DtbLoadAddr,
+           CONST UINT32 *ImageId)
 {
   uintptr_t KernelEnd = (uintptr_t)Kernel + KernelSize;
   VOID *Dtb = NULL;
+  VOID *FirstDtb = NULL;
   struct fdt_header DtbHdr;
   UINT32 DtbSize = 0;
   INT32 DtbCount = 0;
   DtInfo CurDtbInfo = {0};
   DtInfo BestDtbInfo = {0};
+  DtbMatchProps Props;
+  DtbIndexHdr *Index = NULL;
+  BOOLEAN IndexFull = FALSE;
+  BOOLEAN HaveProps;
+
   if (!DtbOffset) {
     DEBUG ((EFI_D_ERROR, "DTB offset is NULL\n"));
     return NULL;
@@ -934,6 +1216,36 @@ GetSocDtb (VOID *Kernel, UINT32 KernelSize, UINT32 DtbOffset, VOID *DtbLoadAddr)
     return NULL;
   }
   Dtb = Kernel + DtbOffset;
+  FirstDtb = Dtb;
+
+  if (IsImageIdValid (ImageId) &&
+      (uintptr_t)FirstDtb < KernelEnd) {
+    Index = LoadDtbIndex (ImageId, DtbOffset);
+    if (Index) {
+      Dtb = GetSocDtbFromIndex (Index, FirstDtb,
+                                KernelEnd - (uintptr_t)FirstDtb);
+      FreePool (Index);
+      Index = NULL;
+      if (Dtb) {
+        DEBUG ((EFI_D_VERBOSE, "Soc Dtb selected from the DTB index\n"));
+        return Dtb;
+      }
+      DEBUG ((EFI_D_VERBOSE, "DTB index is stale, scanning DTBs\n"));
+      Dtb = FirstDtb;
+      DtbIdx = INVALID_PTN;
+      DtboNeed = TRUE;
+    }
+
+    /* Build a new index while scanning */
+    Index = AllocateZeroPool (DTB_INDEX_MAX_SIZE);
+    if (Index) {
+      Index->Version = DTB_INDEX_VERSION;
+      gBS->CopyMem (Index->ImageId, (VOID *)ImageId, sizeof (Index->ImageId));
+      Index->DtbOffset = DtbOffset;
+      Index->Size = sizeof (DtbIndexHdr);
+    }
+  }
+
   while (((uintptr_t)Dtb + sizeof (struct fdt_header)) < (uintptr_t)KernelEnd) {
     /* the DTB could be unaligned, so extract the header,
      * and operate on it separately */
@@ -946,24 +1258,20 @@ GetSocDtb (VOID *Kernel, UINT32 KernelSize, UINT32 DtbOffset, VOID *DtbLoadAddr)
       break;
 
     CurDtbInfo.Dtb = Dtb;
-    if (ReadDtbFindMatch (&CurDtbInfo, &BestDtbInfo, SOC_MATCH)) {
+    CurDtbInfo.DtMatchVal = 0;
+    HaveProps = ReadDtbMatchProps (Dtb, &Props);
+    if (HaveProps &&
+        FindMatchFromProps (&CurDtbInfo, &BestDtbInfo, SOC_MATCH, &Props)) {
         DtbIdx = DtbCount;
     }
-
-    if (CurDtbInfo.DtMatchVal) {
-      if (CurDtbInfo.DtMatchVal & BIT (SOC_MATCH)) {
-        if (CheckAllBitsSet (CurDtbInfo.DtMatchVal)) {
-          DEBUG ((EFI_D_VERBOSE, "Exact DTB match"
-                                 " found. DTBO search is not "
-                                 "required\n"));
-          DtboNeed = FALSE;
-        }
-      }
-    } else {
-      if (!GetRticDtb (Dtb)) {
-        DEBUG ((EFI_D_VERBOSE, "Error while DTB parsing"
-                               " RTIC prop continue with next DTB\n"));
-      }
+    SocDtbMatchDone (&CurDtbInfo, TRUE);
+
+    if (Index &&
+        !IndexFull &&
+        !DtbIndexAdd (Index, Dtb, Dtb - FirstDtb, DtbSize,
+                      HaveProps ? &Props : NULL)) {
+      DEBUG ((EFI_D_VERBOSE, "DTB index is full\n"));
+      IndexFull = TRUE;
     }
 
     DEBUG ((EFI_D_VERBOSE, "Bestmatch = %x\n", BestDtbInfo.DtMatchVal));
@@ -971,6 +1279,14 @@ GetSocDtb (VOID *Kernel, UINT32 KernelSize, UINT32 DtbOffset, VOID *DtbLoadAddr)
     DtbCount++;
   }
 
+  if (Index) {
+    if (!IndexFull &&
+        BestDtbInfo.Dtb) {
+      SaveDtbIndex (Index);
+    }
+    FreePool (Index);
+  }
+
   if (!BestDtbInfo.Dtb) {
     DEBUG ((EFI_D_ERROR, "No match found for Soc Dtb type\n"));
     return NULL;
@@ -30,6 +30,7 @@
 #include "AutoGen.h"
 #include <Library/Board.h>
 #include <Library/BootLinux.h>
+#include <Library/Crc32.h>
 #include <Library/LinuxLoaderLib.h>
 #include <Library/UefiLib.h>
 #include <Library/DebugLib.h>
@@ -45,6 +46,19 @@ STATIC UINT32 MaxLuns;
 STATIC UINT32 PartitionCount;
 STATIC BOOLEAN FirstBoot;
 STATIC struct PartitionEntry PtnEntriesBak[MAX_NUM_PARTITIONS];
+/* Ptable handle backing each PtnEntries slot, NULL until
+ * UpdatePartitionEntries has run on the current enumeration */
+STATIC HandleInfo *PtnHandles[MAX_NUM_PARTITIONS];
+
+/* Open addressed index from partition name to PtnEntries slot + 1 (0 marks
+ * an empty bucket), rebuilt by UpdatePartitionEntries. At most half full,
+ * so a probe always ends on an empty bucket.
+ */
+#define PTN_INDEX_SIZE (2 * MAX_NUM_PARTITIONS)
+#define PTN_NAME_LEN ARRAY_SIZE (PtnEntries[0].PartEntry.PartitionName)
+STATIC UINT16 PtnIndex[PTN_INDEX_SIZE];
+/* PtnEntries slot of the first partition of each lun */
+STATIC UINT32 LunFirstIndex[MAX_LUNS];
 
 STATIC struct BootPartsLinkedList *HeadNode;
 STATIC EFI_STATUS
@@ -81,12 +95,83 @@ GetPartitionCount (UINT32 *Val)
   return;
 }
 
+STATIC UINT32
+PtnNameHash (CONST CHAR16 *Name)
+{
+  UINT32 Hash = 2166136261U;
+  UINT32 i;
+
+  for (i = 0; i < PTN_NAME_LEN && Name[i]; i++) {
+    Hash = (Hash ^ Name[i]) * 16777619U;
+  }
+
+  return Hash & (PTN_INDEX_SIZE - 1);
+}
+
+STATIC INT32
+PtnIndexFind (CONST CHAR16 *Pname)
+{
+  UINT32 Bucket = PtnNameHash (Pname);
+  UINT32 Index;
+
+  while ((Index = PtnIndex[Bucket]) != 0) {
+    if (!StrnCmp (PtnEntries[Index - 1].PartEntry.PartitionName, Pname,
+                  PTN_NAME_LEN)) {
+      return Index - 1;
+    }
+    Bucket = (Bucket + 1) & (PTN_INDEX_SIZE - 1);
+  }
+
+  return INVALID_PTN;
+}
+
+STATIC VOID
+BuildPtnIndex (VOID)
+{
+  UINT32 i;
+  UINT32 Bucket;
+  UINT32 Index;
+
+  gBS->SetMem ((VOID *)PtnIndex, sizeof (PtnIndex), 0);
+
+  for (i = 0; i < PartitionCount; i++) {
+    if (!PtnEntries[i].PartEntry.PartitionName[0])
+      continue;
+
+    /* Keep the first of duplicate names, as the linear search did */
+    Bucket = PtnNameHash (PtnEntries[i].PartEntry.PartitionName);
+    while ((Index = PtnIndex[Bucket]) != 0) {
+      if (!StrnCmp (PtnEntries[Index - 1].PartEntry.PartitionName,
+                    PtnEntries[i].PartEntry.PartitionName, PTN_NAME_LEN)) {
+        break;
+      }
+      Bucket = (Bucket + 1) & (PTN_INDEX_SIZE - 1);
+    }
+
+    if (!Index) {
+      PtnIndex[Bucket] = i + 1;
+    }
+  }
+}
+
 INT32
 GetPartitionIdxInLun (CHAR16 *Pname, UINT32 Lun)
 {
   UINT32 n;
   UINT32 RelativeIndex = 0;
+  INT32 Index;
+
+  /* Partitions of a lun are contiguous in PtnEntries */
+  Index = PtnIndexFind (Pname);
+  if (Index == INVALID_PTN) {
+    return INVALID_PTN;
+  }
+
+  if (PtnEntries[Index].lun == Lun) {
+    return Index - LunFirstIndex[Lun];
+  }
 
+  /* The first match is on another lun, look for one on this lun */
   for (n = 0; n < PartitionCount; n++) {
     if (Lun == PtnEntries[n].lun) {
       if (!StrnCmp (Pname, PtnEntries[n].PartEntry.PartitionName,
@@ -111,8 +196,10 @@ VOID UpdatePartitionEntries (VOID)
   /*Nullify the PtnEntries array before using it*/
   gBS->SetMem ((VOID *)PtnEntries,
                (sizeof (PtnEntries[0]) * MAX_NUM_PARTITIONS), 0);
+  gBS->SetMem ((VOID *)PtnHandles, sizeof (PtnHandles), 0);
 
   for (i = 0; i < MaxLuns; i++) {
+    LunFirstIndex[i] = Index;
     for (j = 0; (j < Ptable[i].MaxHandles) && (Index < MAX_NUM_PARTITIONS);
          j++, Index++) {
       Status =
@@ -129,25 +216,61 @@ VOID UpdatePartitionEntries (VOID)
 
       gBS->CopyMem ((&PtnEntries[Index]), PartEntry, sizeof (PartEntry[0]));
       PtnEntries[Index].lun = i;
+      PtnHandles[Index] = &Ptable[i].HandleInfoList[j];
     }
   }
   /* Back up the ptn entries */
   gBS->CopyMem (PtnEntriesBak, PtnEntries, sizeof (PtnEntries));
+  BuildPtnIndex ();
 }
 
 INT32
 GetPartitionIndex (CHAR16 *Pname)
 {
-  INT32 i;
+  return PtnIndexFind (Pname);
+}
 
-  for (i = 0; i < PartitionCount; i++) {
-    if (!StrnCmp (PtnEntries[i].PartEntry.PartitionName, Pname,
-                  ARRAY_SIZE (PtnEntries[i].PartEntry.PartitionName))) {
-      return i;
-    }
+/* Index of partition Pname with slot Suffix ("_a"/"_b") appended */
+INT32
+GetPartitionIndexWithSuffix (CONST CHAR16 *Pname, CONST CHAR16 *Suffix)
+{
+  CHAR16 Name[MAX_GPT_NAME_SIZE];
+  UINTN NameLen = StrLen (Pname);
+  UINTN SuffixLen = StrLen (Suffix);
+
+  if (NameLen + SuffixLen >= ARRAY_SIZE (Name)) {
+    return INVALID_PTN;
   }
 
-  return INVALID_PTN;
+  gBS->CopyMem (Name, (VOID *)Pname, NameLen * sizeof (CHAR16));
+  gBS->CopyMem (&Name[NameLen], (VOID *)Suffix,
+                (SuffixLen + 1) * sizeof (CHAR16));
+
+  return PtnIndexFind (Name);
+}
+
+/* Get the block io handle of a partition from the table built by
+ * UpdatePartitionEntries, saves a walk over every BlockIo handle in
+ * the system for each lookup.
+ */
+EFI_STATUS
+GetPartitionHandleInfo (CONST CHAR16 *Pname, HandleInfo **Info)
+{
+  INT32 Index;
+
+  if (Pname == NULL ||
+      Info == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Index = GetPartitionIndex ((CHAR16 *)Pname);
+  if (Index == INVALID_PTN ||
+      PtnHandles[Index] == NULL) {
+    return EFI_NOT_FOUND;
+  }
+
+  *Info = PtnHandles[Index];
+  return EFI_SUCCESS;
 }
 
 STATIC EFI_STATUS
@@ -372,27 +495,14 @@ VOID UpdatePartitionAttributes (UINT32 UpdateType)
         goto Exit;
       }
 
-      Status = gBS->CalculateCrc32 (Ptn_Entries, ((MaxPtnCount) * (PtnEntrySz)),
-                                    &CrcVal);
-      if (Status != EFI_SUCCESS) {
-        DEBUG ((EFI_D_ERROR, "Error Calculating CRC32 on the Gpt header: %x\n",
-                Status));
-        goto Exit;
-      }
-
+      CrcVal = Crc32Update (0, Ptn_Entries, ((MaxPtnCount) * (PtnEntrySz)));
       PUT_LONG (&GptHdr[PARTITION_CRC_OFFSET], CrcVal);
 
       /*Write CRC to 0 before we calculate the crc of the GPT header*/
       CrcVal = 0;
       PUT_LONG (&GptHdr[HEADER_CRC_OFFSET], CrcVal);
 
-      Status = gBS->CalculateCrc32 (GptHdr, HdrSz, &CrcVal);
-      if (Status != EFI_SUCCESS) {
-        DEBUG ((EFI_D_ERROR, "Error Calculating CRC32 on the Gpt header: %x\n",
-                Status));
-        goto Exit;
-      }
-
+      CrcVal = Crc32Update (0, GptHdr, HdrSz);
       PUT_LONG (&GptHdr[HEADER_CRC_OFFSET], CrcVal);
 
       if (Iter == 0x1)
@@ -501,7 +611,7 @@ STATIC EFI_STATUS GetMultiSlotPartsList (VOID)
 STATIC VOID
 SwitchPtnSlots (CONST CHAR16 *SetActive)
 {
-  UINT32 i;
+  INT32 Index;
   struct PartitionEntry *PtnCurrent = NULL;
   struct PartitionEntry *PtnNew = NULL;
   CHAR16 CurSlot[BOOT_PART_SIZE];
@@ -545,14 +655,13 @@ SwitchPtnSlots (CONST CHAR16 *SetActive)
 
     /* Find the pointer to partition table entry for active and non-active
      * slots*/
-    for (i = 0; i < PartitionCount; i++) {
-      if (!StrnCmp (PtnEntries[i].PartEntry.PartitionName, CurSlot,
-                    StrLen (CurSlot))) {
-        PtnCurrent = &PtnEntries[i];
-      } else if (!StrnCmp (PtnEntries[i].PartEntry.PartitionName, NewSlot,
-                           StrLen (NewSlot))) {
-        PtnNew = &PtnEntries[i];
-      }
+    Index = GetPartitionIndex (CurSlot);
+    if (Index != INVALID_PTN) {
+      PtnCurrent = &PtnEntries[Index];
+    }
+    Index = GetPartitionIndex (NewSlot);
+    if (Index != INVALID_PTN) {
+      PtnNew = &PtnEntries[Index];
     }
     /* Swap the guids for the slots */
     SwapPtnGuid (&PtnCurrent->PartEntry, &PtnNew->PartEntry);
@@ -595,6 +704,8 @@ EnumeratePartitions (VOID)
   };
 
   gBS->SetMem ((VOID *)Ptable, (sizeof (struct StoragePartInfo) * MAX_LUNS), 0);
+  /* Handles may change, drop the cache until UpdatePartitionEntries */
+  gBS->SetMem ((VOID *)PtnHandles, sizeof (PtnHandles), 0);
 
   /* By default look for emmc partitions if not found look for UFS */
   Attribs |= BLK_IO_SEL_MATCH_ROOT_DEVICE;
@@ -668,21 +779,10 @@ EnumeratePartitions (VOID)
 BOOLEAN
 PartitionHasMultiSlot (CONST CHAR16 *Pname)
 {
-  UINT32 i;
-  UINT32 SlotCount = 0;
-  UINT32 Len = StrLen (Pname);
-
-  for (i = 0; i < PartitionCount; i++) {
-    if (!(StrnCmp (PtnEntries[i].PartEntry.PartitionName, Pname, Len))) {
-      if (PtnEntries[i].PartEntry.PartitionName[Len] == L'_' &&
-          (PtnEntries[i].PartEntry.PartitionName[Len + 1] == L'a' ||
-           PtnEntries[i].PartEntry.PartitionName[Len + 1] == L'b'))
-        if (++SlotCount > MIN_SLOTS) {
-          return TRUE;
-        }
-    }
-  }
-  return FALSE;
+  return (GetPartitionIndexWithSuffix (Pname, (CONST CHAR16 *)L"_a") !=
+              INVALID_PTN &&
+          GetPartitionIndexWithSuffix (Pname, (CONST CHAR16 *)L"_b") !=
+              INVALID_PTN);
 }
 
 VOID FindPtnActiveSlot (VOID)
@@ -759,7 +859,6 @@ ParseGptHeader (struct GptHeaderData *GptHeader,
   UINT32 CrcOrig;
   UINT32 CrcVal;
   UINT32 CurrentLba;
-  EFI_STATUS Status;
 
   if (((UINT32 *)GptBuffer)[0] != GPT_SIGNATURE_2 ||
       ((UINT32 *)GptBuffer)[1] != GPT_SIGNATURE_1) {
@@ -786,12 +885,7 @@ ParseGptHeader (struct GptHeaderData *GptHeader,
   CrcVal = 0;
   PUT_LONG (&GptBuffer[HEADER_CRC_OFFSET], CrcVal);
 
-  Status = gBS->CalculateCrc32 (GptBuffer, GptHeader->HeaderSz, &CrcVal);
-  if (Status != EFI_SUCCESS) {
-    DEBUG ((EFI_D_ERROR, "Error Calculating CRC32 on the Gpt header: %x\n",
-            Status));
-    return FAILURE;
-  }
+  CrcVal = Crc32Update (0, GptBuffer, GptHeader->HeaderSz);
 
   if (CrcVal != CrcOrig) {
     DEBUG ((EFI_D_ERROR, "Header CRC mismatch CrcVal = %u and CrcOrig = %u\n",
@@ -866,7 +960,6 @@ PatchGpt (UINT8 *Gpt,
   UINT32 LastPartOffset;
   UINT8 *PartitionEntryArrStart;
   UINT32 CrcVal;
-  EFI_STATUS Status;
 
   NumSectors = DeviceDensity / BlkSz;
 
@@ -910,40 +1003,20 @@ PatchGpt (UINT8 *Gpt,
 
   /* Update CRC of the partition entry array for both headers */
   PartitionEntryArrStart = PrimaryGptHeader + BlkSz;
-  Status = gBS->CalculateCrc32 (PartitionEntryArrStart,
-                                (GptHeader->MaxPtCnt * GptHeader->PartEntrySz),
-                                &CrcVal);
-  if (EFI_ERROR (Status)) {
-    DEBUG (
-        (EFI_D_ERROR, "Error calculating CRC for primary partition entry\n"));
-    return FAILURE;
-  }
+  CrcVal = Crc32Update (0, PartitionEntryArrStart,
+                        (GptHeader->MaxPtCnt * GptHeader->PartEntrySz));
   PUT_LONG (PrimaryGptHeader + PARTITION_CRC_OFFSET, CrcVal);
 
-  Status = gBS->CalculateCrc32 (PartitionEntryArrStart + PartEntryArrSz,
-                                (GptHeader->MaxPtCnt * GptHeader->PartEntrySz),
-                                &CrcVal);
-  if (EFI_ERROR (Status)) {
-    DEBUG (
-        (EFI_D_ERROR, "Error calculating CRC for secondary partition entry\n"));
-    return FAILURE;
-  }
+  CrcVal = Crc32Update (0, PartitionEntryArrStart + PartEntryArrSz,
+                        (GptHeader->MaxPtCnt * GptHeader->PartEntrySz));
   PUT_LONG (SecondaryGptHeader + PARTITION_CRC_OFFSET, CrcVal);
 
   /* Clear Header CRC field values & recalculate */
   PUT_LONG (PrimaryGptHeader + HEADER_CRC_OFFSET, 0);
-  Status = gBS->CalculateCrc32 (PrimaryGptHeader, GPT_HEADER_SIZE, &CrcVal);
-  if (EFI_ERROR (Status)) {
-    DEBUG ((EFI_D_ERROR, "Error calculating CRC for primary gpt header\n"));
-    return FAILURE;
-  }
+  CrcVal = Crc32Update (0, PrimaryGptHeader, GPT_HEADER_SIZE);
   PUT_LONG (PrimaryGptHeader + HEADER_CRC_OFFSET, CrcVal);
   PUT_LONG (SecondaryGptHeader + HEADER_CRC_OFFSET, 0);
-  Status = gBS->CalculateCrc32 (SecondaryGptHeader, GPT_HEADER_SIZE, &CrcVal);
-  if (EFI_ERROR (Status)) {
-    DEBUG ((EFI_D_ERROR, "Error calculating CRC for secondary gpt header\n"));
-    return FAILURE;
-  }
+  CrcVal = Crc32Update (0, SecondaryGptHeader, GPT_HEADER_SIZE);
   PUT_LONG (SecondaryGptHeader + HEADER_CRC_OFFSET, CrcVal);
 
   return SUCCESS;
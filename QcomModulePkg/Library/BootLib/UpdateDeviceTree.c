@@ -36,6 +36,7 @@
 #include <Library/UpdateDeviceTree.h>
 #include <Library/LocateDeviceTree.h>
 #include <Library/BootLinux.h>
+#include <Library/BootStats.h>
 #include <Protocol/EFIChipInfoTypes.h>
 #include <Protocol/EFIDDRGetConfig.h>
 #include <Protocol/EFIRng.h>
@@ -245,7 +246,7 @@ fdt_check_header_ext (VOID *fdt)
 
 STATIC
 VOID
-UpdateGranuleInfo (VOID *fdt)
+UpdateGranuleInfo (VOID *fdt, FDT_EDIT_LIST *Edits)
 {
   EFI_STATUS Status = EFI_SUCCESS;
   INT32 GranuleNodeOffset;
@@ -266,7 +267,7 @@ UpdateGranuleInfo (VOID *fdt)
     return;
   }
 
-  Ret = fdt_setprop_u32 (fdt, GranuleNodeOffset, "granule", GranuleSize);
+  Ret = FdtEditSetPropU32 (Edits, GranuleNodeOffset, "granule", GranuleSize);
   if (Ret) {
     DEBUG ((EFI_D_ERROR, "INFO: Granule size update failed.\n"));
   }
@@ -330,7 +331,10 @@ QueryMemoryCellSize (IN VOID *Fdt, OUT UINT32 *MemoryCellLen)
 
 STATIC
 EFI_STATUS
-AddMemMap (VOID *Fdt, UINT32 MemNodeOffset, BOOLEAN BootWith32Bit)
+AddMemMap (VOID *Fdt,
+           FDT_EDIT_LIST *Edits,
+           UINT32 MemNodeOffset,
+           BOOLEAN BootWith32Bit)
 {
   EFI_STATUS Status = EFI_NOT_FOUND;
   INT32 ret = 0;
@@ -361,10 +365,10 @@ AddMemMap (VOID *Fdt, UINT32 MemNodeOffset, BOOLEAN BootWith32Bit)
             RamPartitions[i].Base, RamPartitions[i].AvailableLength));
 
     if (MemoryCellLen == 1) {
-      ret = dev_tree_add_mem_info (Fdt, MemNodeOffset, RamPartitions[i].Base,
+      ret = dev_tree_add_mem_info (Edits, MemNodeOffset, RamPartitions[i].Base,
                                     RamPartitions[i].AvailableLength);
     } else {
-      ret = dev_tree_add_mem_infoV64 (Fdt, MemNodeOffset,
+      ret = dev_tree_add_mem_infoV64 (Edits, MemNodeOffset,
                                         RamPartitions[i].Base,
                                         RamPartitions[i].AvailableLength);
     }
@@ -386,12 +390,15 @@ AddMemMap (VOID *Fdt, UINT32 MemNodeOffset, BOOLEAN BootWith32Bit)
  * AddMemMap() */
 STATIC
 EFI_STATUS
-target_dev_tree_mem (VOID *fdt, UINT32 MemNodeOffset, BOOLEAN BootWith32Bit)
+target_dev_tree_mem (VOID *fdt,
+                     FDT_EDIT_LIST *Edits,
+                     UINT32 MemNodeOffset,
+                     BOOLEAN BootWith32Bit)
 {
   EFI_STATUS Status;
 
   /* Get Available memory from partition table */
-  Status = AddMemMap (fdt, MemNodeOffset, BootWith32Bit);
+  Status = AddMemMap (fdt, Edits, MemNodeOffset, BootWith32Bit);
   if (EFI_ERROR (Status)) {
     DEBUG ((EFI_D_ERROR,
             "Invalid memory configuration, check memory partition table: %r\n",
@@ -399,7 +406,7 @@ target_dev_tree_mem (VOID *fdt, UINT32 MemNodeOffset, BOOLEAN BootWith32Bit)
     goto out;
   }
 
-  UpdateGranuleInfo (fdt);
+  UpdateGranuleInfo (fdt, Edits);
 
 out:
   return Status;
@@ -408,18 +415,21 @@ out:
 /* Supporting function of target_dev_tree_mem()
  * Function to add the subsequent RAM partition info to the device tree */
 INT32
-dev_tree_add_mem_info (VOID *fdt, UINT32 offset, UINT32 addr, UINT32 size)
+dev_tree_add_mem_info (FDT_EDIT_LIST *Edits,
+                       UINT32 offset,
+                       UINT32 addr,
+                       UINT32 size)
 {
   STATIC INT32 mem_info_cnt = 0;
   INT32 ret = 0;
 
   if (!mem_info_cnt) {
     /* Replace any other reg prop in the memory node. */
-    ret = fdt_setprop_u32 (fdt, offset, "reg", addr);
+    ret = FdtEditSetPropU32 (Edits, offset, "reg", addr);
     mem_info_cnt = 1;
   } else {
     /* Append the mem info to the reg prop for subsequent nodes.  */
-    ret = fdt_appendprop_u32 (fdt, offset, "reg", addr);
+    ret = FdtEditAppendPropU32 (Edits, offset, "reg", addr);
   }
 
   if (ret) {
@@ -427,7 +437,7 @@ dev_tree_add_mem_info (VOID *fdt, UINT32 offset, UINT32 addr, UINT32 size)
         (EFI_D_ERROR, "Failed to add the memory information addr: %d\n", ret));
   }
 
-  ret = fdt_appendprop_u32 (fdt, offset, "reg", size);
+  ret = FdtEditAppendPropU32 (Edits, offset, "reg", size);
 
   if (ret) {
     DEBUG (
@@ -438,18 +448,21 @@ dev_tree_add_mem_info (VOID *fdt, UINT32 offset, UINT32 addr, UINT32 size)
 }
 
 INT32
-dev_tree_add_mem_infoV64 (VOID *fdt, UINT32 offset, UINT64 addr, UINT64 size)
+dev_tree_add_mem_infoV64 (FDT_EDIT_LIST *Edits,
+                          UINT32 offset,
+                          UINT64 addr,
+                          UINT64 size)
 {
   STATIC INT32 mem_info_cnt = 0;
   INT32 ret = 0;
 
   if (!mem_info_cnt) {
     /* Replace any other reg prop in the memory node. */
-    ret = fdt_setprop_u64 (fdt, offset, "reg", addr);
+    ret = FdtEditSetPropU64 (Edits, offset, "reg", addr);
     mem_info_cnt = 1;
   } else {
     /* Append the mem info to the reg prop for subsequent nodes.  */
-    ret = fdt_appendprop_u64 (fdt, offset, "reg", addr);
+    ret = FdtEditAppendPropU64 (Edits, offset, "reg", addr);
   }
 
   if (ret) {
@@ -457,7 +470,7 @@ dev_tree_add_mem_infoV64 (VOID *fdt, UINT32 offset, UINT64 addr, UINT64 size)
         (EFI_D_ERROR, "Failed to add the memory information addr: %d\n", ret));
   }
 
-  ret = fdt_appendprop_u64 (fdt, offset, "reg", size);
+  ret = FdtEditAppendPropU64 (Edits, offset, "reg", size);
 
   if (ret) {
     DEBUG (
@@ -481,6 +494,7 @@ UpdateDeviceTree (VOID *fdt,
   UINT64 KaslrSeed = 0;
   UINT8 DdrDeviceType;
   EFI_STATUS Status;
+  FDT_EDIT_LIST Edits;
 
   /* Check the device tree header */
   ret = fdt_check_header (fdt) || fdt_check_header_ext (fdt);
@@ -489,38 +503,30 @@ UpdateDeviceTree (VOID *fdt,
     return EFI_NOT_FOUND;
   }
 
-  /* Add padding to make space for new nodes and properties. */
-  PaddSize = ADD_OF (fdt_totalsize (fdt),
-                    DTB_PAD_SIZE + AsciiStrLen (cmdline));
-  if (!PaddSize) {
-    DEBUG ((EFI_D_ERROR, "ERROR: Integer Overflow: fdt size = %u\n",
-            fdt_totalsize (fdt)));
-    return EFI_BAD_BUFFER_SIZE;
-  }
-  ret = fdt_open_into (fdt, fdt, PaddSize);
-  if (ret != 0) {
-    DEBUG ((EFI_D_ERROR, "ERROR: Failed to move/resize dtb buffer ...\n"));
-    return EFI_BAD_BUFFER_SIZE;
-  }
+  /* Property updates are collected against the unmodified blob and written
+   * out in one pass by FdtEditApply below. */
+  FdtEditInit (&Edits);
 
   /* Get offset of the memory node */
   ret = fdt_path_offset (fdt, "/memory");
   if (ret < 0) {
     DEBUG ((EFI_D_ERROR, "ERROR: Could not find memory node ...\n"));
-    return EFI_NOT_FOUND;
+    Status = EFI_NOT_FOUND;
+    goto Out;
   }
 
   offset = ret;
-  Status = target_dev_tree_mem (fdt, offset, BootWith32Bit);
+  Status = target_dev_tree_mem (fdt, &Edits, offset, BootWith32Bit);
   if (Status != EFI_SUCCESS) {
     DEBUG ((EFI_D_ERROR, "ERROR: Cannot update memory node\n"));
-    return Status;
+    goto Out;
   }
 
   Status = GetDDRInfo (&DdrDeviceType);
   if (Status == EFI_SUCCESS) {
-    ret = fdt_appendprop_u32 (fdt, offset, (CONST char *)"ddr_device_type",
-                              (UINT32)DdrDeviceType);
+    ret = FdtEditAppendPropU32 (&Edits, offset,
+                                (CONST char *)"ddr_device_type",
+                                (UINT32)DdrDeviceType);
     if (ret) {
       DEBUG ((EFI_D_ERROR,
               "ERROR: Cannot update memory node [ddr_device_type] - 0x%x\n",
@@ -536,26 +542,28 @@ UpdateDeviceTree (VOID *fdt,
   ret = fdt_path_offset (fdt, "/chosen");
   if (ret < 0) {
     DEBUG ((EFI_D_ERROR, "ERROR: Could not find chosen node ...\n"));
-    return EFI_NOT_FOUND;
+    Status = EFI_NOT_FOUND;
+    goto Out;
   }
 
   offset = ret;
   if (cmdline) {
     /* Adding the cmdline to the chosen node */
-    ret = fdt_appendprop_string (fdt, offset, (CONST char *)"bootargs",
-                                 (CONST VOID *)cmdline);
+    ret = FdtEditAppendPropString (&Edits, offset, (CONST char *)"bootargs",
+                                   cmdline);
     if (ret) {
       DEBUG ((EFI_D_ERROR,
               "ERROR: Cannot update chosen node [bootargs] - 0x%x\n", ret));
-      return EFI_LOAD_ERROR;
+      Status = EFI_LOAD_ERROR;
+      goto Out;
     }
   }
 
   Status = GetKaslrSeed (&KaslrSeed);
   if (Status == EFI_SUCCESS) {
     /* Adding Kaslr Seed to the chosen node */
-    ret = fdt_appendprop_u64 (fdt, offset, (CONST char *)"kaslr-seed",
-                              (UINT64)KaslrSeed);
+    ret = FdtEditAppendPropU64 (&Edits, offset, (CONST char *)"kaslr-seed",
+                                (UINT64)KaslrSeed);
     if (ret) {
       DEBUG ((EFI_D_INFO,
               "ERROR: Cannot update chosen node [kaslr-seed] - 0x%x\n", ret));
@@ -568,50 +576,78 @@ UpdateDeviceTree (VOID *fdt,
 
   if (RamDiskSize) {
     /* Adding the initrd-start to the chosen node */
-    ret = fdt_setprop_u64 (fdt, offset, "linux,initrd-start", (UINT64)ramdisk);
+    ret = FdtEditSetPropU64 (&Edits, offset, "linux,initrd-start",
+                             (UINT64)ramdisk);
     if (ret) {
       DEBUG ((EFI_D_ERROR,
               "ERROR: Cannot update chosen node [linux,initrd-start] - 0x%x\n",
               ret));
-      return EFI_NOT_FOUND;
+      Status = EFI_NOT_FOUND;
+      goto Out;
     }
 
     /* Adding the initrd-end to the chosen node */
-    ret = fdt_setprop_u64 (fdt, offset, "linux,initrd-end",
-                           ((UINT64)ramdisk + RamDiskSize));
+    ret = FdtEditSetPropU64 (&Edits, offset, "linux,initrd-end",
+                             ((UINT64)ramdisk + RamDiskSize));
     if (ret) {
       DEBUG ((EFI_D_ERROR,
               "ERROR: Cannot update chosen node [linux,initrd-end] - 0x%x\n",
               ret));
-      return EFI_NOT_FOUND;
+      Status = EFI_NOT_FOUND;
+      goto Out;
     }
   }
 
+  /* Hand the bootloader time spans and stats to the kernel */
+  ret = BootStatsExport (&Edits, offset);
+  if (ret) {
+    DEBUG ((EFI_D_ERROR,
+            "ERROR: Cannot update chosen node [qcom,bl-spans] - 0x%x\n", ret));
+  }
+
   /* Update fstab node */
   DEBUG ((EFI_D_VERBOSE, "Start DT fstab node update: %lu ms\n",
           GetTimerCountms ()));
-  UpdateFstabNode (fdt);
+  UpdateFstabNode (fdt, &Edits);
   DEBUG ((EFI_D_VERBOSE, "End DT fstab node update: %lu ms\n",
           GetTimerCountms ()));
 
+  /* Write all edits, leaving padding for the nodes added below. */
+  PaddSize = ADD_OF (FdtEditSize (fdt, &Edits), DTB_PAD_SIZE);
+  if (!PaddSize) {
+    DEBUG ((EFI_D_ERROR, "ERROR: Integer Overflow: fdt size = %u\n",
+            fdt_totalsize (fdt)));
+    Status = EFI_BAD_BUFFER_SIZE;
+    goto Out;
+  }
+  ret = FdtEditApply (fdt, PaddSize, &Edits);
+  if (ret != 0) {
+    DEBUG ((EFI_D_ERROR, "ERROR: Failed to update dtb buffer - %d\n", ret));
+    Status = EFI_BAD_BUFFER_SIZE;
+    goto Out;
+  }
+
   /* Check partial goods*/
   if (FixedPcdGetBool (EnablePartialGoods)) {
-    ret = UpdatePartialGoodsNode (fdt);
-    if (ret != EFI_SUCCESS) {
+    Status = UpdatePartialGoodsNode (fdt);
+    if (Status != EFI_SUCCESS) {
       DEBUG ((EFI_D_ERROR,
         "Failed to update device tree for partial goods, Status=%r\n",
-           ret));
-      return ret;
+           Status));
+      goto Out;
     }
   }
   fdt_pack (fdt);
+  Status = EFI_SUCCESS;
 
-  return ret;
+Out:
+  FdtEditFree (&Edits);
+  return Status;
 }
 
 /* Update device tree for fstab node */
 EFI_STATUS
-UpdateFstabNode (VOID *fdt)
+UpdateFstabNode (VOID *fdt, FDT_EDIT_LIST *Edits)
 {
   INT32 ParentOffset = 0;
   INT32 SubNodeOffset = 0;
@@ -671,8 +707,8 @@ UpdateFstabNode (VOID *fdt)
       /* For Dynamic partition support disable firmware fstab nodes. */
       if (IsDynamicPartitionSupport ()) {
         DEBUG ((EFI_D_VERBOSE, "Disabling node status :%a\n", NodeName));
-        Status = fdt_setprop (fdt, SubNodeOffset, Table.Property, "disabled",
-                             (AsciiStrLen ("disabled") + 1));
+        Status = FdtEditSetProp (Edits, SubNodeOffset, Table.Property,
+                                 "disabled", (AsciiStrLen ("disabled") + 1));
         if (Status) {
          DEBUG ((EFI_D_ERROR, "ERROR: Failed to disable Node: %a\n", NodeName));
         }
@@ -0,0 +1,276 @@
+#!/usr/bin/env python3
+
+"""Generates the kernel decompressor vectors under testdata/.
+
+Usage: gen_vectors.py [testdata_dir]
+
+Compresses seeded, kernel-like data with Python's zlib and the lz4 and zstd
+command line tools, and writes each stream as the boot image carries it:
+optionally followed by the little-endian size trailer kbuild's size_append
+adds, and by a DTB header. Corrupted and truncated streams are derived from
+the good ones, a few invalid ones are written by hand.
+
+testdata/vectors.txt lists one vector per line:
+  FILE FORMAT pass OUT_LEN CRC32 POS
+  FILE FORMAT fail
+POS is where decompression must stop, i.e. the offset of the appended DTB.
+
+The data is seeded, so rerunning the script reproduces the files as long as
+the compressors produce the same streams. lz4 and zstd must be on the PATH.
+"""
+
+import os
+import random
+import struct
+import subprocess
+import sys
+import zlib
+
+LZ4_LEGACY_MAGIC = 0x184C2102
+ZSTD_MAGIC = 0xFD2FB528
+ZSTD_SKIPPABLE_MAGIC = 0x184D2A50
+
+# Enough of a DTB header for the lookup after the kernel to find
+DTB = struct.pack('>II', 0xD00DFEED, 64) + bytes(56)
+
+
+def kernel_like(size, seed, segment_size=32768):
+  """Returns size bytes mixing literal runs, byte runs and repeated words.
+
+  A segment repeats with a few bytes changed each time, so that the 8 and
+  16 MB images compress to a few tens of KB and can be checked in. deflate
+  needs segments shorter than its 32 KB window for that.
+  """
+  rng = random.Random(seed)
+  words = [bytes(rng.getrandbits(8) for _ in range(rng.randrange(2, 12)))
+           for _ in range(256)]
+  base = bytearray()
+  while len(base) < segment_size:
+    kind = rng.randrange(10)
+    if kind == 0:
+      base += rng.getrandbits(8 * 256).to_bytes(256, 'little')
+    elif kind == 1:
+      base += bytes([rng.getrandbits(8)]) * rng.randrange(16, 300)
+    else:
+      for _ in range(32):
+        base += rng.choice(words)
+  base = base[:segment_size]
+
+  out = bytearray()
+  while len(out) < size:
+    segment = bytearray(base)
+    for _ in range(4):
+      segment[rng.randrange(len(segment))] = rng.getrandbits(8)
+    out += segment
+  return bytes(out[:size])
+
+
+def patterned(size, seed, max_period=16):
+  """Returns size bytes of short repeating patterns, so that deflate emits
+  matches at every distance from 1 up, most of them overlapping.
+  """
+  rng = random.Random(seed)
+  out = bytearray()
+  while len(out) < size:
+    period = rng.randrange(1, max_period + 1)
+    pattern = bytes(rng.getrandbits(8) for _ in range(period))
+    out += pattern * rng.randrange(2, 40) + pattern[:rng.randrange(period)]
+    if rng.randrange(4) == 0:
+      out += out[-rng.randrange(1, 32768):][:rng.randrange(3, 258)]
+  return bytes(out[:size])
+
+
+def skewed(size, seed):
+  """Returns size bytes with Fibonacci symbol frequencies. Huffman coding
+  gives the rare symbols 15-bit codes, which need the second-level tables
+  behind inflate's 10-bit root table.
+  """
+  rng = random.Random(seed)
+  weights = [1, 1]
+  while len(weights) < 24:
+    weights.append(weights[-1] + weights[-2])
+  return bytes(rng.choices(range(len(weights)), weights=weights, k=size))
+
+
+def gzip_member(data, level, strategy=zlib.Z_DEFAULT_STRATEGY, name=None):
+  """gzip framing like "gzip -n", with an optional file name"""
+  c = zlib.compressobj(level, zlib.DEFLATED, -15, 9, strategy)
+  flags = 0x08 if name else 0
+  header = struct.pack('<BBBBIBB', 0x1F, 0x8B, 8, flags, 0, 0, 3)
+  if name:
+    header += name + b'\0'
+  return (header + c.compress(data) + c.flush() +
+          struct.pack('<II', zlib.crc32(data), len(data)))
+
+
+class BitWriter(object):
+  """Deflate bit order: fields LSB first, Huffman codes MSB first"""
+
+  def __init__(self):
+    self.value = 0
+    self.bits = 0
+
+  def field(self, value, bits):
+    self.value |= value << self.bits
+    self.bits += bits
+
+  def code(self, code, bits):
+    self.field(int(format(code, '0%db' % bits)[::-1], 2), bits)
+
+  def bytes(self):
+    return self.value.to_bytes((self.bits + 7) // 8, 'little')
+
+
+def compress(tool, args, data):
+  return subprocess.check_output([tool, '-q', '-c'] + args, input=data)
+
+
+def trailer(data):
+  return struct.pack('<I', len(data))
+
+
+class Vectors(object):
+
+  def __init__(self, data_dir):
+    self.data_dir = data_dir
+    self.lines = []
+
+  def write(self, name, blob):
+    with open(os.path.join(self.data_dir, name), 'wb') as f:
+      f.write(blob)
+
+  def good(self, name, fmt, stream, data, tail=b''):
+    """stream followed by tail, decompressing to data and stopping at tail's
+    DTB, if any.
+    """
+    blob = stream + tail
+    pos = len(blob) - (len(DTB) if tail.endswith(DTB) else 0)
+    self.write(name, blob)
+    self.lines.append('%s %s pass %d %08x %d' %
+                      (name, fmt, len(data), zlib.crc32(data), pos))
+
+  def bad(self, name, fmt, blob):
+    self.write(name, blob)
+    self.lines.append('%s %s fail' % (name, fmt))
+
+
+def lz4_vectors(v, data3, data8):
+  legacy3 = compress('lz4', ['-l', '-9'], data3)
+  legacy8 = compress('lz4', ['-l', '-9'], data8)
+  frame3 = compress('lz4', ['-9'], data3)
+  linked3 = compress('lz4', ['-9', '-BD', '-B4', '--content-size'], data3)
+
+  v.good('lz4_legacy_3m.lz4', 'lz4', legacy3, data3, trailer(data3) + DTB)
+  # One full 8 MB legacy block, the trailer must not read as a block size
+  v.good('lz4_legacy_8m.lz4', 'lz4', legacy8, data8, trailer(data8) + DTB)
+  v.good('lz4_legacy_3m_notrailer.lz4', 'lz4', legacy3, data3, DTB)
+  v.good('lz4_frame_3m.lz4', 'lz4', frame3, data3, trailer(data3) + DTB)
+  v.good('lz4_frame_linked_3m.lz4', 'lz4', linked3, data3, trailer(data3))
+
+  # Block size past the end of the input
+  blob = bytearray(legacy3)
+  struct.pack_into('<I', blob, 4, len(legacy3))
+  v.bad('lz4_legacy_badblock.lz4', 'lz4', bytes(blob))
+  v.bad('lz4_legacy_truncated.lz4', 'lz4', legacy3[:len(legacy3) // 2])
+  # FLG is the byte after the magic
+  blob = bytearray(frame3)
+  blob[4] = (blob[4] & 0x3F) | 0x80
+  v.bad('lz4_frame_badversion.lz4', 'lz4', bytes(blob))
+  blob = bytearray(frame3)
+  blob[4] |= 0x01
+  v.bad('lz4_frame_dict.lz4', 'lz4', bytes(blob))
+  v.bad('lz4_frame_truncated.lz4', 'lz4', frame3[:len(frame3) // 2])
+
+
+def zstd_vectors(v, data3, data8, data16):
+  z19 = compress('zstd', ['-19'], data3)
+  z3 = compress('zstd', ['-3'], data8)
+  zlong = compress('zstd', ['-19', '--long=24'], data16)
+  split = 1000000
+  skippable = struct.pack('<II', ZSTD_SKIPPABLE_MAGIC, 8) + b'skipthis'
+  concat = (compress('zstd', ['-19'], data3[:split]) + skippable +
+            compress('zstd', ['-19'], data3[split:]))
+
+  v.good('zstd_19_3m.zst', 'zstd', z19, data3, trailer(data3) + DTB)
+  v.good('zstd_3_8m.zst', 'zstd', z3, data8, trailer(data8) + DTB)
+  v.good('zstd_long_16m.zst', 'zstd', zlong, data16, trailer(data16))
+  v.good('zstd_concat_3m.zst', 'zstd', concat, data3, trailer(data3) + DTB)
+  v.good('zstd_19_3m_notrailer.zst', 'zstd', z19, data3, DTB)
+
+  # Frame headers written by hand, one raw last block of 4 bytes each
+  raw_block = struct.pack('<I', (4 << 3) | 1)[:3] + b'abcd'
+  # Dictionary_ID_Flag 1, a one byte dictionary ID
+  v.bad('zstd_dict.zst', 'zstd',
+        struct.pack('<IBBB', ZSTD_MAGIC, 0x01, 0x58, 7) + raw_block)
+  # Single segment with a one byte content size of 5
+  v.bad('zstd_size_mismatch.zst', 'zstd',
+        struct.pack('<IBB', ZSTD_MAGIC, 0x20, 5) + raw_block)
+  # Block type 3 is reserved
+  v.bad('zstd_reserved_block.zst', 'zstd',
+        struct.pack('<IBB', ZSTD_MAGIC, 0x20, 4) +
+        struct.pack('<I', (4 << 3) | (3 << 1) | 1)[:3] + b'abcd')
+  v.bad('zstd_truncated.zst', 'zstd', z19[:len(z19) // 2])
+
+
+def gzip_vectors(v):
+  data1 = kernel_like(1000000, 1, 16384)
+  data8 = kernel_like(8 * 1024 * 1024, 8, 16384)
+  mixed = data1[:500000] + random.Random(1).randbytes(40000) + data1[500000:]
+  pattern = patterned(1000000, 5)
+  runs = patterned(300000, 7, 1)
+  skew = skewed(200000, 6)
+
+  v.good('gzip_6_1m.gz', 'gzip', gzip_member(data1, 6), data1, DTB)
+  v.good('gzip_9_8m.gz', 'gzip', gzip_member(data8, 9), data8, DTB)
+  v.good('gzip_1_300k.gz', 'gzip', gzip_member(data1[:300000], 1),
+         data1[:300000], DTB)
+  v.good('gzip_name_1m.gz', 'gzip',
+         gzip_member(data1, 9, name=b'Image'), data1, DTB)
+  # A stored block for the random part between two compressed ones
+  v.good('gzip_mixed_1m.gz', 'gzip', gzip_member(mixed, 6), mixed, DTB)
+  v.good('gzip_fixed_1m.gz', 'gzip',
+         gzip_member(data1, 9, zlib.Z_FIXED), data1, DTB)
+  v.good('gzip_rle_300k.gz', 'gzip',
+         gzip_member(runs, 9, zlib.Z_RLE), runs, DTB)
+  v.good('gzip_pattern_1m.gz', 'gzip', gzip_member(pattern, 9), pattern, DTB)
+  v.good('gzip_skewed_200k.gz', 'gzip',
+         gzip_member(skew, 9, zlib.Z_HUFFMAN_ONLY), skew, DTB)
+
+  header = struct.pack('<BBBBIBB', 0x1F, 0x8B, 8, 0, 0, 0, 3)
+  trailer8 = bytes(8)
+  # Final block of the reserved type 3
+  v.bad('gzip_reserved_block.gz', 'gzip', header + b'\x07' + trailer8)
+  # Fixed block: 'a', then a match at distance 2 with one byte of output
+  w = BitWriter()
+  w.field(1, 1)
+  w.field(1, 2)
+  w.code(0x30 + ord('a'), 8)
+  w.code(257 - 256, 7)
+  w.code(1, 5)
+  w.code(0, 7)
+  v.bad('gzip_far_distance.gz', 'gzip', header + w.bytes() + trailer8)
+  gz = gzip_member(data1, 6)
+  v.bad('gzip_truncated.gz', 'gzip', gz[:len(gz) // 2])
+
+
+def main():
+  data_dir = sys.argv[1] if len(sys.argv) > 1 else os.path.join(
+      os.path.dirname(os.path.abspath(__file__)), 'testdata')
+
+  data3 = kernel_like(3000000, 3)
+  data8 = kernel_like(8 * 1024 * 1024, 8)
+  data16 = kernel_like(16 * 1024 * 1024, 16)
+
+  v = Vectors(data_dir)
+  gzip_vectors(v)
+  lz4_vectors(v, data3, data8)
+  zstd_vectors(v, data3, data8, data16)
+
+  with open(os.path.join(data_dir, 'vectors.txt'), 'w') as f:
+    f.write('# Kernel decompressor vectors, generated by gen_vectors.py\n')
+    f.write('# FILE FORMAT pass OUT_LEN CRC32 POS | FILE FORMAT fail\n')
+    f.write('\n'.join(v.lines) + '\n')
+
+
+if __name__ == '__main__':
+  main()
@@ -0,0 +1,53 @@
+#!/bin/bash
+
+# Usage: run_tests.sh [OUT] [bench]
+#   OUT: the make output directory holding decomp_test,
+#     decomp_test_bytewise, decomp_test_asan and fdt_edit_test
+#     (default: ./out).
+#   bench: time each passing vector instead of running the checks, gzip
+#     with both builds of inflate_fast ().
+
+SCRIPT_DIR="$(dirname "$(readlink -f "$0")")"
+OUT="$(readlink -f "${1:-${SCRIPT_DIR}/out}")"
+VECTORS="${SCRIPT_DIR}/testdata/vectors.txt"
+BENCH_ITERATIONS=20
+
+alert() {
+  echo "$*" >&2
+}
+
+die() {
+  echo "ERROR: $@"
+  exit 1
+}
+
+main() {
+  local bin
+  for bin in decomp_test decomp_test_bytewise decomp_test_asan \
+    fdt_edit_test; do
+    [ -x "${OUT}/${bin}" ] || die "Run make in ${SCRIPT_DIR} yet?"
+  done
+
+  if [ "$2" = "bench" ]; then
+    alert "========== Benchmarking the kernel decompressors =========="
+    "${OUT}/decomp_test" -b ${BENCH_ITERATIONS} "${VECTORS}" ||
+      die "Benchmark failed!!"
+    alert "========== gzip with the byte-wise inflate_fast () =========="
+    "${OUT}/decomp_test_bytewise" -b ${BENCH_ITERATIONS} "${VECTORS}" |
+      grep "^gzip_"
+    [ "${PIPESTATUS[0]}" = 0 ] || die "Benchmark failed!!"
+    return
+  fi
+
+  alert "========== Running Tests of the kernel decompressors =========="
+  "${OUT}/decomp_test_asan" "${VECTORS}" ||
+    die "Decompressor vectors failed!!"
+  alert "Run the vectors with the byte-wise inflate_fast ()"
+  "${OUT}/decomp_test_bytewise" "${VECTORS}" ||
+    die "Decompressor vectors failed with the byte-wise inflate_fast ()!!"
+  alert "========== Running Tests of FdtEdit =========="
+  "${OUT}/fdt_edit_test" || die "FdtEdit tests failed!!"
+  alert "========== All tests passed =========="
+}
+
+main "$@"
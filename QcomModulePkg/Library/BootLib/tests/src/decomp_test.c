@@ -0,0 +1,435 @@
+/* Vector test and benchmark for the kernel decompressors BootLinux.c
+ * dispatches to through KernelDecompressors.
+ *
+ *   decomp_test [-v] VECTORS
+ *       Decompresses every vector listed in VECTORS, see gen_vectors.py for
+ *       the format. A passing vector must match its length, CRC32 and stop
+ *       position, and must fail with a buffer one byte short. It is then
+ *       decoded again truncated and with single bytes corrupted: those may
+ *       fail, but must not write past the output buffer or report the full
+ *       output for a truncated stream. gzip vectors are also inflated with
+ *       input and output handed over in small chunks. Exits non-zero if any
+ *       check fails.
+ *   decomp_test -b ITERATIONS VECTORS
+ *       Times each passing vector instead.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "Decompress.h"
+#include "zlib.h"
+
+#define GUARD_SIZE 64
+#define GUARD_BYTE 0xA5
+#define FAIL_OUT_SIZE (32 * 1024 * 1024)
+#define TRUNCATE_STEPS 97
+#define CORRUPT_COUNT 256
+#define CHUNKED_RUNS 4
+/* Longest trailer after a stream: gzip's CRC32 and size */
+#define TRAILER_MAX 8
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+typedef int (*decompress_t)(unsigned char *, unsigned int, unsigned char *,
+                            unsigned int, unsigned int *, unsigned int *);
+
+typedef struct vector vector_t;
+typedef int (*check_t)(const vector_t *, const unsigned char *, unsigned int);
+
+static int check_chunked(const vector_t *v, const unsigned char *in,
+                         unsigned int in_len);
+
+static const struct {
+  const char *name;
+  decompress_t decompress;
+  check_t check;
+} formats[] = {
+    {"gzip", decompress, check_chunked},
+    {"lz4", lz4_decompress, NULL},
+    {"zstd", zstd_decompress, NULL},
+};
+
+struct vector {
+  char file[256];
+  decompress_t decompress;
+  check_t check;
+  int pass;
+  unsigned int out_len;
+  unsigned int crc;
+  unsigned int pos;
+  int line;
+};
+
+int HostDebug;
+
+void HostDebugPrint(unsigned int Level, const char *Format, ...) {
+  char fmt[256];
+  size_t i, j;
+  va_list args;
+
+  (void)Level;
+  for (i = 0, j = 0; Format[i] && j < sizeof(fmt) - 2; i++) {
+    fmt[j++] = Format[i];
+    if (Format[i] == '%' && Format[i + 1] == 'a') {
+      fmt[j++] = 's';
+      i++;
+    }
+  }
+  fmt[j] = '\0';
+
+  va_start(args, Format);
+  vfprintf(stderr, fmt, args);
+  va_end(args);
+}
+
+static unsigned int checksum(const unsigned char *buf, size_t len) {
+  static unsigned int table[256];
+  unsigned int crc = 0xFFFFFFFF;
+  size_t i;
+
+  if (table[1] == 0) {
+    for (i = 0; i < 256; i++) {
+      unsigned int c = i;
+      int k;
+      for (k = 0; k < 8; k++) {
+        c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+      }
+      table[i] = c;
+    }
+  }
+  for (i = 0; i < len; i++) {
+    crc = table[(crc ^ buf[i]) & 0xFF] ^ (crc >> 8);
+  }
+  return crc ^ 0xFFFFFFFF;
+}
+
+static unsigned char *read_file(const char *path, unsigned int *len) {
+  unsigned char *buf;
+  long size;
+  FILE *fp;
+
+  fp = fopen(path, "rb");
+  if (!fp) {
+    return NULL;
+  }
+  fseek(fp, 0, SEEK_END);
+  size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  /* At least one byte, so that empty truncations still have a buffer */
+  buf = malloc(size + 1);
+  if (buf && fread(buf, 1, size, fp) != (size_t)size) {
+    free(buf);
+    buf = NULL;
+  }
+  fclose(fp);
+  *len = (unsigned int)size;
+  return buf;
+}
+
+/* Output buffer of Size bytes followed by the guard */
+static unsigned char *alloc_out(unsigned int size) {
+  unsigned char *out = malloc(size + GUARD_SIZE);
+
+  if (out) {
+    memset(out + size, GUARD_BYTE, GUARD_SIZE);
+  }
+  return out;
+}
+
+static int guard_ok(const unsigned char *out, unsigned int size) {
+  unsigned int i;
+
+  for (i = 0; i < GUARD_SIZE; i++) {
+    if (out[size + i] != GUARD_BYTE) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/* Runs the decompressor on the first In_len bytes of In, copied so that
+ * reads past In_len hit the end of a heap block. Returns its result; -2 if
+ * it wrote past Out_size or claims to have.
+ */
+static int run(const vector_t *v, const unsigned char *in, unsigned int in_len,
+               unsigned char *out, unsigned int out_size, unsigned int *pos,
+               unsigned int *out_len) {
+  unsigned char *copy = malloc(in_len + 1);
+  int rc;
+
+  memcpy(copy, in, in_len);
+  *pos = 0;
+  *out_len = 0;
+  rc = v->decompress(copy, in_len, out, out_size, pos, out_len);
+  free(copy);
+  if (!guard_ok(out, out_size) ||
+      (rc == 0 && (*out_len > out_size || *pos > in_len))) {
+    return -2;
+  }
+  return rc;
+}
+
+static int check_pass(const vector_t *v, const unsigned char *in,
+                      unsigned int in_len) {
+  unsigned char *out = alloc_out(v->out_len);
+  unsigned int pos, out_len, len, i;
+  unsigned int seed = v->crc;
+  int failed = 0;
+  int rc;
+
+  rc = run(v, in, in_len, out, v->out_len, &pos, &out_len);
+  if (rc != 0 || out_len != v->out_len || checksum(out, out_len) != v->crc ||
+      pos != v->pos) {
+    fprintf(stderr, "%s: rc %d, %u bytes, crc %08x, pos %u\n", v->file, rc,
+            out_len, checksum(out, out_len), pos);
+    failed++;
+  }
+
+  /* One byte short */
+  memset(out + v->out_len - 1, GUARD_BYTE, GUARD_SIZE);
+  if (run(v, in, in_len, out, v->out_len - 1, &pos, &out_len) == 0) {
+    fprintf(stderr, "%s: decoded into a buffer one byte short\n", v->file);
+    failed++;
+  }
+  memset(out + v->out_len, GUARD_BYTE, GUARD_SIZE);
+
+  /* Truncated inside the stream, before any trailer */
+  for (i = 0; i <= TRUNCATE_STEPS + 64; i++) {
+    len = i < 64 ? i : (unsigned long long)(v->pos - TRAILER_MAX) *
+                           (i - 64) / (TRUNCATE_STEPS + 1);
+    if (len >= v->pos - TRAILER_MAX) {
+      continue;
+    }
+    rc = run(v, in, len, out, v->out_len, &pos, &out_len);
+    if (rc == -2 || (rc == 0 && out_len == v->out_len)) {
+      fprintf(stderr, "%s: truncated to %u bytes: rc %d, %u bytes\n",
+              v->file, len, rc, out_len);
+      failed++;
+    }
+  }
+
+  /* Single corrupted bytes */
+  for (i = 0; i < CORRUPT_COUNT; i++) {
+    unsigned char *bad = malloc(in_len);
+    unsigned int at;
+
+    seed = seed * 1103515245 + 12345;
+    at = (seed >> 8) % v->pos;
+    memcpy(bad, in, in_len);
+    bad[at] ^= 1 + (seed >> 24) % 255;
+    rc = run(v, bad, in_len, out, v->out_len, &pos, &out_len);
+    free(bad);
+    if (rc == -2) {
+      fprintf(stderr, "%s: byte %u corrupted: wrote past the buffer\n",
+              v->file, at);
+      failed++;
+    }
+  }
+
+  if (v->check) {
+    failed += v->check(v, in, in_len);
+  }
+
+  free(out);
+  return failed;
+}
+
+/* Inflates a gzip vector with zlib directly, handing over input and output
+ * a few bytes to a few KB at a time. inflate () then keeps switching between
+ * inflate_fast () and its own byte-wise states at the buffer edges.
+ */
+static int check_chunked(const vector_t *v, const unsigned char *in,
+                         unsigned int in_len) {
+  unsigned char *out = alloc_out(v->out_len);
+  unsigned int seed = v->crc;
+  unsigned int start = 10;
+  int failed = 0;
+  int run_no;
+
+  /* FNAME, the only optional field decompress () skips too */
+  if (in[3] & 0x08) {
+    while (start < in_len && in[start++]) {
+    }
+  }
+
+  for (run_no = 0; run_no < CHUNKED_RUNS; run_no++) {
+    z_stream stream;
+    unsigned int max_chunk = run_no & 1 ? 16 : 4096;
+    int rc = Z_OK;
+
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+      fprintf(stderr, "%s: inflateInit2 failed\n", v->file);
+      failed++;
+      break;
+    }
+    stream.next_in = (unsigned char *)in + start;
+    stream.next_out = out;
+    while (rc == Z_OK) {
+      unsigned int in_left = in_len - (stream.next_in - in);
+      unsigned int out_left = v->out_len - (stream.next_out - out);
+
+      seed = seed * 1103515245 + 12345;
+      stream.avail_in = MIN(in_left, 1 + (seed >> 8) % max_chunk);
+      seed = seed * 1103515245 + 12345;
+      stream.avail_out = MIN(out_left, 1 + (seed >> 8) % max_chunk);
+      rc = inflate(&stream, Z_NO_FLUSH);
+      if (rc == Z_BUF_ERROR && in_left && out_left) {
+        rc = Z_OK;
+      }
+    }
+    inflateEnd(&stream);
+
+    if (rc != Z_STREAM_END || stream.total_out != v->out_len ||
+        checksum(out, v->out_len) != v->crc || !guard_ok(out, v->out_len)) {
+      fprintf(stderr, "%s: chunks of up to %u bytes: rc %d, %lu bytes\n",
+              v->file, max_chunk, rc, stream.total_out);
+      failed++;
+    }
+  }
+
+  free(out);
+  return failed;
+}
+
+static int check_fail(const vector_t *v, const unsigned char *in,
+                      unsigned int in_len) {
+  unsigned char *out = alloc_out(FAIL_OUT_SIZE);
+  unsigned int pos, out_len;
+  int rc;
+
+  rc = run(v, in, in_len, out, FAIL_OUT_SIZE, &pos, &out_len);
+  free(out);
+  if (rc != -1) {
+    fprintf(stderr, "%s: rc %d, %u bytes, expected a failure\n", v->file, rc,
+            out_len);
+    return 1;
+  }
+  return 0;
+}
+
+static void bench(const vector_t *v, unsigned char *in, unsigned int in_len,
+                  int iterations) {
+  unsigned char *out = alloc_out(v->out_len);
+  unsigned int pos, out_len;
+  struct timespec start, end;
+  double ms;
+  int i;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < iterations; i++) {
+    if (v->decompress(in, in_len, out, v->out_len, &pos, &out_len)) {
+      fprintf(stderr, "%s: decompression failed\n", v->file);
+      exit(1);
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  ms = ((end.tv_sec - start.tv_sec) * 1e3 +
+        (end.tv_nsec - start.tv_nsec) / 1e6) / iterations;
+  printf("%s: %u -> %u bytes, %.2f ms, %.0f MB/s\n", v->file, pos, out_len,
+         ms, out_len / ms / 1e3);
+  free(out);
+}
+
+static int parse_line(vector_t *v, char *line) {
+  char format[16], result[8];
+  size_t i;
+
+  if (sscanf(line, "%255s %15s %7s %u %x %u", v->file, format, result,
+             &v->out_len, &v->crc, &v->pos) < 3) {
+    return -1;
+  }
+  v->pass = !strcmp(result, "pass");
+  v->decompress = NULL;
+  for (i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+    if (!strcmp(formats[i].name, format)) {
+      v->decompress = formats[i].decompress;
+      v->check = formats[i].check;
+    }
+  }
+  if (v->decompress == NULL ||
+      (v->pass && (v->out_len == 0 || v->pos < TRAILER_MAX))) {
+    return -1;
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  char dir[1024], path[1300], *slash;
+  char *line = NULL;
+  size_t cap = 0;
+  int iterations = 0, count = 0, failed = 0, line_no = 0;
+  int i = 1;
+  FILE *fp;
+
+  for (; i < argc && argv[i][0] == '-'; i++) {
+    if (!strcmp(argv[i], "-v")) {
+      HostDebug = 1;
+    } else if (!strcmp(argv[i], "-b") && i + 1 < argc) {
+      iterations = atoi(argv[++i]);
+    } else {
+      break;
+    }
+  }
+  if (i + 1 != argc || iterations < 0) {
+    fprintf(stderr, "Usage: %s [-v] [-b ITERATIONS] VECTORS\n", argv[0]);
+    return 1;
+  }
+
+  fp = fopen(argv[i], "r");
+  if (!fp) {
+    fprintf(stderr, "Can not open %s\n", argv[i]);
+    return 1;
+  }
+  snprintf(dir, sizeof(dir), "%s", argv[i]);
+  slash = strrchr(dir, '/');
+  if (slash) {
+    slash[1] = '\0';
+  } else {
+    dir[0] = '\0';
+  }
+
+  while (getline(&line, &cap, fp) > 0) {
+    unsigned char *in;
+    unsigned int in_len;
+    vector_t v;
+
+    line_no++;
+    if (line[0] == '#' || line[0] == '\n') {
+      continue;
+    }
+    if (parse_line(&v, line)) {
+      fprintf(stderr, "%s:%d: bad line\n", argv[i], line_no);
+      failed++;
+      continue;
+    }
+    snprintf(path, sizeof(path), "%s%s", dir, v.file);
+    in = read_file(path, &in_len);
+    if (in == NULL) {
+      fprintf(stderr, "Can not read %s\n", path);
+      failed++;
+      continue;
+    }
+
+    if (iterations > 0) {
+      if (v.pass) {
+        bench(&v, in, in_len, iterations);
+      }
+    } else {
+      failed += v.pass ? check_pass(&v, in, in_len) : check_fail(&v, in, in_len);
+      count++;
+    }
+    free(in);
+  }
+
+  if (iterations == 0) {
+    printf("%s: %d vectors, %d failed checks\n", argv[i], count, failed);
+  }
+  free(line);
+  fclose(fp);
+  return failed != 0;
+}
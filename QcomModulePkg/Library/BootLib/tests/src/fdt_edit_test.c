@@ -0,0 +1,551 @@
+/* Host test for the batched device tree edits of FdtEdit.c.
+ *
+ *   fdt_edit_test [-s SEEDS]
+ *       Applies a fixed edit list like UpdateDeviceTree's and SEEDS
+ *       (default 500) seeded random ones to a generated device tree, as
+ *       built, converted to version 16 and with its blocks misordered.
+ *       Exits non-zero if any check fails.
+ *
+ * Every edit list is also replayed through fdt_setprop, fdt_appendprop,
+ * fdt_appendprop_string and fdt_delprop, one edit at a time on a blob opened
+ * with fdt_open_into, and both results must hold the same nodes and property
+ * values. libfdt puts a property it adds first in its node while FdtEdit.c
+ * keeps an existing one in place, so property order is not compared.
+ *
+ * FdtEditApply () runs on a buffer of exactly FdtEditSize () bytes, so the
+ * sanitizers catch a result past the bound, and on one byte less, which
+ * must fail with -FDT_ERR_NOSPACE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <Library/FdtEdit.h>
+
+#define MAX_NODES 64
+#define MAX_EDITS 48
+#define MAX_VAL 48
+
+typedef enum {
+  LAYOUT_V17,
+  LAYOUT_V16,
+  LAYOUT_V16_MISORDERED,
+  LAYOUT_COUNT,
+} layout_t;
+
+static const char* layout_names[] = {"v17", "v16", "v16 misordered"};
+
+typedef enum {
+  EDIT_SET,
+  EDIT_SET_U32,
+  EDIT_SET_U64,
+  EDIT_APPEND,
+  EDIT_APPEND_U32,
+  EDIT_APPEND_U64,
+  EDIT_APPEND_STRING,
+  EDIT_DELETE,
+} edit_op_t;
+
+typedef struct {
+  int node; /* Index into nodes[] */
+  const char* name;
+  edit_op_t op;
+  uint64_t num;
+  uint8_t val[MAX_VAL];
+  int len;
+} edit_t;
+
+/* Every node of the source tree, by offset and by path */
+static struct {
+  int offset;
+  char path[64];
+} nodes[MAX_NODES];
+static int node_count;
+
+/* Properties the random edits pick from. String ones only ever hold
+ * strings, fdt_appendprop_string overwrites the last byte of the old value.
+ */
+static const char* string_names[] = {"bootargs", "status", "model",
+                                     "compatible", "label"};
+static const char* cell_names[] = {
+    "reg",     "linux,initrd-start", "kaslr-seed", "granule",
+    "ranges",  "dma-coherent",       "interrupts", "#address-cells"};
+
+static uint32_t rng_state;
+
+static uint32_t rnd(uint32_t n) {
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 17;
+  rng_state ^= rng_state << 5;
+  return rng_state % n;
+}
+
+static void check(int ok, const char* what, const char* layout, int seed,
+                  int* failed) {
+  if (!ok) {
+    fprintf(stderr, "%s, seed %d: %s\n", layout, seed, what);
+    (*failed)++;
+  }
+}
+
+static void property_cells(void* fdt, const char* name, const uint32_t* cells,
+                           int count) {
+  fdt32_t val[8];
+  int i;
+
+  for (i = 0; i < count; i++) {
+    val[i] = cpu_to_fdt32(cells[i]);
+  }
+  fdt_property(fdt, name, val, count * sizeof(val[0]));
+}
+
+/* A tree shaped like a board DTB: root properties, chosen, two memory
+ * nodes, cpus and a soc with many devices, one property turned into NOPs.
+ */
+static void* build_tree(void) {
+  static const uint32_t mem0[] = {0, 0x80000000, 0, 0x3a800000};
+  static const uint32_t mem1[] = {0, 0xc0000000, 0, 0x40000000};
+  int size = 64 * 1024;
+  void* fdt = malloc(size);
+  char name[32];
+  uint32_t cells[4];
+  int i;
+
+  fdt_create(fdt, size);
+  fdt_add_reservemap_entry(fdt, 0x85000000, 0x100000);
+  fdt_finish_reservemap(fdt);
+  fdt_begin_node(fdt, "");
+  fdt_property_u32(fdt, "#address-cells", 2);
+  fdt_property_u32(fdt, "#size-cells", 2);
+  fdt_property_string(fdt, "model", "Qualcomm Technologies, Inc. Test");
+  fdt_property_string(fdt, "compatible", "qcom,test");
+
+  fdt_begin_node(fdt, "chosen");
+  fdt_property_string(fdt, "bootargs", "console=ttyMSM0,115200n8");
+  fdt_end_node(fdt);
+
+  fdt_begin_node(fdt, "memory");
+  fdt_property_string(fdt, "device_type", "memory");
+  property_cells(fdt, "reg", mem0, 4);
+  fdt_end_node(fdt);
+  fdt_begin_node(fdt, "memory@c0000000");
+  fdt_property_string(fdt, "device_type", "memory");
+  property_cells(fdt, "reg", mem1, 4);
+  fdt_end_node(fdt);
+
+  fdt_begin_node(fdt, "cpus");
+  fdt_property_u32(fdt, "#address-cells", 2);
+  fdt_property_u32(fdt, "#size-cells", 0);
+  for (i = 0; i < 8; i++) {
+    snprintf(name, sizeof(name), "cpu@%d", i * 100);
+    fdt_begin_node(fdt, name);
+    fdt_property_string(fdt, "device_type", "cpu");
+    fdt_property_string(fdt, "compatible", "arm,armv8");
+    cells[0] = 0;
+    cells[1] = i * 0x100;
+    property_cells(fdt, "reg", cells, 2);
+    fdt_property_string(fdt, "enable-method", "psci");
+    fdt_end_node(fdt);
+  }
+  fdt_end_node(fdt);
+
+  fdt_begin_node(fdt, "soc");
+  fdt_property(fdt, "ranges", "", 0);
+  for (i = 0; i < 40; i++) {
+    snprintf(name, sizeof(name), "dev@%x", 0x1000000 + i * 0x10000);
+    fdt_begin_node(fdt, name);
+    fdt_property_string(fdt, "compatible", i % 3 ? "qcom,dev" : "qcom,other");
+    cells[0] = 0x1000000 + i * 0x10000;
+    cells[1] = 0x1000;
+    property_cells(fdt, "reg", cells, 2);
+    fdt_property_string(fdt, "status", i % 4 ? "okay" : "disabled");
+    if (i % 5 == 0) {
+      fdt_property(fdt, "dma-coherent", "", 0);
+    }
+    fdt_end_node(fdt);
+  }
+  fdt_end_node(fdt);
+
+  fdt_end_node(fdt);
+  fdt_finish(fdt);
+
+  fdt_nop_property(fdt, fdt_path_offset(fdt, "/cpus/cpu@300"),
+                   "enable-method");
+  return fdt;
+}
+
+/* fdt as dtc -V 16 writes it: a 36 byte header, so no struct block size.
+ * Misordered puts the strings block before the struct block.
+ */
+static void* convert_tree(const void* fdt, layout_t layout) {
+  uint32_t struct_off = fdt_off_dt_struct(fdt);
+  uint32_t struct_size = fdt_size_dt_struct(fdt);
+  uint32_t strings_size = fdt_size_dt_strings(fdt);
+  uint32_t total = fdt_totalsize(fdt);
+  /* The struct block stays 4 byte aligned behind the strings */
+  uint32_t moved_off = struct_off + ALIGN_VALUE(strings_size, FDT_TAGSIZE);
+  uint8_t* out = calloc(1, moved_off + struct_size);
+
+  memcpy(out, fdt, total);
+  if (layout == LAYOUT_V17) {
+    return out;
+  }
+  fdt_set_version(out, 16);
+  fdt_set_size_dt_struct(out, 0);
+  if (layout == LAYOUT_V16_MISORDERED) {
+    memcpy(out + struct_off, (const uint8_t*)fdt + fdt_off_dt_strings(fdt),
+           strings_size);
+    memcpy(out + moved_off, (const uint8_t*)fdt + struct_off, struct_size);
+    fdt_set_off_dt_strings(out, struct_off);
+    fdt_set_off_dt_struct(out, moved_off);
+    fdt_set_totalsize(out, moved_off + struct_size);
+  }
+  return out;
+}
+
+static void collect_nodes(const void* fdt) {
+  int offset = 0;
+  int depth = 0;
+
+  /* fdt_next_node returns depth -1 past the root's end */
+  node_count = 0;
+  while (offset >= 0 && depth >= 0 && node_count < MAX_NODES) {
+    nodes[node_count].offset = offset;
+    fdt_get_path(fdt, offset, nodes[node_count].path,
+                 sizeof(nodes[node_count].path));
+    node_count++;
+    offset = fdt_next_node(fdt, offset, &depth);
+  }
+}
+
+static void random_bytes(uint8_t* val, int len) {
+  int i;
+
+  for (i = 0; i < len; i++) {
+    val[i] = (uint8_t)rnd(256);
+  }
+}
+
+static void random_string(edit_t* e) {
+  static const char* words[] = {"androidboot.mode=normal", "ok", "", "fail",
+                                "qcom,dev-v2", "a"};
+  const char* word = words[rnd(sizeof(words) / sizeof(words[0]))];
+
+  e->len = strlen(word) + 1;
+  memcpy(e->val, word, e->len);
+}
+
+static int random_edits(edit_t* edits) {
+  int count = 1 + rnd(MAX_EDITS);
+  int i;
+
+  for (i = 0; i < count; i++) {
+    edit_t* e = &edits[i];
+    int string = rnd(3) == 0;
+
+    memset(e, 0, sizeof(*e));
+    /* Favor a few nodes so that edits pile up on the same properties */
+    e->node = rnd(2) ? rnd(4) : rnd(node_count);
+    if (string) {
+      e->name = string_names[rnd(sizeof(string_names) /
+                                 sizeof(string_names[0]))];
+      e->op = (edit_op_t[]){EDIT_SET, EDIT_APPEND_STRING,
+                            EDIT_DELETE}[rnd(3)];
+      if (e->op != EDIT_DELETE) {
+        random_string(e);
+      }
+      continue;
+    }
+    e->name = cell_names[rnd(sizeof(cell_names) / sizeof(cell_names[0]))];
+    e->op = (edit_op_t[]){EDIT_SET, EDIT_SET_U32, EDIT_SET_U64, EDIT_APPEND,
+                          EDIT_APPEND_U32, EDIT_APPEND_U64,
+                          EDIT_DELETE}[rnd(7)];
+    e->num = (uint64_t)rnd(0x7fffffff) << 32 | rnd(0x7fffffff);
+    e->len = rnd(MAX_VAL + 1);
+    random_bytes(e->val, e->len);
+  }
+  return count;
+}
+
+/* The edits UpdateDeviceTree makes, plus a status change on a device */
+static int fixed_edits(edit_t* edits) {
+  static const edit_t fixed[] = {
+      {2, "reg", EDIT_SET_U64, 0x80000000},
+      {2, "reg", EDIT_APPEND_U64, 0x3a800000},
+      {2, "reg", EDIT_APPEND_U64, 0x100000000ULL},
+      {2, "reg", EDIT_APPEND_U64, 0x80000000},
+      {1, "bootargs", EDIT_APPEND_STRING, 0, "androidboot.verifiedbootstate=green",
+       36},
+      {1, "bootargs", EDIT_APPEND_STRING, 0, "androidboot.mode=normal", 24},
+      {1, "kaslr-seed", EDIT_APPEND_U64, 0x0123456789abcdefULL},
+      {1, "linux,initrd-start", EDIT_SET_U64, 0x88000000},
+      {1, "linux,initrd-end", EDIT_SET_U64, 0x88400000},
+      {0, "granule", EDIT_SET_U32, 0x200},
+      {20, "status", EDIT_SET, 0, "disabled", 9},
+      {3, "reg", EDIT_DELETE},
+  };
+
+  memcpy(edits, fixed, sizeof(fixed));
+  return sizeof(fixed) / sizeof(fixed[0]);
+}
+
+static int add_edit(FDT_EDIT_LIST* list, const edit_t* e) {
+  int node = nodes[e->node].offset;
+
+  switch (e->op) {
+    case EDIT_SET:
+      return FdtEditSetProp(list, node, e->name, e->val, e->len);
+    case EDIT_SET_U32:
+      return FdtEditSetPropU32(list, node, e->name, (UINT32)e->num);
+    case EDIT_SET_U64:
+      return FdtEditSetPropU64(list, node, e->name, e->num);
+    case EDIT_APPEND:
+      return FdtEditAppendProp(list, node, e->name, e->val, e->len);
+    case EDIT_APPEND_U32:
+      return FdtEditAppendPropU32(list, node, e->name, (UINT32)e->num);
+    case EDIT_APPEND_U64:
+      return FdtEditAppendPropU64(list, node, e->name, e->num);
+    case EDIT_APPEND_STRING:
+      return FdtEditAppendPropString(list, node, e->name,
+                                     (const char*)e->val);
+    case EDIT_DELETE:
+      return FdtEditDelProp(list, node, e->name);
+  }
+  return -FDT_ERR_INTERNAL;
+}
+
+/* The same edit through libfdt, on a blob whose offsets move with each */
+static int libfdt_edit(void* fdt, const edit_t* e) {
+  int node = fdt_path_offset(fdt, nodes[e->node].path);
+  int ret = -FDT_ERR_INTERNAL;
+
+  if (node < 0) {
+    return node;
+  }
+  switch (e->op) {
+    case EDIT_SET:
+      ret = fdt_setprop(fdt, node, e->name, e->val, e->len);
+      break;
+    case EDIT_SET_U32:
+      ret = fdt_setprop_u32(fdt, node, e->name, (uint32_t)e->num);
+      break;
+    case EDIT_SET_U64:
+      ret = fdt_setprop_u64(fdt, node, e->name, e->num);
+      break;
+    case EDIT_APPEND:
+      ret = fdt_appendprop(fdt, node, e->name, e->val, e->len);
+      break;
+    case EDIT_APPEND_U32:
+      ret = fdt_appendprop_u32(fdt, node, e->name, (uint32_t)e->num);
+      break;
+    case EDIT_APPEND_U64:
+      ret = fdt_appendprop_u64(fdt, node, e->name, e->num);
+      break;
+    case EDIT_APPEND_STRING:
+      ret = fdt_appendprop_string(fdt, node, e->name, (const char*)e->val);
+      break;
+    case EDIT_DELETE:
+      ret = fdt_delprop(fdt, node, e->name);
+      /* FdtEditDelProp of a missing property is no edit either */
+      if (ret == -FDT_ERR_NOTFOUND) {
+        ret = 0;
+      }
+      break;
+  }
+  return ret;
+}
+
+static int count_props(const void* fdt, int node) {
+  int count = 0;
+  int offset;
+
+  for (offset = fdt_first_property_offset(fdt, node); offset >= 0;
+       offset = fdt_next_property_offset(fdt, offset)) {
+    count++;
+  }
+  return count;
+}
+
+/* Whether a and b hold the same reserve map, nodes and property values */
+static int same_tree(const void* a, const void* b) {
+  uint64_t addr_a, size_a, addr_b, size_b;
+  int node_a = 0, node_b = 0;
+  int depth_a = 0, depth_b = 0;
+  int i;
+
+  if (fdt_num_mem_rsv(a) != fdt_num_mem_rsv(b)) {
+    return 0;
+  }
+  for (i = 0; i < fdt_num_mem_rsv(a); i++) {
+    fdt_get_mem_rsv(a, i, &addr_a, &size_a);
+    fdt_get_mem_rsv(b, i, &addr_b, &size_b);
+    if (addr_a != addr_b || size_a != size_b) {
+      return 0;
+    }
+  }
+
+  while (node_a >= 0 && node_b >= 0 && depth_a >= 0 && depth_b >= 0) {
+    const char* name_a = fdt_get_name(a, node_a, NULL);
+    const char* name_b = fdt_get_name(b, node_b, NULL);
+    int offset;
+
+    if (depth_a != depth_b || name_a == NULL || name_b == NULL ||
+        strcmp(name_a, name_b) ||
+        count_props(a, node_a) != count_props(b, node_b)) {
+      return 0;
+    }
+    for (offset = fdt_first_property_offset(a, node_a); offset >= 0;
+         offset = fdt_next_property_offset(a, offset)) {
+      const char* name;
+      const void* val_a;
+      const void* val_b;
+      int len_a, len_b;
+
+      val_a = fdt_getprop_by_offset(a, offset, &name, &len_a);
+      val_b = fdt_getprop(b, node_b, name, &len_b);
+      if (val_b == NULL || len_a != len_b || memcmp(val_a, val_b, len_a)) {
+        return 0;
+      }
+    }
+    node_a = fdt_next_node(a, node_a, &depth_a);
+    node_b = fdt_next_node(b, node_b, &depth_b);
+  }
+  return depth_a < 0 && depth_b < 0 && node_a >= 0 && node_b >= 0;
+}
+
+/* Runs one edit list against one layout of the source tree. Returns the
+ * number of failed checks.
+ */
+static int run_edits(const void* src, layout_t layout, const edit_t* edits,
+                     int count, int seed) {
+  const char* name = layout_names[layout];
+  uint32_t total = fdt_totalsize(src);
+  FDT_EDIT_LIST list;
+  uint32_t bound;
+  uint32_t size;
+  uint8_t* out;
+  uint8_t* ref;
+  int failed = 0;
+  int ret = 0;
+  int i;
+
+  FdtEditInit(&list);
+  for (i = 0; i < count && !ret; i++) {
+    ret = add_edit(&list, &edits[i]);
+  }
+  check(ret == 0, "FdtEdit*Prop failed", name, seed, &failed);
+
+  /* libfdt, one edit at a time */
+  ref = malloc(total + 64 * 1024);
+  ret = fdt_open_into(src, ref, total + 64 * 1024);
+  for (i = 0; i < count && !ret; i++) {
+    ret = libfdt_edit(ref, &edits[i]);
+  }
+  check(ret == 0, "libfdt edits failed", name, seed, &failed);
+
+  /* An in-place fdt_open_into of misordered blocks needs room for both */
+  bound = FdtEditSize(src, &list);
+  size = layout == LAYOUT_V16_MISORDERED ? total + bound : bound;
+  out = malloc(MAX(size, total));
+
+  if (layout == LAYOUT_V17) {
+    memcpy(out, src, total);
+    check(FdtEditApply(out, bound - 1, &list) == -FDT_ERR_NOSPACE,
+          "FdtEditApply fit one byte under FdtEditSize", name, seed, &failed);
+    check(!memcmp(out, src, total), "failed FdtEditApply changed the blob",
+          name, seed, &failed);
+  }
+
+  memcpy(out, src, total);
+  ret = FdtEditApply(out, size, &list);
+  check(ret == 0, "FdtEditApply failed", name, seed, &failed);
+  if (ret == 0) {
+    check(fdt_check_header(out) == 0 && fdt_version(out) == 17 &&
+              fdt_totalsize(out) == size,
+          "bad header", name, seed, &failed);
+    check(fdt_off_dt_strings(out) + fdt_size_dt_strings(out) <= bound,
+          "result larger than FdtEditSize", name, seed, &failed);
+    check(same_tree(out, ref), "differs from libfdt", name, seed, &failed);
+  }
+
+  FdtEditFree(&list);
+  free(out);
+  free(ref);
+  return failed;
+}
+
+/* Node offsets that are not nodes must be rejected */
+static int run_bad_offsets(const void* src) {
+  int offsets[] = {fdt_first_property_offset(src, 0),
+                   (int)fdt_size_dt_struct(src) + 8};
+  uint32_t total = fdt_totalsize(src);
+  uint8_t* out = malloc(total + 1024);
+  FDT_EDIT_LIST list;
+  int failed = 0;
+  size_t i;
+
+  FdtEditInit(&list);
+  check(FdtEditSetPropU32(&list, -1, "reg", 0) == -FDT_ERR_BADOFFSET,
+        "negative node accepted", "v17", 0, &failed);
+  FdtEditFree(&list);
+
+  for (i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++) {
+    FdtEditInit(&list);
+    FdtEditSetPropU32(&list, offsets[i], "reg", 0);
+    memcpy(out, src, total);
+    check(FdtEditApply(out, total + 1024, &list) == -FDT_ERR_BADOFFSET,
+          "bad node offset accepted", "v17", 0, &failed);
+    FdtEditFree(&list);
+  }
+  free(out);
+  return failed;
+}
+
+int main(int argc, char** argv) {
+  edit_t edits[MAX_EDITS];
+  void* tree;
+  void* src[LAYOUT_COUNT];
+  int seeds = 500;
+  int failed = 0;
+  int layout;
+  int opt;
+  int seed;
+
+  while ((opt = getopt(argc, argv, "s:")) != -1) {
+    if (opt != 's' || (seeds = atoi(optarg)) < 0) {
+      fprintf(stderr, "Usage: %s [-s SEEDS]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  tree = build_tree();
+  collect_nodes(tree);
+  for (layout = 0; layout < LAYOUT_COUNT; layout++) {
+    src[layout] = convert_tree(tree, layout);
+  }
+
+  failed += run_bad_offsets(src[LAYOUT_V17]);
+  for (layout = 0; layout < LAYOUT_COUNT; layout++) {
+    int layout_failed = 0;
+
+    /* Seed 0 is the fixed list */
+    for (seed = 0; seed <= seeds; seed++) {
+      int count;
+
+      rng_state = 0x9e3779b9u ^ (uint32_t)seed * 2654435761u;
+      count = seed ? random_edits(edits) : fixed_edits(edits);
+      layout_failed += run_edits(src[layout], layout, edits, count, seed);
+    }
+    printf("%s: %d edit lists, %d failed checks\n", layout_names[layout],
+           seeds + 1, layout_failed);
+    failed += layout_failed;
+  }
+
+  for (layout = 0; layout < LAYOUT_COUNT; layout++) {
+    free(src[layout]);
+  }
+  free(tree);
+  return failed != 0;
+}
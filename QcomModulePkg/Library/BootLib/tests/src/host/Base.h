@@ -0,0 +1,48 @@
+#ifndef _DECOMP_TEST_BASE_H_
+#define _DECOMP_TEST_BASE_H_
+
+/* Host stand-in for MdePkg's Base.h: the types and macros the kernel
+ * decompressors and FdtEdit.c use, mapped onto the C runtime ones.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef unsigned char BOOLEAN;
+typedef int8_t INT8;
+typedef uint8_t UINT8;
+typedef int16_t INT16;
+typedef uint16_t UINT16;
+typedef int32_t INT32;
+typedef uint32_t UINT32;
+typedef int64_t INT64;
+typedef uint64_t UINT64;
+typedef intptr_t INTN;
+typedef uintptr_t UINTN;
+typedef char CHAR8;
+typedef void VOID;
+
+#define CONST const
+#define STATIC static
+#define IN
+#define OUT
+
+#define TRUE ((BOOLEAN)1)
+#define FALSE ((BOOLEAN)0)
+
+#define BIT0 0x00000001
+#define BIT1 0x00000002
+#define BIT2 0x00000004
+#define BIT3 0x00000008
+#define BIT4 0x00000010
+#define BIT5 0x00000020
+#define BIT6 0x00000040
+#define BIT7 0x00000080
+#define BIT31 0x80000000
+
+#define MIN(a, b) (((a) < (b)) ? (a) : (b))
+#define MAX(a, b) (((a) > (b)) ? (a) : (b))
+#define ALIGN_VALUE(Value, Alignment) \
+  ((Value) + (((Alignment) - (Value)) & ((Alignment) - 1)))
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef _DECOMP_TEST_BASE_LIB_H_
+#define _DECOMP_TEST_BASE_LIB_H_
+
+/* Host stand-in for BaseLib.h: the string functions FdtEdit.c uses */
+
+#include <string.h>
+
+#define AsciiStrSize(String) (strlen (String) + 1)
+#define AsciiStrCmp(First, Second) strcmp ((First), (Second))
+
+#endif
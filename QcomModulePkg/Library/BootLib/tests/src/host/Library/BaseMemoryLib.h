@@ -0,0 +1,11 @@
+#ifndef _DECOMP_TEST_BASE_MEMORY_LIB_H_
+#define _DECOMP_TEST_BASE_MEMORY_LIB_H_
+
+#include <string.h>
+
+#define CopyMem(Dst, Src, Len) memmove ((Dst), (Src), (Len))
+#define SetMem(Buf, Len, Value) memset ((Buf), (Value), (Len))
+#define ZeroMem(Buf, Len) memset ((Buf), 0, (Len))
+#define CompareMem(First, Second, Len) memcmp ((First), (Second), (Len))
+
+#endif
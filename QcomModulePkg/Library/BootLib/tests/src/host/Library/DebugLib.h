@@ -0,0 +1,25 @@
+#ifndef _DECOMP_TEST_DEBUG_LIB_H_
+#define _DECOMP_TEST_DEBUG_LIB_H_
+
+/* DEBUG () prints to stderr with -v only. The formats the decompressors
+ * use are printf compatible, apart from %a which HostDebugPrint maps to %s.
+ */
+
+#define EFI_D_ERROR 0x80000000
+#define EFI_D_INFO 0x00000040
+#define EFI_D_VERBOSE 0x00400000
+
+extern int HostDebug;
+
+void HostDebugPrint (unsigned int Level, const char *Format, ...);
+
+#define DEBUG(Expression)                                                      \
+  do {                                                                         \
+    if (HostDebug) {                                                           \
+      HostDebugPrint Expression;                                               \
+    }                                                                          \
+  } while (0)
+
+#define ASSERT(Expression)
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef _DECOMP_TEST_MEMORY_ALLOCATION_LIB_H_
+#define _DECOMP_TEST_MEMORY_ALLOCATION_LIB_H_
+
+#include <stdlib.h>
+
+#define AllocatePool(Size) malloc (Size)
+#define AllocateZeroPool(Size) calloc (1, (Size))
+#define FreePool(Buf) free (Buf)
+#define ReallocatePool(OldSize, NewSize, Old) realloc ((Old), (NewSize))
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef _DECOMP_TEST_UEFI_H_
+#define _DECOMP_TEST_UEFI_H_
+
+/* Host stand-in for MdePkg's Uefi.h, the decompressors and FdtEdit.c only
+ * need Base.h
+ */
+
+#include "Base.h"
+
+#endif
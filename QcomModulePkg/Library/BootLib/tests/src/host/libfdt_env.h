@@ -0,0 +1,30 @@
+#ifndef _LIBFDT_ENV_H
+#define _LIBFDT_ENV_H
+
+/* Host stand-in for EmbeddedPkg/Include/libfdt_env.h, which maps libfdt
+ * onto BaseLib. Lets tests/Makefile build FdtLib with libc.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Base.h"
+
+typedef uint16_t fdt16_t;
+typedef uint32_t fdt32_t;
+typedef uint64_t fdt64_t;
+
+#define fdt16_to_cpu(x) __builtin_bswap16(x)
+#define cpu_to_fdt16(x) __builtin_bswap16(x)
+#define fdt32_to_cpu(x) __builtin_bswap32(x)
+#define cpu_to_fdt32(x) __builtin_bswap32(x)
+#define fdt64_to_cpu(x) __builtin_bswap64(x)
+#define cpu_to_fdt64(x) __builtin_bswap64(x)
+
+/* FdtLib's local changes use MAX_UINT32 */
+#define MAX_UINT32 0xffffffffU
+
+#endif /* _LIBFDT_ENV_H */
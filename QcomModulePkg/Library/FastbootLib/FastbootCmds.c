@@ -48,6 +48,7 @@ found at
 #include <Library/BaseLib.h>
 #include <Library/BaseMemoryLib.h>
 #include <Library/BaseMemoryLib.h>
+#include <Library/Crc32.h>
 #include <Library/DebugLib.h>
 #include <Library/DeviceInfo.h>
 #include <Library/DevicePathLib.h>
@@ -103,6 +104,7 @@ IsCriticalPartition (CHAR16 *PartitionName);
 #endif
 
 STATIC FASTBOOT_VAR *Varlist;
+STATIC FASTBOOT_VAR *VarHash[FASTBOOT_VAR_HASH_SIZE];
 STATIC BOOLEAN Finished = FALSE;
 STATIC CHAR8 StrSerialNum[MAX_RSP_SIZE];
 STATIC CHAR8 FullProduct[MAX_RSP_SIZE];
@@ -162,14 +164,54 @@ STATIC UINT8 *mDataBuffer = NULL;
 STATIC UINT8 *mFlashDataBuffer = NULL;
 STATIC UINT8 *mUsbDataBuffer = NULL;
 
+/* Size of the download transfers. It doubles each time a transfer completes
+ * in full, up to mXfrSizeMax, which is lowered if the controller refuses a
+ * size.
+ */
+STATIC UINTN mXfrSize = USB_BUFFER_SIZE;
+STATIC UINTN mXfrSizeMax = USB_MAX_XFER_SIZE;
+
+typedef struct {
+  UINT64 StartMs;
+  UINT64 QueuedMs;
+  UINT32 Count;
+  UINT64 TotalMs;
+  UINT64 MinMs;
+  UINT64 MaxMs;
+} DownloadXfrStats;
+STATIC DownloadXfrStats XfrStats;
+
 STATIC BOOLEAN IsFlashComplete = TRUE;
 STATIC EFI_STATUS FlashResult = EFI_SUCCESS;
 #ifdef ENABLE_UPDATE_PARTITIONS_CMDS
 STATIC EFI_EVENT UsbTimerEvent;
+STATIC SparseStreamState SparseStream;
 #endif
 
 STATIC UINT64 MaxDownLoadSize = 0;
 
+/* Download ring: the fastboot buffer is split into DownloadSlotCount slots of
+ * MaxDownLoadSize each. A download goes to the next free slot while earlier
+ * slots are still being flashed.
+ */
+STATIC DOWNLOAD_SLOT DownloadSlots[MAX_DOWNLOAD_SLOTS];
+STATIC UINT32 DownloadSlotCount = 1;
+/* Slot holding the current or last download */
+STATIC UINT32 DownloadSlot;
+STATIC BOOLEAN DownloadStalled;
+STATIC CHAR8 DownloadSlotCountStr[MAX_RSP_SIZE];
+#ifdef ENABLE_UPDATE_PARTITIONS_CMDS
+/* Sparse images queued behind the running flash, oldest first */
+STATIC FLASH_JOB FlashQueue[MAX_DOWNLOAD_SLOTS];
+STATIC UINT32 FlashQueueHead;
+STATIC UINT32 FlashQueueCount;
+#endif
+
+/* Command waiting for the running flash or for a free download slot, it is
+ * dispatched again by signalling PendingCmdEvent.
+ */
+STATIC EFI_EVENT PendingCmdEvent;
+
 STATIC INT32 Lun = NO_LUN;
 STATIC BOOLEAN LunSet;
 
@@ -182,6 +224,7 @@ STATIC VOID
 AcceptCmd (IN UINT64 Size, IN CHAR8 *Data);
 STATIC VOID
 AcceptCmdHandler (IN EFI_EVENT Event, IN VOID *Context);
+STATIC VOID WaitForTransferComplete (VOID);
 
 #define NAND_PAGES_PER_BLOCK 64
 
@@ -196,6 +239,8 @@ typedef struct {
   VOID *Data;
 } CmdInfo;
 
+STATIC CmdInfo PendingCmd;
+
 STATIC BOOLEAN UsbTimerStarted;
 
 BOOLEAN IsUsbTimerStarted (VOID)
@@ -232,10 +277,51 @@ STATIC EFI_STATUS FastbootUnInit (VOID)
     FreePool (Var);
     Var = NULL;
   }
+  Varlist = NULL;
+  gBS->SetMem ((VOID *)VarHash, sizeof (VarHash), 0);
 
   return EFI_SUCCESS;
 }
 
+STATIC UINT32
+FastbootVarHash (IN CONST CHAR8 *Name)
+{
+  UINT32 Hash = 5381;
+
+  while (*Name) {
+    Hash = (Hash * 33) ^ (UINT8)*Name++;
+  }
+
+  return Hash & (FASTBOOT_VAR_HASH_SIZE - 1);
+}
+
+STATIC FASTBOOT_VAR *
+FastbootFindVar (IN CONST CHAR8 *Name)
+{
+  FASTBOOT_VAR *Var;
+
+  for (Var = VarHash[FastbootVarHash (Name)]; Var; Var = Var->hnext) {
+    if (!AsciiStrCmp (Var->name, Name)) {
+      return Var;
+    }
+  }
+
+  return NULL;
+}
+
+STATIC VOID
+FastbootUnhashVar (IN FASTBOOT_VAR *Var)
+{
+  FASTBOOT_VAR **Link = &VarHash[FastbootVarHash (Var->name)];
+
+  for (; *Link; Link = &(*Link)->hnext) {
+    if (*Link == Var) {
+      *Link = Var->hnext;
+      return;
+    }
+  }
+}
+
 /* Publish a variable readable by the built-in getvar command
  * These Variables must not be temporary, shallow copies are used.
  */
@@ -243,12 +329,18 @@ STATIC VOID
 FastbootPublishVar (IN CONST CHAR8 *Name, IN CONST CHAR8 *Value)
 {
   FASTBOOT_VAR *Var;
+  UINT32 Bucket;
+
   Var = AllocateZeroPool (sizeof (*Var));
   if (Var) {
     Var->next = Varlist;
     Varlist = Var;
     Var->name = Name;
     Var->value = Value;
+    /* Newest first, like the list, so a republished name wins */
+    Bucket = FastbootVarHash (Name);
+    Var->hnext = VarHash[Bucket];
+    VarHash[Bucket] = Var;
   } else {
     DEBUG ((EFI_D_VERBOSE,
             "Failed to publish a variable readable(%a): malloc error!\n",
@@ -262,10 +354,87 @@ FastbootPublishVar (IN CONST CHAR8 *Name, IN CONST CHAR8 *Value)
 UINTN GetXfrSize (VOID)
 {
   UINTN BytesLeft = mNumDataBytes - mBytesReceivedSoFar;
-  if ((mState == ExpectDataState) && (BytesLeft < USB_BUFFER_SIZE))
+
+  if (mState != ExpectDataState)
+    return USB_BUFFER_SIZE;
+
+  if (BytesLeft < mXfrSize)
     return BytesLeft;
 
-  return USB_BUFFER_SIZE;
+  return mXfrSize;
+}
+
+/* The usb device protocol takes one transfer per endpoint at a time, so the
+ * gap between transfers is paid once per transfer. Keep transfers as large
+ * as the controller accepts to amortize it.
+ */
+EFI_STATUS
+QueueDownloadXfr (VOID *Buffer)
+{
+  EFI_STATUS Status;
+  UINTN XfrSize;
+
+  while (TRUE) {
+    XfrSize = GetXfrSize ();
+    Status = GetFastbootDeviceData ()->UsbDeviceProtocol->Send (
+        ENDPOINT_IN, XfrSize, Buffer);
+    if (Status == EFI_SUCCESS ||
+        XfrSize <= USB_BUFFER_SIZE) {
+      break;
+    }
+
+    /* XfrSize may have been cut down to the bytes left, go by mXfrSize */
+    mXfrSize = MAX (mXfrSize / 2, USB_BUFFER_SIZE);
+    mXfrSizeMax = mXfrSize;
+    DEBUG ((EFI_D_INFO, "Usb transfer of %u KB refused, using %u KB\n",
+            XfrSize >> 10, mXfrSize >> 10));
+  }
+
+  XfrStats.QueuedMs = GetTimerCountms ();
+  DEBUG ((EFI_D_VERBOSE, "QueueDownloadXfr: Send %d\n", XfrSize));
+  return Status;
+}
+
+/* Account a completed download transfer and grow the transfer size */
+STATIC VOID
+DownloadXfrDone (UINT64 Size)
+{
+  UINT64 Ms = GetTimerCountms () - XfrStats.QueuedMs;
+
+  if (!XfrStats.Count ||
+      Ms < XfrStats.MinMs) {
+    XfrStats.MinMs = Ms;
+  }
+  if (Ms > XfrStats.MaxMs) {
+    XfrStats.MaxMs = Ms;
+  }
+  XfrStats.TotalMs += Ms;
+  XfrStats.Count++;
+
+  if (Size == mXfrSize &&
+      mXfrSize < mXfrSizeMax) {
+    mXfrSize = MIN (mXfrSize * 2, mXfrSizeMax);
+  }
+}
+
+STATIC VOID
+DownloadXfrReport (VOID)
+{
+  UINT64 ElapsedMs = GetTimerCountms () - XfrStats.StartMs;
+
+  if (!ElapsedMs) {
+    ElapsedMs = 1;
+  }
+
+  DEBUG ((EFI_D_INFO, "Downloaded %lld KB in %lld ms (%lld MB/s), %u "
+          "transfers up to %u KB\n", mNumDataBytes >> 10, ElapsedMs,
+          ((mNumDataBytes * 1000) / ElapsedMs) >> 20, XfrStats.Count,
+          mXfrSize >> 10));
+  if (XfrStats.Count) {
+    DEBUG ((EFI_D_INFO, "Transfer latency min %lld avg %lld max %lld ms\n",
+            XfrStats.MinMs, XfrStats.TotalMs / XfrStats.Count,
+            XfrStats.MaxMs));
+  }
 }
 
 /* Acknowlege to host, INFO, OKAY and FAILURE */
@@ -345,12 +514,20 @@ PartitionGetInfo (IN CHAR16 *PartitionName,
 {
   EFI_STATUS Status;
   EFI_PARTITION_ENTRY *PartEntry;
+  HandleInfo *CachedInfo;
   UINT16 i;
   UINT32 j;
   /* By default the LunStart and LunEnd would point to '0' and max value */
   UINT32 LunStart = 0;
   UINT32 LunEnd = GetMaxLuns ();
 
+  if (!LunSet &&
+      GetPartitionHandleInfo (PartitionName, &CachedInfo) == EFI_SUCCESS) {
+    *BlockIo = CachedInfo->BlkIo;
+    *Handle = CachedInfo->Handle;
+    return EFI_SUCCESS;
+  }
+
   /* If Lun is set in the Handle flash command then find the block io for that
    * lun */
   if (LunSet) {
@@ -527,6 +704,23 @@ WriteToDisk (IN EFI_BLOCK_IO_PROTOCOL *BlockIo,
   return WriteBlockToPartition (BlockIo, Handle, offset, Size, Image);
 }
 
+/* Log the write throughput achieved while flashing a partition */
+STATIC VOID
+ReportFlashSpeed (IN CHAR16 *PartitionName,
+                  IN UINT64 Bytes,
+                  IN UINT64 StartMs)
+{
+  UINT64 ElapsedMs = GetTimerCountms () - StartMs;
+
+  if (!ElapsedMs) {
+    ElapsedMs = 1;
+  }
+
+  DEBUG ((EFI_D_INFO, "Flashed %s: %lld KB in %lld ms (%lld MB/s)\n",
+          PartitionName, Bytes >> 10, ElapsedMs,
+          ((Bytes * 1000) / ElapsedMs) >> 20));
+}
+
 STATIC BOOLEAN
 GetPartitionHasSlot (CHAR16 *PartitionName,
                      UINT32 PnameMaxSize,
@@ -557,6 +751,20 @@ GetPartitionHasSlot (CHAR16 *PartitionName,
   return HasSlot;
 }
 
+/* Add raw image data to both running CRCs with a single pass over it */
+STATIC VOID
+SparseCrcAddData (IN OUT SparseImgParam *SparseImgData,
+                  IN CONST VOID *Data,
+                  IN UINT64 Len)
+{
+  UINT32 DataCrc;
+
+  DataCrc = Crc32Update (0, Data, Len);
+  SparseImgData->Crc = Crc32Combine (SparseImgData->Crc, DataCrc, Len);
+  SparseImgData->WriterCrc = Crc32Combine (SparseImgData->WriterCrc,
+                                           DataCrc, Len);
+}
+
 STATIC EFI_STATUS
 HandleChunkTypeRaw (sparse_header_t *sparse_header,
         chunk_header_t *chunk_header,
@@ -604,6 +812,7 @@ HandleChunkTypeRaw (sparse_header_t *sparse_header,
     DEBUG ((EFI_D_ERROR, "Flash Write Failure\n"));
     return Status;
   }
+  SparseCrcAddData (SparseImgData, *Image, SparseImgData->ChunkDataSz);
 
   if (SparseImgData->TotalBlocks >
        (MAX_UINT32 - chunk_header->chunk_sz)) {
@@ -617,16 +826,259 @@ HandleChunkTypeRaw (sparse_header_t *sparse_header,
   return EFI_SUCCESS;
 }
 
+/* Make sure the fill buffer holds FillVal replicated over its whole size.
+ * The buffer is allocated once per image and only rewritten when the
+ * pattern changes.
+ */
+STATIC EFI_STATUS
+PrepareFillBuffer (IN UINT32 BlkSz,
+                   IN UINT32 FillVal,
+                   IN OUT SparseImgParam *SparseImgData)
+{
+  UINT64 Count;
+  UINT64 Temp;
+
+  if (SparseImgData->FillBuf == NULL) {
+    SparseImgData->FillBufSize = (FILL_BUF_SIZE / BlkSz) * BlkSz;
+    if (!SparseImgData->FillBufSize) {
+      SparseImgData->FillBufSize = BlkSz;
+    }
+
+    SparseImgData->FillBuf = AllocatePool (SparseImgData->FillBufSize);
+    if (SparseImgData->FillBuf == NULL) {
+      /* Fall back to a single block pattern */
+      SparseImgData->FillBufSize = BlkSz;
+      SparseImgData->FillBuf = AllocatePool (SparseImgData->FillBufSize);
+      if (SparseImgData->FillBuf == NULL) {
+        DEBUG ((EFI_D_ERROR, "Malloc failed for: CHUNK_TYPE_FILL\n"));
+        return EFI_OUT_OF_RESOURCES;
+      }
+    }
+  } else if (SparseImgData->FillBufVal == FillVal) {
+    return EFI_SUCCESS;
+  }
+
+  if (FillVal == 0) {
+    gBS->SetMem ((VOID *)SparseImgData->FillBuf, SparseImgData->FillBufSize,
+                 0);
+  } else {
+    Count = SparseImgData->FillBufSize / sizeof (FillVal);
+    for (Temp = 0; Temp < Count; Temp++) {
+      SparseImgData->FillBuf[Temp] = FillVal;
+    }
+  }
+  SparseImgData->FillBufVal = FillVal;
+
+  return EFI_SUCCESS;
+}
+
+STATIC VOID
+FreeFillBuffer (IN OUT SparseImgParam *SparseImgData)
+{
+  if (SparseImgData->FillBuf) {
+    FreePool (SparseImgData->FillBuf);
+    SparseImgData->FillBuf = NULL;
+  }
+  SparseImgData->FillBufSize = 0;
+  SparseImgData->FillRunBlocks = 0;
+}
+
+/* Write Size bytes of the current fill pattern starting at Lba, in
+ * FillBufSize batches.
+ */
+STATIC EFI_STATUS
+WriteFillPattern (IN SparseImgParam *SparseImgData,
+                  IN UINT64 Lba,
+                  IN UINT64 Size)
+{
+  EFI_STATUS Status;
+  UINT64 WriteSize;
+  UINT32 BlockSize = SparseImgData->BlockIo->Media->BlockSize;
+
+  while (Size) {
+    WriteSize = MIN (Size, SparseImgData->FillBufSize);
+    Status = WriteToDisk (SparseImgData->BlockIo, SparseImgData->Handle,
+                          (VOID *)SparseImgData->FillBuf, WriteSize, Lba);
+    if (EFI_ERROR (Status)) {
+      DEBUG ((EFI_D_ERROR, "Flash write failure for FILL Chunk\n"));
+      return Status;
+    }
+    Lba += WriteSize / BlockSize;
+    Size -= WriteSize;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/* Returns EFI_SUCCESS if the first, middle and last of the Blocks blocks at
+ * Lba all read back as zeroes.
+ */
+STATIC EFI_STATUS
+ErasedBlocksAreZero (IN EFI_BLOCK_IO_PROTOCOL *BlockIo,
+                     IN UINT64 Lba,
+                     IN UINT64 Blocks)
+{
+  EFI_STATUS Status = EFI_SUCCESS;
+  UINT32 BlockSize = BlockIo->Media->BlockSize;
+  UINT64 Sample[] = {0, Blocks / 2, Blocks - 1};
+  UINT8 *ReadBack;
+  UINT32 Index;
+  UINT32 Byte;
+
+  ReadBack = AllocatePool (BlockSize);
+  if (ReadBack == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  for (Index = 0; !EFI_ERROR (Status) && Index < ARRAY_SIZE (Sample);
+       Index++) {
+    Status = BlockIo->ReadBlocks (BlockIo, BlockIo->Media->MediaId,
+                                  Lba + Sample[Index], BlockSize, ReadBack);
+    for (Byte = 0; !EFI_ERROR (Status) && Byte < BlockSize; Byte++) {
+      if (ReadBack[Byte]) {
+        Status = EFI_UNSUPPORTED;
+      }
+    }
+  }
+
+  FreePool (ReadBack);
+  return Status;
+}
+
+/* Erase Size bytes at Lba instead of writing zeroes to them. The first
+ * erase of an image is sampled at its start, middle and end to make sure
+ * the device returns zeroes for erased blocks; if it does not, or the erase
+ * fails, the range is written with zeroes and erasing is not attempted
+ * again for this image.
+ */
+STATIC EFI_STATUS
+EraseZeroFill (IN OUT SparseImgParam *SparseImgData,
+               IN EFI_ERASE_BLOCK_PROTOCOL *EraseProt,
+               IN UINT64 Lba,
+               IN UINT64 Size)
+{
+  EFI_STATUS Status;
+  EFI_ERASE_BLOCK_TOKEN EraseToken;
+  EFI_BLOCK_IO_PROTOCOL *BlockIo = SparseImgData->BlockIo;
+  UINTN TokenIndex;
+
+  gBS->SetMem ((VOID *)&EraseToken, sizeof (EraseToken), 0);
+  Status = EraseProt->EraseBlocks (BlockIo, BlockIo->Media->MediaId, Lba,
+                                   &EraseToken, Size);
+  if (!EFI_ERROR (Status) &&
+      EraseToken.Event != NULL) {
+    gBS->WaitForEvent (1, &EraseToken.Event, &TokenIndex);
+    Status = EraseToken.TransactionStatus;
+  }
+
+  if (!EFI_ERROR (Status) &&
+      SparseImgData->EraseState == FILL_ERASE_UNTESTED) {
+    Status = ErasedBlocksAreZero (BlockIo, Lba,
+                                  Size / BlockIo->Media->BlockSize);
+    if (!EFI_ERROR (Status)) {
+      SparseImgData->EraseState = FILL_ERASE_ZEROES;
+    }
+  }
+
+  if (EFI_ERROR (Status)) {
+    DEBUG ((EFI_D_INFO, "Erase can't be used for zero fill (%r), writing "
+                        "zeroes instead\n", Status));
+    SparseImgData->EraseState = FILL_ERASE_DISABLED;
+    return WriteFillPattern (SparseImgData, Lba, Size);
+  }
+
+  return EFI_SUCCESS;
+}
+
+/* Write out the pending run of coalesced fill chunks. Long zero runs go
+ * through the erase protocol, only their unaligned head and tail are written.
+ */
+STATIC EFI_STATUS
+FlushFillRun (IN sparse_header_t *sparse_header,
+              IN OUT SparseImgParam *SparseImgData)
+{
+  EFI_STATUS Status;
+  EFI_ERASE_BLOCK_PROTOCOL *EraseProt = NULL;
+  UINT32 BlockSize;
+  UINT64 Lba;
+  UINT64 Size;
+  UINT64 Start;
+  UINT64 End;
+  UINT64 EraseStart;
+  UINT64 EraseEnd;
+  UINT64 EraseUnit;
+
+  if (!SparseImgData->FillRunBlocks) {
+    return EFI_SUCCESS;
+  }
+
+  BlockSize = SparseImgData->BlockIo->Media->BlockSize;
+  Lba = (UINT64)SparseImgData->FillRunStart * SparseImgData->BlockCountFactor;
+  Size = SparseImgData->FillRunBlocks * sparse_header->blk_sz;
+  SparseImgData->FillRunBlocks = 0;
+
+  Status = PrepareFillBuffer (sparse_header->blk_sz, SparseImgData->FillRunVal,
+                              SparseImgData);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (SparseImgData->FillRunVal != 0 ||
+      Size < FILL_ERASE_MIN_SIZE ||
+      SparseImgData->EraseState == FILL_ERASE_DISABLED ||
+      CheckRootDeviceType () == NAND) {
+    return WriteFillPattern (SparseImgData, Lba, Size);
+  }
+
+  Status = gBS->HandleProtocol (SparseImgData->Handle,
+                                &gEfiEraseBlockProtocolGuid,
+                                (VOID **)&EraseProt);
+  if (EFI_ERROR (Status) ||
+      !EraseProt->EraseLengthGranularity) {
+    SparseImgData->EraseState = FILL_ERASE_DISABLED;
+    return WriteFillPattern (SparseImgData, Lba, Size);
+  }
+
+  /* Only whole erase units can be erased, the granularity is in blocks */
+  EraseUnit = (UINT64)EraseProt->EraseLengthGranularity * BlockSize;
+  Start = Lba * BlockSize;
+  End = Start + Size;
+  EraseStart = ((Start + EraseUnit - 1) / EraseUnit) * EraseUnit;
+  EraseEnd = (End / EraseUnit) * EraseUnit;
+  if (EraseEnd <= EraseStart ||
+      EraseEnd - EraseStart < FILL_ERASE_MIN_SIZE) {
+    return WriteFillPattern (SparseImgData, Lba, Size);
+  }
+
+  if (EraseStart > Start) {
+    Status = WriteFillPattern (SparseImgData, Lba, EraseStart - Start);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  Status = EraseZeroFill (SparseImgData, EraseProt, EraseStart / BlockSize,
+                          EraseEnd - EraseStart);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (End > EraseEnd) {
+    Status = WriteFillPattern (SparseImgData, EraseEnd / BlockSize,
+                               End - EraseEnd);
+  }
+
+  return Status;
+}
+
 STATIC EFI_STATUS
 HandleChunkTypeFill (sparse_header_t *sparse_header,
         chunk_header_t *chunk_header,
         VOID **Image,
         SparseImgParam *SparseImgData)
 {
-  UINT32 *FillBuf = NULL;
   UINT32 FillVal;
-  EFI_STATUS Status = EFI_SUCCESS;
-  UINT32 Temp;
+  EFI_STATUS Status;
 
   if (sparse_header == NULL ||
       chunk_header == NULL ||
@@ -642,70 +1094,133 @@ HandleChunkTypeFill (sparse_header_t *sparse_header,
     return EFI_INVALID_PARAMETER;
   }
 
-  FillBuf = AllocateZeroPool (sparse_header->blk_sz);
-  if (!FillBuf) {
-    DEBUG ((EFI_D_ERROR, "Malloc failed for: CHUNK_TYPE_FILL\n"));
-    return EFI_OUT_OF_RESOURCES;
-  }
-
   if (CHECK_ADD64 ((UINT64)*Image, sizeof (UINT32))) {
     DEBUG ((EFI_D_ERROR,
               "Integer overflow while adding Image and uint32\n"));
-    Status = EFI_INVALID_PARAMETER;
-    goto out;
+    return EFI_INVALID_PARAMETER;
   }
 
   if (SparseImgData->ImageEnd < (UINT64)*Image + sizeof (UINT32)) {
     DEBUG ((EFI_D_ERROR,
             "Buffer overread occured due to invalid sparse header\n"));
-   Status = EFI_INVALID_PARAMETER;
-   goto out;
+    return EFI_INVALID_PARAMETER;
   }
 
   FillVal = *(UINT32 *)*Image;
   *Image = (CHAR8 *)*Image + sizeof (UINT32);
 
-  for (Temp = 0;
-       Temp < (sparse_header->blk_sz / sizeof (FillVal));
-       Temp++) {
-    FillBuf[Temp] = FillVal;
+  /* Make sure the data does not exceed the partition size */
+  if ((UINT64)SparseImgData->TotalBlocks *
+       (UINT64)sparse_header->blk_sz +
+       SparseImgData->ChunkDataSz >
+       SparseImgData->PartitionSize) {
+    DEBUG ((EFI_D_ERROR, "Chunk data size for fill type "
+                          "exceeds partition size\n"));
+    return EFI_VOLUME_FULL;
   }
 
-  for (Temp = 0; Temp < chunk_header->chunk_sz; Temp++) {
-    /* Make sure the data does not exceed the partition size */
-    if ((UINT64)SparseImgData->TotalBlocks *
-         (UINT64)sparse_header->blk_sz +
-         sparse_header->blk_sz >
-         SparseImgData->PartitionSize) {
-      DEBUG ((EFI_D_ERROR, "Chunk data size for fill type "
-                            "exceeds partition size\n"));
-      Status = EFI_VOLUME_FULL;
-      goto out;
-    }
+  if (SparseImgData->TotalBlocks >
+       (MAX_UINT32 - chunk_header->chunk_sz)) {
+    DEBUG ((EFI_D_ERROR, "Bogus size for FILL chunk Type\n"));
+    return EFI_INVALID_PARAMETER;
+  }
 
-    SparseImgData->WrittenBlockCount =
-      SparseImgData->TotalBlocks *
-        SparseImgData->BlockCountFactor;
-    Status = WriteToDisk (SparseImgData->BlockIo,
-                          SparseImgData->Handle,
-                          (VOID *)FillBuf,
-                          sparse_header->blk_sz,
-                          SparseImgData->WrittenBlockCount);
-    if (EFI_ERROR (Status)) {
-      DEBUG ((EFI_D_ERROR, "Flash write failure for FILL Chunk\n"));
+  SparseImgData->Crc = Crc32Fill (SparseImgData->Crc, FillVal,
+                                  SparseImgData->ChunkDataSz);
+  SparseImgData->WriterCrc = Crc32Fill (SparseImgData->WriterCrc, FillVal,
+                                        sparse_header->blk_sz);
 
-    goto out;
+  /* A fill chunk directly following one with the same value extends the
+   * pending run, anything else writes the pending run out first.
+   */
+  if (SparseImgData->FillRunBlocks &&
+      SparseImgData->FillRunVal != FillVal) {
+    Status = FlushFillRun (sparse_header, SparseImgData);
+    if (EFI_ERROR (Status)) {
+      return Status;
     }
+  }
 
-    SparseImgData->TotalBlocks++;
+  if (!SparseImgData->FillRunBlocks) {
+    SparseImgData->FillRunStart = SparseImgData->TotalBlocks;
+    SparseImgData->FillRunVal = FillVal;
   }
 
-  out:
-    if (FillBuf) {
-    FreePool (FillBuf);
-    FillBuf = NULL;
+  SparseImgData->FillRunBlocks += chunk_header->chunk_sz;
+  SparseImgData->TotalBlocks += chunk_header->chunk_sz;
+
+  return EFI_SUCCESS;
+}
+
+/* Check a CRC chunk against the data written so far. In the layout
+ * libsparse writes, the chunk holds a CRC-32 of the preceding chunks and
+ * covers no blocks. Either the CRC of the whole image or the one libsparse's
+ * writer computes is accepted, see SparseImgParam. Chunks without a value
+ * are skipped over as before.
+ */
+STATIC EFI_STATUS
+HandleChunkTypeCrc (sparse_header_t *sparse_header,
+        chunk_header_t *chunk_header,
+        VOID **Image,
+        SparseImgParam *SparseImgData)
+{
+  UINT32 FileCrc;
+
+  if (chunk_header->total_sz ==
+      (sparse_header->chunk_hdr_sz + sizeof (UINT32))) {
+    if (CHECK_ADD64 ((UINT64)*Image, sizeof (UINT32))) {
+      DEBUG ((EFI_D_ERROR,
+                "Integer overflow while adding Image and uint32\n"));
+      return EFI_INVALID_PARAMETER;
     }
-    return Status;
+
+    if (SparseImgData->ImageEnd < (UINT64)*Image + sizeof (UINT32)) {
+      DEBUG ((EFI_D_ERROR,
+              "Buffer overread occured due to invalid sparse header\n"));
+      return EFI_INVALID_PARAMETER;
+    }
+
+    FileCrc = *(UINT32 *)*Image;
+    *Image = (CHAR8 *)*Image + sizeof (UINT32);
+
+    if (FileCrc != SparseImgData->Crc &&
+        FileCrc != SparseImgData->WriterCrc) {
+      DEBUG ((EFI_D_ERROR, "CRC mismatch at chunk %d: expected 0x%x, "
+                           "written 0x%x (0x%x as libsparse counts it)\n",
+              SparseImgData->Chunk, FileCrc, SparseImgData->Crc,
+              SparseImgData->WriterCrc));
+      return EFI_CRC_ERROR;
+    }
+    return EFI_SUCCESS;
+  }
+
+  if (chunk_header->total_sz != sparse_header->chunk_hdr_sz) {
+    DEBUG ((EFI_D_ERROR, "Bogus chunk size for chunk type CRC\n"));
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (SparseImgData->TotalBlocks >
+       (MAX_UINT32 - chunk_header->chunk_sz)) {
+    DEBUG ((EFI_D_ERROR, "Bogus size for chunk type CRC\n"));
+    return EFI_INVALID_PARAMETER;
+  }
+
+  SparseImgData->TotalBlocks += chunk_header->chunk_sz;
+
+  if (CHECK_ADD64 ((UINT64)*Image, SparseImgData->ChunkDataSz)) {
+    DEBUG ((EFI_D_ERROR,
+            "Integer overflow while adding Image and chunk data sz\n"));
+    return EFI_INVALID_PARAMETER;
+  }
+
+  *Image += (UINT32)SparseImgData->ChunkDataSz;
+  if (SparseImgData->ImageEnd < (UINT64)*Image) {
+    DEBUG ((EFI_D_ERROR, "buffer overreads occured due to "
+                          "invalid sparse header\n"));
+    return EFI_INVALID_PARAMETER;
+  }
+
+  return EFI_SUCCESS;
 }
 
 STATIC EFI_STATUS
@@ -724,6 +1239,14 @@ ValidateChunkDataAndFlash (sparse_header_t *sparse_header,
     return EFI_INVALID_PARAMETER;
   }
 
+  /* Any other chunk ends the current run of fill chunks */
+  if (chunk_header->chunk_type != CHUNK_TYPE_FILL) {
+    Status = FlushFillRun (sparse_header, SparseImgData);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
   switch (chunk_header->chunk_type) {
     case CHUNK_TYPE_RAW:
     Status = HandleChunkTypeRaw (sparse_header,
@@ -755,42 +1278,104 @@ ValidateChunkDataAndFlash (sparse_header_t *sparse_header,
         return EFI_INVALID_PARAMETER;
       }
       SparseImgData->TotalBlocks += chunk_header->chunk_sz;
+      SparseImgData->Crc = Crc32Fill (SparseImgData->Crc, 0,
+                                      SparseImgData->ChunkDataSz);
     break;
 
     case CHUNK_TYPE_CRC:
-      if (chunk_header->total_sz != sparse_header->chunk_hdr_sz) {
-        DEBUG ((EFI_D_ERROR, "Bogus chunk size for chunk type CRC\n"));
-        return EFI_INVALID_PARAMETER;
+      Status = HandleChunkTypeCrc (sparse_header,
+                                   chunk_header,
+                                   Image,
+                                   SparseImgData);
+      if (EFI_ERROR (Status)) {
+        return Status;
       }
+    break;
 
-      if (SparseImgData->TotalBlocks >
-           (MAX_UINT32 - chunk_header->chunk_sz)) {
-        DEBUG ((EFI_D_ERROR, "Bogus size for chunk type CRC\n"));
-        return EFI_INVALID_PARAMETER;
-      }
+    default:
+      DEBUG ((EFI_D_ERROR, "Unknown chunk type: %x\n",
+             chunk_header->chunk_type));
+      return EFI_INVALID_PARAMETER;
+  }
+  return EFI_SUCCESS;
+}
 
-      SparseImgData->TotalBlocks += chunk_header->chunk_sz;
+/* Validate the sparse file header against the target partition and fill in
+ * the block count factor. PartitionSize and BlockIo must already be set.
+ */
+STATIC EFI_STATUS
+ValidateSparseHeader (IN sparse_header_t *sparse_header,
+                      IN OUT SparseImgParam *SparseImgData)
+{
+  if (((UINT64)sparse_header->total_blks * (UINT64)sparse_header->blk_sz) >
+      SparseImgData->PartitionSize) {
+    DEBUG ((EFI_D_ERROR, "Image is too large for the partition\n"));
+    return EFI_VOLUME_FULL;
+  }
 
+  if (sparse_header->file_hdr_sz != sizeof (sparse_header_t)) {
+    DEBUG ((EFI_D_ERROR, "Sparse header size mismatch\n"));
+    return EFI_BAD_BUFFER_SIZE;
+  }
 
-      if (CHECK_ADD64 ((UINT64)*Image, SparseImgData->ChunkDataSz)) {
-        DEBUG ((EFI_D_ERROR,
-                "Integer overflow while adding Image and chunk data sz\n"));
-        return EFI_INVALID_PARAMETER;
-      }
+  if (!sparse_header->blk_sz) {
+    DEBUG ((EFI_D_ERROR, "Invalid block size in the sparse header\n"));
+    return EFI_INVALID_PARAMETER;
+  }
 
-      *Image += (UINT32)SparseImgData->ChunkDataSz;
-      if (SparseImgData->ImageEnd < (UINT64)*Image) {
-        DEBUG ((EFI_D_ERROR, "buffer overreads occured due to "
-                              "invalid sparse header\n"));
-        return EFI_INVALID_PARAMETER;
-      }
-    break;
+  if ((sparse_header->blk_sz) % (SparseImgData->BlockIo->Media->BlockSize)) {
+    DEBUG ((EFI_D_ERROR, "Unsupported sparse block size %x\n",
+            sparse_header->blk_sz));
+    return EFI_INVALID_PARAMETER;
+  }
 
-    default:
-      DEBUG ((EFI_D_ERROR, "Unknown chunk type: %x\n",
-             chunk_header->chunk_type));
-      return EFI_INVALID_PARAMETER;
+  SparseImgData->BlockCountFactor = (sparse_header->blk_sz) /
+                                    (SparseImgData->BlockIo->Media->BlockSize);
+
+  DEBUG ((EFI_D_VERBOSE, "=== Sparse Image Header ===\n"));
+  DEBUG ((EFI_D_VERBOSE, "magic: 0x%x\n", sparse_header->magic));
+  DEBUG (
+      (EFI_D_VERBOSE, "major_version: 0x%x\n", sparse_header->major_version));
+  DEBUG (
+      (EFI_D_VERBOSE, "minor_version: 0x%x\n", sparse_header->minor_version));
+  DEBUG ((EFI_D_VERBOSE, "file_hdr_sz: %d\n", sparse_header->file_hdr_sz));
+  DEBUG ((EFI_D_VERBOSE, "chunk_hdr_sz: %d\n", sparse_header->chunk_hdr_sz));
+  DEBUG ((EFI_D_VERBOSE, "blk_sz: %d\n", sparse_header->blk_sz));
+  DEBUG ((EFI_D_VERBOSE, "total_blks: %d\n", sparse_header->total_blks));
+  DEBUG ((EFI_D_VERBOSE, "total_chunks: %d\n", sparse_header->total_chunks));
+
+  return EFI_SUCCESS;
+}
+
+/* Validate a chunk header and compute the size of its output data */
+STATIC EFI_STATUS
+ValidateChunkHeader (IN sparse_header_t *sparse_header,
+                     IN chunk_header_t *chunk_header,
+                     IN OUT SparseImgParam *SparseImgData)
+{
+  DEBUG ((EFI_D_VERBOSE, "=== Chunk Header ===\n"));
+  DEBUG ((EFI_D_VERBOSE, "chunk_type: 0x%x\n", chunk_header->chunk_type));
+  DEBUG ((EFI_D_VERBOSE, "chunk_data_sz: 0x%x\n", chunk_header->chunk_sz));
+  DEBUG ((EFI_D_VERBOSE, "total_size: 0x%x\n", chunk_header->total_sz));
+
+  if (sparse_header->chunk_hdr_sz != sizeof (chunk_header_t)) {
+    DEBUG ((EFI_D_ERROR, "chunk header size mismatch\n"));
+    return EFI_INVALID_PARAMETER;
+  }
+
+  SparseImgData->ChunkDataSz = (UINT64)sparse_header->blk_sz *
+                                chunk_header->chunk_sz;
+  /* Make sure that chunk size calculate from sparse image does not exceed the
+   * partition size
+   */
+  if ((UINT64)SparseImgData->TotalBlocks *
+      (UINT64)sparse_header->blk_sz +
+      SparseImgData->ChunkDataSz >
+      SparseImgData->PartitionSize) {
+    DEBUG ((EFI_D_ERROR, "Chunk data size exceeds partition size\n"));
+    return EFI_VOLUME_FULL;
   }
+
   return EFI_SUCCESS;
 }
 
@@ -807,6 +1392,7 @@ HandleSparseImgFlash (IN CHAR16 *PartitionName,
   EFI_STATUS Status;
 
   SparseImgParam SparseImgData = {0};
+  UINT64 StartMs = GetTimerCountms ();
 
   if (CHECK_ADD64 ((UINT64)Image, sz)) {
     DEBUG ((EFI_D_ERROR, "Integer overflow while adding Image and sz\n"));
@@ -840,45 +1426,13 @@ HandleSparseImgFlash (IN CHAR16 *PartitionName,
   }
 
   sparse_header = (sparse_header_t *)Image;
-  if (((UINT64)sparse_header->total_blks * (UINT64)sparse_header->blk_sz) >
-      SparseImgData.PartitionSize) {
-    DEBUG ((EFI_D_ERROR, "Image is too large for the partition\n"));
-    return EFI_VOLUME_FULL;
+  Status = ValidateSparseHeader (sparse_header, &SparseImgData);
+  if (EFI_ERROR (Status)) {
+    return Status;
   }
 
   Image += sizeof (sparse_header_t);
 
-  if (sparse_header->file_hdr_sz != sizeof (sparse_header_t)) {
-    DEBUG ((EFI_D_ERROR, "Sparse header size mismatch\n"));
-    return EFI_BAD_BUFFER_SIZE;
-  }
-
-  if (!sparse_header->blk_sz) {
-    DEBUG ((EFI_D_ERROR, "Invalid block size in the sparse header\n"));
-    return EFI_INVALID_PARAMETER;
-  }
-
-  if ((sparse_header->blk_sz) % (SparseImgData.BlockIo->Media->BlockSize)) {
-    DEBUG ((EFI_D_ERROR, "Unsupported sparse block size %x\n",
-            sparse_header->blk_sz));
-    return EFI_INVALID_PARAMETER;
-  }
-
-  SparseImgData.BlockCountFactor = (sparse_header->blk_sz) /
-                                   (SparseImgData.BlockIo->Media->BlockSize);
-
-  DEBUG ((EFI_D_VERBOSE, "=== Sparse Image Header ===\n"));
-  DEBUG ((EFI_D_VERBOSE, "magic: 0x%x\n", sparse_header->magic));
-  DEBUG (
-      (EFI_D_VERBOSE, "major_version: 0x%x\n", sparse_header->major_version));
-  DEBUG (
-      (EFI_D_VERBOSE, "minor_version: 0x%x\n", sparse_header->minor_version));
-  DEBUG ((EFI_D_VERBOSE, "file_hdr_sz: %d\n", sparse_header->file_hdr_sz));
-  DEBUG ((EFI_D_VERBOSE, "chunk_hdr_sz: %d\n", sparse_header->chunk_hdr_sz));
-  DEBUG ((EFI_D_VERBOSE, "blk_sz: %d\n", sparse_header->blk_sz));
-  DEBUG ((EFI_D_VERBOSE, "total_blks: %d\n", sparse_header->total_blks));
-  DEBUG ((EFI_D_VERBOSE, "total_chunks: %d\n", sparse_header->total_chunks));
-
   /* Start processing the chunks */
   for (SparseImgData.Chunk = 0;
        SparseImgData.Chunk < sparse_header->total_chunks;
@@ -887,7 +1441,8 @@ HandleSparseImgFlash (IN CHAR16 *PartitionName,
     if (((UINT64)SparseImgData.TotalBlocks * (UINT64)sparse_header->blk_sz) >=
         SparseImgData.PartitionSize) {
       DEBUG ((EFI_D_ERROR, "Size of image is too large for the partition\n"));
-      return EFI_VOLUME_FULL;
+      Status = EFI_VOLUME_FULL;
+      goto Out;
     }
 
     /* Read and skip over chunk header */
@@ -896,37 +1451,21 @@ HandleSparseImgFlash (IN CHAR16 *PartitionName,
     if (CHECK_ADD64 ((UINT64)Image, sizeof (chunk_header_t))) {
       DEBUG ((EFI_D_ERROR,
               "Integer overflow while adding Image and chunk header\n"));
-      return EFI_INVALID_PARAMETER;
+      Status = EFI_INVALID_PARAMETER;
+      goto Out;
     }
     Image += sizeof (chunk_header_t);
 
     if (SparseImgData.ImageEnd < (UINT64)Image) {
       DEBUG ((EFI_D_ERROR,
               "buffer overreads occured due to invalid sparse header\n"));
-      return EFI_BAD_BUFFER_SIZE;
-    }
-
-    DEBUG ((EFI_D_VERBOSE, "=== Chunk Header ===\n"));
-    DEBUG ((EFI_D_VERBOSE, "chunk_type: 0x%x\n", chunk_header->chunk_type));
-    DEBUG ((EFI_D_VERBOSE, "chunk_data_sz: 0x%x\n", chunk_header->chunk_sz));
-    DEBUG ((EFI_D_VERBOSE, "total_size: 0x%x\n", chunk_header->total_sz));
-
-    if (sparse_header->chunk_hdr_sz != sizeof (chunk_header_t)) {
-      DEBUG ((EFI_D_ERROR, "chunk header size mismatch\n"));
-      return EFI_INVALID_PARAMETER;
+      Status = EFI_BAD_BUFFER_SIZE;
+      goto Out;
     }
 
-    SparseImgData.ChunkDataSz = (UINT64)sparse_header->blk_sz *
-                                 chunk_header->chunk_sz;
-    /* Make sure that chunk size calculate from sparse image does not exceed the
-     * partition size
-     */
-    if ((UINT64)SparseImgData.TotalBlocks *
-        (UINT64)sparse_header->blk_sz +
-        SparseImgData.ChunkDataSz >
-        SparseImgData.PartitionSize) {
-      DEBUG ((EFI_D_ERROR, "Chunk data size exceeds partition size\n"));
-      return EFI_VOLUME_FULL;
+    Status = ValidateChunkHeader (sparse_header, chunk_header, &SparseImgData);
+    if (EFI_ERROR (Status)) {
+      goto Out;
     }
 
     Status = ValidateChunkDataAndFlash (sparse_header,
@@ -935,18 +1474,366 @@ HandleSparseImgFlash (IN CHAR16 *PartitionName,
                                         &SparseImgData);
 
     if (EFI_ERROR (Status)) {
-      return Status;
+      goto Out;
     }
   }
 
+  /* Write out a trailing run of fill chunks */
+  Status = FlushFillRun (sparse_header, &SparseImgData);
+  if (EFI_ERROR (Status)) {
+    goto Out;
+  }
+
   DEBUG ((EFI_D_INFO, "Wrote %d blocks, expected to write %d blocks\n",
             SparseImgData.TotalBlocks, sparse_header->total_blks));
 
   if (SparseImgData.TotalBlocks != sparse_header->total_blks) {
     DEBUG ((EFI_D_ERROR, "Sparse Image Write Failure\n"));
     Status = EFI_VOLUME_CORRUPTED;
+  } else {
+    ReportFlashSpeed (PartitionName,
+                      (UINT64)SparseImgData.TotalBlocks *
+                          sparse_header->blk_sz,
+                      StartMs);
+  }
+
+Out:
+  FreeFillBuffer (&SparseImgData);
+  return Status;
+}
+
+/* Clear the per-download state of the sparse stream */
+STATIC VOID SparseStreamReset (VOID)
+{
+  SparseStream.Active = FALSE;
+  SparseStream.HeaderDone = FALSE;
+  SparseStream.Done = FALSE;
+  SparseStream.Status = EFI_SUCCESS;
+  SparseStream.Base = NULL;
+  SparseStream.Parsed = 0;
+  SparseStream.InRawChunk = FALSE;
+  SparseStream.RawChunkDone = 0;
+  SparseStream.BytesWritten = 0;
+  SparseStream.StartTime = 0;
+  FreeFillBuffer (&SparseStream.Params);
+  gBS->SetMem ((VOID *)&SparseStream.Params, sizeof (SparseStream.Params), 0);
+}
+
+/* Returns why PartitionName may not be streamed to, NULL if it may */
+STATIC CONST CHAR8 *
+SparseStreamDenied (CONST CHAR16 *PartitionName)
+{
+  if ((GetAVBVersion () == AVB_LE) ||
+      ((GetAVBVersion () != AVB_LE) &&
+      (TargetBuildVariantUser ()))) {
+    if (!IsUnlocked ()) {
+      return "Flashing is not allowed in Lock State";
+    }
+
+    if (!IsUnlockCritical () && IsCriticalPartition ((CHAR16 *)PartitionName)) {
+      return "Flashing is not allowed for Critical Partitions\n";
+    }
+  }
+
+  if (CheckRootDeviceType () == NAND) {
+    return "Sparse streaming is not supported on NAND";
+  }
+
+  return NULL;
+}
+
+STATIC VOID
+SparseStreamDisarm (VOID)
+{
+  SparseStream.Armed = FALSE;
+  SparseStreamReset ();
+}
+
+/* Start streaming the download that is about to land in Base. The arm is
+ * used up by this download, the lock state is checked again since it may
+ * have changed after arming.
+ */
+STATIC VOID
+SparseStreamStart (IN UINT8 *Base)
+{
+  CONST CHAR8 *Denied = SparseStreamDenied (SparseStream.PartitionName);
+
+  SparseStreamDisarm ();
+  if (Denied != NULL) {
+    DEBUG ((EFI_D_ERROR, "Sparse stream to %s dropped: %a\n",
+            SparseStream.PartitionName, Denied));
+    return;
+  }
+
+  SparseStream.Active = TRUE;
+  SparseStream.Base = Base;
+  SparseStream.StartTime = GetTimerCountms ();
+}
+
+/* Write as much of the current raw chunk as has been received so far.
+ * Partial writes are kept sparse block aligned and at least
+ * SPARSE_STREAM_MIN_WRITE long, so that the storage still sees big requests.
+ * Returns EFI_NOT_READY until the whole chunk is written.
+ */
+STATIC EFI_STATUS
+SparseStreamWriteRaw (IN UINT64 Available)
+{
+  SparseImgParam *Params = &SparseStream.Params;
+  UINT64 Remaining;
+  UINT64 WriteSize;
+  UINT64 Lba;
+  EFI_STATUS Status;
+
+  Remaining = Params->ChunkDataSz - SparseStream.RawChunkDone;
+  WriteSize = Available - SparseStream.Parsed;
+  if (WriteSize < Remaining) {
+    WriteSize -= WriteSize % SparseStream.Header.blk_sz;
+    if (WriteSize < SPARSE_STREAM_MIN_WRITE) {
+      return EFI_NOT_READY;
+    }
+  } else {
+    WriteSize = Remaining;
+  }
+
+  if (WriteSize) {
+    Lba = (UINT64)Params->TotalBlocks * Params->BlockCountFactor +
+          SparseStream.RawChunkDone / Params->BlockIo->Media->BlockSize;
+    Status = WriteToDisk (Params->BlockIo, Params->Handle,
+                          SparseStream.Base + SparseStream.Parsed, WriteSize,
+                          Lba);
+    if (EFI_ERROR (Status)) {
+      DEBUG ((EFI_D_ERROR, "Flash Write Failure\n"));
+      return Status;
+    }
+    SparseCrcAddData (Params, SparseStream.Base + SparseStream.Parsed,
+                      WriteSize);
+  }
+
+  SparseStream.Parsed += WriteSize;
+  SparseStream.RawChunkDone += WriteSize;
+  SparseStream.BytesWritten += WriteSize;
+  if (SparseStream.RawChunkDone < Params->ChunkDataSz) {
+    return EFI_NOT_READY;
+  }
+
+  if (Params->TotalBlocks > (MAX_UINT32 - SparseStream.RawChunk.chunk_sz)) {
+    DEBUG ((EFI_D_ERROR, "Bogus size for RAW chunk Type\n"));
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Params->TotalBlocks += SparseStream.RawChunk.chunk_sz;
+  SparseStream.InRawChunk = FALSE;
+  Params->Chunk++;
+  return EFI_SUCCESS;
+}
+
+/* Consume the part of the download received so far: validate the sparse
+ * header, then write out every chunk as soon as its data has arrived.
+ * Available is the number of bytes of the download present in the buffer.
+ */
+STATIC VOID
+SparseStreamProcess (IN UINT64 Available)
+{
+  sparse_header_t *sparse_header = &SparseStream.Header;
+  SparseImgParam *Params = &SparseStream.Params;
+  chunk_header_t ChunkHeader;
+  UINT64 Needed;
+  VOID *Image;
+  EFI_STATUS Status = EFI_SUCCESS;
+
+  if (!SparseStream.Active ||
+      SparseStream.Done ||
+      EFI_ERROR (SparseStream.Status)) {
+    return;
+  }
+
+  if (!SparseStream.HeaderDone) {
+    if (Available < sizeof (sparse_header_t)) {
+      return;
+    }
+
+    gBS->CopyMem ((VOID *)sparse_header, SparseStream.Base,
+                  sizeof (sparse_header_t));
+    if (sparse_header->magic != SPARSE_HEADER_MAGIC) {
+      /* Not a sparse image, leave it to the flash command */
+      SparseStream.Active = FALSE;
+      return;
+    }
+
+    Status = PartitionGetInfo (SparseStream.PartitionName, &Params->BlockIo,
+                               &Params->Handle);
+    if (EFI_ERROR (Status)) {
+      goto Out;
+    }
+
+    Params->PartitionSize = (Params->BlockIo->Media->LastBlock + 1) *
+                            Params->BlockIo->Media->BlockSize;
+    Status = ValidateSparseHeader (sparse_header, Params);
+    if (EFI_ERROR (Status)) {
+      goto Out;
+    }
+
+    SparseStream.Parsed = sizeof (sparse_header_t);
+    SparseStream.HeaderDone = TRUE;
+  }
+
+  while (Params->Chunk < sparse_header->total_chunks) {
+    if (SparseStream.InRawChunk) {
+      Status = SparseStreamWriteRaw (Available);
+      if (Status == EFI_NOT_READY) {
+        Status = EFI_SUCCESS;
+        goto Out;
+      } else if (EFI_ERROR (Status)) {
+        goto Out;
+      }
+      continue;
+    }
+
+    if (((UINT64)Params->TotalBlocks * (UINT64)sparse_header->blk_sz) >=
+        Params->PartitionSize) {
+      DEBUG ((EFI_D_ERROR, "Size of image is too large for the partition\n"));
+      Status = EFI_VOLUME_FULL;
+      goto Out;
+    }
+
+    if (Available - SparseStream.Parsed < sizeof (chunk_header_t)) {
+      goto Out;
+    }
+
+    gBS->CopyMem ((VOID *)&ChunkHeader,
+                  SparseStream.Base + SparseStream.Parsed,
+                  sizeof (chunk_header_t));
+    Status = ValidateChunkHeader (sparse_header, &ChunkHeader, Params);
+    if (EFI_ERROR (Status)) {
+      goto Out;
+    }
+
+    /* Raw chunks are written piecewise while their data is arriving */
+    if (ChunkHeader.chunk_type == CHUNK_TYPE_RAW) {
+      if ((UINT64)ChunkHeader.total_sz !=
+          ((UINT64)sparse_header->chunk_hdr_sz + Params->ChunkDataSz)) {
+        DEBUG ((EFI_D_ERROR, "Bogus chunk size for chunk type Raw\n"));
+        Status = EFI_INVALID_PARAMETER;
+        goto Out;
+      }
+
+      gBS->CopyMem ((VOID *)&SparseStream.RawChunk, (VOID *)&ChunkHeader,
+                    sizeof (chunk_header_t));
+      SparseStream.RawChunkDone = 0;
+      SparseStream.InRawChunk = TRUE;
+      SparseStream.Parsed += sizeof (chunk_header_t);
+      continue;
+    }
+
+    /* Other chunk types carry little or no data, wait until it is here */
+    Needed = sizeof (chunk_header_t);
+    if (ChunkHeader.chunk_type == CHUNK_TYPE_FILL) {
+      Needed += sizeof (UINT32);
+    } else if (ChunkHeader.chunk_type == CHUNK_TYPE_CRC) {
+      Needed += (ChunkHeader.total_sz > sparse_header->chunk_hdr_sz) ?
+                sizeof (UINT32) : Params->ChunkDataSz;
+    }
+
+    if (Available - SparseStream.Parsed < Needed) {
+      goto Out;
+    }
+
+    Image = SparseStream.Base + SparseStream.Parsed + sizeof (chunk_header_t);
+    Params->ImageEnd = (UINT64)SparseStream.Base + Available;
+    Status = ValidateChunkDataAndFlash (sparse_header, &ChunkHeader, &Image,
+                                        Params);
+    if (EFI_ERROR (Status)) {
+      goto Out;
+    }
+
+    if (ChunkHeader.chunk_type == CHUNK_TYPE_FILL) {
+      SparseStream.BytesWritten += Params->ChunkDataSz;
+    }
+    SparseStream.Parsed = (UINT8 *)Image - SparseStream.Base;
+    Params->Chunk++;
+  }
+
+  Status = FlushFillRun (sparse_header, Params);
+  if (EFI_ERROR (Status)) {
+    goto Out;
+  }
+  SparseStream.Done = TRUE;
+
+Out:
+  if (EFI_ERROR (Status)) {
+    DEBUG ((EFI_D_ERROR, "Sparse stream to %s failed at chunk %d: %r\n",
+            SparseStream.PartitionName, Params->Chunk, Status));
+    SparseStream.Status = Status;
+  }
+}
+
+/* Whether the image waiting in the flash buffer was streamed to PartitionName
+ * while it was being downloaded.
+ */
+STATIC BOOLEAN
+SparseStreamMatches (IN CHAR16 *PartitionName)
+{
+  if (!SparseStream.Active) {
+    return FALSE;
+  }
+
+  /* The buffer still holds the whole image for the other partition */
+  if (StrCmp (SparseStream.PartitionName, PartitionName)) {
+    DEBUG ((EFI_D_INFO, "Sparse stream to %s ended by flash of %s\n",
+            SparseStream.PartitionName, PartitionName));
+    SparseStreamReset ();
+    return FALSE;
+  }
+
+  return (SparseStream.Active && SparseStream.Base == mFlashDataBuffer);
+}
+
+/* Called from the flash command once the download has completed: write what
+ * is left, check the result and report the achieved throughput to the host.
+ */
+STATIC EFI_STATUS
+SparseStreamFinish (IN UINT64 Size)
+{
+  CHAR8 StreamInfo[MAX_RSP_SIZE];
+  UINT64 ElapsedMs;
+  EFI_STATUS Status;
+
+  SparseStreamProcess (Size);
+
+  Status = SparseStream.Status;
+  if (EFI_ERROR (Status)) {
+    goto Out;
+  }
+
+  if (!SparseStream.Done) {
+    DEBUG ((EFI_D_ERROR, "Sparse stream ended in the middle of a chunk\n"));
+    Status = EFI_VOLUME_CORRUPTED;
+    goto Out;
+  }
+
+  DEBUG ((EFI_D_INFO, "Wrote %d blocks, expected to write %d blocks\n",
+          SparseStream.Params.TotalBlocks, SparseStream.Header.total_blks));
+  if (SparseStream.Params.TotalBlocks != SparseStream.Header.total_blks) {
+    DEBUG ((EFI_D_ERROR, "Sparse Image Write Failure\n"));
+    Status = EFI_VOLUME_CORRUPTED;
+    goto Out;
   }
 
+  ElapsedMs = GetTimerCountms () - SparseStream.StartTime;
+  if (!ElapsedMs) {
+    ElapsedMs = 1;
+  }
+
+  AsciiSPrint (StreamInfo, sizeof (StreamInfo),
+               "Streamed %lld MB in %lld ms (%lld MB/s)",
+               SparseStream.BytesWritten >> 20, ElapsedMs,
+               ((SparseStream.BytesWritten * 1000) / ElapsedMs) >> 20);
+  DEBUG ((EFI_D_INFO, "%a\n", StreamInfo));
+  FastbootInfo (StreamInfo);
+  WaitForTransferComplete ();
+
+Out:
+  SparseStreamDisarm ();
   return Status;
 }
 
@@ -956,15 +1843,10 @@ FastbootUpdateAttr (CONST CHAR16 *SlotSuffix)
   struct PartitionEntry *Ptn_Entries_Ptr = NULL;
   UINT32 j;
   INT32 Index;
-  CHAR16 PartName[MAX_GPT_NAME_SIZE];
   CHAR8 SlotSuffixAscii[MAX_SLOT_SUFFIX_SZ];
   UnicodeStrToAsciiStr (SlotSuffix, SlotSuffixAscii);
 
-  StrnCpyS (PartName, StrLen ((CONST CHAR16 *)L"boot") + 1,
-            (CONST CHAR16 *)L"boot", StrLen ((CONST CHAR16 *)L"boot"));
-  StrnCatS (PartName, MAX_GPT_NAME_SIZE - 1, SlotSuffix, StrLen (SlotSuffix));
-
-  Index = GetPartitionIndex (PartName);
+  Index = GetPartitionIndexWithSuffix ((CONST CHAR16 *)L"boot", SlotSuffix);
   if (Index == INVALID_PTN) {
     DEBUG ((EFI_D_ERROR, "Error boot partition for slot: %s not found\n",
             SlotSuffix));
@@ -1007,6 +1889,7 @@ HandleRawImgFlash (IN CHAR16 *PartitionName,
   CHAR16 SlotSuffix[MAX_SLOT_SUFFIX_SZ];
   BOOLEAN MultiSlotBoot = PartitionHasMultiSlot ((CONST CHAR16 *)L"boot");
   BOOLEAN HasSlot = FALSE;
+  UINT64 StartMs;
 
   /* For multislot boot the partition may not support a/b slots.
    * Look for default partition, if it does not exist then try for a/b
@@ -1049,9 +1932,12 @@ HandleRawImgFlash (IN CHAR16 *PartitionName,
     return EFI_VOLUME_FULL;
   }
 
+  StartMs = GetTimerCountms ();
   Status = WriteBlockToPartition (BlockIo, Handle, 0, Size, Image);
   if (EFI_ERROR (Status)) {
     DEBUG ((EFI_D_ERROR, "Writing Block to partition Failure\n"));
+  } else {
+    ReportFlashSpeed (PartitionName, Size, StartMs);
   }
 
   if (MultiSlotBoot && HasSlot &&
@@ -1284,6 +2170,56 @@ FastbootErasePartition (IN CHAR16 *PartitionName)
 }
 #endif
 
+/* Producer side of the download ring: move the download to the next slot
+ * that is not waiting to be flashed.
+ */
+STATIC EFI_STATUS
+DownloadSlotClaim (VOID)
+{
+  UINT32 Index;
+  UINT32 Slot;
+
+  for (Index = 1; Index <= DownloadSlotCount; Index++) {
+    Slot = (DownloadSlot + Index) % DownloadSlotCount;
+    if (DownloadSlots[Slot].State == SLOT_FREE) {
+      DownloadSlot = Slot;
+      mUsbDataBuffer = DownloadSlots[Slot].Base;
+      DownloadStalled = FALSE;
+      return EFI_SUCCESS;
+    }
+  }
+
+  return EFI_NOT_READY;
+}
+
+/* Whether a download has to wait for a slot to be flashed. The stall is
+ * counted once per download, on the slot the ring moves to next.
+ */
+STATIC BOOLEAN
+DownloadSlotStall (VOID)
+{
+  UINT32 Index;
+  UINT32 Slot;
+
+  for (Index = 0; Index < DownloadSlotCount; Index++) {
+    if (DownloadSlots[Index].State == SLOT_FREE) {
+      return FALSE;
+    }
+  }
+
+  if (!DownloadStalled) {
+    Slot = (DownloadSlot + 1) % DownloadSlotCount;
+    DownloadSlots[Slot].Stalls++;
+    AsciiSPrint (DownloadSlots[Slot].StallsStr,
+                 sizeof (DownloadSlots[Slot].StallsStr), "%d",
+                 DownloadSlots[Slot].Stalls);
+    DownloadStalled = TRUE;
+    DEBUG ((EFI_D_VERBOSE, "Download waits for slot %d\n", Slot));
+  }
+
+  return TRUE;
+}
+
 /* Handle Download Command */
 STATIC VOID
 CmdDownload (IN CONST CHAR8 *arg, IN VOID *data, IN UINT32 sz)
@@ -1325,10 +2261,25 @@ CmdDownload (IN CONST CHAR8 *arg, IN VOID *data, IN UINT32 sz)
   AsciiStrnCpyS (Response + InitStrLen, sizeof (Response) - InitStrLen,
                  NumBytesString, AsciiStrLen (NumBytesString));
 
+  /* AcceptCmd held the command back until a slot was free */
+  if (DownloadSlotClaim () != EFI_SUCCESS) {
+    FastbootFail ("No free download slot");
+    return;
+  }
+
   gBS->CopyMem (GetFastbootDeviceData ()->gTxBuffer, Response,
                 sizeof (Response));
   mState = ExpectDataState;
   mBytesReceivedSoFar = 0;
+  gBS->SetMem ((VOID *)&XfrStats, sizeof (XfrStats), 0);
+  XfrStats.StartMs = GetTimerCountms ();
+#ifdef ENABLE_UPDATE_PARTITIONS_CMDS
+  if (SparseStream.Armed) {
+    SparseStreamStart (mUsbDataBuffer);
+  } else {
+    SparseStreamReset ();
+  }
+#endif
   GetFastbootDeviceData ()->UsbDeviceProtocol->Send (
       ENDPOINT_OUT, sizeof (Response), GetFastbootDeviceData ()->gTxBuffer);
   DEBUG ((EFI_D_VERBOSE, "CmdDownload: Send 12 %a\n",
@@ -1423,68 +2374,211 @@ STATIC VOID ClearFastbootVarsofAB (VOID)
     else
       PrevList->next = CurrentList->next;
 
+    FastbootUnhashVar (CurrentList);
     FreePool (CurrentList);
     CurrentList = NULL;
   }
 }
 
-VOID
-IsBootPtnUpdated (INT32 Lun, BOOLEAN *BootPtnUpdated)
+VOID
+IsBootPtnUpdated (INT32 Lun, BOOLEAN *BootPtnUpdated)
+{
+  EFI_STATUS Status;
+  EFI_PARTITION_ENTRY *PartEntry;
+  UINT32 j;
+
+  *BootPtnUpdated = FALSE;
+  if (Lun == NO_LUN)
+    Lun = 0;
+
+  for (j = 0; j < Ptable[Lun].MaxHandles; j++) {
+    Status =
+        gBS->HandleProtocol (Ptable[Lun].HandleInfoList[j].Handle,
+                             &gEfiPartitionRecordGuid, (VOID **)&PartEntry);
+
+    if (EFI_ERROR (Status)) {
+      DEBUG ((
+          EFI_D_VERBOSE,
+          "Error getting the partition record for Lun %d and Handle: %d : %r\n",
+          Lun, j, Status));
+      continue;
+    }
+
+    if (!StrnCmp (PartEntry->PartitionName, L"boot", StrLen (L"boot"))) {
+      DEBUG ((EFI_D_VERBOSE, "Boot Partition is updated\n"));
+      *BootPtnUpdated = TRUE;
+      return;
+    }
+  }
+}
+
+STATIC BOOLEAN
+IsCriticalPartition (CHAR16 *PartitionName)
+{
+  UINT32 i = 0;
+
+  if (PartitionName == NULL)
+    return FALSE;
+
+  for (i = 0; i < ARRAY_SIZE (CriticalPartitions); i++) {
+    if (!StrnCmp (PartitionName, CriticalPartitions[i],
+                  StrLen (CriticalPartitions[i])))
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+/* Hand the slot of the last download over to the flash command */
+STATIC UINT32 TakeDownloadSlot (VOID)
+{
+  mFlashDataBuffer = mUsbDataBuffer;
+  mFlashNumDataBytes = mNumDataBytes;
+  return DownloadSlot;
+}
+
+/* Queue the image of the last download to be flashed after the running
+ * flash. It stays in its download slot until then.
+ */
+STATIC EFI_STATUS
+FlashQueuePush (IN CHAR16 *PartitionName)
+{
+  FLASH_JOB *Job;
+
+  if (FlashQueueCount >= ARRAY_SIZE (FlashQueue)) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Job = &FlashQueue[(FlashQueueHead + FlashQueueCount) %
+                    ARRAY_SIZE (FlashQueue)];
+  Job->Slot = DownloadSlot;
+  Job->Size = mNumDataBytes;
+  StrnCpyS (Job->PartitionName, ARRAY_SIZE (Job->PartitionName),
+            PartitionName, StrLen (PartitionName));
+  DownloadSlots[Job->Slot].State = SLOT_QUEUED;
+  FlashQueueCount++;
+
+  DEBUG ((EFI_D_INFO, "Queued image for %s in slot %d\n", PartitionName,
+          Job->Slot));
+  return EFI_SUCCESS;
+}
+
+/* Drop all queued images, called at TPL_CALLBACK */
+STATIC VOID FlashQueueFlush (VOID)
+{
+  FLASH_JOB *Job;
+
+  while (FlashQueueCount) {
+    Job = &FlashQueue[FlashQueueHead];
+    DEBUG ((EFI_D_ERROR, "Dropping queued image for %s\n",
+            Job->PartitionName));
+    DownloadSlots[Job->Slot].State = SLOT_FREE;
+    FlashQueueHead = (FlashQueueHead + 1) % ARRAY_SIZE (FlashQueue);
+    FlashQueueCount--;
+  }
+}
+
+STATIC VOID
+ResetVerityAfterFlash (IN CHAR16 *PartitionName, IN EFI_STATUS Result)
+{
+  EFI_STATUS Status;
+
+  if (!StrnCmp (PartitionName, L"system", StrLen (L"system")) &&
+    !IsEnforcing () &&
+    (Result == EFI_SUCCESS)) {
+     // reset dm_verity mode to enforcing
+    Status = EnableEnforcingMode (TRUE);
+    if (Status != EFI_SUCCESS) {
+      DEBUG ((EFI_D_ERROR, "failed to update verity mode:  %r\n", Status));
+    }
+  }
+}
+
+/* Resolve the slot suffix of PartitionName and get the partition size */
+STATIC EFI_STATUS
+GetFlashPartitionSize (IN OUT CHAR16 *PartitionName,
+                       IN UINT32 PartitionMaxSize,
+                       OUT UINT64 *PartitionSize)
 {
   EFI_STATUS Status;
-  EFI_PARTITION_ENTRY *PartEntry;
-  UINT32 j;
-
-  *BootPtnUpdated = FALSE;
-  if (Lun == NO_LUN)
-    Lun = 0;
-
-  for (j = 0; j < Ptable[Lun].MaxHandles; j++) {
-    Status =
-        gBS->HandleProtocol (Ptable[Lun].HandleInfoList[j].Handle,
-                             &gEfiPartitionRecordGuid, (VOID **)&PartEntry);
+  EFI_BLOCK_IO_PROTOCOL *BlockIo = NULL;
+  EFI_HANDLE *Handle = NULL;
+  CHAR16 SlotSuffix[MAX_SLOT_SUFFIX_SZ];
 
-    if (EFI_ERROR (Status)) {
-      DEBUG ((
-          EFI_D_VERBOSE,
-          "Error getting the partition record for Lun %d and Handle: %d : %r\n",
-          Lun, j, Status));
-      continue;
-    }
+  if (PartitionHasMultiSlot ((CONST CHAR16 *)L"boot") &&
+      GetPartitionHasSlot (PartitionName, PartitionMaxSize,
+                           SlotSuffix, MAX_SLOT_SUFFIX_SZ)) {
+    DEBUG ((EFI_D_VERBOSE, "Partition %s has slot\n", PartitionName));
+  }
 
-    if (!StrnCmp (PartEntry->PartitionName, L"boot", StrLen (L"boot"))) {
-      DEBUG ((EFI_D_VERBOSE, "Boot Partition is updated\n"));
-      *BootPtnUpdated = TRUE;
-      return;
-    }
+  Status = PartitionGetInfo (PartitionName, &BlockIo, &Handle);
+  if (EFI_ERROR (Status)) {
+    return Status;
   }
+
+  *PartitionSize = (BlockIo->Media->LastBlock + 1)
+                      * (BlockIo->Media->BlockSize);
+  return EFI_SUCCESS;
 }
 
-STATIC BOOLEAN
-IsCriticalPartition (CHAR16 *PartitionName)
+/* Consumer side of the download ring: release Slot, whose image was flashed
+ * with Result, then flash the images that were queued while it was being
+ * written. Once the queue is empty the flash is complete and a command
+ * waiting for it is dispatched right away.
+ *
+ * Queued images were acknowledged when they were queued, so the first of
+ * them to fail is left in FlashResult for the next command to report.
+ */
+STATIC VOID
+FlashQueueDrain (IN UINT32 Slot, IN EFI_STATUS Result)
 {
-  UINT32 i = 0;
+  FLASH_JOB Job;
+  EFI_TPL OldTpl;
+  BOOLEAN Queued;
 
-  if (PartitionName == NULL)
-    return FALSE;
+  do {
+    /* The usb timer queues images and claims slots at TPL_CALLBACK */
+    OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+    DownloadSlots[Slot].State = SLOT_FREE;
+    if (EFI_ERROR (Result)) {
+      /* Images after a failed one were acknowledged but can't be written */
+      FlashQueueFlush ();
+    }
 
-  for (i = 0; i < ARRAY_SIZE (CriticalPartitions); i++) {
-    if (!StrnCmp (PartitionName, CriticalPartitions[i],
-                  StrLen (CriticalPartitions[i])))
-      return TRUE;
-  }
+    Queued = (FlashQueueCount > 0);
+    if (Queued) {
+      Job = FlashQueue[FlashQueueHead];
+      FlashQueueHead = (FlashQueueHead + 1) % ARRAY_SIZE (FlashQueue);
+      FlashQueueCount--;
+      DownloadSlots[Job.Slot].State = SLOT_FLASHING;
+    } else {
+      IsFlashComplete = TRUE;
+    }
+    gBS->RestoreTPL (OldTpl);
 
-  return FALSE;
-}
+    if (!Queued) {
+      StopUsbTimer ();
+    }
 
-STATIC VOID ExchangeFlashAndUsbDataBuf (VOID)
-{
-  VOID *mTmpbuff;
+    /* A stalled download or a deferred command may go on now */
+    if (PendingCmd.Data) {
+      gBS->SignalEvent (PendingCmdEvent);
+    }
 
-  mTmpbuff = mUsbDataBuffer;
-  mUsbDataBuffer = mFlashDataBuffer;
-  mFlashDataBuffer = mTmpbuff;
-  mFlashNumDataBytes = mNumDataBytes;
+    if (Queued) {
+      DEBUG ((EFI_D_INFO, "Flashing queued image for %s from slot %d\n",
+              Job.PartitionName, Job.Slot));
+      Result = HandleSparseImgFlash (Job.PartitionName,
+                                     ARRAY_SIZE (Job.PartitionName),
+                                     DownloadSlots[Job.Slot].Base,
+                                     Job.Size);
+      if (EFI_ERROR (Result) && !EFI_ERROR (FlashResult)) {
+        FlashResult = Result;
+      }
+      ResetVerityAfterFlash (Job.PartitionName, Result);
+      Slot = Job.Slot;
+    }
+  } while (Queued);
 }
 
 STATIC EFI_STATUS
@@ -1561,20 +2655,16 @@ CmdFlash (IN CONST CHAR8 *arg, IN VOID *data, IN UINT32 sz)
   UbiHeader_t *UbiHeader;
   CHAR16 PartitionName[MAX_GPT_NAME_SIZE];
   CHAR16 *Token = NULL;
-  LunSet = FALSE;
-  BOOLEAN MultiSlotBoot = FALSE;
   UINT32 UfsBootLun = 0;
   CHAR8 BootDeviceType[BOOT_DEV_NAME_SIZE_MAX];
-  /* For partition info */
-  EFI_BLOCK_IO_PROTOCOL *BlockIo = NULL;
-  EFI_HANDLE *Handle = NULL;
-  BOOLEAN HasSlot = FALSE;
-  CHAR16 SlotSuffix[MAX_SLOT_SUFFIX_SZ];
   CHAR8 FlashResultStr[MAX_RSP_SIZE] = "";
   UINT64 PartitionSize = 0;
+  EFI_STATUS Result = EFI_NOT_STARTED;
+  BOOLEAN Acknowledged = FALSE;
+  BOOLEAN IsSparse;
+  UINT32 Slot;
 
-  ExchangeFlashAndUsbDataBuf ();
-  if (mFlashDataBuffer == NULL) {
+  if (mUsbDataBuffer == NULL) {
     // Doesn't look like we were sent any data
     FastbootFail ("No data to flash");
     return;
@@ -1612,6 +2702,26 @@ CmdFlash (IN CONST CHAR8 *arg, IN VOID *data, IN UINT32 sz)
     return;
   }
 
+  if (!IsFlashComplete) {
+    /* Accepted by FlashCanQueue while another image is being flashed. This
+     * runs from the usb timer in the middle of that flash, so the image is
+     * only queued, the state of the running flash is left alone.
+     */
+    Status = GetFlashPartitionSize (PartitionName, ARRAY_SIZE (PartitionName),
+                                    &PartitionSize);
+    if (EFI_ERROR (Status)) {
+      FastbootFail ("Partition not found");
+    } else if (EFI_ERROR (FlashQueuePush (PartitionName))) {
+      FastbootFail ("No room to queue the image");
+    } else {
+      FastbootOkay ("");
+    }
+    return;
+  }
+
+  Slot = TakeDownloadSlot ();
+  LunSet = FALSE;
+
   /* Find the lun number from input string */
   Token = StrStr (PartitionName, L":");
 
@@ -1664,106 +2774,98 @@ CmdFlash (IN CONST CHAR8 *arg, IN VOID *data, IN UINT32 sz)
   meta_header = (meta_header_t *)mFlashDataBuffer;
   UbiHeader = (UbiHeader_t *)mFlashDataBuffer;
 
-  /* Send okay for next data sending */
-  if (sparse_header->magic == SPARSE_HEADER_MAGIC) {
+  /* Once FlashQueueDrain frees the slot, the next download may overwrite
+   * the image, so the header is only looked at here.
+   */
+  IsSparse = (sparse_header->magic == SPARSE_HEADER_MAGIC);
 
-    MultiSlotBoot = PartitionHasMultiSlot ((CONST CHAR16 *)L"boot");
-    if (MultiSlotBoot) {
-      HasSlot = GetPartitionHasSlot (PartitionName,
-                                     ARRAY_SIZE (PartitionName),
-                                     SlotSuffix, MAX_SLOT_SUFFIX_SZ);
-      if (HasSlot) {
-        DEBUG ((EFI_D_VERBOSE, "Partition %s has slot\n", PartitionName));
-      }
-    }
+  /* Send okay for next data sending */
+  if (IsSparse) {
 
-    Status = PartitionGetInfo (PartitionName, &BlockIo, &Handle);
+    Status = GetFlashPartitionSize (PartitionName, ARRAY_SIZE (PartitionName),
+                                    &PartitionSize);
     if (EFI_ERROR (Status)) {
       FastbootFail ("Partition not found");
       goto out;
     }
 
     IsFlashComplete = FALSE;
-    PartitionSize = (BlockIo->Media->LastBlock + 1)
-                        * (BlockIo->Media->BlockSize);
 
-    if ((PartitionSize > MaxDownLoadSize) &&
-         !IsDisableParallelDownloadFlash ()) {
-      Status = HandleUsbEventsInTimer ();
-      if (EFI_ERROR (Status)) {
-        DEBUG ((EFI_D_ERROR, "Failed to handle usb event: %r\n", Status));
-        IsFlashComplete = TRUE;
-        StopUsbTimer ();
-      } else {
-        UsbTimerStarted = TRUE;
-        FastbootOkay ("");
+    if (SparseStreamMatches (PartitionName)) {
+      /* Chunks were already written while the image was downloading */
+      Result = SparseStreamFinish (mFlashNumDataBytes);
+    } else {
+      if ((PartitionSize > MaxDownLoadSize) &&
+           !IsDisableParallelDownloadFlash ()) {
+        DownloadSlots[Slot].State = SLOT_FLASHING;
+        Status = HandleUsbEventsInTimer ();
+        if (EFI_ERROR (Status)) {
+          DEBUG ((EFI_D_ERROR, "Failed to handle usb event: %r\n", Status));
+          IsFlashComplete = TRUE;
+          StopUsbTimer ();
+        } else {
+          UsbTimerStarted = TRUE;
+          Acknowledged = TRUE;
+          FastbootOkay ("");
+        }
       }
+
+      Result = HandleSparseImgFlash (PartitionName,
+                                     ARRAY_SIZE (PartitionName),
+                                     mFlashDataBuffer,
+                                     mFlashNumDataBytes);
     }
 
-    FlashResult = HandleSparseImgFlash (PartitionName,
-                                        ARRAY_SIZE (PartitionName),
-                                        mFlashDataBuffer, mFlashNumDataBytes);
+    /* Already acknowledged, the next command reports the error */
+    if (Acknowledged && EFI_ERROR (Result)) {
+      FlashResult = Result;
+    }
 
-    IsFlashComplete = TRUE;
+    /* Write out the images queued meanwhile */
+    FlashQueueDrain (Slot, Result);
     StopUsbTimer ();
   } else if (!AsciiStrnCmp (UbiHeader->HdrMagic, UBI_HEADER_MAGIC, 4)) {
-    FlashResult = HandleUbiImgFlash (PartitionName,
-                                     ARRAY_SIZE (PartitionName),
-                                     mFlashDataBuffer,
-                                     mFlashNumDataBytes);
+    Result = HandleUbiImgFlash (PartitionName,
+                                ARRAY_SIZE (PartitionName),
+                                mFlashDataBuffer,
+                                mFlashNumDataBytes);
   } else if (meta_header->magic == META_HEADER_MAGIC) {
 
-    FlashResult = HandleMetaImgFlash (PartitionName,
-                                      ARRAY_SIZE (PartitionName),
-                                      mFlashDataBuffer, mFlashNumDataBytes);
+    Result = HandleMetaImgFlash (PartitionName,
+                                 ARRAY_SIZE (PartitionName),
+                                 mFlashDataBuffer, mFlashNumDataBytes);
   } else {
 
-    FlashResult = HandleRawImgFlash (PartitionName,
-                                     ARRAY_SIZE (PartitionName),
-                                     mFlashDataBuffer, mFlashNumDataBytes);
+    Result = HandleRawImgFlash (PartitionName,
+                                ARRAY_SIZE (PartitionName),
+                                mFlashDataBuffer, mFlashNumDataBytes);
   }
 
   /*
-   * For Non-sparse image: Check flash result and update the result
-   * Also, Handle if there is Failure in handling USB events especially for
-   * sparse images.
+   * Report the result unless the image was acknowledged before it was
+   * written, for sparse images flashed in parallel with the next download.
    */
-  if ((sparse_header->magic != SPARSE_HEADER_MAGIC) ||
-        (PartitionSize < MaxDownLoadSize) ||
-        ((PartitionSize > MaxDownLoadSize) &&
-        (IsDisableParallelDownloadFlash () ||
-        (Status != EFI_SUCCESS)))) {
-    if (EFI_ERROR (FlashResult)) {
-      if (FlashResult == EFI_NOT_FOUND) {
+  if (!Acknowledged) {
+    if (EFI_ERROR (Result)) {
+      if (Result == EFI_NOT_FOUND) {
         AsciiSPrint (FlashResultStr, MAX_RSP_SIZE, "(%s) No such partition",
                      PartitionName);
       } else {
         AsciiSPrint (FlashResultStr, MAX_RSP_SIZE, "%a : %r",
-                     "Error flashing partition", FlashResult);
+                     "Error flashing partition", Result);
       }
 
       DEBUG ((EFI_D_ERROR, "%a\n", FlashResultStr));
       FastbootFail (FlashResultStr);
-
-      /* Reset the Flash Result for next flash command */
-      FlashResult = EFI_SUCCESS;
       goto out;
     } else {
-      DEBUG ((EFI_D_INFO, "flash image status:  %r\n", FlashResult));
+      DEBUG ((EFI_D_INFO, "flash image status:  %r\n", Result));
       FastbootOkay ("");
     }
   }
 
 out:
-  if (!AsciiStrnCmp (arg, "system", AsciiStrLen ("system")) &&
-    !IsEnforcing () &&
-    (FlashResult == EFI_SUCCESS)) {
-     // reset dm_verity mode to enforcing
-    Status = EnableEnforcingMode (TRUE);
-    if (Status != EFI_SUCCESS) {
-      DEBUG ((EFI_D_ERROR, "failed to update verity mode:  %r\n", Status));
-    }
-  }
+  ResetVerityAfterFlash (PartitionName, Result);
 
   LunSet = FALSE;
 }
@@ -1940,53 +3042,6 @@ CmdSetActive (CONST CHAR8 *Arg, VOID *Data, UINT32 Size)
 }
 #endif
 
-STATIC VOID
-FlashCompleteHandler (IN EFI_EVENT Event, IN VOID *Context)
-{
-  EFI_STATUS Status = EFI_SUCCESS;
-
-  /* Wait for flash completely before sending okay */
-  if (!IsFlashComplete) {
-    Status = gBS->SetTimer (Event, TimerRelative, 100000);
-    if (EFI_ERROR (Status)) {
-      FastbootFail ("Failed to set timer for waiting flash completely");
-      goto Out;
-    }
-    return;
-  }
-
-  FastbootOkay ("");
-Out:
-  gBS->CloseEvent (Event);
-  Event = NULL;
-}
-
-/* Parallel usb sending data and device writing data
- * It's need to delay to send okay until flashing finished for
- * next command.
- */
-STATIC EFI_STATUS FastbootOkayDelay (VOID)
-{
-  EFI_STATUS Status = EFI_SUCCESS;
-  EFI_EVENT FlashCompleteEvent = NULL;
-
-  Status = gBS->CreateEvent (EVT_TIMER | EVT_NOTIFY_SIGNAL, TPL_CALLBACK,
-                             FlashCompleteHandler, NULL, &FlashCompleteEvent);
-  if (EFI_ERROR (Status)) {
-    FastbootFail ("Failed to creat event for waiting flash completely");
-    return Status;
-  }
-
-  Status = gBS->SetTimer (FlashCompleteEvent, TimerRelative, 100000);
-  if (EFI_ERROR (Status)) {
-    gBS->CloseEvent (FlashCompleteEvent);
-    FlashCompleteEvent = NULL;
-    FastbootFail ("Failed to set timer for waiting flash completely");
-  }
-
-  return Status;
-}
-
 STATIC VOID
 AcceptData (IN UINT64 Size, IN VOID *Data)
 {
@@ -2000,13 +3055,15 @@ AcceptData (IN UINT64 Size, IN VOID *Data)
   }
 
   mBytesReceivedSoFar += Size;
+  DownloadXfrDone (Size);
 
-  /* Either queue the max transfer size 1 MB or only queue the remaining
+  /* Either queue the current transfer size or only queue the remaining
    * amount of data left to avoid zlt issues
    */
   if (mBytesReceivedSoFar == mNumDataBytes) {
     /* Download Finished */
     DEBUG ((EFI_D_INFO, "Download Finished\n"));
+    DownloadXfrReport ();
     /* Zero initialized the surplus data buffer. It's risky to access the data
      * buffer which it's not zero initialized, its content might leak
      */
@@ -2016,15 +3073,29 @@ AcceptData (IN UINT64 Size, IN VOID *Data)
       gBS->SetMem ((VOID *)(Data + mNumDataBytes), RoundSize - mNumDataBytes,
                    0);
     }
-    /* Stop usb timer after data transfer completed */
-    StopUsbTimer ();
-    /* Postpone Fastboot Okay until flash completed */
-    FastbootOkayDelay ();
+#ifdef ENABLE_UPDATE_PARTITIONS_CMDS
+    /* Streamed chunks can't be written while a flash is still running */
+    if (IsFlashComplete) {
+      SparseStreamProcess (mBytesReceivedSoFar);
+    }
+#endif
+    /* The image has a slot of its own, so the download is acknowledged
+     * right away. Usb is still serviced while a flash runs, so that the
+     * flash command for this image can be queued behind it.
+     */
+    if (IsFlashComplete) {
+      StopUsbTimer ();
+    }
     mState = ExpectCmdState;
+    FastbootOkay ("");
   } else {
-    GetFastbootDeviceData ()->UsbDeviceProtocol->Send (
-        ENDPOINT_IN, GetXfrSize (), (Data + mBytesReceivedSoFar));
-    DEBUG ((EFI_D_VERBOSE, "AcceptData: Send %d\n", GetXfrSize ()));
+    QueueDownloadXfr (Data + mBytesReceivedSoFar);
+#ifdef ENABLE_UPDATE_PARTITIONS_CMDS
+    /* The next transfer is queued, write out what has arrived meanwhile */
+    if (IsFlashComplete) {
+      SparseStreamProcess (mBytesReceivedSoFar);
+    }
+#endif
   }
 }
 
@@ -2073,6 +3144,10 @@ FastbootCmdsUnInit (VOID)
       return Status;
     }
   }
+  if (PendingCmdEvent) {
+    gBS->CloseEvent (PendingCmdEvent);
+    PendingCmdEvent = NULL;
+  }
   FastbootUnInit ();
   GetFastbootDeviceData ()->UsbDeviceProtocol->Stop ();
   return EFI_SUCCESS;
@@ -2188,6 +3263,15 @@ FastbootCmdsInit (VOID)
     return Status;
   }
 
+  /* Create event to dispatch commands held back while flashing */
+  Status = gBS->CreateEvent (EVT_NOTIFY_SIGNAL, TPL_CALLBACK, AcceptCmdHandler,
+                             &PendingCmd, &PendingCmdEvent);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((EFI_D_ERROR, "Couldn't create Fastboot pending command event: %r\n",
+            Status));
+    return Status;
+  }
+
   /* Allocate buffer used to store images passed by the download command */
   GetMaxAllocatableMemory (&MaxDownLoadSize);
   if (!MaxDownLoadSize) {
@@ -2227,8 +3311,11 @@ FastbootCmdsInit (VOID)
   DEBUG ((EFI_D_VERBOSE,
                   "Fastboot Buffer Size allocated: %ld\n", MaxDownLoadSize));
 
-  MaxDownLoadSize = (CheckRootDeviceType () == NAND) ?
-                              MaxDownLoadSize : MaxDownLoadSize / 2;
+  /* Split the buffer into the download ring, NAND flashes in place */
+  DownloadSlotCount = (CheckRootDeviceType () == NAND) ?
+                              1 : FASTBOOT_DOWNLOAD_SLOTS;
+  MaxDownLoadSize = (MaxDownLoadSize / DownloadSlotCount) &
+                              ~((UINT64)EFI_PAGE_MASK);
 
   FastbootCommandSetup ((VOID *)FastBootBuffer, MaxDownLoadSize);
   return EFI_SUCCESS;
@@ -2367,22 +3454,36 @@ STATIC VOID WaitForTransferComplete (VOID)
   }
 }
 
+/* Only one transfer can be queued on the endpoint, so each INFO line still
+ * waits for the previous one. The next line is formatted while the current
+ * one is on the bus, and sent as soon as it completes.
+ */
 STATIC VOID CmdGetVarAll (VOID)
 {
   FASTBOOT_VAR *Var;
+  CHAR8 *TxBuffer = GetFastbootDeviceData ()->gTxBuffer;
   CHAR8 GetVarAll[MAX_RSP_SIZE];
+  UINTN Len;
+  BOOLEAN InFlight = FALSE;
 
   for (Var = Varlist; Var; Var = Var->next) {
-    AsciiStrnCpyS (GetVarAll, sizeof (GetVarAll), Var->name, MAX_RSP_SIZE);
-    AsciiStrnCatS (GetVarAll, sizeof (GetVarAll), ":", AsciiStrLen (":"));
-    AsciiStrnCatS (GetVarAll, sizeof (GetVarAll), Var->value, MAX_RSP_SIZE);
-    FastbootInfo (GetVarAll);
-    /* Wait for the transfer to complete */
+    Len = AsciiSPrint (GetVarAll, sizeof (GetVarAll), "INFO%a:%a", Var->name,
+                       Var->value);
+    if (InFlight) {
+      WaitForTransferComplete ();
+    }
+
+    gBS->CopyMem (TxBuffer, GetVarAll, Len + 1);
+    GetFastbootDeviceData ()->UsbDeviceProtocol->Send (ENDPOINT_OUT, Len,
+                                                       TxBuffer);
+    InFlight = TRUE;
+  }
+
+  if (InFlight) {
     WaitForTransferComplete ();
-    ZeroMem (GetVarAll, sizeof (GetVarAll));
   }
 
-  FastbootOkay (GetVarAll);
+  FastbootOkay ("");
 }
 
 STATIC VOID
@@ -2421,11 +3522,10 @@ CmdGetVar (CONST CHAR8 *Arg, VOID *Data, UINT32 Size)
     }
   }
 
-  for (Var = Varlist; Var; Var = Var->next) {
-    if (!AsciiStrCmp (Var->name, Arg)) {
-      FastbootOkay (Var->value);
-      return;
-    }
+  Var = FastbootFindVar (Arg);
+  if (Var) {
+    FastbootOkay (Var->value);
+    return;
   }
 
   FastbootFail ("GetVar Variable Not found");
@@ -2540,12 +3640,18 @@ CmdRebootBootloader (CONST CHAR8 *arg, VOID *data, UINT32 sz)
 STATIC VOID
 CmdFlashingLockCritical (CONST CHAR8 *arg, VOID *data, UINT32 sz)
 {
+#ifdef ENABLE_UPDATE_PARTITIONS_CMDS
+  SparseStreamDisarm ();
+#endif
   SetDeviceUnlock (UNLOCK_CRITICAL, FALSE);
 }
 
 STATIC VOID
 CmdFlashingUnLockCritical (CONST CHAR8 *arg, VOID *data, UINT32 sz)
 {
+#ifdef ENABLE_UPDATE_PARTITIONS_CMDS
+  SparseStreamDisarm ();
+#endif
   SetDeviceUnlock (UNLOCK_CRITICAL, TRUE);
 }
 #endif
@@ -2785,6 +3891,79 @@ CmdFlashingGetUnlockAbility (CONST CHAR8 *arg, VOID *data, UINT32 sz)
 }
 #endif
 
+#ifdef ENABLE_UPDATE_PARTITIONS_CMDS
+/* "oem sparse-stream <partition>" makes the next download, if it is a sparse
+ * image, get written to <partition> while it is still being received. The
+ * flash command for the same partition then only completes the stream. The
+ * arm covers a single download, the host repeats it for every segment.
+ * "oem sparse-stream" without a partition disarms streaming.
+ */
+STATIC VOID
+CmdOemSparseStream (CONST CHAR8 *Arg, VOID *Data, UINT32 Size)
+{
+  CHAR16 PartitionName[MAX_GPT_NAME_SIZE];
+  CHAR16 SlotSuffix[MAX_SLOT_SUFFIX_SZ];
+  EFI_BLOCK_IO_PROTOCOL *BlockIo = NULL;
+  EFI_HANDLE *Handle = NULL;
+  CONST CHAR8 *Denied;
+  EFI_STATUS Status;
+  UINT32 BatteryVoltage = 0;
+
+  while (*Arg == ' ') {
+    Arg++;
+  }
+
+  if (*Arg == '\0') {
+    SparseStreamDisarm ();
+    FastbootOkay ("");
+    return;
+  }
+
+  if (AsciiStrLen (Arg) >= MAX_GPT_NAME_SIZE) {
+    FastbootFail ("Invalid partition name");
+    return;
+  }
+  AsciiStrToUnicodeStr (Arg, PartitionName);
+
+  Denied = SparseStreamDenied (PartitionName);
+  if (Denied != NULL) {
+    SparseStreamDisarm ();
+    FastbootFail (Denied);
+    return;
+  }
+
+  /* The download writes to storage, so it gets the battery check AcceptCmd
+   * does for flash and erase.
+   */
+  if (FixedPcdGetBool (EnableBatteryVoltageCheck) &&
+      !TargetBatterySocOk (&BatteryVoltage)) {
+    DEBUG ((EFI_D_VERBOSE, "fastboot: battery voltage: %d\n", BatteryVoltage));
+    SparseStreamDisarm ();
+    FastbootFail ("Warning: battery's capacity is very low\n");
+    return;
+  }
+
+  if (PartitionHasMultiSlot ((CONST CHAR16 *)L"boot")) {
+    GetPartitionHasSlot (PartitionName, ARRAY_SIZE (PartitionName), SlotSuffix,
+                         MAX_SLOT_SUFFIX_SZ);
+  }
+
+  Status = PartitionGetInfo (PartitionName, &BlockIo, &Handle);
+  if (EFI_ERROR (Status)) {
+    SparseStreamDisarm ();
+    FastbootFail ("Partition not found");
+    return;
+  }
+
+  SparseStreamReset ();
+  StrnCpyS (SparseStream.PartitionName, ARRAY_SIZE (SparseStream.PartitionName),
+            PartitionName, StrLen (PartitionName));
+  SparseStream.Armed = TRUE;
+  DEBUG ((EFI_D_INFO, "Sparse stream armed for %s\n", PartitionName));
+  FastbootOkay ("");
+}
+#endif
+
 STATIC VOID
 CmdOemDevinfo (CONST CHAR8 *arg, VOID *data, UINT32 sz)
 {
@@ -2809,48 +3988,78 @@ CmdOemDevinfo (CONST CHAR8 *arg, VOID *data, UINT32 sz)
   FastbootOkay ("");
 }
 
+/* Hold the command back until PendingCmdEvent is signalled, either by the
+ * end of the running flash or by a download slot becoming free.
+ */
 STATIC EFI_STATUS
-AcceptCmdTimerInit (IN UINT64 Size, IN CHAR8 *Data)
+AcceptCmdDefer (IN UINT64 Size, IN CHAR8 *Data)
 {
-  EFI_STATUS Status = EFI_SUCCESS;
-  CmdInfo *AcceptCmdInfo = NULL;
-  EFI_EVENT CmdEvent = NULL;
-
-  AcceptCmdInfo = AllocateZeroPool (sizeof (CmdInfo));
-  if (!AcceptCmdInfo)
-    return EFI_OUT_OF_RESOURCES;
-
-  AcceptCmdInfo->Size = Size;
-  AcceptCmdInfo->Data = Data;
-
-  Status = gBS->CreateEvent (EVT_TIMER | EVT_NOTIFY_SIGNAL, TPL_CALLBACK,
-                             AcceptCmdHandler, AcceptCmdInfo, &CmdEvent);
-
-  if (!EFI_ERROR (Status)) {
-    Status = gBS->SetTimer (CmdEvent, TimerRelative, 100000);
-  }
+  if (!PendingCmdEvent)
+    return EFI_NOT_READY;
 
-  if (EFI_ERROR (Status)) {
-    FreePool (AcceptCmdInfo);
-    AcceptCmdInfo = NULL;
-  }
+  PendingCmd.Size = Size;
+  PendingCmd.Data = Data;
 
-  return Status;
+  return EFI_SUCCESS;
 }
 
 STATIC VOID
 AcceptCmdHandler (IN EFI_EVENT Event, IN VOID *Context)
 {
   CmdInfo *AcceptCmdInfo = Context;
+  CHAR8 *Data = AcceptCmdInfo->Data;
 
-  if (Event) {
-    gBS->SetTimer (Event, TimerCancel, 0);
-    gBS->CloseEvent (Event);
+  if (!Data)
+    return;
+
+  AcceptCmdInfo->Data = NULL;
+  AcceptCmd (AcceptCmdInfo->Size, Data);
+}
+
+/* Whether the flash command in Cmd can be queued behind the running flash.
+ * Only sparse images for partitions larger than a download slot are flashed
+ * in parallel with the next download.
+ */
+STATIC BOOLEAN
+FlashCanQueue (IN CONST CHAR8 *Cmd)
+{
+#ifdef ENABLE_UPDATE_PARTITIONS_CMDS
+  CHAR16 PartitionName[MAX_GPT_NAME_SIZE];
+  CONST CHAR8 *Arg = Cmd + AsciiStrLen ("flash:");
+  sparse_header_t *sparse_header = (sparse_header_t *)mUsbDataBuffer;
+  UINT64 PartitionSize = 0;
+
+  if (IsFlashComplete ||
+      AsciiStrnCmp (Cmd, "flash:", AsciiStrLen ("flash:")) ||
+      AsciiStrLen (Arg) >= MAX_GPT_NAME_SIZE ||
+      AsciiStrStr (Arg, ":") ||
+      sparse_header->magic != SPARSE_HEADER_MAGIC) {
+    return FALSE;
+  }
+
+  AsciiStrToUnicodeStr (Arg, PartitionName);
+  if (!StrnCmp (PartitionName, L"partition", StrLen (L"partition")) ||
+      !StrnCmp (PartitionName, L"avb_custom_key",
+                StrLen (L"avb_custom_key"))) {
+    return FALSE;
+  }
+
+  if (EFI_ERROR (GetFlashPartitionSize (PartitionName,
+                                        ARRAY_SIZE (PartitionName),
+                                        &PartitionSize))) {
+    return FALSE;
+  }
+
+  /* Streamed images are finished in place, not queued */
+  if (SparseStream.Active &&
+      !StrCmp (SparseStream.PartitionName, PartitionName)) {
+    return FALSE;
   }
 
-  AcceptCmd (AcceptCmdInfo->Size, AcceptCmdInfo->Data);
-  FreePool (AcceptCmdInfo);
-  AcceptCmdInfo = NULL;
+  return (PartitionSize > MaxDownLoadSize);
+#else
+  return FALSE;
+#endif
 }
 
 STATIC VOID
@@ -2873,11 +4082,19 @@ AcceptCmd (IN UINT64 Size, IN CHAR8 *Data)
   DEBUG ((EFI_D_INFO, "Handling Cmd: %a\n", Data));
 
   if (!IsDisableParallelDownloadFlash ()) {
-    /* Wait for flash finished before next command */
-    if (AsciiStrnCmp (Data, "download", AsciiStrLen ("download"))) {
+    if (!AsciiStrnCmp (Data, "download", AsciiStrLen ("download"))) {
+      /* Wait for a download slot to be flashed */
+      if (DownloadSlotStall ()) {
+        Status = AcceptCmdDefer (Size, Data);
+        if (Status == EFI_SUCCESS) {
+          return;
+        }
+      }
+    } else if (!FlashCanQueue (Data)) {
+      /* Wait for flash finished before next command */
       StopUsbTimer ();
       if (!IsFlashComplete) {
-        Status = AcceptCmdTimerInit (Size, Data);
+        Status = AcceptCmdDefer (Size, Data);
         if (Status == EFI_SUCCESS) {
           return;
         }
@@ -3199,14 +4416,19 @@ FastbootCommandSetup (IN VOID *Base, IN UINT64 Size)
   UINT32 PartitionCount = 0;
   BOOLEAN MultiSlotBoot = PartitionHasMultiSlot ((CONST CHAR16 *)L"boot");
   MemCardType Type = UNKNOWN;
+  UINT32 Slot;
 
   mDataBuffer = Base;
   mNumDataBytes = Size;
   mFlashNumDataBytes = Size;
-  mUsbDataBuffer = Base;
 
-  mFlashDataBuffer = (CheckRootDeviceType () == NAND) ?
-                           Base : (Base + MaxDownLoadSize);
+  for (Slot = 0; Slot < DownloadSlotCount; Slot++) {
+    DownloadSlots[Slot].Base = (UINT8 *)Base + Slot * Size;
+    DownloadSlots[Slot].State = SLOT_FREE;
+  }
+  DownloadSlot = 0;
+  mUsbDataBuffer = DownloadSlots[0].Base;
+  mFlashDataBuffer = DownloadSlots[DownloadSlotCount - 1].Base;
 
   /* Find all Software Partitions in the User Partition */
   UINT32 i;
@@ -3224,6 +4446,7 @@ FastbootCommandSetup (IN VOID *Base, IN UINT64 Size)
       {"erase:", CmdErase},
       {"set_active", CmdSetActive},
       {"flashing get_unlock_ability", CmdFlashingGetUnlockAbility},
+      {"oem sparse-stream", CmdOemSparseStream},
 #endif
 /*
  *CAUTION(CRITICAL): Enabling these commands will allow changes to bootimage.
@@ -3267,6 +4490,20 @@ FastbootCommandSetup (IN VOID *Base, IN UINT64 Size)
                   sizeof (MaxDownloadSizeStr), "%ld", MaxDownLoadSize);
   FastbootPublishVar ("max-download-size", MaxDownloadSizeStr);
 
+  AsciiSPrint (DownloadSlotCountStr,
+                  sizeof (DownloadSlotCountStr), "%d", DownloadSlotCount);
+  FastbootPublishVar ("download-ring-depth", DownloadSlotCountStr);
+  for (Slot = 0; Slot < DownloadSlotCount; Slot++) {
+    AsciiSPrint (DownloadSlots[Slot].StallsVar,
+                 sizeof (DownloadSlots[Slot].StallsVar),
+                 "download-slot-stalls:%d", Slot);
+    AsciiSPrint (DownloadSlots[Slot].StallsStr,
+                 sizeof (DownloadSlots[Slot].StallsStr), "%d",
+                 DownloadSlots[Slot].Stalls);
+    FastbootPublishVar (DownloadSlots[Slot].StallsVar,
+                        DownloadSlots[Slot].StallsStr);
+  }
+
   if (IsDynamicPartitionSupport ()) {
     FastbootPublishVar ("is-userspace", "no");
   }
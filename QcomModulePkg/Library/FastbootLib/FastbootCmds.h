@@ -43,10 +43,15 @@
 #define ENDPOINT_OUT 0x81
 
 #define MAX_WRITE_SIZE (1024 * 1024)
+/* BlockIo2 writes: request size and number of requests kept in flight */
+#define ASYNC_WRITE_UNIT_SIZE (4 * 1024 * 1024)
+#define ASYNC_WRITE_DEPTH 4
 #define MAX_RSP_SIZE 64
 #define ERASE_BUFF_SIZE 256 * 1024
 #define ERASE_BUFF_BLOCKS 256 * 2
 #define USB_BUFFER_SIZE 1024 * 1024 * 16
+/* Upper bound for a single download transfer, see QueueDownloadXfr */
+#define USB_MAX_XFER_SIZE (64 * 1024 * 1024)
 #define VERSION_STR_LEN 96
 #define FASTBOOT_STRING_MAX_LENGTH 256
 #define FASTBOOT_COMMAND_MAX_LENGTH 64
@@ -76,6 +81,17 @@
 /* 1.5GB */
 #define MAX_BUFFER_SIZE (1610612736)
 
+/* Number of download slots the fastboot buffer is split into when images
+ * are flashed in parallel with the next download.
+ */
+#ifndef FASTBOOT_DOWNLOAD_SLOTS
+#define FASTBOOT_DOWNLOAD_SLOTS 2
+#endif
+#define MAX_DOWNLOAD_SLOTS 8
+#if (FASTBOOT_DOWNLOAD_SLOTS < 1) || (FASTBOOT_DOWNLOAD_SLOTS > MAX_DOWNLOAD_SLOTS)
+#error "FASTBOOT_DOWNLOAD_SLOTS must be between 1 and MAX_DOWNLOAD_SLOTS"
+#endif
+
 typedef enum FsSignature {
   EXT_FS_SIGNATURE = 1,
   F2FS_FS_SIGNATURE,
@@ -90,13 +106,16 @@ struct FastbootCmdDesc {
   fastboot_cmd_fn cb;
 };
 
-/* Fastboot Variable list */
+/* Fastboot Variable list, also chained by name hash for getvar lookups */
 typedef struct _FASTBOOT_VAR {
   struct _FASTBOOT_VAR *next;
+  struct _FASTBOOT_VAR *hnext;
   CONST CHAR8 *name;
   CONST CHAR8 *value;
 } FASTBOOT_VAR;
 
+#define FASTBOOT_VAR_HASH_SIZE 256
+
 /* Partition info fastboot variable */
 struct GetVarPartitionInfo {
   const CHAR8 part_name[MAX_GET_VAR_NAME_SIZE];
@@ -106,6 +125,29 @@ struct GetVarPartitionInfo {
   CHAR8 type_response[MAX_RSP_SIZE];
 };
 
+/* State of a download slot */
+typedef enum {
+  SLOT_FREE = 0,
+  SLOT_QUEUED,
+  SLOT_FLASHING
+} DOWNLOAD_SLOT_STATE;
+
+/* One slot of the download ring */
+typedef struct {
+  UINT8 *Base;
+  DOWNLOAD_SLOT_STATE State;
+  UINT32 Stalls;
+  CHAR8 StallsVar[MAX_GET_VAR_NAME_SIZE];
+  CHAR8 StallsStr[MAX_RSP_SIZE];
+} DOWNLOAD_SLOT;
+
+/* Sparse image waiting in a download slot to be flashed */
+typedef struct {
+  UINT32 Slot;
+  UINT64 Size;
+  CHAR16 PartitionName[MAX_GPT_NAME_SIZE];
+} FLASH_JOB;
+
 /* Fastboot State */
 typedef enum {
   ExpectCmdState,
@@ -127,6 +169,10 @@ typedef struct _FASTBOOT_CMD {
  */
 UINTN GetXfrSize (VOID);
 
+/* Queue the next download transfer into Buffer */
+EFI_STATUS
+QueueDownloadXfr (VOID *Buffer);
+
 /* Registers commands and publishes Variables */
 EFI_STATUS
 FastbootEnvSetup (VOID *xfer_buffer, UINT32 max);
@@ -285,8 +285,7 @@ ProcessBulkXfrCompleteTx (IN USB_DEVICE_TRANSFER_OUTCOME *Uto)
     DEBUG ((EFI_D_VERBOSE, "UsbDeviceTransferStatusCompleteOK\n"));
     /* Just Queue the next recieve, must be a Command */
     if (FastbootCurrentState () == ExpectDataState)
-      Status = Fbd.UsbDeviceProtocol->Send (ENDPOINT_IN, GetXfrSize (),
-                                            FastbootDloadBuffer ());
+      Status = QueueDownloadXfr (FastbootDloadBuffer ());
     else
       Status = Fbd.UsbDeviceProtocol->Send (ENDPOINT_IN, GetXfrSize (),
                                             Fbd.gRxBuffer);
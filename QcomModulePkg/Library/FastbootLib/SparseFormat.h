@@ -52,6 +52,17 @@ typedef struct chunk_header {
  *  For a Fill chunk, it's 4 bytes of the fill data.
  */
 
+/* Fill chunks are written from a replicated pattern buffer of this size */
+#define FILL_BUF_SIZE (4 * 1024 * 1024)
+/* Zero fill runs at least this long are erased instead of written */
+#define FILL_ERASE_MIN_SIZE (1024 * 1024)
+
+typedef enum {
+  FILL_ERASE_UNTESTED = 0, /* Erase not tried yet for this image */
+  FILL_ERASE_ZEROES,       /* Erased blocks were seen to read back as zero */
+  FILL_ERASE_DISABLED      /* Write zeroes instead of erasing */
+} FILL_ERASE_STATE;
+
 typedef struct SparseImgParams {
   UINT32 Chunk;
   UINT32 TotalBlocks;
@@ -62,4 +73,42 @@ typedef struct SparseImgParams {
   UINT64 PartitionSize;
   EFI_BLOCK_IO_PROTOCOL *BlockIo;
   EFI_HANDLE *Handle;
+  /* Pattern buffer shared by all fill chunks of the image */
+  UINT32 *FillBuf;
+  UINT64 FillBufSize;
+  UINT32 FillBufVal;
+  /* Consecutive fill chunks are coalesced into one pending run */
+  UINT32 FillRunStart;
+  UINT64 FillRunBlocks;
+  UINT32 FillRunVal;
+  FILL_ERASE_STATE EraseState;
+  /* CRC-32 of the image data so far, don't care blocks counting as zeroes */
+  UINT32 Crc;
+  /* The CRC libsparse's writer puts in its CRC chunk: it hashes only one
+   * block of each fill chunk and nothing for don't care chunks
+   */
+  UINT32 WriterCrc;
 } SparseImgParam;
+
+/* Streaming sparse flash: chunks are written while the rest of the image is
+ * still being downloaded. Armed with "oem sparse-stream <partition>".
+ */
+#define SPARSE_STREAM_MIN_WRITE (4 * 1024 * 1024)
+
+typedef struct SparseStreamState {
+  BOOLEAN Armed;       /* Stream the next download */
+  BOOLEAN Active;      /* Current download is being streamed */
+  BOOLEAN HeaderDone;  /* Sparse header parsed and validated */
+  BOOLEAN Done;        /* All chunks written */
+  EFI_STATUS Status;   /* First error hit while streaming */
+  CHAR16 PartitionName[MAX_GPT_NAME_SIZE];
+  UINT8 *Base;         /* Download buffer the stream is parsing */
+  UINT64 Parsed;       /* Offset of the first byte not consumed yet */
+  sparse_header_t Header;
+  chunk_header_t RawChunk; /* Raw chunk currently being written */
+  BOOLEAN InRawChunk;
+  UINT64 RawChunkDone; /* Bytes of RawChunk already written */
+  UINT64 BytesWritten;
+  UINT64 StartTime;
+  SparseImgParam Params;
+} SparseStreamState;
@@ -0,0 +1,138 @@
+#!/bin/bash
+
+# Usage: run_tests.sh [OUT] [bench]
+#   OUT: the make output directory holding fastboot_bench and fbimg
+#     (default: ./out). Images are generated under OUT/data and the LUN
+#     files of each session under OUT/luns.
+#   bench: time testdata/bench.fbs at target-like usb and storage
+#     speeds instead of running the tests.
+
+SCRIPT_DIR="$(dirname "$(readlink -f "$0")")"
+OUT="$(readlink -f "${1:-${SCRIPT_DIR}/out}")"
+DATA="${OUT}/data"
+LUNS="${OUT}/luns"
+FBIMG="${OUT}/fbimg"
+BENCH="${OUT}/fastboot_bench"
+
+alert() {
+  echo "$*" >&2
+}
+
+die() {
+  echo "ERROR: $@"
+  exit 1
+}
+
+# Images used by testdata/*.fbs, regenerated when fbimg or this list changes
+gen_data() {
+  if [ "${DATA}/.stamp" -nt "${FBIMG}" ] &&
+     [ "${DATA}/.stamp" -nt "${SCRIPT_DIR}/run_tests.sh" ]; then
+    return
+  fi
+
+  rm -rf "${DATA}"
+  mkdir -p "${DATA}"
+  (
+  cd "${DATA}"
+  set -e
+  "${FBIMG}" gen raw_4m.img rand:4M
+  "${FBIMG}" gen raw_1m.img rand:1M
+  "${FBIMG}" gen raw_odd.img rand:3000001
+  "${FBIMG}" gen raw_odd_small.img rand:300001
+  "${FBIMG}" gen raw_100m.img zero:100M
+  "${FBIMG}" gen zero_4m.img zero:4M
+  "${FBIMG}" gen zero_64m.img zero:64M
+  "${FBIMG}" gen gpt0.img rand:24K
+  "${FBIMG}" gen gpt1.img rand:24K
+  "${FBIMG}" gen sparse.raw rand:1M zero:20M fill:deadbeef:8M rand:300K \
+      zero:30M fill:00ff00ff:4K rand:5000
+  "${FBIMG}" sparse sparse.raw sparse.simg
+  "${FBIMG}" sparse -s sparse.raw sparse_holes.simg
+  "${FBIMG}" gen sparse_small.raw rand:100K fill:01020304:2M rand:1
+  "${FBIMG}" sparse -b 8192 sparse_small.raw sparse_small.simg
+  "${FBIMG}" gen sparse_crc.raw rand:100K fill:01020304:2M zero:1M rand:1
+  "${FBIMG}" sparse -s -c image sparse_crc.raw sparse_crc_image.simg
+  "${FBIMG}" sparse -s -c libsparse sparse_crc.raw sparse_crc_libsparse.simg
+  "${FBIMG}" sparse -s -c bad sparse_crc.raw sparse_crc_bad.simg
+  "${FBIMG}" gen large_a.raw rand:30M zero:60M fill:12345678:40M rand:20M
+  "${FBIMG}" sparse large_a.raw large_a.simg
+  "${FBIMG}" gen large_b.raw rand:40M fill:0:100M rand:10M
+  "${FBIMG}" sparse -s large_b.raw large_b.simg
+  "${FBIMG}" gen large_c.raw zero:64M rand:50M
+  "${FBIMG}" sparse -s large_c.raw large_c.simg
+  "${FBIMG}" sparse -s -c bad large_c.raw large_c_bad.simg
+  "${FBIMG}" meta meta.img xbl:raw_1m.img aop:raw_odd_small.img
+  touch .stamp
+  ) || die "Failed to generate test images"
+}
+
+# Usage: run_test_case <script> <description> [fastboot_bench options]
+run_test_case() {
+  local script="$1"
+  local description="$2"
+  shift 2
+
+  alert "${description}"
+  "${BENCH}" -l "${SCRIPT_DIR}/testdata/layout.txt" -d "${DATA}" \
+      -o "${LUNS}" "$@" "${SCRIPT_DIR}/testdata/${script}" >&2 ||
+    die "Test case: ${script} $* failed!!"
+}
+
+# Usage: run_bench <description> [fastboot_bench options]
+run_bench() {
+  local description="$1"
+  shift
+
+  alert "${description}"
+  "${BENCH}" -l "${SCRIPT_DIR}/testdata/layout.txt" -d "${DATA}" \
+      -o "${LUNS}" -n 3 "$@" "${SCRIPT_DIR}/testdata/bench.fbs" \
+      2>/dev/null | tail -n 1
+  [ "${PIPESTATUS[0]}" = 0 ] || die "Benchmark: $* failed!!"
+}
+
+bench() {
+  alert "========== Benchmarking FastbootLib =========="
+
+  run_bench "USB 3.0, UFS 3.1" -b 350 -w 1200
+  run_bench "USB 3.0, UFS 3.1, BlockIo2" -b 350 -w 1200 -a
+  run_bench "USB 2.0, UFS 2.1" -b 40 -w 400
+  run_bench "USB 2.0, UFS 2.1, BlockIo2" -b 40 -w 400 -a
+  run_bench "USB 3.0, eMMC" -b 350 -w 150
+  run_bench "USB 3.0, eMMC, BlockIo2" -b 350 -w 150 -a
+}
+
+main() {
+  if [ ! -x "${BENCH}" ] || [ ! -x "${FBIMG}" ]; then
+    die "Run make in ${SCRIPT_DIR} yet?"
+  fi
+
+  gen_data
+  mkdir -p "${LUNS}"
+
+  if [ "$2" = "bench" ]; then
+    bench
+    rm -rf "${LUNS}"
+    return
+  fi
+
+  alert "========== Running Tests of FastbootLib =========="
+
+  run_test_case raw.fbs "Flash raw images"
+  run_test_case sparse.fbs "Flash sparse images"
+  run_test_case sparse.fbs "Flash sparse images through BlockIo2" -a
+  run_test_case sparse_stream.fbs "Stream sparse images while downloading"
+  run_test_case sparse_crc.fbs "Check the CRC chunks of sparse images"
+  run_test_case meta.fbs "Flash a meta image"
+  run_test_case gpt.fbs "Flash partition tables"
+  run_test_case erase.fbs "Erase partitions"
+  run_test_case parallel.fbs "Flash large sparse images in parallel"
+  run_test_case parallel.fbs "Flash in parallel with slow storage" -w 400
+  run_test_case parallel.fbs "Flash in parallel through BlockIo2" -a -w 400
+  run_test_case parallel.fbs "Fall back to smaller usb transfers" \
+      -t 16777216
+
+  rm -rf "${LUNS}"
+  alert "========== All tests passed =========="
+}
+
+main "$@"
@@ -0,0 +1,35 @@
+/* Host stand-in for the AutoGen.h the edk2 build generates for
+ * FastbootLib and LinuxLoaderLib.c: GUIDs from the package declarations
+ * and the PCDs they read.
+ */
+
+#ifndef _FASTBOOT_TEST_AUTOGEN_H_
+#define _FASTBOOT_TEST_AUTOGEN_H_
+
+#include <Base.h>
+#include <Uefi.h>
+#include <Library/PcdLib.h>
+
+extern EFI_GUID gQcomTokenSpaceGuid;
+extern EFI_GUID gBlockIoRefreshGuid;
+extern EFI_GUID gEfiBlockIoProtocolGuid;
+extern EFI_GUID gEfiBlockIo2ProtocolGuid;
+extern EFI_GUID gEfiDevicePathProtocolGuid;
+extern EFI_GUID gEfiLoadedImageProtocolGuid;
+extern EFI_GUID gEfiSimpleFileSystemProtocolGuid;
+extern EFI_GUID gEfiPartitionTypeGuid;
+extern EFI_GUID gEfiPartitionRecordGuid;
+extern EFI_GUID gEfiEraseBlockProtocolGuid;
+extern EFI_GUID gEfiUbiFlasherProtocolGuid;
+extern EFI_GUID gQcomDisplayUtilsProtocolGuid;
+extern EFI_GUID gEfiNandPartiGuidProtocolGuid;
+extern EFI_GUID gEfiQcomVerifiedBootProtocolGuid;
+extern EFI_GUID gQcomMdtpProtocolGuid;
+
+#define _PCD_GET_MODE_BOOL_EnableMdtpSupport FALSE
+#define _PCD_GET_MODE_BOOL_EnableBatteryVoltageCheck TRUE
+#define _PCD_VALUE_EnableBatteryVoltageCheck TRUE
+#define _PCD_GET_MODE_32_PcdMaximumAsciiStringLength 0
+#define _PCD_GET_MODE_32_PcdMaximumUnicodeStringLength 0
+
+#endif
@@ -0,0 +1,499 @@
+/* File-backed storage for the harness. Each LUN is a host file, and each
+ * partition of HostConfig gets a handle with the block io, block io2,
+ * erase and partition record protocols, like the partition driver
+ * publishes on target. The partition table side of BootLib is stubbed
+ * here on top of these handles.
+ *
+ * With HostConfig.StorageBytesPerSec set, a write keeps the device busy
+ * for the time it takes at that rate. Synchronous writes wait for it with
+ * timers running, block io2 writes complete in the background.
+ */
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/LinuxLoaderLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/PartitionTableUpdate.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Protocol/BlockIo.h>
+#include <Protocol/BlockIo2.h>
+#include <Protocol/EFIEraseBlock.h>
+
+#include "HostOs.h"
+#include "UefiStubs.h"
+
+#define ASYNC_QUEUE_SIZE 16
+
+typedef struct {
+  EFI_BLOCK_IO_PROTOCOL BlockIo;
+  EFI_BLOCK_IO2_PROTOCOL BlockIo2;
+  EFI_ERASE_BLOCK_PROTOCOL Erase;
+  EFI_BLOCK_IO_MEDIA Media;
+  EFI_PARTITION_ENTRY Entry;
+  HOST_LUN *Lun;
+  UINT64 FirstBlock;
+} STUB_HANDLE;
+
+typedef struct {
+  EFI_BLOCK_IO2_TOKEN *Token;
+  UINT64 DoneUs;
+} ASYNC_REQUEST;
+
+struct StoragePartInfo Ptable[MAX_LUNS];
+struct PartitionEntry PtnEntries[MAX_NUM_PARTITIONS];
+
+STATIC STUB_HANDLE Handles[HOST_MAX_PARTITIONS];
+STATIC HandleInfo PtnHandles[HOST_MAX_PARTITIONS];
+STATIC UINT32 PartitionCount;
+STATIC UINT64 StorageFreeUs;
+STATIC ASYNC_REQUEST AsyncQueue[ASYNC_QUEUE_SIZE];
+STATIC UINT32 AsyncHead;
+STATIC UINT32 AsyncCount;
+
+/* Time at which the storage is done with Size more bytes */
+STATIC UINT64
+StorageBusy (UINT64 Size)
+{
+  UINT64 Now = HostTimeUs ();
+
+  if (!HostConfig.StorageBytesPerSec) {
+    return Now;
+  }
+
+  if (StorageFreeUs < Now) {
+    StorageFreeUs = Now;
+  }
+  StorageFreeUs += (Size * 1000000) / HostConfig.StorageBytesPerSec;
+  return StorageFreeUs;
+}
+
+STATIC EFI_STATUS
+CheckRange (STUB_HANDLE *Handle, EFI_LBA Lba, UINTN BufferSize)
+{
+  UINT32 BlockSize = Handle->Media.BlockSize;
+
+  if (BufferSize % BlockSize) {
+    return EFI_BAD_BUFFER_SIZE;
+  }
+  if (Lba > Handle->Media.LastBlock ||
+      BufferSize / BlockSize > Handle->Media.LastBlock + 1 - Lba) {
+    return EFI_INVALID_PARAMETER;
+  }
+  return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS
+DoIo (STUB_HANDLE *Handle, BOOLEAN Write, EFI_LBA Lba, UINTN BufferSize,
+      VOID *Buffer)
+{
+  EFI_STATUS Status;
+  UINT64 Offset;
+  INT32 Ret;
+
+  Status = CheckRange (Handle, Lba, BufferSize);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((EFI_D_ERROR, "Block io stub: %s lba %lld size %lld: %r\n",
+            Handle->Entry.PartitionName, Lba, (UINT64)BufferSize, Status));
+    return Status;
+  }
+
+  Offset = (Handle->FirstBlock + Lba) * Handle->Media.BlockSize;
+  if (Write) {
+    Ret = HostFileWrite (Handle->Lun->Fd, Buffer, BufferSize, Offset);
+  } else {
+    Ret = HostFileRead (Handle->Lun->Fd, Buffer, BufferSize, Offset);
+  }
+  return Ret ? EFI_DEVICE_ERROR : EFI_SUCCESS;
+}
+
+STATIC VOID
+WaitStorage (UINT64 DoneUs)
+{
+  do {
+    HostTimerTick ();
+  } while (HostTimeUs () < DoneUs);
+}
+
+STATIC EFI_STATUS EFIAPI
+StubReset (IN EFI_BLOCK_IO_PROTOCOL *This, IN BOOLEAN ExtendedVerification)
+{
+  return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI
+StubReadBlocks (IN EFI_BLOCK_IO_PROTOCOL *This,
+                IN UINT32 MediaId,
+                IN EFI_LBA Lba,
+                IN UINTN BufferSize,
+                OUT VOID *Buffer)
+{
+  STUB_HANDLE *Handle = BASE_CR (This, STUB_HANDLE, BlockIo);
+
+  return DoIo (Handle, FALSE, Lba, BufferSize, Buffer);
+}
+
+STATIC EFI_STATUS EFIAPI
+StubWriteBlocks (IN EFI_BLOCK_IO_PROTOCOL *This,
+                 IN UINT32 MediaId,
+                 IN EFI_LBA Lba,
+                 IN UINTN BufferSize,
+                 IN VOID *Buffer)
+{
+  STUB_HANDLE *Handle = BASE_CR (This, STUB_HANDLE, BlockIo);
+  EFI_STATUS Status;
+
+  Status = DoIo (Handle, TRUE, Lba, BufferSize, Buffer);
+  WaitStorage (StorageBusy (BufferSize));
+  return Status;
+}
+
+STATIC EFI_STATUS EFIAPI
+StubFlushBlocks (IN EFI_BLOCK_IO_PROTOCOL *This)
+{
+  return EFI_SUCCESS;
+}
+
+/* Complete the block io2 requests the storage is done with */
+VOID
+BlockIoStubPoll (VOID)
+{
+  ASYNC_REQUEST *Request;
+  UINT64 Now = HostTimeUs ();
+
+  while (AsyncCount) {
+    Request = &AsyncQueue[AsyncHead];
+    if (Request->DoneUs > Now) {
+      break;
+    }
+    gBS->SignalEvent (Request->Token->Event);
+    AsyncHead = (AsyncHead + 1) % ASYNC_QUEUE_SIZE;
+    AsyncCount--;
+  }
+}
+
+STATIC EFI_STATUS
+QueueAsync (EFI_BLOCK_IO2_TOKEN *Token, EFI_STATUS Status, UINT64 DoneUs)
+{
+  if (!Token ||
+      !Token->Event) {
+    WaitStorage (DoneUs);
+    return Status;
+  }
+
+  /* The queue depth of the device */
+  while (AsyncCount == ASYNC_QUEUE_SIZE) {
+    HostTimerTick ();
+  }
+
+  Token->TransactionStatus = Status;
+  AsyncQueue[(AsyncHead + AsyncCount) % ASYNC_QUEUE_SIZE].Token = Token;
+  AsyncQueue[(AsyncHead + AsyncCount) % ASYNC_QUEUE_SIZE].DoneUs = DoneUs;
+  AsyncCount++;
+  return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI
+StubReset2 (IN EFI_BLOCK_IO2_PROTOCOL *This, IN BOOLEAN ExtendedVerification)
+{
+  return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI
+StubReadBlocksEx (IN EFI_BLOCK_IO2_PROTOCOL *This,
+                  IN UINT32 MediaId,
+                  IN EFI_LBA Lba,
+                  IN OUT EFI_BLOCK_IO2_TOKEN *Token,
+                  IN UINTN BufferSize,
+                  OUT VOID *Buffer)
+{
+  STUB_HANDLE *Handle = BASE_CR (This, STUB_HANDLE, BlockIo2);
+  EFI_STATUS Status;
+
+  Status = DoIo (Handle, FALSE, Lba, BufferSize, Buffer);
+  return QueueAsync (Token, Status, HostTimeUs ());
+}
+
+STATIC EFI_STATUS EFIAPI
+StubWriteBlocksEx (IN EFI_BLOCK_IO2_PROTOCOL *This,
+                   IN UINT32 MediaId,
+                   IN EFI_LBA Lba,
+                   IN OUT EFI_BLOCK_IO2_TOKEN *Token,
+                   IN UINTN BufferSize,
+                   IN VOID *Buffer)
+{
+  STUB_HANDLE *Handle = BASE_CR (This, STUB_HANDLE, BlockIo2);
+  EFI_STATUS Status;
+
+  Status = DoIo (Handle, TRUE, Lba, BufferSize, Buffer);
+  return QueueAsync (Token, Status, StorageBusy (BufferSize));
+}
+
+STATIC EFI_STATUS EFIAPI
+StubFlushBlocksEx (IN EFI_BLOCK_IO2_PROTOCOL *This,
+                   IN OUT EFI_BLOCK_IO2_TOKEN *Token)
+{
+  return QueueAsync (Token, EFI_SUCCESS, HostTimeUs ());
+}
+
+STATIC EFI_STATUS EFIAPI
+StubEraseBlocks (IN EFI_BLOCK_IO_PROTOCOL *This,
+                 IN UINT32 MediaId,
+                 IN EFI_LBA Lba,
+                 IN OUT EFI_ERASE_BLOCK_TOKEN *Token,
+                 IN UINTN Size)
+{
+  STUB_HANDLE *Handle = BASE_CR (This, STUB_HANDLE, BlockIo);
+  UINT64 Granularity = (UINT64)Handle->Erase.EraseLengthGranularity *
+                       Handle->Media.BlockSize;
+  EFI_STATUS Status;
+
+  Status = CheckRange (Handle, Lba, Size);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  if (((Handle->FirstBlock + Lba) * Handle->Media.BlockSize) % Granularity ||
+      Size % Granularity) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (HostFileZero (Handle->Lun->Fd,
+                    (Handle->FirstBlock + Lba) * Handle->Media.BlockSize,
+                    Size)) {
+    return EFI_DEVICE_ERROR;
+  }
+  if (Token) {
+    Token->TransactionStatus = EFI_SUCCESS;
+  }
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+BlockIoStubHandleProtocol (IN EFI_HANDLE Handle,
+                           IN EFI_GUID *Protocol,
+                           OUT VOID **Interface)
+{
+  STUB_HANDLE *Stub = (STUB_HANDLE *)Handle;
+
+  if (Stub < Handles ||
+      Stub >= Handles + PartitionCount) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (CompareGuid (Protocol, &gEfiBlockIoProtocolGuid)) {
+    *Interface = &Stub->BlockIo;
+  } else if (CompareGuid (Protocol, &gEfiBlockIo2ProtocolGuid) &&
+             HostConfig.BlockIo2) {
+    *Interface = &Stub->BlockIo2;
+  } else if (CompareGuid (Protocol, &gEfiEraseBlockProtocolGuid) &&
+             Stub->Lun->EraseBlocks) {
+    *Interface = &Stub->Erase;
+  } else if (CompareGuid (Protocol, &gEfiPartitionRecordGuid)) {
+    *Interface = &Stub->Entry;
+  } else {
+    return EFI_UNSUPPORTED;
+  }
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+BlockIoStubInit (VOID)
+{
+  HOST_PARTITION *Part;
+  HOST_LUN *Lun;
+  STUB_HANDLE *Stub;
+  UINT32 Idx;
+
+  PartitionCount = 0;
+  for (Idx = 0; Idx < HostConfig.PartitionCount; Idx++) {
+    Part = &HostConfig.Partitions[Idx];
+    Lun = &HostConfig.Luns[Part->Lun];
+    Stub = &Handles[Idx];
+    SetMem (Stub, sizeof (*Stub), 0);
+
+    Stub->Lun = Lun;
+    Stub->FirstBlock = Part->FirstBlock;
+    Stub->Media.MediaId = Part->Lun;
+    Stub->Media.MediaPresent = TRUE;
+    Stub->Media.LogicalPartition = TRUE;
+    Stub->Media.BlockSize = Lun->BlockSize;
+    Stub->Media.IoAlign = 0;
+    Stub->Media.LastBlock = Part->Blocks - 1;
+
+    Stub->BlockIo.Revision = EFI_BLOCK_IO_PROTOCOL_REVISION3;
+    Stub->BlockIo.Media = &Stub->Media;
+    Stub->BlockIo.Reset = StubReset;
+    Stub->BlockIo.ReadBlocks = StubReadBlocks;
+    Stub->BlockIo.WriteBlocks = StubWriteBlocks;
+    Stub->BlockIo.FlushBlocks = StubFlushBlocks;
+
+    Stub->BlockIo2.Media = &Stub->Media;
+    Stub->BlockIo2.Reset = StubReset2;
+    Stub->BlockIo2.ReadBlocksEx = StubReadBlocksEx;
+    Stub->BlockIo2.WriteBlocksEx = StubWriteBlocksEx;
+    Stub->BlockIo2.FlushBlocksEx = StubFlushBlocksEx;
+
+    Stub->Erase.Revision = EFI_ERASE_BLOCK_PROTOCOL_REVISION;
+    Stub->Erase.EraseLengthGranularity = Lun->EraseBlocks;
+    Stub->Erase.EraseBlocks = StubEraseBlocks;
+
+    Stub->Entry.StartingLBA = Part->FirstBlock;
+    Stub->Entry.EndingLBA = Part->FirstBlock + Part->Blocks - 1;
+    AsciiStrToUnicodeStr (Part->Name, Stub->Entry.PartitionName);
+    PartitionCount++;
+  }
+
+  return EnumeratePartitions ();
+}
+
+/* Partition table side of BootLib */
+
+EFI_STATUS
+EnumeratePartitions (VOID)
+{
+  HandleInfo *Info;
+  UINT32 Lun;
+  UINT32 Idx;
+
+  SetMem (Ptable, sizeof (Ptable), 0);
+  for (Idx = 0; Idx < PartitionCount; Idx++) {
+    Lun = HostConfig.Partitions[Idx].Lun;
+    Info = &Ptable[Lun].HandleInfoList[Ptable[Lun].MaxHandles++];
+    Info->Handle = (EFI_HANDLE *)&Handles[Idx];
+    Info->BlkIo = &Handles[Idx].BlockIo;
+  }
+
+  UpdatePartitionEntries ();
+  return EFI_SUCCESS;
+}
+
+VOID
+UpdatePartitionEntries (VOID)
+{
+  UINT32 Idx;
+
+  SetMem (PtnEntries, sizeof (PtnEntries), 0);
+  for (Idx = 0; Idx < PartitionCount; Idx++) {
+    CopyMem (&PtnEntries[Idx].PartEntry, &Handles[Idx].Entry,
+             sizeof (EFI_PARTITION_ENTRY));
+    PtnEntries[Idx].lun = HostConfig.Partitions[Idx].Lun;
+    PtnHandles[Idx].Handle = (EFI_HANDLE *)&Handles[Idx];
+    PtnHandles[Idx].BlkIo = &Handles[Idx].BlockIo;
+  }
+}
+
+VOID
+UpdatePartitionAttributes (UINT32 UpdateType)
+{
+}
+
+VOID
+FindPtnActiveSlot (VOID)
+{
+}
+
+UINT32
+GetMaxLuns (VOID)
+{
+  return HostConfig.LunCount;
+}
+
+VOID
+GetPartitionCount (UINT32 *Val)
+{
+  *Val = PartitionCount;
+}
+
+INT32
+GetPartitionIndex (CHAR16 *Pname)
+{
+  UINT32 Idx;
+
+  for (Idx = 0; Idx < PartitionCount; Idx++) {
+    if (!StrCmp (PtnEntries[Idx].PartEntry.PartitionName, Pname)) {
+      return Idx;
+    }
+  }
+  return INVALID_PTN;
+}
+
+INT32
+GetPartitionIndexWithSuffix (CONST CHAR16 *Pname, CONST CHAR16 *Suffix)
+{
+  CHAR16 Name[MAX_GPT_NAME_SIZE];
+
+  if (StrLen (Pname) + StrLen (Suffix) >= ARRAY_SIZE (Name)) {
+    return INVALID_PTN;
+  }
+  StrCpyS (Name, ARRAY_SIZE (Name), Pname);
+  StrCatS (Name, ARRAY_SIZE (Name), Suffix);
+  return GetPartitionIndex (Name);
+}
+
+EFI_STATUS
+GetPartitionHandleInfo (CONST CHAR16 *Pname, HandleInfo **Info)
+{
+  INT32 Index = GetPartitionIndex ((CHAR16 *)Pname);
+
+  if (Index == INVALID_PTN) {
+    return EFI_NOT_FOUND;
+  }
+  *Info = &PtnHandles[Index];
+  return EFI_SUCCESS;
+}
+
+BOOLEAN
+PartitionHasMultiSlot (CONST CHAR16 *Pname)
+{
+  return FALSE;
+}
+
+Slot
+GetCurrentSlotSuffix (VOID)
+{
+  Slot Empty = {{0}};
+
+  return Empty;
+}
+
+EFI_STATUS
+SetActiveSlot (Slot *NewSlot, BOOLEAN ResetSuccessBit)
+{
+  return EFI_UNSUPPORTED;
+}
+
+EFI_STATUS
+ClearUnbootable (VOID)
+{
+  return EFI_SUCCESS;
+}
+
+/* The GPT image is written to the start of the LUN as is. The layout of
+ * the harness is fixed, so the partitions are not re-read from it.
+ */
+EFI_STATUS
+UpdatePartitionTable (UINT8 *GptImage,
+                      UINT32 Sz,
+                      INT32 Lun,
+                      struct StoragePartInfo *Ptable)
+{
+  HOST_LUN *Target;
+
+  if (Lun < 0) {
+    Lun = 0;
+  }
+  if ((UINT32)Lun >= HostConfig.LunCount) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Target = &HostConfig.Luns[Lun];
+  if (Sz > Target->Blocks * Target->BlockSize) {
+    return EFI_VOLUME_FULL;
+  }
+  if (HostFileWrite (Target->Fd, GptImage, Sz, 0)) {
+    return EFI_DEVICE_ERROR;
+  }
+  WaitStorage (StorageBusy (Sz));
+  return EFI_SUCCESS;
+}
@@ -0,0 +1,289 @@
+/* Stand-ins for the BootLib, board and verified boot services FastbootLib
+ * links against. The device reports itself as an unlocked UFS target with
+ * no A/B slots, which is what the flash paths under test expect.
+ */
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/Board.h>
+#include <Library/BootLinux.h>
+#include <Library/BootStats.h>
+#include <Library/DebugLib.h>
+#include <Library/DeviceInfo.h>
+#include <Library/DevicePathLib.h>
+#include <Library/EfiFileLib.h>
+#include <Library/FastbootMenu.h>
+#include <Library/MenuKeysDetection.h>
+#include <Library/ShutdownServices.h>
+#include <Library/UpdateCmdLine.h>
+#include <Library/VerifiedBoot.h>
+
+#include "FastbootCmds.h"
+#include "FastbootMain.h"
+#include "HostOs.h"
+#include "UefiStubs.h"
+
+STATIC DeviceInfo DevInfo = {
+    .magic = DEVICE_MAGIC,
+    .is_unlocked = TRUE,
+    .is_unlock_critical = TRUE,
+    .is_charger_screen_enabled = FALSE,
+    .bootloader_version = "host",
+    .radio_version = "host",
+    .verity_mode = TRUE,
+};
+
+VOID
+HostRunFastboot (VOID)
+{
+  EFI_STATUS Status;
+
+  Status = BlockIoStubInit ();
+  if (Status != EFI_SUCCESS) {
+    DEBUG ((EFI_D_ERROR, "Failed to set up the partitions: %r\n", Status));
+    HostExit (2);
+  }
+
+  /* Only returns if the usb device could not be started */
+  Status = FastbootInitialize ();
+  DEBUG ((EFI_D_ERROR, "Fastboot exited: %r\n", Status));
+  HostExit (2);
+}
+
+/* Board */
+EFI_STATUS
+BoardSerialNum (CHAR8 *StrSerialNum, UINT32 Len)
+{
+  AsciiStrnCpy (StrSerialNum, "0123456789abcdef", Len - 1);
+  StrSerialNum[Len - 1] = '\0';
+  return EFI_SUCCESS;
+}
+
+VOID
+BoardHwPlatformName (CHAR8 *StrHwPlatform, UINT32 Len)
+{
+  AsciiStrnCpy (StrHwPlatform, "host", Len - 1);
+  StrHwPlatform[Len - 1] = '\0';
+}
+
+EFIChipInfoVersionType
+BoardPlatformChipVersion (VOID)
+{
+  return 0x10000;
+}
+
+VOID
+GetRootDeviceType (CHAR8 *StrDeviceType, UINT32 Len)
+{
+  AsciiStrnCpy (StrDeviceType, "UFS", Len - 1);
+  StrDeviceType[Len - 1] = '\0';
+}
+
+MemCardType
+CheckRootDeviceType (VOID)
+{
+  return UFS;
+}
+
+EFI_STATUS
+UfsGetSetBootLun (UINT32 *UfsBootlun, BOOLEAN IsGet)
+{
+  if (IsGet) {
+    *UfsBootlun = 1;
+  }
+  return EFI_SUCCESS;
+}
+
+VOID
+GetPageSize (UINT32 *PageSize)
+{
+  *PageSize = 4096;
+}
+
+/* Device info */
+VOID
+GetDevInfo (DeviceInfo **DevinfoPtr)
+{
+  *DevinfoPtr = &DevInfo;
+}
+
+EFI_STATUS
+UpdateDevInfo (CHAR16 *Pname, CHAR8 *ImgVersion)
+{
+  return EFI_SUCCESS;
+}
+
+BOOLEAN
+IsUnlocked (VOID)
+{
+  return DevInfo.is_unlocked;
+}
+
+BOOLEAN
+IsUnlockCritical (VOID)
+{
+  return DevInfo.is_unlock_critical;
+}
+
+BOOLEAN
+IsEnforcing (VOID)
+{
+  return DevInfo.verity_mode;
+}
+
+BOOLEAN
+IsChargingScreenEnable (VOID)
+{
+  return DevInfo.is_charger_screen_enabled;
+}
+
+EFI_STATUS
+EnableChargingScreen (BOOLEAN IsEnabled)
+{
+  DevInfo.is_charger_screen_enabled = IsEnabled;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EnableEnforcingMode (BOOLEAN IsEnabled)
+{
+  DevInfo.verity_mode = IsEnabled;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+SetDeviceUnlock (UINT32 Type, BOOLEAN State)
+{
+  if (Type == UNLOCK_CRITICAL) {
+    DevInfo.is_unlock_critical = State;
+  } else {
+    DevInfo.is_unlocked = State;
+  }
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+StoreUserKey (CHAR8 *UserKey, UINT32 UserKeySize)
+{
+  if (UserKeySize > sizeof (DevInfo.user_public_key)) {
+    return EFI_BUFFER_TOO_SMALL;
+  }
+  CopyMem (DevInfo.user_public_key, UserKey, UserKeySize);
+  DevInfo.user_public_key_length = UserKeySize;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EraseUserKey (VOID)
+{
+  ZeroMem (DevInfo.user_public_key, sizeof (DevInfo.user_public_key));
+  DevInfo.user_public_key_length = 0;
+  return EFI_SUCCESS;
+}
+
+/* Boot and verified boot. Booting ends the session. */
+EFI_STATUS
+BootLinux (BootInfo *Info)
+{
+  DEBUG ((EFI_D_ERROR, "Boot requested\n"));
+  HostSessionDone ();
+  return EFI_UNSUPPORTED;
+}
+
+EFI_STATUS
+LoadImageAndAuth (BootInfo *Info)
+{
+  return EFI_UNSUPPORTED;
+}
+
+BOOLEAN
+VerifiedBootEnbled ()
+{
+  return FALSE;
+}
+
+UINT32
+GetAVBVersion ()
+{
+  return 2;
+}
+
+BOOLEAN
+TargetBuildVariantUser (VOID)
+{
+  return FALSE;
+}
+
+BOOLEAN
+IsDynamicPartitionSupport (VOID)
+{
+  return FALSE;
+}
+
+BOOLEAN
+TargetBatterySocOk (UINT32 *BatteryVoltage)
+{
+  *BatteryVoltage = HostConfig.BatteryLow ? 3200 : 3800;
+  return !HostConfig.BatteryLow;
+}
+
+VOID
+RebootDevice (UINT8 RebootReason)
+{
+  HostSessionDone ();
+}
+
+void
+BootStatsSetTimeStamp (BS_ENTRY BootStatId)
+{
+}
+
+/* Menus */
+VOID
+DisplayFastbootMenu (VOID)
+{
+}
+
+VOID
+ExitMenuKeysDetection (VOID)
+{
+}
+
+/* LinuxLoaderLib's file loader is not used by fastboot */
+EFI_OPEN_FILE *
+EfiOpen (IN CHAR8 *PathName,
+         IN CONST UINT64 OpenMode,
+         IN CONST EFI_SECTION_TYPE SectionType)
+{
+  return NULL;
+}
+
+EFI_STATUS
+EfiClose (IN EFI_OPEN_FILE *Stream)
+{
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EfiReadAllocatePool (IN EFI_OPEN_FILE *Stream,
+                     OUT VOID **Buffer,
+                     OUT UINTN *BufferSize)
+{
+  return EFI_UNSUPPORTED;
+}
+
+/* The partition handles have no device path */
+BOOLEAN
+EFIAPI
+IsDevicePathEnd (IN CONST VOID *Node)
+{
+  return TRUE;
+}
+
+EFI_DEVICE_PATH_PROTOCOL *
+EFIAPI
+NextDevicePathNode (IN CONST VOID *Node)
+{
+  return (EFI_DEVICE_PATH_PROTOCOL *)Node;
+}
@@ -0,0 +1,505 @@
+/* Replays a fastboot session script against FastbootLib running on
+ * file-backed storage and reports the time and throughput of each step.
+ *
+ * Usage: fastboot_bench [options] SCRIPT
+ *   -l LAYOUT  storage layout (default: layout.txt next to SCRIPT)
+ *   -d DIR     directory the image paths of SCRIPT are relative to
+ *   -o DIR     directory for the LUN files (default: .)
+ *   -m MB      memory the device reports as free (default: 256)
+ *   -t BYTES   largest usb transfer, at least 16 MiB (default: 64 MiB)
+ *   -b MB/s    simulated usb throughput (default: unlimited)
+ *   -w MB/s    simulated storage write throughput (default: unlimited)
+ *   -n COUNT   replay the script COUNT times (default: 1)
+ *   -a         publish BlockIo2 on the partition handles
+ *   -v         firmware log level, repeat for more
+ *
+ * Layout lines:
+ *   lun INDEX BLOCK_SIZE ERASE_BLOCKS SIZE_MB
+ *   part NAME LUN SIZE_KB
+ * Partitions are laid out in order from 1 MiB into their LUN, the space
+ * before that is left for the partition table.
+ *
+ * Script lines, a leading '!' expects the step to fail:
+ *   download FILE
+ *   flash PARTITION FILE     download FILE, then flash:PARTITION
+ *   erase PARTITION
+ *   getvar NAME [VALUE]
+ *   oem ARGS...
+ *   cmd COMMAND              any other command, sent as is
+ *   verify PARTITION FILE    compare PARTITION (or lun:N) with FILE
+ *   battery low|ok           battery level the next steps see
+ */
+
+#include <errno.h>
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "HostOs.h"
+
+#define MAX_STEPS 256
+#define MAX_IMAGES 64
+#define LUN_RESERVED (1024 * 1024ULL)
+
+typedef struct {
+  char *Path;
+  unsigned char *Data;
+  unsigned long long Size;
+} IMAGE;
+
+static HOST_STEP Steps[MAX_STEPS];
+static unsigned int StepCount;
+static unsigned int NextStep;
+static unsigned int Iterations = 1;
+static unsigned int Iteration;
+static unsigned int Failures;
+static int Aborted;
+static unsigned long long SessionStartUs;
+static unsigned long long DownloadedBytes;
+
+static IMAGE Images[MAX_IMAGES];
+static unsigned int ImageCount;
+
+static const char *ScriptPath;
+static const char *ScriptName;
+
+static void Die (const char *Fmt, const char *Arg)
+{
+  fprintf (stderr, "fastboot_bench: ");
+  fprintf (stderr, Fmt, Arg);
+  fprintf (stderr, "\n");
+  exit (2);
+}
+
+static IMAGE *LoadImage (const char *Dir, const char *Name)
+{
+  char Path[4096];
+  IMAGE *Image;
+  long long Size;
+  unsigned int Index;
+  int Fd;
+
+  snprintf (Path, sizeof (Path), "%s/%s", Dir, Name);
+  for (Index = 0; Index < ImageCount; Index++) {
+    if (!strcmp (Images[Index].Path, Path)) {
+      return &Images[Index];
+    }
+  }
+
+  if (ImageCount == MAX_IMAGES) {
+    Die ("too many images", "");
+  }
+
+  Fd = HostFileOpen (Path, 0);
+  if (Fd < 0) {
+    Die ("cannot open %s", Path);
+  }
+  Size = HostFileSize (Fd);
+  Image = &Images[ImageCount++];
+  Image->Path = strdup (Path);
+  Image->Size = Size;
+  Image->Data = malloc (Size ? Size : 1);
+  if (!Image->Data ||
+      HostFileRead (Fd, Image->Data, Size, 0)) {
+    Die ("cannot read %s", Path);
+  }
+  close (Fd);
+  return Image;
+}
+
+static HOST_STEP *AddStep (HOST_STEP_TYPE Type, int Line, int ExpectFail)
+{
+  HOST_STEP *Step;
+
+  if (StepCount == MAX_STEPS) {
+    Die ("too many steps", "");
+  }
+  Step = &Steps[StepCount++];
+  memset (Step, 0, sizeof (*Step));
+  Step->Type = Type;
+  Step->Line = Line;
+  Step->ExpectFail = ExpectFail;
+  return Step;
+}
+
+static void ParseScript (const char *Path, const char *DataDir)
+{
+  char Buf[512];
+  char *Words[8];
+  unsigned int WordCount;
+  HOST_STEP *Step;
+  IMAGE *Image;
+  char *Cmd;
+  char *Tok;
+  int ExpectFail;
+  int Line = 0;
+  FILE *File;
+
+  File = fopen (Path, "r");
+  if (!File) {
+    Die ("cannot open %s", Path);
+  }
+
+  while (fgets (Buf, sizeof (Buf), File)) {
+    Line++;
+    Buf[strcspn (Buf, "\r\n")] = '\0';
+    Cmd = Buf + strspn (Buf, " \t");
+    if (!*Cmd ||
+        *Cmd == '#') {
+      continue;
+    }
+
+    ExpectFail = (*Cmd == '!');
+    if (ExpectFail) {
+      Cmd++;
+    }
+
+    /* "oem" and "cmd" pass the rest of the line through */
+    if (!strncmp (Cmd, "oem ", 4)) {
+      Step = AddStep (HOST_STEP_COMMAND, Line, ExpectFail);
+      snprintf (Step->Command, sizeof (Step->Command), "%s", Cmd);
+      continue;
+    }
+    if (!strncmp (Cmd, "cmd ", 4)) {
+      Step = AddStep (HOST_STEP_COMMAND, Line, ExpectFail);
+      snprintf (Step->Command, sizeof (Step->Command), "%s", Cmd + 4);
+      continue;
+    }
+
+    WordCount = 0;
+    for (Tok = strtok (Cmd, " \t"); Tok && WordCount < 8;
+         Tok = strtok (NULL, " \t")) {
+      Words[WordCount++] = Tok;
+    }
+
+    if (!strcmp (Words[0], "download") &&
+        WordCount == 2) {
+      Image = LoadImage (DataDir, Words[1]);
+      Step = AddStep (HOST_STEP_DOWNLOAD, Line, ExpectFail);
+      Step->Path = Image->Path;
+      Step->Data = Image->Data;
+      Step->Size = Image->Size;
+    } else if (!strcmp (Words[0], "flash") &&
+               WordCount == 3) {
+      Image = LoadImage (DataDir, Words[2]);
+      Step = AddStep (HOST_STEP_DOWNLOAD, Line, 0);
+      Step->Path = Image->Path;
+      Step->Data = Image->Data;
+      Step->Size = Image->Size;
+      Step = AddStep (HOST_STEP_COMMAND, Line, ExpectFail);
+      Step->Path = Image->Path;
+      snprintf (Step->Command, sizeof (Step->Command), "flash:%s", Words[1]);
+    } else if (!strcmp (Words[0], "erase") &&
+               WordCount == 2) {
+      Step = AddStep (HOST_STEP_COMMAND, Line, ExpectFail);
+      snprintf (Step->Command, sizeof (Step->Command), "erase:%s", Words[1]);
+    } else if (!strcmp (Words[0], "getvar") &&
+               (WordCount == 2 || WordCount == 3)) {
+      Step = AddStep (HOST_STEP_COMMAND, Line, ExpectFail);
+      snprintf (Step->Command, sizeof (Step->Command), "getvar:%s", Words[1]);
+      if (WordCount == 3) {
+        Step->Expect = strdup (Words[2]);
+      }
+    } else if (!strcmp (Words[0], "verify") &&
+               WordCount == 3) {
+      Image = LoadImage (DataDir, Words[2]);
+      Step = AddStep (HOST_STEP_VERIFY, Line, ExpectFail);
+      snprintf (Step->Command, sizeof (Step->Command), "%s", Words[1]);
+      Step->Path = Image->Path;
+      Step->Data = Image->Data;
+      Step->Size = Image->Size;
+    } else if (!strcmp (Words[0], "battery") &&
+               WordCount == 2 &&
+               (!strcmp (Words[1], "low") || !strcmp (Words[1], "ok"))) {
+      Step = AddStep (HOST_STEP_BATTERY, Line, 0);
+      Step->BatteryLow = !strcmp (Words[1], "low");
+    } else {
+      fprintf (stderr, "%s:%d: bad step\n", Path, Line);
+      exit (2);
+    }
+  }
+
+  fclose (File);
+}
+
+static void ParseLayout (const char *Path, const char *OutDir)
+{
+  unsigned long long NextBlock[HOST_MAX_LUNS];
+  char Buf[256];
+  char Name[HOST_NAME_LEN];
+  char LunPath[4096];
+  unsigned long long SizeKb;
+  unsigned long long SizeMb;
+  unsigned int Index;
+  unsigned int BlockSize;
+  unsigned int EraseBlocks;
+  HOST_PARTITION *Ptn;
+  HOST_LUN *Lun;
+  FILE *File;
+
+  File = fopen (Path, "r");
+  if (!File) {
+    Die ("cannot open %s", Path);
+  }
+
+  while (fgets (Buf, sizeof (Buf), File)) {
+    if (Buf[0] == '#' ||
+        Buf[0] == '\n') {
+      continue;
+    }
+
+    if (sscanf (Buf, "lun %u %u %u %llu", &Index, &BlockSize, &EraseBlocks,
+                &SizeMb) == 4) {
+      if (Index != HostConfig.LunCount ||
+          Index >= HOST_MAX_LUNS) {
+        Die ("luns must be listed in order: %s", Buf);
+      }
+      Lun = &HostConfig.Luns[HostConfig.LunCount++];
+      Lun->BlockSize = BlockSize;
+      Lun->EraseBlocks = EraseBlocks;
+      Lun->Blocks = SizeMb * 1024 * 1024 / BlockSize;
+      NextBlock[Index] = LUN_RESERVED / BlockSize;
+
+      snprintf (LunPath, sizeof (LunPath), "%s/lun%u.img", OutDir, Index);
+      Lun->Fd = HostFileOpen (LunPath, 1);
+      if (Lun->Fd < 0 ||
+          HostFileResize (Lun->Fd, Lun->Blocks * BlockSize)) {
+        Die ("cannot create %s", LunPath);
+      }
+    } else if (sscanf (Buf, "part %35s %u %llu", Name, &Index, &SizeKb) ==
+               3) {
+      if (Index >= HostConfig.LunCount ||
+          HostConfig.PartitionCount == HOST_MAX_PARTITIONS) {
+        Die ("bad partition: %s", Buf);
+      }
+      Lun = &HostConfig.Luns[Index];
+      Ptn = &HostConfig.Partitions[HostConfig.PartitionCount++];
+      snprintf (Ptn->Name, sizeof (Ptn->Name), "%s", Name);
+      Ptn->Lun = Index;
+      Ptn->FirstBlock = NextBlock[Index];
+      Ptn->Blocks = SizeKb * 1024 / Lun->BlockSize;
+      NextBlock[Index] += Ptn->Blocks;
+      if (NextBlock[Index] > Lun->Blocks) {
+        Die ("partition does not fit its lun: %s", Buf);
+      }
+    } else {
+      Die ("bad layout line: %s", Buf);
+    }
+  }
+
+  fclose (File);
+}
+
+static void PrintStep (HOST_STEP *Step, const char *Result)
+{
+  unsigned long long Us = Step->EndUs - Step->StartUs;
+  const char *What = Step->Type == HOST_STEP_DOWNLOAD ? "download" :
+                     Step->Type == HOST_STEP_VERIFY ? "verify" : Step->Command;
+
+  printf ("%s:%-4d %-32.32s %-6s %9.3f ms", ScriptName, Step->Line, What,
+          Result, Us / 1000.0);
+  if (Step->Type == HOST_STEP_DOWNLOAD &&
+      !strcmp (Result, "OKAY") &&
+      Us) {
+    printf ("  %8.1f MB/s", (double)Step->Size / Us);
+  }
+  printf ("\n");
+}
+
+/* Like the fastboot tool, the session stops at the first unexpected result */
+static void StepFailed (HOST_STEP *Step, const char *Why)
+{
+  Step->Failed = 1;
+  Failures++;
+  Aborted = 1;
+  PrintStep (Step, "FAILED");
+  fprintf (stderr, "%s:%d: %s\n", ScriptName, Step->Line, Why);
+}
+
+HOST_STEP *HostNextStep (void)
+{
+  if (Aborted) {
+    return NULL;
+  }
+  if (NextStep == StepCount) {
+    if (++Iteration >= Iterations) {
+      return NULL;
+    }
+    NextStep = 0;
+  }
+  return &Steps[NextStep++];
+}
+
+void HostStepDone (HOST_STEP *Step, const char *Response)
+{
+  char Why[128];
+  int Failed = !strncmp (Response, "FAIL", 4);
+
+  if (Step->Type == HOST_STEP_DOWNLOAD &&
+      !Failed) {
+    DownloadedBytes += Step->Size;
+  }
+
+  if (strncmp (Response, "OKAY", 4) &&
+      !Failed) {
+    snprintf (Why, sizeof (Why), "unexpected response '%s'", Response);
+    StepFailed (Step, Why);
+  } else if (Failed != Step->ExpectFail) {
+    snprintf (Why, sizeof (Why), "got '%s'", Response);
+    StepFailed (Step, Why);
+  } else if (Step->Expect &&
+             strcmp (Response + 4, Step->Expect)) {
+    snprintf (Why, sizeof (Why), "got '%s', expected '%s'", Response + 4,
+              Step->Expect);
+    StepFailed (Step, Why);
+  } else {
+    PrintStep (Step, Failed ? "FAIL" : "OKAY");
+  }
+}
+
+void HostVerifyStep (HOST_STEP *Step)
+{
+  unsigned long long Offset = 0;
+  unsigned long long Limit = 0;
+  unsigned char *Buf;
+  unsigned int Index;
+  HOST_LUN *Lun = NULL;
+  int Mismatch;
+
+  if (!strncmp (Step->Command, "lun:", 4)) {
+    Index = atoi (Step->Command + 4);
+    if (Index < HostConfig.LunCount) {
+      Lun = &HostConfig.Luns[Index];
+      Limit = Lun->Blocks * Lun->BlockSize;
+    }
+  } else {
+    for (Index = 0; Index < HostConfig.PartitionCount; Index++) {
+      HOST_PARTITION *Ptn = &HostConfig.Partitions[Index];
+
+      if (!strcmp (Ptn->Name, Step->Command)) {
+        Lun = &HostConfig.Luns[Ptn->Lun];
+        Offset = Ptn->FirstBlock * Lun->BlockSize;
+        Limit = Ptn->Blocks * Lun->BlockSize;
+        break;
+      }
+    }
+  }
+
+  if (!Lun) {
+    StepFailed (Step, "no such partition");
+    return;
+  }
+  if (Step->Size > Limit) {
+    StepFailed (Step, "image is larger than the partition");
+    return;
+  }
+
+  Buf = malloc (Step->Size ? Step->Size : 1);
+  if (!Buf ||
+      HostFileRead (Lun->Fd, Buf, Step->Size, Offset)) {
+    Die ("cannot read back %s", Step->Command);
+  }
+  Mismatch = memcmp (Buf, Step->Data, Step->Size) != 0;
+  free (Buf);
+
+  Step->EndUs = HostTimeUs ();
+  if (Mismatch != Step->ExpectFail) {
+    StepFailed (Step, Mismatch ? "contents differ" : "contents match");
+  } else {
+    PrintStep (Step, Mismatch ? "DIFFER" : "MATCH");
+  }
+}
+
+void HostSessionDone (void)
+{
+  unsigned long long Us = HostTimeUs () - SessionStartUs;
+
+  printf ("%s: %u step(s), %u failed%s, %.3f s", ScriptName,
+          StepCount * Iterations, Failures, Aborted ? " (stopped)" : "",
+          Us / 1000000.0);
+  if (Us &&
+      DownloadedBytes) {
+    printf (", %.1f MB/s", (double)DownloadedBytes / Us);
+  }
+  printf ("\n");
+  HostExit (Failures ? 1 : 0);
+}
+
+int main (int Argc, char **Argv)
+{
+  char LayoutBuf[4096];
+  const char *Layout = NULL;
+  const char *DataDir = NULL;
+  const char *OutDir = ".";
+  char *ScriptCopy;
+  int Opt;
+
+  HostConfig.MemorySize = 256ULL * 1024 * 1024;
+  HostConfig.MaxTransfer = 64ULL * 1024 * 1024;
+
+  while ((Opt = getopt (Argc, Argv, "l:d:o:m:t:b:w:n:av")) != -1) {
+    switch (Opt) {
+    case 'l':
+      Layout = optarg;
+      break;
+    case 'd':
+      DataDir = optarg;
+      break;
+    case 'o':
+      OutDir = optarg;
+      break;
+    case 'm':
+      HostConfig.MemorySize = strtoull (optarg, NULL, 0) * 1024 * 1024;
+      break;
+    case 't':
+      HostConfig.MaxTransfer = strtoull (optarg, NULL, 0);
+      break;
+    case 'b':
+      HostConfig.UsbBytesPerSec = strtoull (optarg, NULL, 0) * 1000000;
+      break;
+    case 'w':
+      HostConfig.StorageBytesPerSec = strtoull (optarg, NULL, 0) * 1000000;
+      break;
+    case 'n':
+      Iterations = strtoul (optarg, NULL, 0);
+      break;
+    case 'a':
+      HostConfig.BlockIo2 = 1;
+      break;
+    case 'v':
+      HostConfig.Verbose++;
+      break;
+    default:
+      fprintf (stderr, "usage: %s [options] SCRIPT, see %s\n", Argv[0],
+               __FILE__);
+      return 2;
+    }
+  }
+
+  if (optind != Argc - 1 ||
+      !Iterations) {
+    fprintf (stderr, "usage: %s [options] SCRIPT\n", Argv[0]);
+    return 2;
+  }
+  ScriptPath = Argv[optind];
+  ScriptName = basename (strdup (ScriptPath));
+
+  ScriptCopy = strdup (ScriptPath);
+  if (!DataDir) {
+    DataDir = dirname (ScriptCopy);
+  }
+  if (!Layout) {
+    snprintf (LayoutBuf, sizeof (LayoutBuf), "%s/layout.txt",
+              dirname (strdup (ScriptPath)));
+    Layout = LayoutBuf;
+  }
+
+  ParseLayout (Layout, OutDir);
+  ParseScript (ScriptPath, DataDir);
+
+  SessionStartUs = HostTimeUs ();
+  HostRunFastboot ();
+  return 2;
+}
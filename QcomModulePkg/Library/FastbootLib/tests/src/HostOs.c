@@ -0,0 +1,125 @@
+/* libc side of the harness: memory, time and the files backing the LUNs */
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "HostOs.h"
+
+HOST_CONFIG HostConfig;
+
+void *HostAlloc (unsigned long long Size)
+{
+  return malloc (Size ? Size : 1);
+}
+
+void HostFree (void *Ptr)
+{
+  free (Ptr);
+}
+
+unsigned long long HostTimeUs (void)
+{
+  struct timespec Ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &Ts);
+  return (unsigned long long)Ts.tv_sec * 1000000ULL + Ts.tv_nsec / 1000;
+}
+
+void HostPuts (const char *Str)
+{
+  fputs (Str, stderr);
+}
+
+void HostExit (int Code)
+{
+  fflush (stdout);
+  fflush (stderr);
+  exit (Code);
+}
+
+int HostFileOpen (const char *Path, int Create)
+{
+  return open (Path, O_RDWR | (Create ? O_CREAT | O_TRUNC : 0), 0644);
+}
+
+long long HostFileSize (int Fd)
+{
+  struct stat St;
+
+  if (fstat (Fd, &St)) {
+    return -1;
+  }
+  return St.st_size;
+}
+
+int HostFileResize (int Fd, unsigned long long Size)
+{
+  return ftruncate (Fd, Size);
+}
+
+int HostFileRead (int Fd, void *Buf, unsigned long long Size,
+                  unsigned long long Offset)
+{
+  ssize_t Done;
+
+  while (Size) {
+    Done = pread (Fd, Buf, Size, Offset);
+    if (Done <= 0) {
+      return -1;
+    }
+    Buf = (char *)Buf + Done;
+    Size -= Done;
+    Offset += Done;
+  }
+  return 0;
+}
+
+int HostFileWrite (int Fd, const void *Buf, unsigned long long Size,
+                   unsigned long long Offset)
+{
+  ssize_t Done;
+
+  while (Size) {
+    Done = pwrite (Fd, Buf, Size, Offset);
+    if (Done <= 0) {
+      return -1;
+    }
+    Buf = (const char *)Buf + Done;
+    Size -= Done;
+    Offset += Done;
+  }
+  return 0;
+}
+
+/* Erased blocks read back as zeroes */
+int HostFileZero (int Fd, unsigned long long Offset, unsigned long long Size)
+{
+  static char Zero[1 << 16];
+  unsigned long long Len;
+
+  if (!fallocate (Fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, Offset,
+                  Size)) {
+    return 0;
+  }
+
+  while (Size) {
+    Len = Size < sizeof (Zero) ? Size : sizeof (Zero);
+    if (HostFileWrite (Fd, Zero, Len, Offset)) {
+      return -1;
+    }
+    Offset += Len;
+    Size -= Len;
+  }
+  return 0;
+}
+
+int HostFileSync (int Fd)
+{
+  return fdatasync (Fd);
+}
@@ -0,0 +1,106 @@
+/* Interface between the firmware side of the harness, built against the
+ * edk2 headers only, and the host side built against libc. Only plain C
+ * types are used here so both sides can include it.
+ */
+
+#ifndef _FASTBOOT_TEST_HOST_OS_H_
+#define _FASTBOOT_TEST_HOST_OS_H_
+
+/* Memory, time, console and exit */
+void *HostAlloc (unsigned long long Size);
+void HostFree (void *Ptr);
+unsigned long long HostTimeUs (void);
+void HostPuts (const char *Str);
+void HostExit (int Code);
+
+/* Files backing the storage LUNs */
+int HostFileOpen (const char *Path, int Create);
+long long HostFileSize (int Fd);
+int HostFileResize (int Fd, unsigned long long Size);
+int HostFileRead (int Fd, void *Buf, unsigned long long Size,
+                  unsigned long long Offset);
+int HostFileWrite (int Fd, const void *Buf, unsigned long long Size,
+                   unsigned long long Offset);
+int HostFileZero (int Fd, unsigned long long Offset, unsigned long long Size);
+int HostFileSync (int Fd);
+
+/* Storage layout, set up by the host before the firmware side runs */
+#define HOST_MAX_LUNS 8
+#define HOST_MAX_PARTITIONS 64
+#define HOST_NAME_LEN 36
+
+typedef struct {
+  int Fd;
+  unsigned int BlockSize;
+  unsigned long long Blocks;
+  /* Erase granularity in blocks, 0 if erase is not supported */
+  unsigned int EraseBlocks;
+} HOST_LUN;
+
+typedef struct {
+  char Name[HOST_NAME_LEN];
+  unsigned int Lun;
+  unsigned long long FirstBlock;
+  unsigned long long Blocks;
+} HOST_PARTITION;
+
+typedef struct {
+  HOST_LUN Luns[HOST_MAX_LUNS];
+  unsigned int LunCount;
+  HOST_PARTITION Partitions[HOST_MAX_PARTITIONS];
+  unsigned int PartitionCount;
+  /* Memory the device reports as free, sizes the download buffer */
+  unsigned long long MemorySize;
+  /* Largest transfer the usb controller accepts */
+  unsigned long long MaxTransfer;
+  /* Simulated throughput in bytes per second, 0 for unlimited */
+  unsigned long long UsbBytesPerSec;
+  unsigned long long StorageBytesPerSec;
+  /* Publish EFI_BLOCK_IO2_PROTOCOL on the partition handles */
+  int BlockIo2;
+  /* Battery below the level flashing needs, set by the "battery" step */
+  int BatteryLow;
+  int Verbose;
+} HOST_CONFIG;
+
+extern HOST_CONFIG HostConfig;
+
+/* Host side of the usb link: one step of the replayed fastboot session */
+typedef enum {
+  HOST_STEP_COMMAND, /* Send Command, expect OKAY (or FAIL if ExpectFail) */
+  HOST_STEP_DOWNLOAD, /* download:<size> of Data, then OKAY */
+  HOST_STEP_VERIFY, /* Compare a partition with Data once the device is idle */
+  HOST_STEP_BATTERY, /* Set HostConfig.BatteryLow to BatteryLow */
+} HOST_STEP_TYPE;
+
+typedef struct {
+  HOST_STEP_TYPE Type;
+  char Command[64];
+  /* Image to download or to compare with */
+  const char *Path;
+  unsigned char *Data;
+  unsigned long long Size;
+  /* Expected response payload, NULL for any */
+  const char *Expect;
+  int ExpectFail;
+  int BatteryLow;
+  int Line;
+  /* Filled in when the step completes */
+  unsigned long long StartUs;
+  unsigned long long EndUs;
+  int Failed;
+} HOST_STEP;
+
+/* Called by the usb stub to get the next step and to report it done.
+ * HostNextStep returns NULL at the end of the session, HostSessionDone
+ * reports the results and exits.
+ */
+HOST_STEP *HostNextStep (void);
+void HostStepDone (HOST_STEP *Step, const char *Response);
+void HostVerifyStep (HOST_STEP *Step);
+void HostSessionDone (void);
+
+/* Firmware side entry point, does not return */
+void HostRunFastboot (void);
+
+#endif
@@ -0,0 +1,8 @@
+/* Host stand-in for ArmLib.h. Nothing here is built for AArch64, so
+ * callers only take their portable paths.
+ */
+
+#ifndef __ARM_LIB__
+#define __ARM_LIB__
+
+#endif
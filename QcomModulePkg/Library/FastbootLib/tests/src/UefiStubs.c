@@ -0,0 +1,576 @@
+/* Stand-in for the parts of the UEFI core FastbootLib uses: boot and
+ * runtime services, events, timers and TPLs, memory allocation and debug
+ * output. Built against the edk2 headers like the code under test.
+ *
+ * Timers are not interrupts here. A due timer fires when the firmware
+ * lowers the TPL, waits, or does block I/O, which are the points where
+ * the usb timer of FastbootLib gets to run during a flash on target.
+ */
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/PrintLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiRuntimeServicesTableLib.h>
+#include <Protocol/BlockIo.h>
+
+#include "HostOs.h"
+#include "UefiStubs.h"
+
+/* libc, resolved at link time */
+VOID *memcpy (VOID *Dst, CONST VOID *Src, UINTN Len);
+VOID *memmove (VOID *Dst, CONST VOID *Src, UINTN Len);
+VOID *memset (VOID *Dst, INT32 Val, UINTN Len);
+INT32 memcmp (CONST VOID *A, CONST VOID *B, UINTN Len);
+
+EFI_GUID gQcomTokenSpaceGuid = {
+    0x882f8c2b, 0x9646, 0x435f,
+    {0x8d, 0xe5, 0xf2, 0x08, 0xff, 0x80, 0xc1, 0xbd}};
+EFI_GUID gBlockIoRefreshGuid = {
+    0xb1eb3d10, 0x9d67, 0x40ca,
+    {0x95, 0x59, 0xf1, 0x48, 0x8b, 0x1b, 0x2d, 0xdb}};
+EFI_GUID gEfiBlockIoProtocolGuid = EFI_BLOCK_IO_PROTOCOL_GUID;
+EFI_GUID gEfiBlockIo2ProtocolGuid = {
+    0xa77b2472, 0xe282, 0x4e9f,
+    {0xa2, 0x45, 0xc2, 0xc0, 0xe2, 0x7b, 0xbc, 0xc1}};
+EFI_GUID gEfiDevicePathProtocolGuid = {
+    0x09576e91, 0x6d3f, 0x11d2,
+    {0x8e, 0x39, 0x00, 0xa0, 0xc9, 0x69, 0x72, 0x3b}};
+EFI_GUID gEfiLoadedImageProtocolGuid = {
+    0x5b1b31a1, 0x9562, 0x11d2,
+    {0x8e, 0x3f, 0x00, 0xa0, 0xc9, 0x69, 0x72, 0x3b}};
+EFI_GUID gEfiSimpleFileSystemProtocolGuid = {
+    0x964e5b22, 0x6459, 0x11d2,
+    {0x8e, 0x39, 0x00, 0xa0, 0xc9, 0x69, 0x72, 0x3b}};
+EFI_GUID gEfiPartitionTypeGuid = {
+    0x6848de61, 0xeb61, 0x4def,
+    {0x9a, 0x8e, 0x38, 0x17, 0xcb, 0xeb, 0x8f, 0x1c}};
+EFI_GUID gEfiPartitionRecordGuid = {
+    0xfe2555be, 0xd716, 0x4686,
+    {0xb9, 0xd0, 0x79, 0xdb, 0x59, 0x21, 0xb7, 0x0d}};
+EFI_GUID gEfiEraseBlockProtocolGuid = {
+    0x95a9a93e, 0xa86e, 0x4926,
+    {0xaa, 0xef, 0x99, 0x18, 0xe7, 0x72, 0xd9, 0x87}};
+EFI_GUID gEfiUbiFlasherProtocolGuid = {
+    0xe3eef434, 0x22c9, 0xe33b,
+    {0x8f, 0x5d, 0x0e, 0x81, 0x68, 0x6a, 0x68, 0xcb}};
+EFI_GUID gQcomDisplayUtilsProtocolGuid = {
+    0xc0dd69ac, 0x76ba, 0x11e6,
+    {0xab, 0x24, 0x1f, 0xc7, 0xf5, 0x57, 0x5f, 0x19}};
+EFI_GUID gEfiNandPartiGuidProtocolGuid = {
+    0xd68edce2, 0xa314, 0x457b,
+    {0x96, 0x2a, 0x1d, 0x99, 0xbb, 0xfc, 0xbb, 0xfb}};
+EFI_GUID gEfiQcomVerifiedBootProtocolGuid = {
+    0x8e5eff91, 0x21b6, 0x47d3,
+    {0xaf, 0x2b, 0xc1, 0x5a, 0x01, 0xe0, 0x20, 0xec}};
+EFI_GUID gQcomMdtpProtocolGuid = {
+    0x71746e63, 0x65f9, 0x41ec,
+    {0xac, 0x08, 0xcd, 0xd1, 0xf2, 0xd0, 0x22, 0x98}};
+
+EFI_HANDLE gImageHandle;
+
+typedef struct _HOST_EVENT {
+  UINT32 Type;
+  EFI_TPL NotifyTpl;
+  EFI_EVENT_NOTIFY Notify;
+  VOID *Context;
+  BOOLEAN Signaled;
+  /* Timer state, in microseconds */
+  EFI_TIMER_DELAY TimerType;
+  UINT64 PeriodUs;
+  UINT64 DueUs;
+  struct _HOST_EVENT *Next;
+} HOST_EVENT;
+
+STATIC HOST_EVENT *Events;
+STATIC EFI_TPL CurrentTpl = TPL_APPLICATION;
+
+EFI_TPL
+HostCurrentTpl (VOID)
+{
+  return CurrentTpl;
+}
+
+STATIC VOID
+DispatchPending (VOID)
+{
+  HOST_EVENT *Event;
+  EFI_TPL OldTpl;
+  BOOLEAN Again;
+
+  do {
+    Again = FALSE;
+    for (Event = Events; Event; Event = Event->Next) {
+      if (!Event->Signaled ||
+          !(Event->Type & EVT_NOTIFY_SIGNAL) ||
+          Event->NotifyTpl <= CurrentTpl) {
+        continue;
+      }
+      Event->Signaled = FALSE;
+      OldTpl = CurrentTpl;
+      CurrentTpl = Event->NotifyTpl;
+      Event->Notify ((EFI_EVENT)Event, Event->Context);
+      CurrentTpl = OldTpl;
+      /* The list may have changed under the notify function */
+      Again = TRUE;
+      break;
+    }
+  } while (Again);
+}
+
+VOID
+HostTimerTick (VOID)
+{
+  HOST_EVENT *Event;
+  UINT64 Now = HostTimeUs ();
+
+  BlockIoStubPoll ();
+  for (Event = Events; Event; Event = Event->Next) {
+    if (Event->TimerType == TimerCancel ||
+        Now < Event->DueUs) {
+      continue;
+    }
+    Event->Signaled = TRUE;
+    if (Event->TimerType == TimerPeriodic) {
+      Event->DueUs = Now + Event->PeriodUs;
+    } else {
+      Event->TimerType = TimerCancel;
+    }
+  }
+  DispatchPending ();
+}
+
+STATIC EFI_TPL EFIAPI
+StubRaiseTpl (IN EFI_TPL NewTpl)
+{
+  EFI_TPL OldTpl = CurrentTpl;
+
+  CurrentTpl = NewTpl;
+  return OldTpl;
+}
+
+STATIC VOID EFIAPI
+StubRestoreTpl (IN EFI_TPL OldTpl)
+{
+  CurrentTpl = OldTpl;
+  HostTimerTick ();
+}
+
+STATIC EFI_STATUS EFIAPI
+StubCreateEvent (IN UINT32 Type,
+                 IN EFI_TPL NotifyTpl,
+                 IN EFI_EVENT_NOTIFY NotifyFunction,
+                 IN VOID *NotifyContext,
+                 OUT EFI_EVENT *Event)
+{
+  HOST_EVENT *New;
+
+  if ((Type & EVT_NOTIFY_SIGNAL) && !NotifyFunction) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  New = AllocateZeroPool (sizeof (*New));
+  if (!New) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  New->Type = Type;
+  New->NotifyTpl = NotifyTpl;
+  New->Notify = NotifyFunction;
+  New->Context = NotifyContext;
+  New->TimerType = TimerCancel;
+  New->Next = Events;
+  Events = New;
+  *Event = (EFI_EVENT)New;
+  return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI
+StubCreateEventEx (IN UINT32 Type,
+                   IN EFI_TPL NotifyTpl,
+                   IN EFI_EVENT_NOTIFY NotifyFunction OPTIONAL,
+                   IN CONST VOID *NotifyContext OPTIONAL,
+                   IN CONST EFI_GUID *EventGroup OPTIONAL,
+                   OUT EFI_EVENT *Event)
+{
+  /* No other members of the group live in the harness */
+  return StubCreateEvent (Type, NotifyTpl, NotifyFunction,
+                          (VOID *)NotifyContext, Event);
+}
+
+STATIC EFI_STATUS EFIAPI
+StubCloseEvent (IN EFI_EVENT Event)
+{
+  HOST_EVENT **Link;
+
+  for (Link = &Events; *Link; Link = &(*Link)->Next) {
+    if (*Link == (HOST_EVENT *)Event) {
+      *Link = ((HOST_EVENT *)Event)->Next;
+      FreePool (Event);
+      return EFI_SUCCESS;
+    }
+  }
+  return EFI_INVALID_PARAMETER;
+}
+
+STATIC EFI_STATUS EFIAPI
+StubSignalEvent (IN EFI_EVENT Event)
+{
+  ((HOST_EVENT *)Event)->Signaled = TRUE;
+  DispatchPending ();
+  return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI
+StubSetTimer (IN EFI_EVENT Event,
+              IN EFI_TIMER_DELAY Type,
+              IN UINT64 TriggerTime)
+{
+  HOST_EVENT *Timer = (HOST_EVENT *)Event;
+
+  Timer->TimerType = Type;
+  Timer->PeriodUs = TriggerTime / 10;
+  Timer->DueUs = HostTimeUs () + Timer->PeriodUs;
+  return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI
+StubWaitForEvent (IN UINTN NumberOfEvents,
+                  IN EFI_EVENT *Event,
+                  OUT UINTN *Index)
+{
+  UINTN Idx;
+
+  while (TRUE) {
+    for (Idx = 0; Idx < NumberOfEvents; Idx++) {
+      if (((HOST_EVENT *)Event[Idx])->Signaled) {
+        ((HOST_EVENT *)Event[Idx])->Signaled = FALSE;
+        *Index = Idx;
+        return EFI_SUCCESS;
+      }
+    }
+    HostTimerTick ();
+  }
+}
+
+STATIC EFI_STATUS EFIAPI
+StubCheckEvent (IN EFI_EVENT Event)
+{
+  HostTimerTick ();
+  if (!((HOST_EVENT *)Event)->Signaled) {
+    return EFI_NOT_READY;
+  }
+  ((HOST_EVENT *)Event)->Signaled = FALSE;
+  return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI
+StubHandleProtocol (IN EFI_HANDLE Handle,
+                    IN EFI_GUID *Protocol,
+                    OUT VOID **Interface)
+{
+  return BlockIoStubHandleProtocol (Handle, Protocol, Interface);
+}
+
+STATIC EFI_STATUS EFIAPI
+StubLocateProtocol (IN EFI_GUID *Protocol,
+                    IN VOID *Registration OPTIONAL,
+                    OUT VOID **Interface)
+{
+  return UsbDeviceStubLocate (Protocol, Interface);
+}
+
+/* The whole of HostConfig.MemorySize is reported as one free region */
+STATIC EFI_STATUS EFIAPI
+StubGetMemoryMap (IN OUT UINTN *MemoryMapSize,
+                  IN OUT EFI_MEMORY_DESCRIPTOR *MemoryMap,
+                  OUT UINTN *MapKey,
+                  OUT UINTN *DescriptorSize,
+                  OUT UINT32 *DescriptorVersion)
+{
+  *DescriptorSize = sizeof (EFI_MEMORY_DESCRIPTOR);
+  *DescriptorVersion = EFI_MEMORY_DESCRIPTOR_VERSION;
+  *MapKey = 0;
+  if (*MemoryMapSize < sizeof (EFI_MEMORY_DESCRIPTOR)) {
+    *MemoryMapSize = sizeof (EFI_MEMORY_DESCRIPTOR);
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  SetMem (MemoryMap, sizeof (*MemoryMap), 0);
+  MemoryMap->Type = EfiConventionalMemory;
+  MemoryMap->NumberOfPages = EFI_SIZE_TO_PAGES (HostConfig.MemorySize);
+  *MemoryMapSize = sizeof (EFI_MEMORY_DESCRIPTOR);
+  return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI
+StubSetWatchdogTimer (IN UINTN Timeout,
+                      IN UINT64 WatchdogCode,
+                      IN UINTN DataSize,
+                      IN CHAR16 *WatchdogData OPTIONAL)
+{
+  return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI
+StubStall (IN UINTN Microseconds)
+{
+  UINT64 End = HostTimeUs () + Microseconds;
+
+  while (HostTimeUs () < End) {
+    HostTimerTick ();
+  }
+  return EFI_SUCCESS;
+}
+
+STATIC VOID EFIAPI
+StubCopyMem (IN VOID *Destination, IN VOID *Source, IN UINTN Length)
+{
+  memmove (Destination, Source, Length);
+}
+
+STATIC VOID EFIAPI
+StubSetMem (IN VOID *Buffer, IN UINTN Size, IN UINT8 Value)
+{
+  memset (Buffer, Value, Size);
+}
+
+STATIC EFI_BOOT_SERVICES StubBootServices = {
+  .RaiseTPL = StubRaiseTpl,
+  .RestoreTPL = StubRestoreTpl,
+  .GetMemoryMap = StubGetMemoryMap,
+  .CreateEvent = StubCreateEvent,
+  .SetTimer = StubSetTimer,
+  .WaitForEvent = StubWaitForEvent,
+  .SignalEvent = StubSignalEvent,
+  .CloseEvent = StubCloseEvent,
+  .CheckEvent = StubCheckEvent,
+  .HandleProtocol = StubHandleProtocol,
+  .SetWatchdogTimer = StubSetWatchdogTimer,
+  .Stall = StubStall,
+  .LocateProtocol = StubLocateProtocol,
+  .CopyMem = StubCopyMem,
+  .SetMem = StubSetMem,
+  .CreateEventEx = StubCreateEventEx,
+};
+
+STATIC EFI_STATUS EFIAPI
+StubGetVariable (IN CHAR16 *VariableName,
+                 IN EFI_GUID *VendorGuid,
+                 OUT UINT32 *Attributes OPTIONAL,
+                 IN OUT UINTN *DataSize,
+                 OUT VOID *Data)
+{
+  return EFI_NOT_FOUND;
+}
+
+STATIC EFI_STATUS EFIAPI
+StubSetVariable (IN CHAR16 *VariableName,
+                 IN EFI_GUID *VendorGuid,
+                 IN UINT32 Attributes,
+                 IN UINTN DataSize,
+                 IN VOID *Data)
+{
+  return EFI_SUCCESS;
+}
+
+STATIC EFI_RUNTIME_SERVICES StubRuntimeServices = {
+  .GetVariable = StubGetVariable,
+  .SetVariable = StubSetVariable,
+};
+
+EFI_BOOT_SERVICES *gBS = &StubBootServices;
+EFI_RUNTIME_SERVICES *gRT = &StubRuntimeServices;
+
+/* MemoryAllocationLib */
+
+VOID *
+EFIAPI
+AllocatePool (IN UINTN AllocationSize)
+{
+  return HostAlloc (AllocationSize);
+}
+
+VOID *
+EFIAPI
+AllocateZeroPool (IN UINTN AllocationSize)
+{
+  VOID *Buffer = HostAlloc (AllocationSize);
+
+  if (Buffer) {
+    memset (Buffer, 0, AllocationSize);
+  }
+  return Buffer;
+}
+
+VOID *
+EFIAPI
+AllocateCopyPool (IN UINTN AllocationSize, IN CONST VOID *Buffer)
+{
+  VOID *Copy = HostAlloc (AllocationSize);
+
+  if (Copy) {
+    memcpy (Copy, Buffer, AllocationSize);
+  }
+  return Copy;
+}
+
+VOID
+EFIAPI
+FreePool (IN VOID *Buffer)
+{
+  HostFree (Buffer);
+}
+
+VOID *
+EFIAPI
+AllocatePages (IN UINTN Pages)
+{
+  return HostAlloc (EFI_PAGES_TO_SIZE (Pages));
+}
+
+VOID
+EFIAPI
+FreePages (IN VOID *Buffer, IN UINTN Pages)
+{
+  HostFree (Buffer);
+}
+
+/* BaseMemoryLib */
+
+VOID *
+EFIAPI
+CopyMem (OUT VOID *DestinationBuffer,
+         IN CONST VOID *SourceBuffer,
+         IN UINTN Length)
+{
+  return memmove (DestinationBuffer, SourceBuffer, Length);
+}
+
+VOID *
+EFIAPI
+SetMem (OUT VOID *Buffer, IN UINTN Length, IN UINT8 Value)
+{
+  return memset (Buffer, Value, Length);
+}
+
+VOID *
+EFIAPI
+ZeroMem (OUT VOID *Buffer, IN UINTN Length)
+{
+  return memset (Buffer, 0, Length);
+}
+
+INTN
+EFIAPI
+CompareMem (IN CONST VOID *DestinationBuffer,
+            IN CONST VOID *SourceBuffer,
+            IN UINTN Length)
+{
+  return memcmp (DestinationBuffer, SourceBuffer, Length);
+}
+
+BOOLEAN
+EFIAPI
+CompareGuid (IN CONST GUID *Guid1, IN CONST GUID *Guid2)
+{
+  return !memcmp (Guid1, Guid2, sizeof (GUID));
+}
+
+/* TimerLib, counting microseconds */
+
+UINT64
+EFIAPI
+GetPerformanceCounter (VOID)
+{
+  return HostTimeUs ();
+}
+
+UINT64
+EFIAPI
+GetPerformanceCounterProperties (OUT UINT64 *StartValue OPTIONAL,
+                                 OUT UINT64 *EndValue OPTIONAL)
+{
+  if (StartValue) {
+    *StartValue = 0;
+  }
+  if (EndValue) {
+    *EndValue = (UINT64)-1;
+  }
+  return 1000000;
+}
+
+/* DebugLib */
+
+VOID
+EFIAPI
+DebugPrint (IN UINTN ErrorLevel, IN CONST CHAR8 *Format, ...)
+{
+  CHAR8 Buffer[512];
+  VA_LIST Marker;
+
+  if (!DebugPrintLevelEnabled (ErrorLevel)) {
+    return;
+  }
+
+  VA_START (Marker, Format);
+  AsciiVSPrint (Buffer, sizeof (Buffer), Format, Marker);
+  VA_END (Marker);
+  HostPuts (Buffer);
+}
+
+VOID
+EFIAPI
+DebugAssert (IN CONST CHAR8 *FileName,
+             IN UINTN LineNumber,
+             IN CONST CHAR8 *Description)
+{
+  DebugPrint (EFI_D_ERROR, "ASSERT %a(%d): %a\n", FileName, LineNumber,
+              Description);
+  HostExit (2);
+}
+
+BOOLEAN
+EFIAPI
+DebugPrintEnabled (VOID)
+{
+  return TRUE;
+}
+
+BOOLEAN
+EFIAPI
+DebugPrintLevelEnabled (IN CONST UINTN ErrorLevel)
+{
+  UINTN Mask = EFI_D_ERROR;
+
+  if (HostConfig.Verbose > 0) {
+    Mask |= EFI_D_WARN | EFI_D_INFO;
+  }
+  if (HostConfig.Verbose > 1) {
+    Mask |= EFI_D_VERBOSE;
+  }
+  return (ErrorLevel & Mask) != 0;
+}
+
+BOOLEAN
+EFIAPI
+DebugAssertEnabled (VOID)
+{
+  return TRUE;
+}
+
+BOOLEAN
+EFIAPI
+DebugCodeEnabled (VOID)
+{
+  return FALSE;
+}
+
+BOOLEAN
+EFIAPI
+DebugClearMemoryEnabled (VOID)
+{
+  return FALSE;
+}
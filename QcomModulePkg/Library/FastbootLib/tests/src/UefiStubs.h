@@ -0,0 +1,26 @@
+/* Internal interfaces between the firmware-side stubs of the harness */
+
+#ifndef _FASTBOOT_TEST_UEFI_STUBS_H_
+#define _FASTBOOT_TEST_UEFI_STUBS_H_
+
+/* Current TPL, and the point where due timers fire */
+EFI_TPL
+HostCurrentTpl (VOID);
+VOID
+HostTimerTick (VOID);
+
+/* Partition handles backed by the LUN files */
+EFI_STATUS
+BlockIoStubInit (VOID);
+VOID
+BlockIoStubPoll (VOID);
+EFI_STATUS
+BlockIoStubHandleProtocol (IN EFI_HANDLE Handle,
+                           IN EFI_GUID *Protocol,
+                           OUT VOID **Interface);
+
+/* The usb device protocol, driven by the replayed host session */
+EFI_STATUS
+UsbDeviceStubLocate (IN EFI_GUID *Protocol, OUT VOID **Interface);
+
+#endif
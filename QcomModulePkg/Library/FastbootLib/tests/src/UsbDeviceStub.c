@@ -0,0 +1,348 @@
+/* In-process stand-in for the usb device protocol. The host end of the
+ * link replays the steps of the session script like the fastboot tool:
+ * it sends each command, streams the image after a DATA response and
+ * waits for OKAY or FAIL.
+ *
+ * Only one transfer is outstanding per endpoint, as on target. A transfer
+ * completes after the bus time it takes at HostConfig.UsbBytesPerSec, so
+ * flashing can overlap the download of the next image.
+ */
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/PrintLib.h>
+#include <Protocol/EFIUsbDevice.h>
+
+#include "FastbootCmds.h"
+#include "HostOs.h"
+#include "UefiStubs.h"
+
+#define EVENT_QUEUE_SIZE 8
+
+typedef struct {
+  USB_DEVICE_EVENT Msg;
+  USB_DEVICE_EVENT_DATA Data;
+  UINT64 ReadyUs;
+} STUB_EVENT;
+
+typedef enum {
+  CLIENT_IDLE,      /* Between steps */
+  CLIENT_SEND_CMD,  /* Command waiting for a receive transfer */
+  CLIENT_SEND_DATA, /* Image being sent after DATA */
+  CLIENT_WAIT,      /* Waiting for OKAY or FAIL */
+  CLIENT_DONE       /* No steps left */
+} CLIENT_STATE;
+
+STATIC EFI_GUID UsbDeviceProtocolGuid = {
+    0xd9d9ce48, 0x44b8, 0x4f49,
+    {0x8e, 0x3e, 0x2a, 0x3b, 0x92, 0x7d, 0xc6, 0xc1}};
+
+STATIC STUB_EVENT EventQueue[EVENT_QUEUE_SIZE];
+STATIC UINT32 EventHead;
+STATIC UINT32 EventCount;
+STATIC BOOLEAN Connected;
+STATIC UINT64 BusFreeUs;
+
+/* Receive transfer queued by the device */
+STATIC BOOLEAN RxQueued;
+STATIC VOID *RxBuffer;
+STATIC UINTN RxSize;
+
+/* Host end of the link */
+STATIC CLIENT_STATE ClientState = CLIENT_IDLE;
+STATIC HOST_STEP *Step;
+STATIC CHAR8 CmdBuf[MAX_RSP_SIZE];
+STATIC CONST UINT8 *OutData;
+STATIC UINT64 OutSize;
+STATIC UINT64 OutDone;
+
+/* Time at which a transfer of Size bytes queued now is off the bus */
+STATIC UINT64
+BusTransfer (UINT64 Size)
+{
+  UINT64 Now = HostTimeUs ();
+
+  if (!HostConfig.UsbBytesPerSec) {
+    return Now;
+  }
+
+  if (BusFreeUs < Now) {
+    BusFreeUs = Now;
+  }
+  BusFreeUs += (Size * 1000000) / HostConfig.UsbBytesPerSec;
+  return BusFreeUs;
+}
+
+STATIC VOID
+PushEvent (USB_DEVICE_EVENT Msg, UINT8 Endpoint, UINTN Bytes, VOID *Buffer,
+           UINT64 ReadyUs)
+{
+  STUB_EVENT *Event;
+
+  if (EventCount == EVENT_QUEUE_SIZE) {
+    DEBUG ((EFI_D_ERROR, "Usb stub: event queue overflow\n"));
+    HostExit (2);
+  }
+
+  Event = &EventQueue[(EventHead + EventCount) % EVENT_QUEUE_SIZE];
+  SetMem (Event, sizeof (*Event), 0);
+  Event->Msg = Msg;
+  Event->ReadyUs = ReadyUs;
+  if (Msg == UsbDeviceEventDeviceStateChange) {
+    Event->Data.DeviceState = UsbDeviceStateConnected;
+  } else {
+    Event->Data.TransferOutcome.Status = UsbDeviceTransferStatusCompleteOK;
+    Event->Data.TransferOutcome.EndpointIndex = Endpoint;
+    Event->Data.TransferOutcome.BytesCompleted = Bytes;
+    Event->Data.TransferOutcome.DataBuffer = Buffer;
+  }
+  EventCount++;
+}
+
+/* Start the next step of the session. Verification waits until the
+ * firmware is back in its command loop, so every queued flash is done.
+ */
+STATIC VOID
+ClientStartStep (VOID)
+{
+  while (ClientState == CLIENT_IDLE) {
+    if (!Step) {
+      Step = HostNextStep ();
+      if (!Step) {
+        ClientState = CLIENT_DONE;
+        return;
+      }
+      Step->StartUs = HostTimeUs ();
+    }
+
+    switch (Step->Type) {
+    case HOST_STEP_VERIFY:
+      if (HostCurrentTpl () != TPL_APPLICATION ||
+          EventCount) {
+        return;
+      }
+      HostVerifyStep (Step);
+      Step->EndUs = HostTimeUs ();
+      Step = NULL;
+      break;
+    case HOST_STEP_BATTERY:
+      HostConfig.BatteryLow = Step->BatteryLow;
+      Step->EndUs = HostTimeUs ();
+      Step = NULL;
+      break;
+    case HOST_STEP_DOWNLOAD:
+      AsciiSPrint (CmdBuf, sizeof (CmdBuf), "download:%08x", Step->Size);
+      OutData = (CONST UINT8 *)CmdBuf;
+      OutSize = AsciiStrLen (CmdBuf);
+      OutDone = 0;
+      ClientState = CLIENT_SEND_CMD;
+      break;
+    case HOST_STEP_COMMAND:
+    default:
+      AsciiStrnCpyS (CmdBuf, sizeof (CmdBuf), Step->Command,
+                     sizeof (CmdBuf) - 1);
+      OutData = (CONST UINT8 *)CmdBuf;
+      OutSize = AsciiStrLen (CmdBuf);
+      OutDone = 0;
+      ClientState = CLIENT_SEND_CMD;
+      break;
+    }
+  }
+}
+
+/* Fill the receive transfer queued by the device, if any */
+STATIC VOID
+ClientSend (VOID)
+{
+  UINT64 Len;
+
+  if ((ClientState != CLIENT_SEND_CMD &&
+       ClientState != CLIENT_SEND_DATA) ||
+      !RxQueued) {
+    return;
+  }
+
+  Len = MIN (OutSize - OutDone, RxSize);
+  CopyMem (RxBuffer, OutData + OutDone, Len);
+  OutDone += Len;
+  RxQueued = FALSE;
+  PushEvent (UsbDeviceEventTransferNotification, ENDPOINT_IN, Len, RxBuffer,
+             BusTransfer (Len));
+
+  if (OutDone == OutSize) {
+    ClientState = CLIENT_WAIT;
+  }
+}
+
+STATIC VOID
+ClientResponse (CONST CHAR8 *Response)
+{
+  if (!AsciiStrnCmp (Response, "INFO", 4)) {
+    DEBUG ((EFI_D_INFO, "(bootloader) %a\n", Response + 4));
+    return;
+  }
+
+  if (!Step ||
+      ClientState != CLIENT_WAIT) {
+    DEBUG ((EFI_D_ERROR, "Usb stub: unexpected response %a\n", Response));
+    HostExit (2);
+  }
+
+  if (!AsciiStrnCmp (Response, "DATA", 4) &&
+      Step->Type == HOST_STEP_DOWNLOAD) {
+    OutData = Step->Data;
+    OutSize = Step->Size;
+    OutDone = 0;
+    ClientState = CLIENT_SEND_DATA;
+    return;
+  }
+
+  Step->EndUs = HostTimeUs ();
+  HostStepDone (Step, Response);
+  Step = NULL;
+  ClientState = CLIENT_IDLE;
+}
+
+STATIC EFI_STATUS
+UsbStubStart (IN USB_DEVICE_DESCRIPTOR *DeviceDescriptor,
+              IN VOID **Descriptors,
+              IN USB_DEVICE_QUALIFIER_DESCRIPTOR *DeviceQualifierDescriptor,
+              IN VOID *BinaryDeviceOjectStore,
+              IN UINT8 StringDescriptorCount,
+              IN USB_STRING_DESCRIPTOR **StringDescritors)
+{
+  return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS
+UsbStubStartEx (IN USB_DEVICE_DESCRIPTOR_SET *UsbDevDescSet)
+{
+  return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS
+UsbStubSend (IN UINT8 EndpointIndex, IN UINTN Size, IN VOID *Buffer)
+{
+  CHAR8 Response[MAX_RSP_SIZE + 1];
+
+  if (EndpointIndex == ENDPOINT_IN) {
+    /* Receive from the host */
+    if (Size > HostConfig.MaxTransfer) {
+      return EFI_INVALID_PARAMETER;
+    }
+    RxBuffer = Buffer;
+    RxSize = Size;
+    RxQueued = TRUE;
+    return EFI_SUCCESS;
+  }
+
+  if (Size > MAX_RSP_SIZE) {
+    Size = MAX_RSP_SIZE;
+  }
+  CopyMem (Response, Buffer, Size);
+  Response[Size] = '\0';
+  PushEvent (UsbDeviceEventTransferNotification, ENDPOINT_OUT, Size, Buffer,
+             BusTransfer (Size));
+  ClientResponse (Response);
+  return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI
+UsbStubHandleEvent (OUT USB_DEVICE_EVENT *Event,
+                    OUT UINTN *DataSize,
+                    OUT USB_DEVICE_EVENT_DATA *EventData)
+{
+  STUB_EVENT *Head;
+
+  *Event = UsbDeviceEventNoEvent;
+  *DataSize = 0;
+
+  if (!Connected) {
+    Connected = TRUE;
+    PushEvent (UsbDeviceEventDeviceStateChange, 0, 0, NULL, 0);
+  }
+
+  ClientStartStep ();
+  ClientSend ();
+
+  if (!EventCount) {
+    if (ClientState == CLIENT_DONE &&
+        HostCurrentTpl () == TPL_APPLICATION) {
+      HostSessionDone ();
+    }
+    return EFI_SUCCESS;
+  }
+
+  Head = &EventQueue[EventHead];
+  if (Head->ReadyUs > HostTimeUs ()) {
+    return EFI_SUCCESS;
+  }
+
+  *Event = Head->Msg;
+  *DataSize = sizeof (*EventData);
+  CopyMem (EventData, &Head->Data, sizeof (*EventData));
+  EventHead = (EventHead + 1) % EVENT_QUEUE_SIZE;
+  EventCount--;
+  return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI
+UsbStubAllocateTransferBuffer (IN UINTN Size, OUT VOID **Buffer)
+{
+  *Buffer = AllocatePool (Size);
+  return *Buffer ? EFI_SUCCESS : EFI_OUT_OF_RESOURCES;
+}
+
+STATIC EFI_STATUS EFIAPI
+UsbStubFreeTransferBuffer (IN VOID *Buffer)
+{
+  FreePool (Buffer);
+  return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS
+UsbStubStop (VOID)
+{
+  return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS
+UsbStubAbortXfer (IN UINT8 EndpointIndex)
+{
+  if (EndpointIndex == ENDPOINT_IN) {
+    RxQueued = FALSE;
+  }
+  return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI
+UsbStubSetEndpointStallState (IN UINT8 EndpointIndex, IN BOOLEAN State)
+{
+  return EFI_SUCCESS;
+}
+
+STATIC EFI_USB_DEVICE_PROTOCOL UsbDeviceStub = {
+  .Revision = 1,
+  .Start = UsbStubStart,
+  .Send = UsbStubSend,
+  .HandleEvent = UsbStubHandleEvent,
+  .AllocateTransferBuffer = UsbStubAllocateTransferBuffer,
+  .FreeTransferBuffer = UsbStubFreeTransferBuffer,
+  .Stop = UsbStubStop,
+  .AbortXfer = UsbStubAbortXfer,
+  .SetEndpointStallState = UsbStubSetEndpointStallState,
+  .StartEx = UsbStubStartEx,
+};
+
+EFI_STATUS
+UsbDeviceStubLocate (IN EFI_GUID *Protocol, OUT VOID **Interface)
+{
+  if (!CompareGuid (Protocol, &UsbDeviceProtocolGuid)) {
+    return EFI_NOT_FOUND;
+  }
+  *Interface = &UsbDeviceStub;
+  return EFI_SUCCESS;
+}
@@ -0,0 +1,413 @@
+/* Builds the images the fastboot tests flash.
+ *
+ *   fbimg gen OUT ITEM...
+ *       Raw image from ITEMs laid end to end: rand:SIZE, zero:SIZE or
+ *       fill:HEX32:SIZE. SIZE takes a K or M suffix. Random data is
+ *       seeded from the item position, so images are reproducible.
+ *   fbimg sparse [-b BLOCK_SIZE] [-s] [-c CRC] IN OUT
+ *       Android sparse image of IN. Blocks repeating one 32 bit word
+ *       become fill chunks, with -s zero blocks become don't care chunks.
+ *       -c ends the image with a CRC chunk holding the CRC-32 of the whole
+ *       image (image), the one libsparse's writer computes, which hashes a
+ *       single block of each fill chunk and skips don't care chunks
+ *       (libsparse), or a wrong one (bad).
+ *   fbimg meta OUT NAME:FILE...
+ *       Meta image holding each FILE for partition NAME.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SPARSE_HEADER_MAGIC 0xed26ff3a
+#define CHUNK_TYPE_RAW 0xCAC1
+#define CHUNK_TYPE_FILL 0xCAC2
+#define CHUNK_TYPE_DONT_CARE 0xCAC3
+#define CHUNK_TYPE_CRC 0xCAC4
+
+#define META_HEADER_MAGIC 0xce1ad63c
+#define META_PARTITION_NAME_SZ 72
+#define MAX_IMAGES_IN_METAIMG 32
+
+typedef struct {
+  uint32_t magic;
+  uint16_t major_version;
+  uint16_t minor_version;
+  uint16_t file_hdr_sz;
+  uint16_t chunk_hdr_sz;
+  uint32_t blk_sz;
+  uint32_t total_blks;
+  uint32_t total_chunks;
+  uint32_t image_checksum;
+} sparse_header_t;
+
+typedef struct {
+  uint16_t chunk_type;
+  uint16_t reserved1;
+  uint32_t chunk_sz;
+  uint32_t total_sz;
+} chunk_header_t;
+
+typedef struct {
+  uint32_t magic;
+  uint16_t major_version;
+  uint16_t minor_version;
+  char img_version[64];
+  uint16_t meta_hdr_sz;
+  uint16_t img_hdr_sz;
+} meta_header_t;
+
+typedef struct {
+  char ptn_name[META_PARTITION_NAME_SZ];
+  uint32_t start_offset;
+  uint32_t size;
+} img_header_entry_t;
+
+static void Die (const char *Msg, const char *Arg)
+{
+  fprintf (stderr, "fbimg: %s%s\n", Msg, Arg);
+  exit (2);
+}
+
+static unsigned char *ReadFile (const char *Path, size_t *Size)
+{
+  unsigned char *Data;
+  FILE *File;
+  long Len;
+
+  File = fopen (Path, "rb");
+  if (!File) {
+    Die ("cannot open ", Path);
+  }
+  fseek (File, 0, SEEK_END);
+  Len = ftell (File);
+  fseek (File, 0, SEEK_SET);
+  Data = malloc (Len ? Len : 1);
+  if (!Data ||
+      fread (Data, 1, Len, File) != (size_t)Len) {
+    Die ("cannot read ", Path);
+  }
+  fclose (File);
+  *Size = Len;
+  return Data;
+}
+
+static void Write (FILE *File, const void *Data, size_t Size)
+{
+  if (fwrite (Data, 1, Size, File) != Size) {
+    Die ("write failed", "");
+  }
+}
+
+static uint64_t ParseSize (const char *Str)
+{
+  char *End;
+  uint64_t Size = strtoull (Str, &End, 0);
+
+  if (*End == 'K' || *End == 'k') {
+    Size <<= 10;
+  } else if (*End == 'M' || *End == 'm') {
+    Size <<= 20;
+  } else if (*End) {
+    Die ("bad size ", Str);
+  }
+  return Size;
+}
+
+static int Gen (int Argc, char **Argv)
+{
+  unsigned char Buf[65536];
+  uint64_t State;
+  uint64_t Size;
+  uint64_t Done;
+  uint32_t Fill;
+  size_t Len;
+  size_t Index;
+  FILE *File;
+  char *Arg;
+  int Item;
+
+  if (Argc < 2) {
+    Die ("usage: fbimg gen OUT ITEM...", "");
+  }
+
+  File = fopen (Argv[0], "wb");
+  if (!File) {
+    Die ("cannot create ", Argv[0]);
+  }
+
+  for (Item = 1; Item < Argc; Item++) {
+    Arg = Argv[Item];
+    State = 0x9e3779b97f4a7c15ULL * Item;
+    Fill = 0;
+    if (!strncmp (Arg, "rand:", 5)) {
+      Size = ParseSize (Arg + 5);
+    } else if (!strncmp (Arg, "zero:", 5)) {
+      Size = ParseSize (Arg + 5);
+    } else if (!strncmp (Arg, "fill:", 5) &&
+               strchr (Arg + 5, ':')) {
+      Fill = strtoul (Arg + 5, NULL, 16);
+      Size = ParseSize (strchr (Arg + 5, ':') + 1);
+    } else {
+      Die ("bad item ", Arg);
+    }
+
+    for (Done = 0; Done < Size; Done += Len) {
+      Len = Size - Done < sizeof (Buf) ? Size - Done : sizeof (Buf);
+      for (Index = 0; Index < Len; Index += 4) {
+        uint32_t Word = Fill;
+
+        if (Arg[0] == 'r') {
+          State ^= State << 13;
+          State ^= State >> 7;
+          State ^= State << 17;
+          Word = (uint32_t)State;
+        }
+        memcpy (Buf + Index, &Word, Len - Index < 4 ? Len - Index : 4);
+      }
+      Write (File, Buf, Len);
+    }
+  }
+
+  fclose (File);
+  return 0;
+}
+
+/* Bitwise CRC-32 (IEEE 802.3, reflected), chained like zlib's crc32() */
+static uint32_t Crc32 (uint32_t Crc, const void *Data, size_t Len)
+{
+  const unsigned char *Byte = Data;
+  int Bit;
+
+  Crc = ~Crc;
+  while (Len--) {
+    Crc ^= *Byte++;
+    for (Bit = 0; Bit < 8; Bit++) {
+      Crc = (Crc >> 1) ^ (0xEDB88320 & -(Crc & 1));
+    }
+  }
+  return ~Crc;
+}
+
+/* Whether Block repeats its first 32 bit word */
+static int IsFillBlock (const unsigned char *Block, uint32_t BlockSize,
+                        uint32_t *Val)
+{
+  uint32_t Offset;
+
+  memcpy (Val, Block, sizeof (*Val));
+  for (Offset = 4; Offset < BlockSize; Offset += 4) {
+    if (memcmp (Block + Offset, Block, 4)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static int Sparse (int Argc, char **Argv)
+{
+  sparse_header_t Header = {0};
+  chunk_header_t Chunk;
+  unsigned char *Data;
+  unsigned char *Padded;
+  uint32_t BlockSize = 4096;
+  uint32_t Blocks;
+  uint32_t Block;
+  uint32_t Run;
+  uint32_t Val;
+  uint32_t RunVal;
+  uint16_t Type;
+  uint16_t RunType;
+  uint32_t ImageCrc = 0;
+  uint32_t WriterCrc = 0;
+  uint32_t FileCrc;
+  const char *CrcMode = NULL;
+  int Holes = 0;
+  size_t Size;
+  FILE *File;
+  int Opt;
+
+  for (Opt = 0; Opt < Argc && Argv[Opt][0] == '-'; Opt++) {
+    if (!strcmp (Argv[Opt], "-b") &&
+        Opt + 1 < Argc) {
+      BlockSize = strtoul (Argv[++Opt], NULL, 0);
+    } else if (!strcmp (Argv[Opt], "-s")) {
+      Holes = 1;
+    } else if (!strcmp (Argv[Opt], "-c") &&
+               Opt + 1 < Argc) {
+      CrcMode = Argv[++Opt];
+    } else {
+      Die ("bad option ", Argv[Opt]);
+    }
+  }
+  if (Argc - Opt != 2 ||
+      !BlockSize ||
+      BlockSize % 4 ||
+      (CrcMode &&
+       strcmp (CrcMode, "image") &&
+       strcmp (CrcMode, "libsparse") &&
+       strcmp (CrcMode, "bad"))) {
+    Die ("usage: fbimg sparse [-b BLOCK_SIZE] [-s] [-c CRC] IN OUT", "");
+  }
+
+  Data = ReadFile (Argv[Opt], &Size);
+  Blocks = (Size + BlockSize - 1) / BlockSize;
+  Padded = calloc (Blocks ? Blocks : 1, BlockSize);
+  memcpy (Padded, Data, Size);
+
+  File = fopen (Argv[Opt + 1], "wb");
+  if (!File) {
+    Die ("cannot create ", Argv[Opt + 1]);
+  }
+
+  Header.magic = SPARSE_HEADER_MAGIC;
+  Header.major_version = 1;
+  Header.file_hdr_sz = sizeof (sparse_header_t);
+  Header.chunk_hdr_sz = sizeof (chunk_header_t);
+  Header.blk_sz = BlockSize;
+  Header.total_blks = Blocks;
+  /* total_chunks is filled in once the chunks are known */
+  Write (File, &Header, sizeof (Header));
+
+  for (Block = 0; Block < Blocks; Block += Run) {
+    RunType = CHUNK_TYPE_RAW;
+    RunVal = 0;
+    if (IsFillBlock (Padded + (size_t)Block * BlockSize, BlockSize, &RunVal)) {
+      RunType = (Holes && !RunVal) ? CHUNK_TYPE_DONT_CARE : CHUNK_TYPE_FILL;
+    }
+
+    for (Run = 1; Block + Run < Blocks; Run++) {
+      Type = CHUNK_TYPE_RAW;
+      if (IsFillBlock (Padded + (size_t)(Block + Run) * BlockSize, BlockSize,
+                       &Val)) {
+        Type = (Holes && !Val) ? CHUNK_TYPE_DONT_CARE : CHUNK_TYPE_FILL;
+      }
+      if (Type != RunType ||
+          (Type == CHUNK_TYPE_FILL && Val != RunVal)) {
+        break;
+      }
+    }
+
+    Chunk.chunk_type = RunType;
+    Chunk.reserved1 = 0;
+    Chunk.chunk_sz = Run;
+    Chunk.total_sz = sizeof (Chunk);
+    if (RunType == CHUNK_TYPE_RAW) {
+      Chunk.total_sz += Run * BlockSize;
+    } else if (RunType == CHUNK_TYPE_FILL) {
+      Chunk.total_sz += sizeof (RunVal);
+    }
+    Write (File, &Chunk, sizeof (Chunk));
+    if (RunType == CHUNK_TYPE_RAW) {
+      Write (File, Padded + (size_t)Block * BlockSize,
+             (size_t)Run * BlockSize);
+    } else if (RunType == CHUNK_TYPE_FILL) {
+      Write (File, &RunVal, sizeof (RunVal));
+    }
+    Header.total_chunks++;
+
+    /* Padded holds the expanded image, zeroes included */
+    ImageCrc = Crc32 (ImageCrc, Padded + (size_t)Block * BlockSize,
+                      (size_t)Run * BlockSize);
+    if (RunType == CHUNK_TYPE_RAW) {
+      WriterCrc = Crc32 (WriterCrc, Padded + (size_t)Block * BlockSize,
+                         (size_t)Run * BlockSize);
+    } else if (RunType == CHUNK_TYPE_FILL) {
+      WriterCrc = Crc32 (WriterCrc, Padded + (size_t)Block * BlockSize,
+                         BlockSize);
+    }
+  }
+
+  if (CrcMode) {
+    FileCrc = CrcMode[0] == 'i' ? ImageCrc : WriterCrc;
+    if (CrcMode[0] == 'b') {
+      FileCrc = ~FileCrc;
+    }
+    Chunk.chunk_type = CHUNK_TYPE_CRC;
+    Chunk.reserved1 = 0;
+    Chunk.chunk_sz = 0;
+    Chunk.total_sz = sizeof (Chunk) + sizeof (FileCrc);
+    Write (File, &Chunk, sizeof (Chunk));
+    Write (File, &FileCrc, sizeof (FileCrc));
+    Header.total_chunks++;
+  }
+
+  fseek (File, 0, SEEK_SET);
+  Write (File, &Header, sizeof (Header));
+  fclose (File);
+  free (Padded);
+  free (Data);
+  return 0;
+}
+
+static int Meta (int Argc, char **Argv)
+{
+  img_header_entry_t Entries[MAX_IMAGES_IN_METAIMG];
+  meta_header_t Header = {0};
+  unsigned char *Data[MAX_IMAGES_IN_METAIMG];
+  size_t Size;
+  uint32_t Offset;
+  int Count = Argc - 1;
+  FILE *File;
+  char *Sep;
+  int Index;
+
+  if (Count < 1 ||
+      Count > MAX_IMAGES_IN_METAIMG) {
+    Die ("usage: fbimg meta OUT NAME:FILE...", "");
+  }
+
+  memset (Entries, 0, sizeof (Entries));
+  Offset = sizeof (Header) + Count * sizeof (img_header_entry_t);
+  for (Index = 0; Index < Count; Index++) {
+    Sep = strchr (Argv[Index + 1], ':');
+    if (!Sep ||
+        Sep - Argv[Index + 1] >= META_PARTITION_NAME_SZ) {
+      Die ("bad image ", Argv[Index + 1]);
+    }
+    memcpy (Entries[Index].ptn_name, Argv[Index + 1], Sep - Argv[Index + 1]);
+    Data[Index] = ReadFile (Sep + 1, &Size);
+    Entries[Index].start_offset = Offset;
+    Entries[Index].size = Size;
+    Offset += Size;
+  }
+
+  Header.magic = META_HEADER_MAGIC;
+  Header.major_version = 1;
+  snprintf (Header.img_version, sizeof (Header.img_version), "fbimg");
+  Header.meta_hdr_sz = sizeof (Header);
+  Header.img_hdr_sz = Count * sizeof (img_header_entry_t);
+
+  File = fopen (Argv[0], "wb");
+  if (!File) {
+    Die ("cannot create ", Argv[0]);
+  }
+  Write (File, &Header, sizeof (Header));
+  Write (File, Entries, Count * sizeof (img_header_entry_t));
+  for (Index = 0; Index < Count; Index++) {
+    Write (File, Data[Index], Entries[Index].size);
+    free (Data[Index]);
+  }
+  fclose (File);
+  return 0;
+}
+
+int main (int Argc, char **Argv)
+{
+  if (Argc >= 2 &&
+      !strcmp (Argv[1], "gen")) {
+    return Gen (Argc - 2, Argv + 2);
+  }
+  if (Argc >= 2 &&
+      !strcmp (Argv[1], "sparse")) {
+    return Sparse (Argc - 2, Argv + 2);
+  }
+  if (Argc >= 2 &&
+      !strcmp (Argv[1], "meta")) {
+    return Meta (Argc - 2, Argv + 2);
+  }
+
+  fprintf (stderr, "usage: fbimg gen|sparse|meta ..., see %s\n", __FILE__);
+  return 2;
+}
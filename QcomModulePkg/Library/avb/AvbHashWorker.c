@@ -0,0 +1,418 @@
+/* Copyright (c) 2026, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimer in the documentation and/or other materials provided
+ *  with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Partition hashing on secondary CPUs, see hash_job_start in AvbOps, and
+ * the odd boot task from SecondaryCpuTask.h.
+ *
+ * Reads stay on the boot CPU since UEFI services are not MP safe. The
+ * workers are powered on with PSCI CPU_ON, take over the translation
+ * regime of the boot CPU and do nothing but run avb_hash_job_run (). They
+ * power themselves off with PSCI CPU_OFF when stopped, so the kernel finds
+ * the secondary CPUs the way it expects.
+ */
+
+#include "AvbHashWorker.h"
+#include <IndustryStandard/ArmStdSmc.h>
+#include <Library/ArmLib.h>
+#include <Library/ArmSmcLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/CacheMaintenanceLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/SecondaryCpuTask.h>
+#include <Library/TimerLib.h>
+
+/* Workers touch nothing but libavb hashing code and their own stack. A
+ * safe-stack build keeps the unsafe stack pointer in a global that all
+ * CPUs would share, so such builds hash on the boot CPU only.
+ */
+#if defined(__has_feature)
+#if __has_feature(safe_stack)
+#define HASH_WORKERS_UNSUPPORTED
+#endif
+#endif
+#if !defined(MDE_CPU_AARCH64)
+#define HASH_WORKERS_UNSUPPORTED
+#endif
+
+#ifndef HASH_WORKERS_UNSUPPORTED
+
+#define HASH_WORKER_STACK_SIZE SIZE_16KB
+#define HASH_WORKER_CPUS_PROBED 8
+#define HASH_WORKER_TIMEOUT_US 10000
+#define HASH_WORKER_POLL_US 10
+
+#define MPIDR_MT BIT24
+#define MPIDR_AFFINITY_MASK \
+  (ARM_CORE_AFF0 | ARM_CORE_AFF1 | ARM_CORE_AFF2 | ARM_CORE_AFF3)
+
+#define PSCI_AFFINITY_INFO_OFF 1
+
+/* Read by AvbHashWorkerEntry with the MMU off, keep the layout in sync
+ * with AArch64/AvbHashWorker.S
+ */
+typedef struct {
+  UINT64 Sctlr;
+  UINT64 Tcr;
+  UINT64 Mair;
+  UINT64 Ttbr0;
+  UINT64 Vbar;
+  UINT64 Cpacr;
+  UINT64 StackTop;
+} HASH_WORKER_CONTEXT;
+
+typedef struct {
+  HASH_WORKER_CONTEXT Context;
+  UINT64 Mpidr;
+  VOID *Stack;
+  BOOLEAN Online;
+  BOOLEAN Stop;
+  AvbHashJob *Job;
+  SECONDARY_CPU_TASK *Task;
+} HASH_WORKER;
+
+VOID
+AvbHashWorkerEntry (HASH_WORKER *Worker);
+
+VOID
+AvbHashWorkerSaveContext (HASH_WORKER_CONTEXT *Context);
+
+STATIC HASH_WORKER Workers[AVB_HASH_WORKERS_MAX];
+STATIC UINTN NumWorkers;
+
+/* Set once a worker failed to power off; its slot may still be in use */
+STATIC BOOLEAN WorkerStuck;
+
+/* Set while the workers belong to SecondaryCpuTaskStart () */
+STATIC BOOLEAN TaskStartedWorkers;
+
+STATIC INTN
+PsciCall (UINTN Function, UINTN Arg1, UINTN Arg2, UINTN Arg3)
+{
+  ARM_SMC_ARGS Args;
+
+  Args.Arg0 = Function;
+  Args.Arg1 = Arg1;
+  Args.Arg2 = Arg2;
+  Args.Arg3 = Arg3;
+  ArmCallSmc (&Args);
+  return (INTN)Args.Arg0;
+}
+
+/* Runs on the worker once its MMU is on, never returns */
+VOID
+AvbHashWorkerMain (HASH_WORKER *Worker)
+{
+  AvbHashJob *Job;
+  SECONDARY_CPU_TASK *Task;
+
+  __atomic_store_n (&Worker->Online, TRUE, __ATOMIC_RELEASE);
+  ArmCallSEV ();
+
+  for (;;) {
+    Job = __atomic_load_n (&Worker->Job, __ATOMIC_ACQUIRE);
+    Task = __atomic_load_n (&Worker->Task, __ATOMIC_ACQUIRE);
+    if (Job != NULL) {
+      avb_hash_job_run (Job);
+      __atomic_store_n (&Worker->Job, NULL, __ATOMIC_RELEASE);
+      ArmCallSEV ();
+    } else if (Task != NULL) {
+      Task->Func (Task->Context);
+      __atomic_store_n (&Worker->Task, NULL, __ATOMIC_RELEASE);
+      ArmCallSEV ();
+    } else if (__atomic_load_n (&Worker->Stop, __ATOMIC_ACQUIRE)) {
+      break;
+    } else {
+      ArmCallWFE ();
+    }
+  }
+
+  PsciCall (ARM_SMC_ID_PSCI_CPU_OFF, 0, 0, 0);
+}
+
+/* Returns TRUE if Worker is online and has nothing to do */
+STATIC BOOLEAN
+WorkerIdle (HASH_WORKER *Worker)
+{
+  return Worker->Online &&
+         __atomic_load_n (&Worker->Job, __ATOMIC_ACQUIRE) == NULL &&
+         __atomic_load_n (&Worker->Task, __ATOMIC_ACQUIRE) == NULL;
+}
+
+STATIC bool
+HashJobStart (AvbOps *Ops, AvbHashJob *Job)
+{
+  UINTN Index;
+
+  for (Index = 0; Index < NumWorkers; Index++) {
+    if (WorkerIdle (&Workers[Index])) {
+      __atomic_store_n (&Workers[Index].Job, Job, __ATOMIC_RELEASE);
+      ArmCallSEV ();
+      return true;
+    }
+  }
+  return false;
+}
+
+STATIC VOID
+HashJobWait (AvbOps *Ops, AvbHashJob *Job)
+{
+  UINTN Index;
+
+  for (Index = 0; Index < NumWorkers; Index++) {
+    while (__atomic_load_n (&Workers[Index].Job, __ATOMIC_ACQUIRE) == Job) {
+      ArmCallWFE ();
+    }
+  }
+}
+
+/* Powers on the CPU with affinity Mpidr as a worker. A CPU that does not
+ * come online in time stays in the table so StopWorkers () can still power
+ * it off.
+ */
+STATIC EFI_STATUS
+StartWorker (UINT64 Mpidr)
+{
+  HASH_WORKER *Worker = &Workers[NumWorkers];
+  UINTN Waited;
+  INTN Ret;
+
+  SetMem (Worker, sizeof (*Worker), 0);
+  Worker->Stack = AllocatePool (HASH_WORKER_STACK_SIZE);
+  if (Worker->Stack == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  AvbHashWorkerSaveContext (&Worker->Context);
+  Worker->Context.StackTop =
+      ((UINT64)Worker->Stack + HASH_WORKER_STACK_SIZE) & ~(UINT64)0xF;
+  Worker->Mpidr = Mpidr;
+
+  /* The worker reads its context before its caches are on */
+  WriteBackDataCacheRange (Worker, sizeof (*Worker));
+
+  Ret = PsciCall (ARM_SMC_ID_PSCI_CPU_ON_AARCH64, Mpidr,
+                  (UINTN)AvbHashWorkerEntry, (UINTN)Worker);
+  if (Ret != ARM_SMC_PSCI_RET_SUCCESS) {
+    FreePool (Worker->Stack);
+    return EFI_NOT_STARTED;
+  }
+  NumWorkers++;
+
+  for (Waited = 0; Waited < HASH_WORKER_TIMEOUT_US;
+       Waited += HASH_WORKER_POLL_US) {
+    if (__atomic_load_n (&Worker->Online, __ATOMIC_ACQUIRE)) {
+      return EFI_SUCCESS;
+    }
+    MicroSecondDelay (HASH_WORKER_POLL_US);
+  }
+
+  DEBUG ((EFI_D_ERROR, "Hash worker %lx did not come online\n", Mpidr));
+  return EFI_TIMEOUT;
+}
+
+/* Powers on up to Max secondary CPUs as workers, returns how many came
+ * online. StopWorkers () must run even if none did.
+ */
+STATIC UINTN
+StartWorkers (UINTN Max)
+{
+  UINT64 BootMpidr = ArmReadMpidr () & MPIDR_AFFINITY_MASK;
+  UINT64 Mpidr;
+  UINTN Shift;
+  UINTN Index;
+  UINTN Online = 0;
+  EFI_STATUS Status;
+
+  /* Cores are numbered in Aff1 when the MT bit is set, Aff0 otherwise */
+  Shift = (ArmReadMpidr () & MPIDR_MT) ? 8 : 0;
+  for (Index = 0; Index < HASH_WORKER_CPUS_PROBED; Index++) {
+    if (NumWorkers == Max) {
+      break;
+    }
+    Mpidr = (BootMpidr & ~((UINT64)0xFF << Shift)) | ((UINT64)Index << Shift);
+    if (Mpidr == BootMpidr) {
+      continue;
+    }
+    Status = StartWorker (Mpidr);
+    if (Status == EFI_TIMEOUT || Status == EFI_OUT_OF_RESOURCES) {
+      break;
+    }
+  }
+
+  for (Index = 0; Index < NumWorkers; Index++) {
+    if (Workers[Index].Online) {
+      DEBUG ((EFI_D_VERBOSE, "Hash worker %lx online\n",
+              Workers[Index].Mpidr));
+      Online++;
+    }
+  }
+  return Online;
+}
+
+STATIC VOID
+StopWorkers (VOID)
+{
+  UINTN Index;
+  UINTN Waited;
+
+  for (Index = 0; Index < NumWorkers; Index++) {
+    __atomic_store_n (&Workers[Index].Stop, TRUE, __ATOMIC_RELEASE);
+  }
+  ArmCallSEV ();
+
+  for (Index = 0; Index < NumWorkers; Index++) {
+    for (Waited = 0; Waited < HASH_WORKER_TIMEOUT_US;
+         Waited += HASH_WORKER_POLL_US) {
+      if (PsciCall (ARM_SMC_ID_PSCI_AFFINITY_INFO_AARCH64,
+                    Workers[Index].Mpidr, 0, 0) == PSCI_AFFINITY_INFO_OFF) {
+        break;
+      }
+      MicroSecondDelay (HASH_WORKER_POLL_US);
+    }
+
+    /* Only a CPU that is off is done with its stack */
+    if (Waited < HASH_WORKER_TIMEOUT_US) {
+      FreePool (Workers[Index].Stack);
+    } else {
+      DEBUG ((EFI_D_ERROR, "Hash worker %lx did not power off\n",
+              Workers[Index].Mpidr));
+      WorkerStuck = TRUE;
+    }
+  }
+  NumWorkers = 0;
+}
+
+EFI_STATUS
+AvbHashWorkersStart (AvbOps *Ops)
+{
+  if (NumWorkers != 0) {
+    return EFI_ALREADY_STARTED;
+  }
+  if (WorkerStuck) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  /* Settle the crypto extension probes before a worker can race them */
+  avb_sha256_ce_available ();
+  avb_sha512_ce_available ();
+
+  if (StartWorkers (AVB_HASH_WORKERS_MAX) == 0) {
+    return EFI_NOT_STARTED;
+  }
+
+  Ops->hash_job_start = HashJobStart;
+  Ops->hash_job_wait = HashJobWait;
+  return EFI_SUCCESS;
+}
+
+VOID
+AvbHashWorkersStop (AvbOps *Ops)
+{
+  Ops->hash_job_start = NULL;
+  Ops->hash_job_wait = NULL;
+
+  /* Leave workers a boot task brought up to that task */
+  if (!TaskStartedWorkers) {
+    StopWorkers ();
+  }
+}
+
+EFI_STATUS
+SecondaryCpuTaskStart (SECONDARY_CPU_TASK *Task)
+{
+  UINTN Index;
+
+  if (NumWorkers == 0) {
+    if (WorkerStuck) {
+      return EFI_DEVICE_ERROR;
+    }
+    if (StartWorkers (1) == 0) {
+      StopWorkers ();
+      return EFI_NOT_STARTED;
+    }
+    TaskStartedWorkers = TRUE;
+  }
+
+  for (Index = 0; Index < NumWorkers; Index++) {
+    if (WorkerIdle (&Workers[Index])) {
+      __atomic_store_n (&Workers[Index].Task, Task, __ATOMIC_RELEASE);
+      ArmCallSEV ();
+      return EFI_SUCCESS;
+    }
+  }
+  return EFI_NOT_READY;
+}
+
+VOID
+SecondaryCpuTaskWait (SECONDARY_CPU_TASK *Task)
+{
+  UINTN Index;
+
+  for (Index = 0; Index < NumWorkers; Index++) {
+    while (__atomic_load_n (&Workers[Index].Task, __ATOMIC_ACQUIRE) == Task) {
+      ArmCallWFE ();
+    }
+  }
+
+  if (!TaskStartedWorkers) {
+    return;
+  }
+  for (Index = 0; Index < NumWorkers; Index++) {
+    if (__atomic_load_n (&Workers[Index].Task, __ATOMIC_ACQUIRE) != NULL) {
+      return;
+    }
+  }
+  StopWorkers ();
+  TaskStartedWorkers = FALSE;
+}
+
+#else
+
+EFI_STATUS
+AvbHashWorkersStart (AvbOps *Ops)
+{
+  return EFI_UNSUPPORTED;
+}
+
+VOID
+AvbHashWorkersStop (AvbOps *Ops)
+{
+}
+
+EFI_STATUS
+SecondaryCpuTaskStart (SECONDARY_CPU_TASK *Task)
+{
+  return EFI_UNSUPPORTED;
+}
+
+VOID
+SecondaryCpuTaskWait (SECONDARY_CPU_TASK *Task)
+{
+}
+
+#endif
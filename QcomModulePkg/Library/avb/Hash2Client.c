@@ -28,6 +28,7 @@
 
 #include "VerifiedBoot.h"
 #include "avb_sha.h"
+#include <Library/ArmLib.h>
 #include <Library/BaseLib.h>
 #include <Library/BaseMemoryLib.h>
 #include <Library/DebugLib.h>
@@ -35,10 +36,51 @@
 #include <Protocol/Hash2.h>
 #include <Uefi.h>
 
+/* ID_AA64ISAR0_EL1.SHA2, read once; MAX_UINTN until then */
+STATIC UINTN Sha2CeLevel = MAX_UINTN;
+
+STATIC UINTN
+GetSha2CeLevel (VOID)
+{
+#if defined(MDE_CPU_AARCH64)
+  if (Sha2CeLevel == MAX_UINTN) {
+    Sha2CeLevel = (ArmReadIdAa64Isar0 () & AARCH64_ISAR0_SHA2_MASK) >>
+                  AARCH64_ISAR0_SHA2_SHIFT;
+    DEBUG ((EFI_D_VERBOSE, "SHA2 crypto extension level: %u\n",
+            (UINT32)Sha2CeLevel));
+  }
+  return Sha2CeLevel;
+#else
+  return 0;
+#endif
+}
+
+bool
+avb_sha256_ce_available (void)
+{
+#if defined(MDE_CPU_AARCH64)
+  return GetSha2CeLevel () >= AARCH64_ISAR0_SHA2_256;
+#else
+  return false;
+#endif
+}
+
+bool
+avb_sha512_ce_available (void)
+{
+#if defined(MDE_CPU_AARCH64)
+  return GetSha2CeLevel () >= AARCH64_ISAR0_SHA2_512;
+#else
+  return false;
+#endif
+}
+
 /*
   Initializes the SHA-256 context.
   Ctx cannot be NULL here, it is caller's responsibility
   to ensure Ctx is not NULL.
+  The SHA-256 instructions are preferred when the CPU has them, then the
+  Hash2 protocol, then the portable C implementation.
 */
 void
 avb_sha256_init (AvbSHA256Ctx *Ctx)
@@ -46,6 +88,14 @@ avb_sha256_init (AvbSHA256Ctx *Ctx)
   EFI_STATUS Status = EFI_SUCCESS;
   EFI_HASH2_PROTOCOL *pEfiHash2Protocol = NULL;
 
+  Ctx->software = false;
+  Ctx->user_data = NULL;
+
+  if (avb_sha256_ce_available ()) {
+    Status = EFI_UNSUPPORTED;
+    goto out;
+  }
+
   GUARD_OUT (gBS->LocateProtocol (&gEfiHash2ProtocolGuid, NULL,
                                   (VOID **)&pEfiHash2Protocol));
 
@@ -56,7 +106,13 @@ avb_sha256_init (AvbSHA256Ctx *Ctx)
 
 out:
   if (Status != EFI_SUCCESS) {
+    if (Status != EFI_UNSUPPORTED) {
+      DEBUG ((EFI_D_INFO, "Hash2 SHA-256 unavailable: %r, using software\n",
+              Status));
+    }
     Ctx->user_data = NULL;
+    Ctx->software = true;
+    avb_sha256_sw_init (Ctx);
   }
 }
 
@@ -76,6 +132,11 @@ avb_sha256_update (AvbSHA256Ctx *Ctx, const uint8_t *Data, uint32_t Len)
     return;
   }
 
+  if (Ctx->software) {
+    avb_sha256_sw_update (Ctx, Data, Len);
+    return;
+  }
+
   pEfiHash2Protocol = Ctx->user_data;
   if (pEfiHash2Protocol == NULL) {
     DEBUG ((EFI_D_ERROR, "avb_sha256_update failed, Ctx->user_data is NULL\n"));
@@ -100,6 +161,10 @@ avb_sha256_final (AvbSHA256Ctx *Ctx)
   EFI_HASH2_OUTPUT Hash2Output;
   EFI_HASH2_PROTOCOL *pEfiHash2Protocol = NULL;
 
+  if (Ctx->software) {
+    return avb_sha256_sw_final (Ctx);
+  }
+
   pEfiHash2Protocol = Ctx->user_data;
   if (pEfiHash2Protocol == NULL) {
     DEBUG ((EFI_D_ERROR, "avb_sha256_final failed, Ctx->user_data is NULL\n"));
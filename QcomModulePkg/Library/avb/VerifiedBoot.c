@@ -27,9 +27,11 @@
 */
 
 #include "VerifiedBoot.h"
+#include "AvbHashWorker.h"
 #include "BootLinux.h"
 #include "KeymasterClient.h"
 #include "libavb/libavb.h"
+#include <Library/BootStats.h>
 #include <Library/MenuKeysDetection.h>
 #include <Library/VerifiedBootMenu.h>
 #include <Library/LEOEMCertificate.h>
@@ -280,8 +282,11 @@ IsRootCmdLineUpdated (BootInfo *Info)
 }
 
 
+/* ScatterLoad lets LoadImage leave the ramdisk on the partition; only for
+ * callers that never look at the whole boot image buffer.
+ */
 STATIC EFI_STATUS
-LoadImageNoAuth (BootInfo *Info)
+LoadImageNoAuth (BootInfo *Info, BOOLEAN ScatterLoad)
 {
   EFI_STATUS Status = EFI_SUCCESS;
   CHAR16 Pname[MAX_GPT_NAME_SIZE];
@@ -294,7 +299,8 @@ LoadImageNoAuth (BootInfo *Info)
   Status = LoadImage (Info->BootIntoRecovery,
                       Info->Pname,
                       (VOID **)&(Info->Images[0].ImageBuffer),
-                      (UINT32 *)&(Info->Images[0].ImageSize));
+                      (UINT32 *)&(Info->Images[0].ImageSize),
+                      ScatterLoad ? &Info->RamdiskDeferred : NULL);
   if (Status != EFI_SUCCESS) {
     DEBUG ((EFI_D_ERROR, "ERROR: Failed to load image from partition: %r\n",
             Status));
@@ -366,7 +372,7 @@ LoadImageNoAuthWrapper (BootInfo *Info)
   UINT32 SystemPathLen = 0;
 
   GUARD (VBAllocateCmdLine (Info));
-  GUARD (LoadImageNoAuth (Info));
+  GUARD (LoadImageNoAuth (Info, TRUE));
 
    if (!IsDynamicPartitionSupport () &&
         !IsRootCmdLineUpdated (Info)) {
@@ -398,7 +404,7 @@ LoadImageAndAuthVB1 (BootInfo *Info)
 
   GUARD (VBCommonInit (Info));
   GUARD (VBAllocateCmdLine (Info));
-  GUARD (LoadImageNoAuth (Info));
+  GUARD (LoadImageNoAuth (Info, FALSE));
 
   device_info_vb_t DevInfo_vb;
   DevInfo_vb.is_unlocked = IsUnlocked ();
@@ -837,6 +843,7 @@ STATIC EFI_STATUS
 LoadImageAndAuthVB2 (BootInfo *Info)
 {
   EFI_STATUS Status = EFI_SUCCESS;
+  UINT32 Span;
   AvbSlotVerifyResult Result;
   AvbSlotVerifyData *SlotData = NULL;
   VB2Data *VBData = NULL;
@@ -884,6 +891,14 @@ LoadImageAndAuthVB2 (BootInfo *Info)
     Status = EFI_OUT_OF_RESOURCES;
     goto out;
   }
+  /* Lets a repeated avb_slot_verify skip what the first call verified,
+   * the cache is optional so a failed allocation is not an error.
+   */
+  Ops->slot_verify_cache = avb_slot_verify_cache_new ();
+#ifdef AVB_PARALLEL_HASH
+  /* Without workers the partitions are hashed on this CPU */
+  AvbHashWorkersStart (Ops);
+#endif
   UserData->IsMultiSlot = Info->MultiSlotBoot;
 
   if (Info->MultiSlotBoot) {
@@ -930,8 +945,10 @@ LoadImageAndAuthVB2 (BootInfo *Info)
            Info->BootIntoRecovery) {
     AddRequestedPartition (RequestedPartitionAll, IMG_RECOVERY);
     NumRequestedPartition += 1;
+    Span = BootStatsSpanBegin ("avb_slot_verify");
     Result = avb_slot_verify (Ops, (CONST CHAR8 *CONST *)RequestedPartition,
                SlotSuffix, VerifyFlags, VerityFlags, &SlotData);
+    BootStatsSpanEnd (Span);
     if (AllowVerificationError &&
                ResultShouldContinue (Result)) {
       DEBUG ((EFI_D_ERROR, "State: Unlocked, AvbSlotVerify returned "
@@ -956,10 +973,13 @@ LoadImageAndAuthVB2 (BootInfo *Info)
        AddRequestedPartition (RequestedPartitionAll, IMG_DTBO);
        NumRequestedPartition += 1;
        if (SlotData != NULL) {
-          avb_slot_verify_data_free (SlotData);
+          /* Hand the verified images over for the second pass */
+          avb_slot_verify_cache_adopt (Ops->slot_verify_cache, SlotData);
        }
+       Span = BootStatsSpanBegin ("avb_slot_verify");
        Result = avb_slot_verify (Ops, (CONST CHAR8 *CONST *)RequestedPartition,
                   SlotSuffix, VerifyFlags, VerityFlags, &SlotData);
+       BootStatsSpanEnd (Span);
     }
   } else {
     if (!Info->NumLoadedImages) {
@@ -990,10 +1010,19 @@ LoadImageAndAuthVB2 (BootInfo *Info)
       AddRequestedPartition (RequestedPartitionAll, IMG_VMLINUX);
       NumRequestedPartition += 1;
     }
+    Span = BootStatsSpanBegin ("avb_slot_verify");
     Result = avb_slot_verify (Ops, (CONST CHAR8 *CONST *)RequestedPartition,
                 SlotSuffix, VerifyFlags, VerityFlags, &SlotData);
+    BootStatsSpanEnd (Span);
   }
 
+  avb_slot_verify_cache_free (Ops->slot_verify_cache);
+  Ops->slot_verify_cache = NULL;
+  AvbOpsFlushReadCache (Ops);
+#ifdef AVB_PARALLEL_HASH
+  AvbHashWorkersStop (Ops);
+#endif
+
   if (SlotData == NULL) {
     Status = EFI_LOAD_ERROR;
     Info->BootState = RED;
@@ -1144,6 +1173,9 @@ out:
       avb_slot_verify_data_free (SlotData);
     }
     if (Ops != NULL) {
+#ifdef AVB_PARALLEL_HASH
+      AvbHashWorkersStop (Ops);
+#endif
       AvbOpsFree (Ops);
     }
     if (UserData != NULL) {
@@ -1266,7 +1298,7 @@ STATIC EFI_STATUS LoadImageAndAuthForLE (BootInfo *Info)
     /*Load image*/
     GUARD (VBAllocateCmdLine (Info));
     GUARD (VBCommonInit (Info));
-    GUARD (LoadImageNoAuth (Info));
+    GUARD (LoadImageNoAuth (Info, FALSE));
 
     Status = IsSecureDevice (&SecureDevice);
     if (Status != EFI_SUCCESS) {
@@ -1356,8 +1388,8 @@ skip_verification:
     return Status;
 }
 
-EFI_STATUS
-LoadImageAndAuth (BootInfo *Info)
+STATIC EFI_STATUS
+LoadImageAndAuthImage (BootInfo *Info)
 {
   EFI_STATUS Status = EFI_SUCCESS;
   BOOLEAN MdtpActive = FALSE;
@@ -1471,6 +1503,19 @@ LoadImageAndAuth (BootInfo *Info)
   return Status;
 }
 
+EFI_STATUS
+LoadImageAndAuth (BootInfo *Info)
+{
+  EFI_STATUS Status;
+  UINT32 Span;
+
+  Span = BootStatsSpanBegin ("LoadImageAndAuth");
+  Status = LoadImageAndAuthImage (Info);
+  BootStatsSpanEnd (Span);
+
+  return Status;
+}
+
 VOID
 FreeVerifiedBootResource (BootInfo *Info)
 {
@@ -58,18 +58,20 @@
 #include "avb_sysdeps.h"
 #include "libavb.h"
 #include <Library/BaseLib.h>
+#include <Library/BootStats.h>
 #include <Library/BaseMemoryLib.h>
 #include <Library/DebugLib.h>
 #include <Library/MemoryAllocationLib.h>
 #include <Uefi.h>
 
-STATIC AvbIOResult GetHandleInfo(const char *Partition, HandleInfo *HandleInfo)
+STATIC AvbIOResult GetHandleInfo(const char *Partition, HandleInfo *Info)
 {
 	EFI_STATUS Status = EFI_SUCCESS;
 	CHAR16 UnicodePartition[MAX_GPT_NAME_SIZE] = {0};
 	UINT32 BlkIOAttrib = 0;
 	PartiSelectFilter HandleFilter = {0};
 	UINT32 MaxHandles = 1;
+	HandleInfo *CachedInfo = NULL;
 
 	if ((AsciiStrLen(Partition) + 1) > ARRAY_SIZE(UnicodePartition)) {
 		DEBUG((EFI_D_ERROR,
@@ -79,6 +81,12 @@ STATIC AvbIOResult GetHandleInfo(const char *Partition, HandleInfo *HandleInfo)
 
 	AsciiStrToUnicodeStr(Partition, UnicodePartition);
 
+	if (GetPartitionHandleInfo(UnicodePartition, &CachedInfo) ==
+	    EFI_SUCCESS) {
+		*Info = *CachedInfo;
+		return AVB_IO_RESULT_OK;
+	}
+
 	HandleFilter.RootDeviceType = NULL;
 	HandleFilter.PartitionLabel = NULL;
 	HandleFilter.VolumeName = 0;
@@ -89,7 +97,7 @@ STATIC AvbIOResult GetHandleInfo(const char *Partition, HandleInfo *HandleInfo)
 	BlkIOAttrib |= BLK_IO_SEL_MATCH_PARTITION_LABEL;
 	HandleFilter.PartitionLabel = UnicodePartition;
 
-	Status = GetBlkIOHandles(BlkIOAttrib, &HandleFilter, HandleInfo, &MaxHandles);
+	Status = GetBlkIOHandles(BlkIOAttrib, &HandleFilter, Info, &MaxHandles);
 
 	if (Status != EFI_SUCCESS) {
 		DEBUG((EFI_D_ERROR,
@@ -126,27 +134,273 @@ static AvbPartitionDetails SupportedPartitions[] =
   { "recovery", &gEfiRecoveryImgPartitionGuid} ,
 };
 
+/* libavb reads footers, vbmeta headers and whole vbmeta images in many
+ * small, mostly unaligned pieces. Reads spanning at most
+ * AVB_READ_CACHE_SPAN_MAX blocks are served from a small LRU cache of
+ * blocks, missing blocks are fetched with one ReadBlocks per run. Larger
+ * reads only go through the cache for their unaligned head and tail.
+ * Everything lives as long as the AvbOps it belongs to.
+ */
+#define AVB_READ_CACHE_BLOCKS 32
+#define AVB_READ_CACHE_SPAN_MAX 16
+
+typedef struct {
+	EFI_BLOCK_IO_PROTOCOL *BlockIo;
+	EFI_LBA Lba;
+	UINT64 LastUse; /* 0 while the entry is unused */
+	UINT32 Size;
+	UINT8 *Data;
+} AvbCachedBlock;
+
+typedef struct {
+	AvbOps Ops; /* Must be first, AvbOps pointers are cast back */
+	AvbCachedBlock Blocks[AVB_READ_CACHE_BLOCKS];
+	UINT64 Tick;
+	UINT8 *Bounce;
+	UINT32 BounceSize;
+	UINT32 Hits;
+	UINT32 Misses;
+	UINT32 BlockReads;
+} AvbOpsPrivate;
+
+/* Gets the BlockIo of Partition from the partition table handle cache, if it
+ * is there with type PType.
+ */
+STATIC BOOLEAN GetCachedTypedBlockIo(const char *Partition, EFI_GUID *PType,
+                                     EFI_BLOCK_IO_PROTOCOL **BlockIo)
+{
+	CHAR16 UnicodePartition[MAX_GPT_NAME_SIZE] = {0};
+	HandleInfo *CachedInfo = NULL;
+	EFI_PARTITION_ENTRY *PartEntry = NULL;
+
+	if ((AsciiStrLen(Partition) + 1) > ARRAY_SIZE(UnicodePartition)) {
+		return FALSE;
+	}
+	AsciiStrToUnicodeStr(Partition, UnicodePartition);
+
+	if (GetPartitionHandleInfo(UnicodePartition, &CachedInfo) !=
+	        EFI_SUCCESS ||
+	    gBS->HandleProtocol(CachedInfo->Handle, &gEfiPartitionRecordGuid,
+	                        (VOID **)&PartEntry) != EFI_SUCCESS ||
+	    !CompareGuid(&PartEntry->PartitionTypeGUID, PType)) {
+		return FALSE;
+	}
+
+	*BlockIo = CachedInfo->BlkIo;
+	return TRUE;
+}
+
+/* Partitions are found through GetPartitionHandleInfo's cache, which is
+ * rebuilt whenever the partitions are enumerated again, and only looked up
+ * on the BlockIo handles when they are not in it.
+ */
+STATIC AvbIOResult GetPartitionBlockIo(const char *Partition,
+                                       EFI_BLOCK_IO_PROTOCOL **BlockIo)
+{
+	AvbIOResult Result = AVB_IO_RESULT_OK;
+	EFI_STATUS Status = EFI_SUCCESS;
+	HandleInfo InfoList[1];
+	UINT32 BlkIOAttrib = 0;
+	PartiSelectFilter HandleFilter;
+	UINT32 MaxHandles = 0;
+	AvbPartitionDetails *List = SupportedPartitions;
+	UINT32 Count = ARRAY_SIZE (SupportedPartitions);
+	EFI_GUID *PType = NULL;
+	UINTN Index;
+
+	for (Index = 0; Index < Count; Index++) {
+		if (!AsciiStrCmp (List[Index].Name, Partition)) {
+			DEBUG ((EFI_D_VERBOSE, "Partition found: %a\n", Partition));
+			PType = List[Index].Guid;
+		}
+	}
+
+	if (PType &&
+	    GetCachedTypedBlockIo (Partition, PType, BlockIo)) {
+		return AVB_IO_RESULT_OK;
+	}
+
+	if (PType) {
+		BlkIOAttrib = BLK_IO_SEL_PARTITIONED_GPT;
+		BlkIOAttrib |= BLK_IO_SEL_MEDIA_TYPE_NON_REMOVABLE;
+		BlkIOAttrib |= BLK_IO_SEL_MATCH_PARTITION_TYPE_GUID;
+
+		HandleFilter.RootDeviceType = NULL;
+		HandleFilter.PartitionType = PType;
+		HandleFilter.VolumeName = NULL;
+
+		MaxHandles = ARRAY_SIZE (InfoList);
+
+		Status = GetBlkIOHandles (BlkIOAttrib, &HandleFilter,
+		                          InfoList, &MaxHandles);
+		if (Status != EFI_SUCCESS) {
+			DEBUG ((EFI_D_INFO,
+			        "GetBlkIOHandles failed with error: %d\n", Status));
+			return AVB_IO_RESULT_ERROR_IO;
+		}
+		if (MaxHandles == 0) {
+			DEBUG ((EFI_D_INFO, "Partition Not found: %a\n", Partition));
+			return AVB_IO_RESULT_ERROR_NO_SUCH_PARTITION;
+		}
+		if (MaxHandles != 1) {
+			/* Unable to deterministically load from single partition */
+			DEBUG ((EFI_D_INFO,
+			        "multiple partitions found: %a\n", Partition));
+			return AVB_IO_RESULT_ERROR_IO;
+		}
+	} else {
+		Result = GetHandleInfo (Partition, InfoList);
+		if (Result != AVB_IO_RESULT_OK) {
+			DEBUG ((EFI_D_ERROR,
+			        "AvbReadFromPartition: GetHandleInfo failed\n"));
+			return Result;
+		}
+	}
+
+	*BlockIo = InfoList[0].BlkIo;
+	return AVB_IO_RESULT_OK;
+}
+
+STATIC AvbCachedBlock *FindCachedBlock(AvbOpsPrivate *Priv,
+                                       EFI_BLOCK_IO_PROTOCOL *BlockIo,
+                                       EFI_LBA Lba)
+{
+	UINTN Index;
+
+	for (Index = 0; Index < AVB_READ_CACHE_BLOCKS; Index++) {
+		AvbCachedBlock *Block = &Priv->Blocks[Index];
+		if (Block->LastUse != 0 && Block->BlockIo == BlockIo &&
+		    Block->Lba == Lba) {
+			Block->LastUse = ++Priv->Tick;
+			return Block;
+		}
+	}
+	return NULL;
+}
+
+/* Caches |Data|, evicting the least recently used block if needed. The
+ * cache is best effort, nothing happens if there is no memory for it.
+ */
+STATIC VOID InsertCachedBlock(AvbOpsPrivate *Priv,
+                              EFI_BLOCK_IO_PROTOCOL *BlockIo,
+                              EFI_LBA Lba, CONST UINT8 *Data, UINT32 Size)
+{
+	AvbCachedBlock *Victim = &Priv->Blocks[0];
+	UINTN Index;
+
+	for (Index = 1; Index < AVB_READ_CACHE_BLOCKS; Index++) {
+		if (Priv->Blocks[Index].LastUse < Victim->LastUse) {
+			Victim = &Priv->Blocks[Index];
+		}
+	}
+
+	if (Victim->Size != Size) {
+		if (Victim->Data != NULL) {
+			avb_free(Victim->Data);
+		}
+		Victim->LastUse = 0;
+		Victim->Size = 0;
+		Victim->Data = avb_malloc(Size);
+		if (Victim->Data == NULL) {
+			return;
+		}
+		Victim->Size = Size;
+	}
+
+	avb_memcpy(Victim->Data, Data, Size);
+	Victim->BlockIo = BlockIo;
+	Victim->Lba = Lba;
+	Victim->LastUse = ++Priv->Tick;
+}
+
+/* Copies |NumBytes| at |Offset| into |Buffer| through the block cache.
+ * The range must span at most AVB_READ_CACHE_SPAN_MAX blocks.
+ */
+STATIC AvbIOResult ReadCachedSpan(AvbOpsPrivate *Priv,
+                                  EFI_BLOCK_IO_PROTOCOL *BlockIo,
+                                  UINT64 Offset, UINT64 NumBytes,
+                                  UINT8 *Buffer)
+{
+	EFI_STATUS Status = EFI_SUCCESS;
+	UINT32 BlockSize = BlockIo->Media->BlockSize;
+	EFI_LBA StartBlock = Offset / BlockSize;
+	EFI_LBA EndBlock = (Offset + NumBytes - 1) / BlockSize;
+	EFI_LBA Lba = StartBlock;
+	EFI_LBA RunEnd;
+	AvbCachedBlock *Block;
+	CONST UINT8 *Data;
+	UINT64 PieceStart;
+	UINT64 PieceEnd;
+
+	if (Priv->BounceSize < AVB_READ_CACHE_SPAN_MAX * BlockSize) {
+		if (Priv->Bounce != NULL) {
+			avb_free(Priv->Bounce);
+		}
+		Priv->BounceSize = 0;
+		Priv->Bounce = avb_malloc(AVB_READ_CACHE_SPAN_MAX * BlockSize);
+		if (Priv->Bounce == NULL) {
+			DEBUG((EFI_D_ERROR, "Allocate for partial read failed!\n"));
+			return AVB_IO_RESULT_ERROR_OOM;
+		}
+		Priv->BounceSize = AVB_READ_CACHE_SPAN_MAX * BlockSize;
+	}
+
+	while (Lba <= EndBlock) {
+		Block = FindCachedBlock(Priv, BlockIo, Lba);
+		if (Block != NULL) {
+			Priv->Hits++;
+			Data = Block->Data;
+			RunEnd = Lba;
+		} else {
+			/* Fetch this block and the missing ones right after it
+			 * with a single read.
+			 */
+			RunEnd = Lba;
+			while (RunEnd < EndBlock &&
+			       FindCachedBlock(Priv, BlockIo, RunEnd + 1) == NULL) {
+				RunEnd++;
+			}
+			Status = BlockIo->ReadBlocks(BlockIo, BlockIo->Media->MediaId,
+			                             Lba, (RunEnd - Lba + 1) * BlockSize,
+			                             Priv->Bounce);
+			Priv->BlockReads++;
+			if (Status != EFI_SUCCESS) {
+				DEBUG((EFI_D_ERROR, "ReadBlocks failed %r\n", Status));
+				return AVB_IO_RESULT_ERROR_IO;
+			}
+			Priv->Misses += RunEnd - Lba + 1;
+			Data = Priv->Bounce;
+		}
+
+		for (; Lba <= RunEnd; Lba++, Data += BlockSize) {
+			if (Block == NULL) {
+				InsertCachedBlock(Priv, BlockIo, Lba, Data, BlockSize);
+			}
+			PieceStart = MAX (Offset, Lba * BlockSize);
+			PieceEnd = MIN (Offset + NumBytes, (Lba + 1) * BlockSize);
+			avb_memcpy(Buffer + (PieceStart - Offset),
+			           Data + (PieceStart - Lba * BlockSize),
+			           PieceEnd - PieceStart);
+		}
+	}
+
+	return AVB_IO_RESULT_OK;
+}
+
 AvbIOResult AvbReadFromPartition(AvbOps *Ops, const char *Partition, int64_t ReadOffset,
                      size_t NumBytes, void *Buffer, size_t *OutNumRead)
 {
+	AvbOpsPrivate *Priv = (AvbOpsPrivate *)Ops;
 	AvbIOResult Result = AVB_IO_RESULT_OK;
 	EFI_STATUS Status = EFI_SUCCESS;
-	VOID *Page = NULL;
-        UINTN Offset = 0;
-	HandleInfo InfoList[1];
+	UINTN Offset = 0;
 	EFI_BLOCK_IO_PROTOCOL *BlockIo = NULL;
 	UINTN PartitionSize = 0;
-	UINT32 PageSize = 0;
-        UINT64 StartBlock = 0;
-        UINT64 LastBlock = 0;
-        UINT64 FullBlock = 0;
-        UINT64 StartPageReadSize = 0;
-        UINT32 BlkIOAttrib = 0;
-        PartiSelectFilter HandleFilter;
-        UINT32 MaxHandles = 0;
-        AvbPartitionDetails *List = SupportedPartitions;
-        UINT32 Count = ARRAY_SIZE (SupportedPartitions);
-        EFI_GUID *PType = NULL;
+	UINT32 BlockSize = 0;
+	UINT64 StartBlock = 0;
+	UINT64 EndBlock = 0;
+	UINT64 HeadSize = 0;
+	UINT64 TailSize = 0;
 
 	if (Partition == NULL || Buffer == NULL || OutNumRead == NULL || NumBytes <= 0) {
 		DEBUG((EFI_D_ERROR, "bad input paramaters\n"));
@@ -155,58 +409,11 @@ AvbIOResult AvbReadFromPartition(AvbOps *Ops, const char *Partition, int64_t Rea
 	}
 	*OutNumRead = 0;
 
-        for (size_t Index = 0; Index < Count; Index++) {
-                if (!AsciiStrCmp (List[Index].Name, Partition)) {
-                             DEBUG ((EFI_D_INFO,
-                                  "Partition found: %a\n", Partition));
-                             PType = List[Index].Guid;
-                 }
-        }
-
-        if (PType) {
-                BlkIOAttrib = BLK_IO_SEL_PARTITIONED_GPT;
-                BlkIOAttrib |= BLK_IO_SEL_MEDIA_TYPE_NON_REMOVABLE;
-                BlkIOAttrib |= BLK_IO_SEL_MATCH_PARTITION_TYPE_GUID;
-
-                HandleFilter.RootDeviceType = NULL;
-                HandleFilter.PartitionType = PType;
-                HandleFilter.VolumeName = NULL;
-
-                MaxHandles = ARRAY_SIZE (InfoList);
-
-                Status = GetBlkIOHandles (BlkIOAttrib, &HandleFilter,
-                           InfoList, &MaxHandles);
-                if (Status == EFI_SUCCESS) {
-                        if (MaxHandles == 0) {
-                            DEBUG ((EFI_D_INFO,
-                            "Partition Not found: %s\n", Partition));
-                            Result = AVB_IO_RESULT_ERROR_NO_SUCH_PARTITION;
-                            goto out;
-                }
-
-                if (MaxHandles != 1) {
-                /* Unable to deterministically load from single partition */
-                             DEBUG ((EFI_D_INFO,
-                             "multiple partitions found: %s\n", Partition));
-                              Result = AVB_IO_RESULT_ERROR_IO;
-                              goto out;
-                     }
-                 } else {
-                      DEBUG ((EFI_D_INFO,
-                       "GetBlkIOHandles failed with error: %d\n", Status));
-                        Result = AVB_IO_RESULT_ERROR_IO;
-                        goto out;
-               }
-          } else {
-                Result = GetHandleInfo (Partition, InfoList);
-                if (Result != AVB_IO_RESULT_OK) {
-                      DEBUG ((EFI_D_ERROR,
-                       "AvbGetSizeOfPartition: GetHandleInfo failed"));
-                      goto out;
-           }
-       }
-
-	BlockIo = InfoList[0].BlkIo;
+	Result = GetPartitionBlockIo(Partition, &BlockIo);
+	if (Result != AVB_IO_RESULT_OK) {
+		goto out;
+	}
+
 	PartitionSize = (BlockIo->Media->LastBlock + 1) * BlockIo->Media->BlockSize;
 
 	if (ReadOffset < 0) {
@@ -233,6 +440,9 @@ AvbIOResult AvbReadFromPartition(AvbOps *Ops, const char *Partition, int64_t Rea
 	if (NumBytes > PartitionSize - Offset) {
 		NumBytes = PartitionSize - Offset;
 	}
+	if (NumBytes == 0) {
+		goto out;
+	}
 
 	DEBUG((EFI_D_VERBOSE,
 	       "read from %a, 0x%x bytes at Offset 0x%x, partition size 0x%x\n",
@@ -240,125 +450,56 @@ AvbIOResult AvbReadFromPartition(AvbOps *Ops, const char *Partition, int64_t Rea
 
 	/* |NumBytes| and or |Offset| can be unaligned to block size/page size.
 	 */
-	PageSize = BlockIo->Media->BlockSize;
-	Page = avb_malloc(PageSize);
-	if (Page == NULL) {
-		DEBUG((EFI_D_ERROR, "Allocate for partial read failed!"));
-		Result = AVB_IO_RESULT_ERROR_OOM;
+	BlockSize = BlockIo->Media->BlockSize;
+	StartBlock = Offset / BlockSize;
+	EndBlock = (Offset + NumBytes - 1) / BlockSize;
+	if (EndBlock > BlockIo->Media->LastBlock) {
+		DEBUG((EFI_D_ERROR, "EndBlock 0x%llx outside range.\n", EndBlock));
+		Result = AVB_IO_RESULT_ERROR_RANGE_OUTSIDE_PARTITION;
 		goto out;
 	}
 
-	StartBlock = Offset / PageSize;
-	LastBlock = (NumBytes + Offset) / PageSize;
-	FullBlock = StartBlock;
-	StartPageReadSize = 0;
-
-	if (Offset % PageSize != 0) {
-		/* Offset not aligned to PageSize*/
-                UINT64 StartPageReadOffset = Offset - (StartBlock * PageSize);
-
-		if (StartBlock == LastBlock) {
-			/* Offset & Offset + NumBytes are in same block */
-			StartPageReadSize = NumBytes;
-		} else {
-			StartPageReadSize = PageSize - StartPageReadOffset;
-			FullBlock++;
-		}
-
-		DEBUG((EFI_D_VERBOSE,
-                       "StartBlock 0x%llx, ReadOffset 0x%llx, read_size 0x%x\n",
-		       StartBlock, StartPageReadOffset, StartPageReadSize));
-		if (StartPageReadSize <= 0 || StartPageReadOffset >= PageSize ||
-		    StartPageReadSize > PageSize - StartPageReadOffset ||
-		    StartPageReadSize > NumBytes ||
-		    StartBlock > BlockIo->Media->LastBlock) {
-			DEBUG((EFI_D_ERROR,
-                               "StartBlock 0x%llx, ReadOffset 0x%llx,"
-                                "read_size 0x%x outside range.\n",
-			       StartBlock, StartPageReadOffset, StartPageReadSize));
-			Result = AVB_IO_RESULT_ERROR_RANGE_OUTSIDE_PARTITION;
-			goto out;
-		}
-
-		Status = BlockIo->ReadBlocks(BlockIo, BlockIo->Media->MediaId,
-		                             StartBlock, PageSize, Page);
-		if (Status == EFI_SUCCESS) {
-			avb_memcpy(Buffer, Page + StartPageReadOffset, StartPageReadSize);
-			*OutNumRead += StartPageReadSize;
-		} else {
-			*OutNumRead = 0;
-			DEBUG((EFI_D_ERROR, "ReadBlocks failed %d\n", Status));
-			goto out;
+	if (EndBlock - StartBlock < AVB_READ_CACHE_SPAN_MAX) {
+		Result = ReadCachedSpan(Priv, BlockIo, Offset, NumBytes, Buffer);
+		if (Result == AVB_IO_RESULT_OK) {
+			*OutNumRead = NumBytes;
 		}
+		goto out;
 	}
 
-	if (*OutNumRead < NumBytes && (NumBytes + Offset) % PageSize != 0) {
-		/* NumBytes + Offset not aligned to PageSize*/
-		/* Offset for last block is always zero, start at Page boundary
-		 */
-                UINT64 LastPageReadOffset = 0;
-                UINT64 LastPageReadSize =
-                       (Offset + NumBytes) - (LastBlock * PageSize);
-
-		DEBUG((EFI_D_VERBOSE,
-                       "LastBlock 0x%llx, ReadOffset 0x%llx, read_size 0x%x\n",
-		       LastBlock, LastPageReadOffset, LastPageReadSize));
-
-		if (LastPageReadSize <= 0 || LastPageReadSize >= PageSize ||
-		    LastPageReadSize > (NumBytes - *OutNumRead) ||
-		    LastBlock > BlockIo->Media->LastBlock) {
-			DEBUG((EFI_D_ERROR,
-                               "LastBlock 0x%llx, ReadOffset 0x%llx, read_size "
-			       "0x%x outside range.\n",
-			       LastBlock, LastPageReadOffset, LastPageReadSize));
-			Result = AVB_IO_RESULT_ERROR_RANGE_OUTSIDE_PARTITION;
-			goto out;
-		}
-
-		Status = BlockIo->ReadBlocks(BlockIo, BlockIo->Media->MediaId,
-		                             LastBlock, PageSize, Page);
-		if (Status == EFI_SUCCESS) {
-			avb_memcpy(Buffer + (NumBytes - LastPageReadSize), Page,
-			           LastPageReadSize);
-			*OutNumRead += LastPageReadSize;
-		} else {
-			*OutNumRead = 0;
-			DEBUG((EFI_D_ERROR, "ReadBlocks failed %d\n", Status));
+	/* Large read: the partial blocks at either end go through the cache,
+	 * the full blocks in between are read straight into |Buffer|.
+	 */
+	if (Offset % BlockSize != 0) {
+		HeadSize = BlockSize - (Offset % BlockSize);
+		Result = ReadCachedSpan(Priv, BlockIo, Offset, HeadSize, Buffer);
+		if (Result != AVB_IO_RESULT_OK) {
 			goto out;
 		}
 	}
 
-	if (*OutNumRead < NumBytes) {
-		/* full block reads */
-                UINT64 FillPageReadSize = NumBytes - *OutNumRead;
-
-		if ((FillPageReadSize % PageSize) != 0 ||
-		    FullBlock > BlockIo->Media->LastBlock ||
-		    (NumBytes - StartPageReadSize) < FillPageReadSize) {
-			DEBUG((EFI_D_ERROR,
-                               "FullBlock 0x%llx, ReadOffset 0x%x, read_size "
-			       "0x%x outside range.\n",
-			       FullBlock, 0, FillPageReadSize));
-			Result = AVB_IO_RESULT_ERROR_RANGE_OUTSIDE_PARTITION;
-			goto out;
-		}
-		Status = BlockIo->ReadBlocks(BlockIo, BlockIo->Media->MediaId,
-		                             FullBlock, FillPageReadSize,
-		                             Buffer + StartPageReadSize);
-		if (Status == EFI_SUCCESS) {
-			*OutNumRead += FillPageReadSize;
-		} else {
-			*OutNumRead = 0;
-			DEBUG((EFI_D_ERROR, "ReadBlocks failed %d\n", Status));
+	TailSize = (Offset + NumBytes) % BlockSize;
+	if (TailSize != 0) {
+		Result = ReadCachedSpan(Priv, BlockIo, Offset + NumBytes - TailSize,
+		                        TailSize, Buffer + NumBytes - TailSize);
+		if (Result != AVB_IO_RESULT_OK) {
 			goto out;
 		}
 	}
 
-out:
-	if (Page != NULL) {
-		avb_free(Page);
+	Status = BlockIo->ReadBlocks(BlockIo, BlockIo->Media->MediaId,
+	                             (Offset + HeadSize) / BlockSize,
+	                             NumBytes - HeadSize - TailSize,
+	                             Buffer + HeadSize);
+	Priv->BlockReads++;
+	if (Status != EFI_SUCCESS) {
+		DEBUG((EFI_D_ERROR, "ReadBlocks failed %r\n", Status));
+		Result = AVB_IO_RESULT_ERROR_IO;
+		goto out;
 	}
+	*OutNumRead = NumBytes;
 
+out:
 	return Result;
 }
 
@@ -590,12 +731,14 @@ AvbIOResult AvbGetSizeOfPartition(AvbOps *Ops, const char *Partition, uint64_t *
 
 AvbOps *AvbOpsNew(VOID *UserData)
 {
-	AvbOps *Ops = avb_calloc(sizeof(AvbOps));
+	AvbOpsPrivate *Priv = avb_calloc(sizeof(AvbOpsPrivate));
+	AvbOps *Ops = NULL;
 
-	if (Ops == NULL) {
+	if (Priv == NULL) {
 		DEBUG((EFI_D_ERROR, "Error allocating memory for AvbOps.\n"));
 		goto out;
 	}
+	Ops = &Priv->Ops;
 
 	Ops->user_data = UserData;
 	Ops->read_from_partition = AvbReadFromPartition;
@@ -611,9 +754,38 @@ out:
 	return Ops;
 }
 
+VOID AvbOpsFlushReadCache(AvbOps *Ops)
+{
+	AvbOpsPrivate *Priv = (AvbOpsPrivate *)Ops;
+	UINTN Index;
+
+	if (Priv->Hits != 0 || Priv->Misses != 0) {
+		DEBUG((EFI_D_INFO,
+		       "AVB read cache: %u hits, %u misses, %u block reads\n",
+		       Priv->Hits, Priv->Misses, Priv->BlockReads));
+		BootStatsSetValue("avb_read_cache_hits", Priv->Hits);
+		BootStatsSetValue("avb_read_cache_misses", Priv->Misses);
+		BootStatsSetValue("avb_block_reads", Priv->BlockReads);
+	}
+
+	for (Index = 0; Index < AVB_READ_CACHE_BLOCKS; Index++) {
+		if (Priv->Blocks[Index].Data != NULL) {
+			avb_free(Priv->Blocks[Index].Data);
+		}
+	}
+	avb_memset(Priv->Blocks, 0, sizeof(Priv->Blocks));
+	if (Priv->Bounce != NULL) {
+		avb_free(Priv->Bounce);
+	}
+	Priv->Bounce = NULL;
+	Priv->BounceSize = 0;
+}
+
 VOID AvbOpsFree(AvbOps *Ops)
 {
 	if (Ops != NULL) {
+		AvbOpsFlushReadCache(Ops);
+		avb_slot_verify_cache_free(Ops->slot_verify_cache);
 		avb_free(Ops);
 	}
 }
@@ -67,6 +67,12 @@ typedef struct AvbOps AvbOps;
 /* Forward-declaration of operations in libavb_ab. */
 struct AvbABOps;
 
+/* Forward-declarations of the verification cache and hash jobs, see
+ * avb_slot_verify.h.
+ */
+struct AvbSlotVerifyCache;
+struct AvbHashJob;
+
 /* Forward-declaration of operations in libavb_atx. */
 struct AvbAtxOps;
 
@@ -223,6 +229,24 @@ struct AvbOps {
   AvbIOResult (*get_size_of_partition)(AvbOps* ops,
                                        const char* partition,
                                        uint64_t* out_size_num_bytes);
+
+  /* If not NULL, avb_slot_verify() reuses the vbmeta images and hash
+   * partitions that an earlier call verified and that were handed back
+   * with avb_slot_verify_cache_adopt(). Owned by the caller.
+   */
+  struct AvbSlotVerifyCache* slot_verify_cache;
+
+  /* Optional, may be NULL. Hands |job| to another CPU, which runs
+   * avb_hash_job_run() on it, while avb_slot_verify() keeps reading the
+   * partition. Returns false if no CPU is free, the partition is then
+   * hashed inline.
+   */
+  bool (*hash_job_start)(AvbOps* ops, struct AvbHashJob* job);
+
+  /* Waits until the CPU running |job| is done with it. Must be set if
+   * |hash_job_start| is.
+   */
+  void (*hash_job_wait)(AvbOps* ops, struct AvbHashJob* job);
 };
 
 typedef struct {
@@ -234,6 +258,11 @@ typedef struct {
 
 AvbOps *AvbOpsNew(VOID *UserData);
 
+/* Logs and records the read cache counters, then drops the cached
+ * blocks and partition handles. Reads still work afterwards.
+ */
+VOID AvbOpsFlushReadCache(AvbOps *Ops);
+
 VOID AvbOpsFree(AvbOps *Ops);
 
 #ifdef __cplusplus
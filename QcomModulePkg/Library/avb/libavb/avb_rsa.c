@@ -37,18 +37,59 @@
 #include "avb_util.h"
 #include "avb_vbmeta_image.h"
 
+/* The Montgomery arithmetic below works on limbs of AVB_RSA_LIMB_BITS bits.
+ * Building with AVB_RSA_64BIT_LIMBS uses 64-bit limbs where the compiler
+ * has a 128-bit type, which quarters the number of multiply steps per
+ * montMul() on 64-bit CPUs. Key sizes are multiples of 64 bits, so R and
+ * RR are the same for both limb sizes.
+ */
+#if defined(AVB_RSA_64BIT_LIMBS) && defined(__SIZEOF_INT128__)
+typedef uint64_t avb_limb_t;
+typedef unsigned __int128 avb_dlimb_t;
+#define AVB_RSA_LIMB_BITS 64
+#else
+typedef uint32_t avb_limb_t;
+typedef uint64_t avb_dlimb_t;
+#define AVB_RSA_LIMB_BITS 32
+#endif
+
 typedef struct Key {
-  unsigned int len; /* Length of n[] in number of uint32_t */
-  uint32_t n0inv;   /* -1 / n[0] mod 2^32 */
-  uint32_t* n;      /* modulus as array (host-byte order) */
-  uint32_t* rr;     /* R^2 as array (host-byte order) */
+  unsigned int len;  /* Length of n[] in number of avb_limb_t */
+  avb_limb_t n0inv;  /* -1 / n[0] mod 2^AVB_RSA_LIMB_BITS */
+  avb_limb_t* n;     /* modulus as array (host-byte order) */
+  avb_limb_t* rr;    /* R^2 as array (host-byte order) */
 } Key;
 
+/* Reads |len| limbs from the big-endian byte array |in|, least
+ * significant limb first.
+ */
+static void limbs_from_be(avb_limb_t* out, const uint8_t* in, size_t len) {
+  size_t i, j;
+  for (i = 0; i < len; i++) {
+    const uint8_t* p = in + (len - 1 - i) * sizeof(avb_limb_t);
+    avb_limb_t v = 0;
+    for (j = 0; j < sizeof(avb_limb_t); j++) {
+      v = (v << 8) | p[j];
+    }
+    out[i] = v;
+  }
+}
+
+/* Writes |len| limbs to |out| as a big-endian byte array. */
+static void limbs_to_be(uint8_t* out, const avb_limb_t* in, size_t len) {
+  size_t i, j;
+  for (i = len; i > 0; i--) {
+    avb_limb_t v = in[i - 1];
+    for (j = sizeof(avb_limb_t); j > 0; j--) {
+      *out++ = (uint8_t)(v >> ((j - 1) * 8));
+    }
+  }
+}
+
 Key* parse_key_data(const uint8_t* data, size_t length) {
   AvbRSAPublicKeyHeader h;
   Key* key = NULL;
   size_t expected_length;
-  unsigned int i;
   const uint8_t* n;
   const uint8_t* rr;
 
@@ -81,19 +122,33 @@ Key* parse_key_data(const uint8_t* data, size_t length) {
     goto fail;
   }
 
-  key->len = h.key_num_bits / 32;
-  key->n0inv = h.n0inv;
-  key->n = (uint32_t*)(key + 1); /* Skip ahead sizeof(Key) bytes. */
+  key->len = h.key_num_bits / AVB_RSA_LIMB_BITS;
+  key->n = (avb_limb_t*)(key + 1); /* Skip ahead sizeof(Key) bytes. */
   key->rr = key->n + key->len;
 
   /* Crypto-code below (modpowF4() and friends) expects the key in
    * little-endian format (rather than the format we're storing the
    * key in), so convert it.
    */
-  for (i = 0; i < key->len; i++) {
-    key->n[i] = avb_be32toh(((uint32_t*)n)[key->len - i - 1]);
-    key->rr[i] = avb_be32toh(((uint32_t*)rr)[key->len - i - 1]);
+  limbs_from_be(key->n, n, key->len);
+  limbs_from_be(key->rr, rr, key->len);
+
+#if AVB_RSA_LIMB_BITS == 32
+  key->n0inv = h.n0inv;
+#else
+  {
+    /* The header only has n0inv mod 2^32, derive the full limb inverse
+     * by Newton iteration; each step doubles the number of correct bits
+     * and n[0] is its own inverse mod 2^3.
+     */
+    avb_limb_t inv = key->n[0];
+    int i;
+    for (i = 0; i < 5; i++) {
+      inv *= 2 - key->n[0] * inv;
+    }
+    key->n0inv = 0 - inv;
   }
+#endif
   return key;
 
 fail:
@@ -108,18 +163,18 @@ void free_parsed_key(Key* key) {
 }
 
 /* a[] -= mod */
-static void subM(const Key* key, uint32_t* a) {
-  int64_t A = 0;
+static void subM(const Key* key, avb_limb_t* a) {
+  avb_limb_t borrow = 0;
   uint32_t i;
   for (i = 0; i < key->len; ++i) {
-    A += (uint64_t)a[i] - key->n[i];
-    a[i] = (uint32_t)A;
-    A >>= 32;
+    avb_dlimb_t A = (avb_dlimb_t)a[i] - key->n[i] - borrow;
+    a[i] = (avb_limb_t)A;
+    borrow = (avb_limb_t)(A >> AVB_RSA_LIMB_BITS) & 1;
   }
 }
 
 /* return a[] >= mod */
-static int geM(const Key* key, uint32_t* a) {
+static int geM(const Key* key, avb_limb_t* a) {
   uint32_t i;
   for (i = key->len; i;) {
     --i;
@@ -135,31 +190,35 @@ static int geM(const Key* key, uint32_t* a) {
 
 /* montgomery c[] += a * b[] / R % mod */
 static void montMulAdd(const Key* key,
-                       uint32_t* c,
-                       const uint32_t a,
-                       const uint32_t* b) {
-  uint64_t A = (uint64_t)a * b[0] + c[0];
-  uint32_t d0 = (uint32_t)A * key->n0inv;
-  uint64_t B = (uint64_t)d0 * key->n[0] + (uint32_t)A;
+                       avb_limb_t* c,
+                       const avb_limb_t a,
+                       const avb_limb_t* b) {
+  avb_dlimb_t A = (avb_dlimb_t)a * b[0] + c[0];
+  avb_limb_t d0 = (avb_limb_t)A * key->n0inv;
+  avb_dlimb_t B = (avb_dlimb_t)d0 * key->n[0] + (avb_limb_t)A;
   uint32_t i;
 
   for (i = 1; i < key->len; ++i) {
-    A = (A >> 32) + (uint64_t)a * b[i] + c[i];
-    B = (B >> 32) + (uint64_t)d0 * key->n[i] + (uint32_t)A;
-    c[i - 1] = (uint32_t)B;
+    A = (A >> AVB_RSA_LIMB_BITS) + (avb_dlimb_t)a * b[i] + c[i];
+    B = (B >> AVB_RSA_LIMB_BITS) + (avb_dlimb_t)d0 * key->n[i] +
+        (avb_limb_t)A;
+    c[i - 1] = (avb_limb_t)B;
   }
 
-  A = (A >> 32) + (B >> 32);
+  A = (A >> AVB_RSA_LIMB_BITS) + (B >> AVB_RSA_LIMB_BITS);
 
-  c[i - 1] = (uint32_t)A;
+  c[i - 1] = (avb_limb_t)A;
 
-  if (A >> 32) {
+  if (A >> AVB_RSA_LIMB_BITS) {
     subM(key, c);
   }
 }
 
 /* montgomery c[] = a[] * b[] / R % mod */
-static void montMul(const Key* key, uint32_t* c, uint32_t* a, uint32_t* b) {
+static void montMul(const Key* key,
+                    avb_limb_t* c,
+                    avb_limb_t* a,
+                    avb_limb_t* b) {
   uint32_t i;
   for (i = 0; i < key->len; ++i) {
     c[i] = 0;
@@ -173,24 +232,18 @@ static void montMul(const Key* key, uint32_t* c, uint32_t* a, uint32_t* b) {
  * Input and output big-endian byte array in inout.
  */
 static void modpowF4(const Key* key, uint8_t* inout) {
-  uint32_t* a = (uint32_t*)avb_malloc(key->len * sizeof(uint32_t));
-  uint32_t* aR = (uint32_t*)avb_malloc(key->len * sizeof(uint32_t));
-  uint32_t* aaR = (uint32_t*)avb_malloc(key->len * sizeof(uint32_t));
+  avb_limb_t* a = (avb_limb_t*)avb_malloc(key->len * sizeof(avb_limb_t));
+  avb_limb_t* aR = (avb_limb_t*)avb_malloc(key->len * sizeof(avb_limb_t));
+  avb_limb_t* aaR = (avb_limb_t*)avb_malloc(key->len * sizeof(avb_limb_t));
   if (a == NULL || aR == NULL || aaR == NULL) {
     goto out;
   }
 
-  uint32_t* aaa = aaR; /* Re-use location. */
+  avb_limb_t* aaa = aaR; /* Re-use location. */
   int i;
 
   /* Convert from big endian byte array to little endian word array. */
-  for (i = 0; i < (int)key->len; ++i) {
-    uint32_t tmp = (inout[((key->len - 1 - i) * 4) + 0] << 24) |
-                   (inout[((key->len - 1 - i) * 4) + 1] << 16) |
-                   (inout[((key->len - 1 - i) * 4) + 2] << 8) |
-                   (inout[((key->len - 1 - i) * 4) + 3] << 0);
-    a[i] = tmp;
-  }
+  limbs_from_be(a, inout, key->len);
 
   montMul(key, aR, a, key->rr); /* aR = a * RR / R mod M   */
   for (i = 0; i < 16; i += 2) {
@@ -205,13 +258,7 @@ static void modpowF4(const Key* key, uint8_t* inout) {
   }
 
   /* Convert to bigendian byte array */
-  for (i = (int)key->len - 1; i >= 0; --i) {
-    uint32_t tmp = aaa[i];
-    *inout++ = (uint8_t)(tmp >> 24);
-    *inout++ = (uint8_t)(tmp >> 16);
-    *inout++ = (uint8_t)(tmp >> 8);
-    *inout++ = (uint8_t)(tmp >> 0);
-  }
+  limbs_to_be(inout, aaa, key->len);
 
 out:
   if (a != NULL) {
@@ -251,7 +298,7 @@ bool avb_rsa_verify(const uint8_t* key,
     goto out;
   }
 
-  if (sig_num_bytes != (parsed_key->len * sizeof(uint32_t))) {
+  if (sig_num_bytes != (parsed_key->len * sizeof(avb_limb_t))) {
     avb_error("Signature length does not match key length.\n");
     goto out;
   }
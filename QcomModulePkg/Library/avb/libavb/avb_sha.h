@@ -51,6 +51,7 @@ typedef struct {
   uint8_t block[2 * AVB_SHA256_BLOCK_SIZE];
   uint8_t buf[AVB_SHA256_DIGEST_SIZE]; /* Used for storing the final digest. */
   void *user_data;
+  bool software; /* Hashed by avb_sha256_sw_*, |user_data| is unused. */
 } AvbSHA256Ctx;
 
 /* Data structure used for SHA-512. */
@@ -71,6 +72,27 @@ void avb_sha256_update(AvbSHA256Ctx* ctx, const uint8_t* data, uint32_t len);
 /* Returns the SHA-256 digest. */
 uint8_t* avb_sha256_final(AvbSHA256Ctx* ctx) AVB_ATTR_WARN_UNUSED_RESULT;
 
+/* Portable SHA-256 in avb_sha256.c, used by avb_sha256_*() when the CPU
+ * has SHA-256 instructions or the Hash2 protocol is unavailable.
+ */
+void avb_sha256_sw_init(AvbSHA256Ctx* ctx);
+void avb_sha256_sw_update(AvbSHA256Ctx* ctx, const uint8_t* data, uint32_t len);
+uint8_t* avb_sha256_sw_final(AvbSHA256Ctx* ctx);
+
+/* Returns true if the CPU implements the ARMv8 SHA-256 or SHA-512
+ * instructions. The ID register is only read once.
+ */
+bool avb_sha256_ce_available(void);
+bool avb_sha512_ce_available(void);
+
+#if defined(MDE_CPU_AARCH64)
+/* Processes |blocks| 64 (SHA-256) or 128 (SHA-512) byte blocks from |data|
+ * into |h| using the Cryptography Extensions, see AArch64/ShaCe.S.
+ */
+void avb_sha256_ce_transform(uint32_t h[8], const uint8_t* data, size_t blocks);
+void avb_sha512_ce_transform(uint64_t h[8], const uint8_t* data, size_t blocks);
+#endif
+
 /* Initializes the SHA-512 context. */
 void avb_sha512_init(AvbSHA512Ctx* ctx);
 
@@ -161,6 +161,13 @@ static void SHA512_transform(AvbSHA512Ctx* ctx,
   const uint8_t* sub_block;
   int i, j;
 
+#if defined(MDE_CPU_AARCH64)
+  if (avb_sha512_ce_available()) {
+    avb_sha512_ce_transform(ctx->h, message, block_nb);
+    return;
+  }
+#endif
+
   for (i = 0; i < (int)block_nb; i++) {
     sub_block = message + (i << 7);
 
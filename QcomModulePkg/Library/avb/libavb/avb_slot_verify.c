@@ -74,6 +74,12 @@
 /* Maximum size of a vbmeta image - 64 KiB. */
 #define VBMETA_MAX_SIZE (64 * 1024)
 
+/* Hash partitions are read in pieces of this size and each piece is hashed
+ * right after it is read, while it is still in cache, instead of reading the
+ * whole image and then walking it a second time.
+ */
+#define HASH_PARTITION_CHUNK_SIZE (1024 * 1024)
+
 /* Helper function to see if we should continue with verification in
  * allow_verification_error=true mode if something goes wrong. See the
  * comments for the avb_slot_verify() function for more information.
@@ -97,13 +103,348 @@ static inline bool result_should_continue(AvbSlotVerifyResult result) {
   return false;
 }
 
+/* Maximum number of entries in an AvbSlotVerifyCache: what one call hands
+ * back plus what the next call records.
+ */
+#define SLOT_VERIFY_CACHE_MAX_ENTRIES \
+  (2 * (MAX_NUMBER_OF_VBMETA_IMAGES + MAX_NUMBER_OF_LOADED_PARTITIONS))
+
+/* A vbmeta image whose signature checked out, or a hash partition whose
+ * digest matched the hash descriptor |desc|. Entries the cache does not
+ * own only record buffers handed out in the slot data of the current
+ * call, so that avb_slot_verify_cache_adopt() can tell which buffers of
+ * that slot data were verified.
+ */
+typedef struct {
+  bool owned;
+  bool is_vbmeta;
+  char name[PART_NAME_MAX_SIZE];
+  uint8_t* data;
+  size_t data_size;
+  size_t public_key_offset;
+  size_t public_key_size;
+  uint8_t* desc;
+  size_t desc_size;
+} AvbSlotVerifyCacheEntry;
+
+struct AvbSlotVerifyCache {
+  AvbSlotVerifyCacheEntry entries[SLOT_VERIFY_CACHE_MAX_ENTRIES];
+  size_t num_entries;
+};
+
+/* Removes entry |n|, freeing its data if the cache owns it. */
+static void slot_verify_cache_drop(AvbSlotVerifyCache* cache, size_t n) {
+  AvbSlotVerifyCacheEntry* entry = &cache->entries[n];
+
+  if (entry->owned && entry->data != NULL) {
+    avb_free(entry->data);
+  }
+  if (entry->desc != NULL) {
+    avb_free(entry->desc);
+  }
+  cache->entries[n] = cache->entries[--cache->num_entries];
+}
+
+/* Removes the records of buffers the cache does not own. */
+static void slot_verify_cache_drop_records(AvbSlotVerifyCache* cache) {
+  size_t n = 0;
+
+  while (n < cache->num_entries) {
+    if (cache->entries[n].owned) {
+      n++;
+    } else {
+      slot_verify_cache_drop(cache, n);
+    }
+  }
+}
+
+/* Records that |data|, now owned by the slot data being built, was
+ * verified. The cache is best effort: nothing is recorded once it is
+ * full or out of memory.
+ */
+static void slot_verify_cache_record(AvbSlotVerifyCache* cache,
+                                     bool is_vbmeta,
+                                     const char* name,
+                                     uint8_t* data,
+                                     size_t data_size,
+                                     size_t public_key_offset,
+                                     size_t public_key_size,
+                                     const uint8_t* desc,
+                                     size_t desc_size) {
+  AvbSlotVerifyCacheEntry* entry;
+  size_t name_len;
+
+  if (cache == NULL || cache->num_entries == SLOT_VERIFY_CACHE_MAX_ENTRIES) {
+    return;
+  }
+  entry = &cache->entries[cache->num_entries];
+  name_len = avb_strlen(name);
+  if (name_len >= sizeof entry->name) {
+    return;
+  }
+
+  avb_memset(entry, 0, sizeof *entry);
+  if (desc != NULL) {
+    entry->desc = avb_malloc(desc_size);
+    if (entry->desc == NULL) {
+      return;
+    }
+    avb_memcpy(entry->desc, desc, desc_size);
+    entry->desc_size = desc_size;
+  }
+  entry->is_vbmeta = is_vbmeta;
+  avb_memcpy(entry->name, name, name_len + 1);
+  entry->data = data;
+  entry->data_size = data_size;
+  entry->public_key_offset = public_key_offset;
+  entry->public_key_size = public_key_size;
+  cache->num_entries++;
+}
+
+/* Takes the owned entry for |name| out of the cache. The caller then owns
+ * |out_entry->data| and |out_entry->desc|.
+ */
+static bool slot_verify_cache_take(AvbSlotVerifyCache* cache,
+                                   bool is_vbmeta,
+                                   const char* name,
+                                   AvbSlotVerifyCacheEntry* out_entry) {
+  size_t n;
+
+  if (cache == NULL) {
+    return false;
+  }
+  for (n = 0; n < cache->num_entries; n++) {
+    AvbSlotVerifyCacheEntry* entry = &cache->entries[n];
+    if (entry->owned && entry->is_vbmeta == is_vbmeta &&
+        avb_strcmp(entry->name, name) == 0) {
+      *out_entry = *entry;
+      cache->entries[n] = cache->entries[--cache->num_entries];
+      return true;
+    }
+  }
+  return false;
+}
+
+AvbSlotVerifyCache* avb_slot_verify_cache_new(void) {
+  return avb_calloc(sizeof(AvbSlotVerifyCache));
+}
+
+void avb_slot_verify_cache_adopt(AvbSlotVerifyCache* cache,
+                                 AvbSlotVerifyData* data) {
+  size_t n, m;
+
+  if (cache != NULL) {
+    for (m = 0; m < cache->num_entries; m++) {
+      AvbSlotVerifyCacheEntry* entry = &cache->entries[m];
+      if (entry->owned) {
+        continue;
+      }
+      if (entry->is_vbmeta) {
+        for (n = 0; n < data->num_vbmeta_images; n++) {
+          if (data->vbmeta_images[n].vbmeta_data == entry->data) {
+            data->vbmeta_images[n].vbmeta_data = NULL;
+            entry->owned = true;
+            break;
+          }
+        }
+      } else {
+        for (n = 0; n < data->num_loaded_partitions; n++) {
+          if (data->loaded_partitions[n].data == entry->data) {
+            data->loaded_partitions[n].data = NULL;
+            entry->owned = true;
+            break;
+          }
+        }
+      }
+    }
+    slot_verify_cache_drop_records(cache);
+  }
+  avb_slot_verify_data_free(data);
+}
+
+void avb_slot_verify_cache_free(AvbSlotVerifyCache* cache) {
+  if (cache == NULL) {
+    return;
+  }
+  while (cache->num_entries > 0) {
+    slot_verify_cache_drop(cache, cache->num_entries - 1);
+  }
+  avb_free(cache);
+}
+
+/* Maximum number of hash partitions whose digests may be computed on other
+ * CPUs at the same time, per vbmeta image.
+ */
+#define MAX_NUMBER_OF_PENDING_HASH_PARTITIONS 8
+
+/* A loaded hash partition whose digest is still to be checked against its
+ * descriptor. When the digest is computed on another CPU, |job| is where
+ * it ends up.
+ */
+typedef struct {
+  char part_name[PART_NAME_MAX_SIZE];
+  const char* found;
+  const AvbDescriptor* descriptor;
+  size_t desc_size;
+  const uint8_t* desc_digest;
+  size_t desc_digest_len;
+  size_t digest_len;
+  uint8_t* image_buf;
+  uint64_t image_size;
+  AvbHashJob job;
+} HashPartition;
+
+void avb_hash_job_run(AvbHashJob* job) {
+  uint64_t num_hashed = 0;
+  uint64_t num_ready;
+  uint64_t hash_len;
+  bool all_ready;
+  uint8_t* digest;
+
+  do {
+    /* |num_ready| is final once |all_ready| is seen, so load it last. */
+    all_ready = __atomic_load_n(&job->all_ready, __ATOMIC_ACQUIRE);
+    num_ready = __atomic_load_n(&job->num_ready, __ATOMIC_ACQUIRE);
+    while (num_hashed < num_ready) {
+      hash_len = num_ready - num_hashed;
+      if (hash_len > HASH_PARTITION_CHUNK_SIZE) {
+        hash_len = HASH_PARTITION_CHUNK_SIZE;
+      }
+      if (job->is_sha512) {
+        avb_sha512_update(
+            &job->sha512_ctx, job->data + num_hashed, hash_len);
+      } else {
+        avb_sha256_update(
+            &job->sha256_ctx, job->data + num_hashed, hash_len);
+      }
+      num_hashed += hash_len;
+    }
+  } while (!all_ready);
+
+  if (job->is_sha512) {
+    digest = avb_sha512_final(&job->sha512_ctx);
+    avb_memcpy(job->digest, digest, AVB_SHA512_DIGEST_SIZE);
+  } else {
+    digest = avb_sha256_final(&job->sha256_ctx);
+    avb_memcpy(job->digest, digest, AVB_SHA256_DIGEST_SIZE);
+  }
+}
+
+/* Checks |digest| against the descriptor of |hp| and hands the image over
+ * to |slot_data|. A NULL |digest| means the image was verified before.
+ * The image buffer is always consumed.
+ */
+static AvbSlotVerifyResult finish_hash_partition(AvbOps* ops,
+                                                 HashPartition* hp,
+                                                 const uint8_t* digest,
+                                                 AvbSlotVerifyData* slot_data) {
+  AvbSlotVerifyResult ret;
+
+  if (digest == NULL) {
+    ret = AVB_SLOT_VERIFY_RESULT_OK;
+  } else if (hp->digest_len != hp->desc_digest_len) {
+    avb_errorv(
+        hp->part_name, ": Digest in descriptor not of expected size.\n", NULL);
+    ret = AVB_SLOT_VERIFY_RESULT_ERROR_INVALID_METADATA;
+  } else if (avb_safe_memcmp(digest, hp->desc_digest, hp->digest_len) != 0) {
+    avb_errorv(hp->part_name,
+               ": Hash of data does not match digest in descriptor.\n",
+               NULL);
+    ret = AVB_SLOT_VERIFY_RESULT_ERROR_VERIFICATION;
+  } else {
+    avb_debugv(hp->part_name, ": success: Image verification completed\n",
+               NULL);
+    ret = AVB_SLOT_VERIFY_RESULT_OK;
+  }
+
+  /* If it worked and something was loaded, copy to slot_data. */
+  if (ret == AVB_SLOT_VERIFY_RESULT_OK || result_should_continue(ret)) {
+    AvbPartitionData* loaded_partition;
+    if (slot_data->num_loaded_partitions == MAX_NUMBER_OF_LOADED_PARTITIONS) {
+      avb_errorv(hp->part_name, ": Too many loaded partitions.\n", NULL);
+      ret = AVB_SLOT_VERIFY_RESULT_ERROR_OOM;
+      goto out;
+    }
+    loaded_partition =
+        &slot_data->loaded_partitions[slot_data->num_loaded_partitions++];
+    loaded_partition->partition_name = avb_strdup(hp->found);
+    loaded_partition->data_size = hp->image_size;
+    loaded_partition->data = hp->image_buf;
+    hp->image_buf = NULL;
+    if (ret == AVB_SLOT_VERIFY_RESULT_OK) {
+      slot_verify_cache_record(ops->slot_verify_cache,
+                               false /* is_vbmeta */,
+                               hp->part_name,
+                               loaded_partition->data,
+                               hp->image_size,
+                               0 /* public_key_offset */,
+                               0 /* public_key_size */,
+                               (const uint8_t*)hp->descriptor,
+                               hp->desc_size);
+    }
+  }
+
+out:
+  if (hp->image_buf != NULL) {
+    avb_free(hp->image_buf);
+    hp->image_buf = NULL;
+  }
+  return ret;
+}
+
+/* Waits for the digests of the |num_pending| partitions in |pending| and
+ * checks them in the order they were loaded, folding the results into
+ * |ret| the way load_and_verify_vbmeta() folds serial results. Once a
+ * result means verification stops, or if |slot_data| is NULL, the
+ * remaining partitions are only waited for and freed. All entries of
+ * |pending| are consumed.
+ */
+static AvbSlotVerifyResult finish_pending_hash_partitions(
+    AvbOps* ops,
+    HashPartition** pending,
+    size_t* num_pending,
+    bool allow_verification_error,
+    AvbSlotVerifyData* slot_data,
+    AvbSlotVerifyResult ret) {
+  bool stop = (slot_data == NULL);
+  size_t n;
+
+  for (n = 0; n < *num_pending; n++) {
+    HashPartition* hp = pending[n];
+    ops->hash_job_wait(ops, &hp->job);
+    if (!stop) {
+      AvbSlotVerifyResult sub_ret =
+          finish_hash_partition(ops, hp, hp->job.digest, slot_data);
+      if (sub_ret != AVB_SLOT_VERIFY_RESULT_OK) {
+        ret = sub_ret;
+        if (!allow_verification_error || !result_should_continue(ret)) {
+          stop = true;
+        }
+      }
+    }
+    if (hp->image_buf != NULL) {
+      avb_free(hp->image_buf);
+    }
+    avb_free(hp);
+  }
+  *num_pending = 0;
+  return ret;
+}
+
+/* Loads and hashes the partition of the hash descriptor |descriptor|. If
+ * |pending| is not NULL and the platform can hash on another CPU, the
+ * partition is appended to |pending| instead of being checked, see
+ * finish_pending_hash_partitions().
+ */
 static AvbSlotVerifyResult load_and_verify_hash_partition(
     AvbOps* ops,
     const char* const* requested_partitions,
     const char* ab_suffix,
     bool allow_verification_error,
     const AvbDescriptor* descriptor,
-    AvbSlotVerifyData* slot_data) {
+    AvbSlotVerifyData* slot_data,
+    HashPartition** pending,
+    size_t* num_pending) {
   AvbHashDescriptor hash_desc;
   AvbSHA256Ctx sha256_ctx;
   AvbSHA512Ctx sha512_ctx;
@@ -115,10 +456,19 @@ static AvbSlotVerifyResult load_and_verify_hash_partition(
   AvbIOResult io_ret;
   uint8_t* image_buf = NULL;
   size_t part_num_read;
-  uint8_t* digest;
+  uint8_t* digest = NULL;
   size_t digest_len;
   const char* found;
   uint64_t image_size;
+  uint64_t hash_size;
+  uint64_t offset;
+  uint64_t chunk_size;
+  uint64_t hash_len;
+  bool is_sha512 = false;
+  AvbSlotVerifyCacheEntry cached;
+  HashPartition serial_hp;
+  HashPartition* hp = &serial_hp;
+  HashPartition* deferred = NULL;
 
   if (!avb_hash_descriptor_validate_and_byteswap(
           (const AvbHashDescriptor*)descriptor, &hash_desc)) {
@@ -181,87 +531,171 @@ static AvbSlotVerifyResult load_and_verify_hash_partition(
     avb_debugv (part_name, ": Loading entire partition.\n", NULL);
   }
 
-  image_buf = avb_malloc(image_size);
-  if (image_buf == NULL) {
-    ret = AVB_SLOT_VERIFY_RESULT_ERROR_OOM;
-    goto out;
-  }
+  avb_memcpy(serial_hp.part_name, part_name, sizeof part_name);
+  serial_hp.found = found;
+  serial_hp.descriptor = descriptor;
+  serial_hp.desc_size = sizeof(AvbDescriptor) +
+                        hash_desc.parent_descriptor.num_bytes_following;
+  serial_hp.desc_digest = desc_digest;
+  serial_hp.desc_digest_len = hash_desc.digest_len;
+  serial_hp.image_size = image_size;
+  serial_hp.image_buf = NULL;
 
-  io_ret = ops->read_from_partition(
-      ops, part_name, 0 /* offset */, image_size, image_buf, &part_num_read);
-  if (io_ret == AVB_IO_RESULT_ERROR_OOM) {
-    ret = AVB_SLOT_VERIFY_RESULT_ERROR_OOM;
-    goto out;
-  } else if (io_ret != AVB_IO_RESULT_OK) {
-    avb_errorv(part_name, ": Error loading data from partition.\n", NULL);
-    ret = AVB_SLOT_VERIFY_RESULT_ERROR_IO;
-    goto out;
-  }
-  if (part_num_read != image_size) {
-    avb_errorv(part_name, ": Read fewer than requested bytes.\n", NULL);
-    ret = AVB_SLOT_VERIFY_RESULT_ERROR_IO;
-    goto out;
+  /* An image that matched this very descriptor in an earlier call is
+   * still the same image, no need to read and hash it again.
+   */
+  if (slot_verify_cache_take(
+          ops->slot_verify_cache, false, part_name, &cached)) {
+    if (cached.data_size == image_size &&
+        cached.desc_size == serial_hp.desc_size &&
+        avb_safe_memcmp(cached.desc, descriptor, serial_hp.desc_size) == 0) {
+      avb_debugv(part_name, ": Reusing verified image.\n", NULL);
+      serial_hp.image_buf = cached.data;
+      cached.data = NULL;
+    }
+    if (cached.data != NULL) {
+      avb_free(cached.data);
+    }
+    if (cached.desc != NULL) {
+      avb_free(cached.desc);
+    }
+    if (serial_hp.image_buf != NULL) {
+      ret = finish_hash_partition(ops, &serial_hp, NULL, slot_data);
+      goto out;
+    }
   }
 
   if (Avb_StrnCmp ( (CONST CHAR8*)hash_desc.hash_algorithm, "sha256",
                  avb_strlen ("sha256")) == 0) {
     avb_sha256_init(&sha256_ctx);
     avb_sha256_update(&sha256_ctx, desc_salt, hash_desc.salt_len);
-    avb_sha256_update(&sha256_ctx, image_buf, hash_desc.image_size);
-    digest = avb_sha256_final(&sha256_ctx);
     digest_len = AVB_SHA256_DIGEST_SIZE;
   } else if (Avb_StrnCmp ( (CONST CHAR8*)hash_desc.hash_algorithm, "sha512",
                   avb_strlen ("sha512")) == 0) {
     avb_sha512_init(&sha512_ctx);
     avb_sha512_update(&sha512_ctx, desc_salt, hash_desc.salt_len);
-    avb_sha512_update(&sha512_ctx, image_buf, hash_desc.image_size);
-    digest = avb_sha512_final(&sha512_ctx);
     digest_len = AVB_SHA512_DIGEST_SIZE;
+    is_sha512 = true;
   } else {
     avb_errorv(part_name, ": Unsupported hash algorithm.\n", NULL);
     ret = AVB_SLOT_VERIFY_RESULT_ERROR_INVALID_METADATA;
     goto out;
   }
+  serial_hp.digest_len = digest_len;
 
-  if (digest_len != hash_desc.digest_len) {
-    avb_errorv(
-        part_name, ": Digest in descriptor not of expected size.\n", NULL);
-    ret = AVB_SLOT_VERIFY_RESULT_ERROR_INVALID_METADATA;
+  image_buf = avb_malloc(image_size);
+  if (image_buf == NULL) {
+    ret = AVB_SLOT_VERIFY_RESULT_ERROR_OOM;
     goto out;
   }
 
-  if (avb_safe_memcmp(digest, desc_digest, digest_len) != 0) {
-    avb_errorv(part_name,
-               ": Hash of data does not match digest in descriptor.\n",
-               NULL);
-    ret = AVB_SLOT_VERIFY_RESULT_ERROR_VERIFICATION;
-    goto out;
-  } else {
-    avb_debugv (part_name, ": success: Image verification completed\n", NULL);
+  /* Only the first hash_desc.image_size bytes are covered by the digest. A
+   * partition smaller than that can't match, hash what is there.
+   */
+  hash_size = hash_desc.image_size;
+  if (hash_size > image_size) {
+    hash_size = image_size;
   }
 
-  ret = AVB_SLOT_VERIFY_RESULT_OK;
+  /* If the platform has a CPU to spare, the digest is computed there while
+   * this CPU keeps reading, and it is checked when the caller joins the
+   * pending partitions. A SHA-256 context backed by the Hash2 protocol
+   * can only be driven from this CPU.
+   */
+  if (pending != NULL && ops->hash_job_start != NULL &&
+      *num_pending < MAX_NUMBER_OF_PENDING_HASH_PARTITIONS &&
+      (is_sha512 || sha256_ctx.software)) {
+    deferred = avb_calloc(sizeof(HashPartition));
+    if (deferred != NULL) {
+      *deferred = serial_hp;
+      deferred->job.data = image_buf;
+      deferred->job.is_sha512 = is_sha512;
+      if (is_sha512) {
+        deferred->job.sha512_ctx = sha512_ctx;
+      } else {
+        deferred->job.sha256_ctx = sha256_ctx;
+      }
+      if (ops->hash_job_start(ops, &deferred->job)) {
+        hp = deferred;
+      } else {
+        avb_free(deferred);
+        deferred = NULL;
+      }
+    }
+  }
 
-out:
+  /* Read straight into the buffer handed out with the loaded partition and
+   * feed each chunk to the hash as it arrives. Hashing the chunks in order
+   * gives the same digest as hashing the whole image in one go.
+   */
+  for (offset = 0; offset < image_size; offset += chunk_size) {
+    chunk_size = image_size - offset;
+    if (chunk_size > HASH_PARTITION_CHUNK_SIZE) {
+      chunk_size = HASH_PARTITION_CHUNK_SIZE;
+    }
 
-  /* If it worked and something was loaded, copy to slot_data. */
-  if ((ret == AVB_SLOT_VERIFY_RESULT_OK || result_should_continue(ret)) &&
-      image_buf != NULL) {
-    AvbPartitionData* loaded_partition;
-    if (slot_data->num_loaded_partitions == MAX_NUMBER_OF_LOADED_PARTITIONS) {
-      avb_errorv(part_name, ": Too many loaded partitions.\n", NULL);
+    io_ret = ops->read_from_partition(ops,
+                                      part_name,
+                                      offset,
+                                      chunk_size,
+                                      image_buf + offset,
+                                      &part_num_read);
+    if (io_ret == AVB_IO_RESULT_ERROR_OOM) {
       ret = AVB_SLOT_VERIFY_RESULT_ERROR_OOM;
-      goto fail;
+      goto out;
+    } else if (io_ret != AVB_IO_RESULT_OK) {
+      avb_errorv(part_name, ": Error loading data from partition.\n", NULL);
+      ret = AVB_SLOT_VERIFY_RESULT_ERROR_IO;
+      goto out;
+    }
+    if (part_num_read != chunk_size) {
+      avb_errorv(part_name, ": Read fewer than requested bytes.\n", NULL);
+      ret = AVB_SLOT_VERIFY_RESULT_ERROR_IO;
+      goto out;
+    }
+
+    if (offset < hash_size) {
+      hash_len = hash_size - offset;
+      if (hash_len > chunk_size) {
+        hash_len = chunk_size;
+      }
+      if (deferred != NULL) {
+        __atomic_store_n(
+            &deferred->job.num_ready, offset + hash_len, __ATOMIC_RELEASE);
+      } else if (is_sha512) {
+        avb_sha512_update(&sha512_ctx, image_buf + offset, hash_len);
+      } else {
+        avb_sha256_update(&sha256_ctx, image_buf + offset, hash_len);
+      }
     }
-    loaded_partition =
-        &slot_data->loaded_partitions[slot_data->num_loaded_partitions++];
-    loaded_partition->partition_name = avb_strdup(found);
-    loaded_partition->data_size = image_size;
-    loaded_partition->data = image_buf;
-    image_buf = NULL;
   }
 
-fail:
+  hp->image_buf = image_buf;
+  image_buf = NULL;
+
+  if (deferred != NULL) {
+    __atomic_store_n(&deferred->job.all_ready, true, __ATOMIC_RELEASE);
+    pending[(*num_pending)++] = deferred;
+    deferred = NULL;
+    ret = AVB_SLOT_VERIFY_RESULT_OK;
+    goto out;
+  }
+
+  if (is_sha512) {
+    digest = avb_sha512_final(&sha512_ctx);
+  } else {
+    digest = avb_sha256_final(&sha256_ctx);
+  }
+
+  ret = finish_hash_partition(ops, &serial_hp, digest, slot_data);
+
+out:
+  /* A job that was started must be waited for before its buffer goes. */
+  if (deferred != NULL) {
+    __atomic_store_n(&deferred->job.all_ready, true, __ATOMIC_RELEASE);
+    ops->hash_job_wait(ops, &deferred->job);
+    avb_free(deferred);
+  }
   if (image_buf != NULL) {
     avb_free(image_buf);
   }
@@ -386,6 +820,9 @@ static AvbSlotVerifyResult load_and_verify_vbmeta(
   bool is_main_vbmeta;
   bool look_for_vbmeta_footer;
   AvbVBMetaData* vbmeta_image_data = NULL;
+  AvbSlotVerifyCacheEntry cached;
+  HashPartition* pending[MAX_NUMBER_OF_PENDING_HASH_PARTITIONS];
+  size_t num_pending = 0;
 
   ret = AVB_SLOT_VERIFY_RESULT_OK;
 
@@ -426,6 +863,21 @@ static AvbSlotVerifyResult load_and_verify_vbmeta(
     goto out;
   }
 
+  /* A vbmeta image whose signature checked out in an earlier call needs
+   * neither I/O nor another signature check. Everything from the public
+   * key check on is done again.
+   */
+  if (slot_verify_cache_take(
+          ops->slot_verify_cache, true, full_partition_name, &cached)) {
+    avb_debugv(full_partition_name, ": Reusing verified vbmeta.\n", NULL);
+    vbmeta_buf = cached.data;
+    vbmeta_num_read = cached.data_size;
+    pk_data = vbmeta_buf + cached.public_key_offset;
+    pk_len = cached.public_key_size;
+    vbmeta_ret = AVB_VBMETA_VERIFY_RESULT_OK;
+    goto vbmeta_verified;
+  }
+
   /* If we're loading from the main vbmeta partition, the vbmeta struct is in
    * the beginning. Otherwise we may have to locate it via a footer... if no
    * footer is found, we look in the beginning to support e.g. vbmeta_<org>
@@ -568,6 +1020,7 @@ static AvbSlotVerifyResult load_and_verify_vbmeta(
       goto out;
   }
 
+vbmeta_verified:
   /* Byteswap the header. */
   avb_vbmeta_image_header_to_host_byte_order((AvbVBMetaImageHeader*)vbmeta_buf,
                                              &vbmeta_header);
@@ -699,6 +1152,17 @@ static AvbSlotVerifyResult load_and_verify_vbmeta(
       vbmeta_header.authentication_data_block_size +
       vbmeta_header.auxiliary_data_block_size;
   vbmeta_image_data->verify_result = vbmeta_ret;
+  if (vbmeta_ret == AVB_VBMETA_VERIFY_RESULT_OK) {
+    slot_verify_cache_record(ops->slot_verify_cache,
+                             true /* is_vbmeta */,
+                             full_partition_name,
+                             vbmeta_buf,
+                             vbmeta_num_read,
+                             pk_data - vbmeta_buf,
+                             pk_len,
+                             NULL /* desc */,
+                             0 /* desc_size */);
+  }
 
  /* If verification has been disabled by setting a bit in the image,
    * we're done... except that we need to load the entirety of the
@@ -755,7 +1219,9 @@ static AvbSlotVerifyResult load_and_verify_vbmeta(
                                                  ab_suffix,
                                                  allow_verification_error,
                                                  descriptors[n],
-                                                 slot_data);
+                                                 slot_data,
+                                                 pending,
+                                                 &num_pending);
         if (sub_ret != AVB_SLOT_VERIFY_RESULT_OK) {
           ret = sub_ret;
           if (!allow_verification_error || !result_should_continue(ret)) {
@@ -906,6 +1372,14 @@ static AvbSlotVerifyResult load_and_verify_vbmeta(
     }
   }
 
+  /* Join the hash partitions whose digests were computed elsewhere. */
+  ret = finish_pending_hash_partitions(
+      ops, pending, &num_pending, allow_verification_error, slot_data, ret);
+  if (ret != AVB_SLOT_VERIFY_RESULT_OK &&
+      (!allow_verification_error || !result_should_continue(ret))) {
+    goto out;
+  }
+
   if (rollback_index_location >= AVB_MAX_NUMBER_OF_ROLLBACK_INDEX_LOCATIONS) {
     avb_errorv(
         full_partition_name, ": Invalid rollback_index_location.\n", NULL);
@@ -921,6 +1395,12 @@ static AvbSlotVerifyResult load_and_verify_vbmeta(
   }
 
 out:
+  /* Verification failed, the partitions still pending are dropped. */
+  if (num_pending > 0) {
+    finish_pending_hash_partitions(
+        ops, pending, &num_pending, allow_verification_error, NULL, ret);
+  }
+
   /* If |vbmeta_image_data| isn't NULL it means that it adopted
    * |vbmeta_buf| so in that case don't free it here.
    */
@@ -1343,6 +1823,11 @@ AvbSlotVerifyResult avb_slot_verify(AvbOps* ops,
     *out_data = NULL;
   }
 
+  /* Only the buffers handed out by this call can be adopted later. */
+  if (ops->slot_verify_cache != NULL) {
+    slot_verify_cache_drop_records(ops->slot_verify_cache);
+  }
+
   /* Allowing dm-verity errors defeats the purpose of verified boot so
    * only allow this if set up to allow verification errors
    * (e.g. typically only UNLOCKED mode).
@@ -1473,6 +1958,9 @@ AvbSlotVerifyResult avb_slot_verify(AvbOps* ops,
   return ret;
 
 fail:
+  if (ops->slot_verify_cache != NULL) {
+    slot_verify_cache_drop_records(ops->slot_verify_cache);
+  }
   if (slot_data != NULL) {
     avb_slot_verify_data_free(slot_data);
   }
@@ -30,6 +30,7 @@
 #define AVB_SLOT_VERIFY_H_
 
 #include "avb_ops.h"
+#include "avb_sha.h"
 #include "avb_vbmeta_image.h"
 
 #ifdef __cplusplus
@@ -256,6 +257,58 @@ typedef struct {
 /* Frees a |AvbSlotVerifyData| including all data it points to. */
 void avb_slot_verify_data_free(AvbSlotVerifyData* data);
 
+/* Verification work that can be carried from one avb_slot_verify()
+ * call to the next within a boot session, for callers that verify the
+ * same slot again with more requested partitions.
+ *
+ * Set |ops->slot_verify_cache| to the cache, then hand the result of a
+ * call back with avb_slot_verify_cache_adopt() instead of freeing it.
+ * The next call takes the vbmeta images whose signature checked out
+ * and the hash partitions whose digest matched from the cache instead
+ * of reading and verifying them again. Public key, rollback index and
+ * descriptor processing are always redone, and a hash partition is
+ * only reused for a byte-identical hash descriptor.
+ *
+ * The cache must not outlive the partitions it was filled from; free
+ * it with avb_slot_verify_cache_free() once the boot decision is made.
+ */
+typedef struct AvbSlotVerifyCache AvbSlotVerifyCache;
+
+/* Returns a new, empty cache or NULL on OOM. */
+AvbSlotVerifyCache* avb_slot_verify_cache_new(void);
+
+/* Moves what |data| holds that can be reused into |cache| and frees
+ * the rest of |data|. |data| must come from the last avb_slot_verify()
+ * call made with |cache|. With a NULL |cache| this just frees |data|.
+ */
+void avb_slot_verify_cache_adopt(AvbSlotVerifyCache* cache,
+                                 AvbSlotVerifyData* data);
+
+/* Frees |cache| and all data it holds. */
+void avb_slot_verify_cache_free(AvbSlotVerifyCache* cache);
+
+/* A partition digest computed on another CPU, see hash_job_start in
+ * AvbOps. avb_slot_verify() raises |num_ready| as it reads |data| and
+ * sets |all_ready| once the last byte to hash is in. The worker hashes
+ * bytes as they become ready and leaves the result in |digest|.
+ *
+ * |num_ready| and |all_ready| are accessed with acquire/release atomics.
+ */
+typedef struct AvbHashJob {
+  const uint8_t* data;
+  uint64_t num_ready;
+  bool all_ready;
+  bool is_sha512;
+  AvbSHA256Ctx sha256_ctx;
+  AvbSHA512Ctx sha512_ctx;
+  uint8_t digest[AVB_SHA512_DIGEST_SIZE];
+} AvbHashJob;
+
+/* Runs |job| to completion. Called by the platform on the CPU that
+ * hash_job_start handed |job| to.
+ */
+void avb_hash_job_run(AvbHashJob* job);
+
 /* Performs a full verification of the slot identified by |ab_suffix|
  * and load the contents of the partitions whose name is in the
  * NULL-terminated string array |requested_partitions| (each partition
@@ -0,0 +1,202 @@
+#!/usr/bin/env python3
+
+"""Generates the avb_rsa and avb_sha known answer files under testdata/.
+
+Usage: gen_kat.py [testdata_dir]
+
+For every testdata/testkey_rsa{2048,4096,8192}.pem this writes
+testdata/rsa{bits}.kat. Each file holds the key in the AvbRSAPublicKeyHeader
+format libavb parses, followed by:
+  - modpow records: in ^ 65537 mod n, computed with Python's pow(),
+  - verify records: PKCS#1 v1.5 signatures made with the private key, and
+    corrupted ones, with the result avb_rsa_verify() must return.
+rsa2048.kat also has modpow records for the all-ones modulus 2^2048 - 1,
+whose limbs all carry.
+
+testdata/sha{256,512}.kat hold records of
+  alg = SHA256|SHA512, msg = HEX (may be empty), repeat = N (optional,
+  msg is hashed N times over), md = HEX
+for the FIPS 180-4 example messages, checked against the published digests,
+and for seeded messages of every length up to two blocks and a byte, so
+that the padding crosses each block boundary.
+
+The values are seeded, so rerunning the script reproduces the files as long
+as the keys do not change. openssl must be on the PATH to read the keys.
+"""
+
+import hashlib
+import os
+import random
+import re
+import subprocess
+import sys
+
+DIGEST_INFO = {
+    'sha256': bytes.fromhex('3031300d060960864801650304020105000420'),
+    'sha512': bytes.fromhex('3051300d060960864801650304020305000440'),
+}
+
+
+def read_key(pem):
+  """Returns (n, d) of the PEM private key."""
+  text = subprocess.check_output(
+      ['openssl', 'rsa', '-in', pem, '-noout', '-text'],
+      universal_newlines=True)
+
+  def field(name):
+    m = re.search(r'^%s:\s*\n((?:\s+[0-9a-f:]+\n)+)' % name, text,
+                  re.MULTILINE)
+    return int(re.sub(r'[\s:]', '', m.group(1)), 16)
+
+  return field('modulus'), field('privateExponent')
+
+
+def avb_key_blob(n, bits):
+  """Serializes n like avbtool: header, n and R^2 mod n, big endian."""
+  n0inv = (1 << 32) - pow(n, -1, 1 << 32)
+  rr = pow(1 << bits, 2, n)
+  return (bits.to_bytes(4, 'big') + n0inv.to_bytes(4, 'big') +
+          n.to_bytes(bits // 8, 'big') + rr.to_bytes(bits // 8, 'big'))
+
+
+def encode(digest, hash_bytes, bits):
+  """PKCS#1 v1.5 encoding of hash_bytes, as in avb_crypto.c's padding."""
+  t = DIGEST_INFO[digest] + hash_bytes
+  return b'\x00\x01' + b'\xff' * (bits // 8 - len(t) - 3) + b'\x00' + t
+
+
+def modpow_records(out, n, bits, rng):
+  values = [0, 1, 2, n - 1, n - 2]
+  values += [rng.randrange(n) for _ in range(5)]
+  for s in values:
+    out.append('op = modpow')
+    out.append('in = %s' % s.to_bytes(bits // 8, 'big').hex())
+    out.append('out = %s' % pow(s, 65537, n).to_bytes(bits // 8, 'big').hex())
+    out.append('')
+
+
+def verify_records(out, n, d, bits, rng):
+  for digest in ('sha256', 'sha512'):
+    alg = '%s_RSA%d' % (digest.upper(), bits)
+    for i in range(3):
+      msg = rng.getrandbits(8 * 64).to_bytes(64, 'big')
+      hash_bytes = hashlib.new(digest, msg).digest()
+      em = int.from_bytes(encode(digest, hash_bytes, bits), 'big')
+      sig = pow(em, d, n).to_bytes(bits // 8, 'big')
+      cases = [('pass', hash_bytes, sig)]
+      if i == 0:
+        bad_sig = bytearray(sig)
+        bad_sig[rng.randrange(len(sig))] ^= 1 << rng.randrange(8)
+        bad_hash = bytearray(hash_bytes)
+        bad_hash[-1] ^= 0x80
+        cases += [('fail', hash_bytes, bytes(bad_sig)),
+                  ('fail', bytes(bad_hash), sig),
+                  ('fail', hash_bytes, bytes(bits // 8))]
+      for result, h, s in cases:
+        out.append('op = verify')
+        out.append('alg = %s' % alg)
+        out.append('hash = %s' % h.hex())
+        out.append('sig = %s' % s.hex())
+        out.append('result = %s' % result)
+        out.append('')
+
+
+# FIPS 180-4 example messages and their published digests: (msg, repeat,
+# {digest: md})
+FIPS_EXAMPLES = [
+    (b'abc', 1, {
+        'sha256': 'ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f2'
+                  '0015ad',
+        'sha512': 'ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b'
+                  '55d39a2192992a274fc1a836ba3c23a3feebbd454d4423643ce80e2a9a'
+                  'c94fa54ca49f',
+    }),
+    (b'', 1, {
+        'sha256': 'e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b78'
+                  '52b855',
+        'sha512': 'cf83e1357eefb8bdf1542850d66d8007d620e4050b5715dc83f4a921d3'
+                  '6ce9ce47d0d13c5d85f2b0ff8318d2877eec2f63b931bd47417a81a538'
+                  '327af927da3e',
+    }),
+    (b'abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq', 1, {
+        'sha256': '248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419'
+                  'db06c1',
+    }),
+    (b'abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmno'
+     b'ijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu', 1, {
+         'sha512': '8e959b75dae313da8cf4f72814fc143f8f7779c6eb9f7fa17299aeadb'
+                   '6889018501d289e4900f7e4331b99dec4b5433ac7d329eeb6dd26545e'
+                   '96e55b874be909',
+     }),
+    (b'a', 1000000, {
+        'sha256': 'cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7'
+                  '112cd0',
+        'sha512': 'e718483d0ce769644e2e42c7bc15b4638e1f98b13b2044285632a803af'
+                  'a973ebde0ff244877ea60a4cb0432ce577c31beb009c5c2c49aa2e4ead'
+                  'b217ad8cc09b',
+    }),
+]
+
+
+def sha_records(digest, rng):
+  alg = digest.upper()
+  block = hashlib.new(digest).block_size
+  out = ['# %s known answers for avb_sha*.c, generated by gen_kat.py' %
+         alg.replace('SHA', 'SHA-'), '']
+
+  def record(msg, repeat, md):
+    out.append('alg = %s' % alg)
+    out.append('msg = %s' % msg.hex())
+    if repeat > 1:
+      out.append('repeat = %d' % repeat)
+    out.append('md = %s' % md)
+    out.append('')
+
+  out.append('# FIPS 180-4 examples')
+  out.append('')
+  for msg, repeat, mds in FIPS_EXAMPLES:
+    if digest in mds:
+      md = hashlib.new(digest, msg * repeat).hexdigest()
+      assert md == mds[digest], (digest, msg)
+      record(msg, repeat, md)
+
+  out.append('# Every length up to two blocks and a byte')
+  out.append('')
+  for length in range(2 * block + 2):
+    msg = rng.getrandbits(8 * length).to_bytes(length, 'big')
+    record(msg, 1, hashlib.new(digest, msg).hexdigest())
+  return out
+
+
+def main():
+  data_dir = sys.argv[1] if len(sys.argv) > 1 else os.path.join(
+      os.path.dirname(os.path.abspath(__file__)), 'testdata')
+
+  for bits in (2048, 4096, 8192):
+    pem = 'testkey_rsa%d.pem' % bits
+    n, d = read_key(os.path.join(data_dir, pem))
+    rng = random.Random(bits)
+    out = ['# RSA-%d known answers for avb_rsa.c, generated by gen_kat.py '
+           'from %s' % (bits, pem), '']
+    out.append('key = %s' % avb_key_blob(n, bits).hex())
+    out.append('')
+    modpow_records(out, n, bits, rng)
+    verify_records(out, n, d, bits, rng)
+    if bits == 2048:
+      ones = (1 << bits) - 1
+      out.append('# All-ones modulus, not an RSA key')
+      out.append('key = %s' % avb_key_blob(ones, bits).hex())
+      out.append('')
+      modpow_records(out, ones, bits, rng)
+
+    with open(os.path.join(data_dir, 'rsa%d.kat' % bits), 'w') as f:
+      f.write('\n'.join(out).rstrip('\n') + '\n')
+
+  for digest in ('sha256', 'sha512'):
+    out = sha_records(digest, random.Random(digest))
+    with open(os.path.join(data_dir, '%s.kat' % digest), 'w') as f:
+      f.write('\n'.join(out).rstrip('\n') + '\n')
+
+
+if __name__ == '__main__':
+  main()
@@ -0,0 +1,76 @@
+#!/bin/bash
+
+# Usage: run_tests.sh [OUT] [bench]
+#   OUT: the make output directory holding avb_rsa_test32,
+#     avb_rsa_test64 and avb_sha_test (default: ./out).
+#   bench: time avb_rsa_verify() for each key size and limb size, and the
+#     portable SHA-256/512 code, instead of running the known answer tests.
+
+SCRIPT_DIR="$(dirname "$(readlink -f "$0")")"
+OUT="$(readlink -f "${1:-${SCRIPT_DIR}/out}")"
+KATS=("${SCRIPT_DIR}"/testdata/rsa*.kat)
+SHA_KATS=("${SCRIPT_DIR}"/testdata/sha*.kat)
+BENCH_ITERATIONS=200
+BENCH_MEGABYTES=64
+
+alert() {
+  echo "$*" >&2
+}
+
+die() {
+  echo "ERROR: $@"
+  exit 1
+}
+
+# Usage: run_test_case <limb_bits>
+run_test_case() {
+  local limb_bits="$1"
+
+  alert "Run the known answer tests with ${limb_bits}-bit limbs"
+  # The rejected signatures make avb_rsa.c log errors, keep only the results
+  "${OUT}/avb_rsa_test${limb_bits}" "${KATS[@]}" 2>&1 | grep -v " ERROR: "
+  [ "${PIPESTATUS[0]}" = 0 ] ||
+    die "Known answer tests with ${limb_bits}-bit limbs failed!!"
+}
+
+# Usage: run_sha_test_case <isar0_sha2_level> [-n]
+run_sha_test_case() {
+  local level="$1"
+  local hash2="${2:+out}"
+
+  alert "Run the SHA known answer tests with ISAR0.SHA2 ${level}," \
+    "with${hash2} Hash2"
+  "${OUT}/avb_sha_test" -l "${level}" $2 "${SHA_KATS[@]}" ||
+    die "SHA known answer tests with ISAR0.SHA2 ${level} failed!!"
+}
+
+main() {
+  if [ ! -x "${OUT}/avb_rsa_test32" ] || [ ! -x "${OUT}/avb_rsa_test64" ] ||
+    [ ! -x "${OUT}/avb_sha_test" ]; then
+    die "Run make in ${SCRIPT_DIR} yet?"
+  fi
+
+  if [ "$2" = "bench" ]; then
+    alert "========== Benchmarking avb_rsa =========="
+    "${OUT}/avb_rsa_test32" -b ${BENCH_ITERATIONS} "${KATS[@]}" ||
+      die "Benchmark failed!!"
+    "${OUT}/avb_rsa_test64" -b ${BENCH_ITERATIONS} "${KATS[@]}" ||
+      die "Benchmark failed!!"
+    alert "========== Benchmarking avb_sha =========="
+    # Only the portable code runs natively on the host
+    "${OUT}/avb_sha_test" -n -b ${BENCH_MEGABYTES} || die "Benchmark failed!!"
+    return
+  fi
+
+  alert "========== Running Tests of avb_rsa =========="
+  run_test_case 32
+  run_test_case 64
+  alert "========== Running Tests of avb_sha =========="
+  for level in 0 1 2; do
+    run_sha_test_case ${level}
+    run_sha_test_case ${level} -n
+  done
+  alert "========== All tests passed =========="
+}
+
+main "$@"
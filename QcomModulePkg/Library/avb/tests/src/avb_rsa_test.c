@@ -0,0 +1,247 @@
+/* Known answer test and benchmark for avb_rsa.c.
+ *
+ *   avb_rsa_test KAT...
+ *       Runs every record of the known answer files, see gen_kat.py for
+ *       the format. Exits non-zero if any record fails.
+ *   avb_rsa_test -b ITERATIONS KAT...
+ *       Times avb_rsa_verify() on the first passing verify record of each
+ *       file instead.
+ *
+ * avb_rsa.c is included rather than linked so that modpowF4() can be
+ * checked on its own. Build it once per limb size, with and without
+ * AVB_RSA_64BIT_LIMBS.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "avb_rsa.c"
+
+#define MAX_FIELD_BYTES 4096
+
+static const struct {
+  const char* name;
+  AvbAlgorithmType type;
+} algorithms[] = {
+    {"SHA256_RSA2048", AVB_ALGORITHM_TYPE_SHA256_RSA2048},
+    {"SHA256_RSA4096", AVB_ALGORITHM_TYPE_SHA256_RSA4096},
+    {"SHA256_RSA8192", AVB_ALGORITHM_TYPE_SHA256_RSA8192},
+    {"SHA512_RSA2048", AVB_ALGORITHM_TYPE_SHA512_RSA2048},
+    {"SHA512_RSA4096", AVB_ALGORITHM_TYPE_SHA512_RSA4096},
+    {"SHA512_RSA8192", AVB_ALGORITHM_TYPE_SHA512_RSA8192},
+};
+
+typedef struct {
+  uint8_t data[MAX_FIELD_BYTES + sizeof(AvbRSAPublicKeyHeader) +
+               MAX_FIELD_BYTES];
+  size_t len;
+} field_t;
+
+/* One record, the key carries over from the last key line */
+typedef struct {
+  field_t key;
+  char op[16];
+  char alg[32];
+  char result[8];
+  field_t in;
+  field_t out;
+  field_t hash;
+  field_t sig;
+  int line;
+} record_t;
+
+static int parse_hex(field_t* field, const char* hex) {
+  size_t len = strlen(hex);
+  size_t i;
+
+  if (len % 2 || len / 2 > sizeof(field->data)) {
+    return -1;
+  }
+  for (i = 0; i < len / 2; i++) {
+    unsigned int byte;
+    if (sscanf(hex + 2 * i, "%2x", &byte) != 1) {
+      return -1;
+    }
+    field->data[i] = (uint8_t)byte;
+  }
+  field->len = len / 2;
+  return 0;
+}
+
+static const AvbAlgorithmData* find_algorithm(const char* name) {
+  size_t i;
+
+  for (i = 0; i < sizeof(algorithms) / sizeof(algorithms[0]); i++) {
+    if (!strcmp(algorithms[i].name, name)) {
+      return avb_get_algorithm_data(algorithms[i].type);
+    }
+  }
+  return NULL;
+}
+
+static bool run_modpow(const record_t* r) {
+  uint8_t buf[MAX_FIELD_BYTES];
+  Key* key;
+  bool ok;
+
+  key = parse_key_data(r->key.data, r->key.len);
+  if (key == NULL || r->in.len != key->len * sizeof(avb_limb_t) ||
+      r->out.len != r->in.len) {
+    if (key != NULL) {
+      free_parsed_key(key);
+    }
+    return false;
+  }
+
+  memcpy(buf, r->in.data, r->in.len);
+  modpowF4(key, buf);
+  ok = !memcmp(buf, r->out.data, r->out.len);
+  free_parsed_key(key);
+  return ok;
+}
+
+static bool run_verify(const record_t* r) {
+  const AvbAlgorithmData* alg = find_algorithm(r->alg);
+  bool expected = !strcmp(r->result, "pass");
+
+  if (alg == NULL || r->hash.len != alg->hash_len) {
+    return false;
+  }
+  return avb_rsa_verify(r->key.data, r->key.len, r->sig.data, r->sig.len,
+                        r->hash.data, r->hash.len, alg->padding,
+                        alg->padding_len) == expected;
+}
+
+static void bench_verify(const char* filename, const record_t* r,
+                         int iterations) {
+  const AvbAlgorithmData* alg = find_algorithm(r->alg);
+  clock_t start;
+  double secs;
+  int i;
+
+  start = clock();
+  for (i = 0; i < iterations; i++) {
+    if (!avb_rsa_verify(r->key.data, r->key.len, r->sig.data, r->sig.len,
+                        r->hash.data, r->hash.len, alg->padding,
+                        alg->padding_len)) {
+      fprintf(stderr, "%s:%d: verify failed\n", filename, r->line);
+      exit(1);
+    }
+  }
+  secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+  printf("%s: %s, %d-bit limbs: %.1f us per verify\n",
+         avb_basename(filename), r->alg, AVB_RSA_LIMB_BITS,
+         secs * 1e6 / iterations);
+}
+
+/* Runs, or with iterations > 0 benchmarks, the records of one file.
+ * Returns the number of failed records.
+ */
+static int run_file(const char* filename, int iterations) {
+  static record_t r;
+  char* line = NULL;
+  size_t cap = 0;
+  ssize_t len;
+  int line_no = 0;
+  int count = 0;
+  int failed = 0;
+  FILE* fp;
+
+  fp = fopen(filename, "r");
+  if (!fp) {
+    fprintf(stderr, "Can not open %s\n", filename);
+    return 1;
+  }
+
+  memset(&r, 0, sizeof(r));
+  /* A blank line after the last record runs it too */
+  do {
+    char* value;
+
+    len = getline(&line, &cap, fp);
+    line_no++;
+    if (len > 0 && line[len - 1] == '\n') {
+      line[--len] = '\0';
+    }
+    if (len > 0 && line[0] == '#') {
+      continue;
+    }
+
+    if (len > 0) {
+      value = strstr(line, " = ");
+      if (value == NULL) {
+        fprintf(stderr, "%s:%d: bad line\n", filename, line_no);
+        failed++;
+        continue;
+      }
+      *value = '\0';
+      value += 3;
+
+      if ((!strcmp(line, "key") && parse_hex(&r.key, value)) ||
+          (!strcmp(line, "in") && parse_hex(&r.in, value)) ||
+          (!strcmp(line, "out") && parse_hex(&r.out, value)) ||
+          (!strcmp(line, "hash") && parse_hex(&r.hash, value)) ||
+          (!strcmp(line, "sig") && parse_hex(&r.sig, value))) {
+        fprintf(stderr, "%s:%d: bad hex\n", filename, line_no);
+        failed++;
+      } else if (!strcmp(line, "op")) {
+        snprintf(r.op, sizeof(r.op), "%s", value);
+        r.line = line_no;
+      } else if (!strcmp(line, "alg")) {
+        snprintf(r.alg, sizeof(r.alg), "%s", value);
+      } else if (!strcmp(line, "result")) {
+        snprintf(r.result, sizeof(r.result), "%s", value);
+      }
+      continue;
+    }
+
+    /* End of a record */
+    if (r.op[0] == '\0') {
+      continue;
+    }
+    if (iterations > 0) {
+      if (!strcmp(r.op, "verify") && !strcmp(r.result, "pass")) {
+        bench_verify(filename, &r, iterations);
+        break;
+      }
+    } else {
+      bool ok = !strcmp(r.op, "modpow") ? run_modpow(&r) : run_verify(&r);
+      if (!ok) {
+        fprintf(stderr, "%s:%d: %s failed\n", filename, r.line, r.op);
+        failed++;
+      }
+      count++;
+    }
+    r.op[0] = '\0';
+  } while (len >= 0);
+
+  if (iterations == 0) {
+    printf("%s: %d records, %d failed, %d-bit limbs\n",
+           avb_basename(filename), count, failed, AVB_RSA_LIMB_BITS);
+  }
+  free(line);
+  fclose(fp);
+  return failed;
+}
+
+int main(int argc, char** argv) {
+  int iterations = 0;
+  int failed = 0;
+  int i = 1;
+
+  if (argc > 2 && !strcmp(argv[1], "-b")) {
+    iterations = atoi(argv[2]);
+    i = 3;
+  }
+  if (i >= argc || iterations < 0) {
+    fprintf(stderr, "Usage: %s [-b ITERATIONS] KAT...\n", argv[0]);
+    return 1;
+  }
+
+  for (; i < argc; i++) {
+    failed += run_file(argv[i], iterations);
+  }
+  return failed != 0;
+}
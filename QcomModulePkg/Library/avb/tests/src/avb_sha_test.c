@@ -0,0 +1,320 @@
+/* Known answer test and benchmark for the avb_sha256_*() and avb_sha512_*()
+ * backends.
+ *
+ *   avb_sha_test [-l LEVEL] [-n] KAT...
+ *       Runs every record of the known answer files, see gen_kat.py for
+ *       the format, feeding each message whole and in chunks of several
+ *       sizes. Exits non-zero if any record fails or if a message was
+ *       hashed by another backend than Hash2Client.c should pick.
+ *   avb_sha_test [-l LEVEL] [-n] -b MEGABYTES
+ *       Times hashing MEGABYTES of data with each algorithm instead.
+ *
+ * -l sets the SHA2 field of ID_AA64ISAR0_EL1 the code reads (default 0),
+ * -n hides the Hash2 protocol. That picks the SHA-256 backend:
+ *   LEVEL >= 1: the SHA-256 instructions,
+ *   LEVEL 0: the Hash2 protocol, or with -n the portable C code,
+ * and the SHA-512 one: the SHA-512 instructions with LEVEL 2, otherwise
+ * the portable C code. sha_host.c stands in for the instructions with the
+ * FIPS 180-4 reference compression, so only the dispatch around
+ * AArch64/ShaCe.S is tested here.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "avb_sha.h"
+#include "avb_util.h"
+#include "sha_host.h"
+
+#define MAX_MSG_BYTES 4096
+#define MAX_REPEAT 1000000
+
+/* Update sizes each message is also fed in, 0 for the whole message */
+static const size_t chunk_sizes[] = {0, 1, 55, 63, 64, 65, 127, 128, 129};
+
+typedef struct {
+  char alg[8];
+  uint8_t msg[MAX_MSG_BYTES];
+  size_t msg_len;
+  long repeat;
+  uint8_t md[AVB_SHA512_DIGEST_SIZE];
+  size_t md_len;
+  int line;
+} record_t;
+
+static int parse_hex(uint8_t* out, size_t cap, size_t* out_len,
+                     const char* hex) {
+  size_t len = strlen(hex);
+  size_t i;
+
+  if (len % 2 || len / 2 > cap) {
+    return -1;
+  }
+  for (i = 0; i < len / 2; i++) {
+    unsigned int byte;
+    if (sscanf(hex + 2 * i, "%2x", &byte) != 1) {
+      return -1;
+    }
+    out[i] = (uint8_t)byte;
+  }
+  *out_len = len / 2;
+  return 0;
+}
+
+static const char* sha256_backend(void) {
+  if (HostIsar0Sha2 >= 1) {
+    return "SHA-256 instructions";
+  }
+  return HostHash2 ? "Hash2 protocol" : "portable C";
+}
+
+static const char* sha512_backend(void) {
+  return HostIsar0Sha2 >= 2 ? "SHA-512 instructions" : "portable C";
+}
+
+/* Whether the counters since the last reset match the backend */
+static bool backend_used(bool sha512) {
+  bool ok;
+
+  if (sha512) {
+    ok = HostCounters.hash2_inits == 0 && HostCounters.ce256_blocks == 0 &&
+         (HostIsar0Sha2 >= 2) == (HostCounters.ce512_blocks != 0);
+  } else if (HostIsar0Sha2 >= 1) {
+    ok = HostCounters.hash2_inits == 0 && HostCounters.ce256_blocks != 0;
+  } else {
+    ok = HostCounters.ce256_blocks == 0 &&
+         (HostHash2 != 0) == (HostCounters.hash2_inits != 0);
+  }
+  ok = ok && (sha512 || HostCounters.ce512_blocks == 0);
+  HostCounters.ce256_blocks = 0;
+  HostCounters.ce512_blocks = 0;
+  HostCounters.hash2_inits = 0;
+  return ok;
+}
+
+/* Hashes data in chunk byte updates, the whole data for 0 */
+static void hash(bool sha512, const uint8_t* data, size_t len, size_t chunk,
+                 uint8_t* md) {
+  AvbSHA256Ctx ctx256;
+  AvbSHA512Ctx ctx512;
+  size_t off = 0;
+
+  if (chunk == 0) {
+    chunk = len;
+  }
+  if (sha512) {
+    avb_sha512_init(&ctx512);
+  } else {
+    avb_sha256_init(&ctx256);
+  }
+  do {
+    size_t n = len - off < chunk ? len - off : chunk;
+    if (sha512) {
+      avb_sha512_update(&ctx512, data + off, (uint32_t)n);
+    } else {
+      avb_sha256_update(&ctx256, data + off, (uint32_t)n);
+    }
+    off += n;
+  } while (off < len);
+  if (sha512) {
+    memcpy(md, avb_sha512_final(&ctx512), AVB_SHA512_DIGEST_SIZE);
+  } else {
+    memcpy(md, avb_sha256_final(&ctx256), AVB_SHA256_DIGEST_SIZE);
+  }
+}
+
+static bool run_record(const record_t* r, const char* filename) {
+  bool sha512 = !strcmp(r->alg, "SHA512");
+  size_t md_len = sha512 ? AVB_SHA512_DIGEST_SIZE : AVB_SHA256_DIGEST_SIZE;
+  uint8_t md[AVB_SHA512_DIGEST_SIZE];
+  uint8_t* data;
+  size_t len = r->msg_len * r->repeat;
+  bool ok = true;
+  size_t i;
+
+  if ((!sha512 && strcmp(r->alg, "SHA256")) || r->md_len != md_len ||
+      r->repeat < 1 || r->repeat > MAX_REPEAT) {
+    fprintf(stderr, "%s:%d: bad record\n", filename, r->line);
+    return false;
+  }
+
+  data = malloc(len + 1);
+  if (data == NULL) {
+    fprintf(stderr, "%s:%d: out of memory\n", filename, r->line);
+    return false;
+  }
+  for (i = 0; i < (size_t)r->repeat; i++) {
+    memcpy(data + i * r->msg_len, r->msg, r->msg_len);
+  }
+
+  for (i = 0; i < sizeof(chunk_sizes) / sizeof(chunk_sizes[0]); i++) {
+    hash(sha512, data, len, chunk_sizes[i], md);
+    if (memcmp(md, r->md, md_len)) {
+      fprintf(stderr, "%s:%d: %s of %zu bytes in %zu byte chunks: bad digest\n",
+              filename, r->line, r->alg, len, chunk_sizes[i]);
+      ok = false;
+    }
+    if (!backend_used(sha512)) {
+      fprintf(stderr, "%s:%d: %s not hashed by the %s\n", filename, r->line,
+              r->alg, sha512 ? sha512_backend() : sha256_backend());
+      ok = false;
+    }
+  }
+  free(data);
+  return ok;
+}
+
+/* Runs the records of one file. Returns the number of failed records. */
+static int run_file(const char* filename) {
+  static record_t r;
+  char* line = NULL;
+  size_t cap = 0;
+  ssize_t len;
+  int line_no = 0;
+  int count = 0;
+  int failed = 0;
+  FILE* fp;
+
+  fp = fopen(filename, "r");
+  if (!fp) {
+    fprintf(stderr, "Can not open %s\n", filename);
+    return 1;
+  }
+
+  memset(&r, 0, sizeof(r));
+  r.repeat = 1;
+  /* A blank line after the last record runs it too */
+  do {
+    char* value;
+
+    len = getline(&line, &cap, fp);
+    line_no++;
+    if (len > 0 && line[len - 1] == '\n') {
+      line[--len] = '\0';
+    }
+    if (len > 0 && line[0] == '#') {
+      continue;
+    }
+
+    if (len > 0) {
+      /* An empty message is "msg = " */
+      value = strstr(line, " =");
+      if (value == NULL) {
+        fprintf(stderr, "%s:%d: bad line\n", filename, line_no);
+        failed++;
+        continue;
+      }
+      *value = '\0';
+      value += value[2] == ' ' ? 3 : 2;
+
+      if ((!strcmp(line, "msg") &&
+           parse_hex(r.msg, sizeof(r.msg), &r.msg_len, value)) ||
+          (!strcmp(line, "md") &&
+           parse_hex(r.md, sizeof(r.md), &r.md_len, value))) {
+        fprintf(stderr, "%s:%d: bad hex\n", filename, line_no);
+        failed++;
+      } else if (!strcmp(line, "alg")) {
+        snprintf(r.alg, sizeof(r.alg), "%s", value);
+        r.line = line_no;
+      } else if (!strcmp(line, "repeat")) {
+        r.repeat = atol(value);
+      }
+      continue;
+    }
+
+    /* End of a record */
+    if (r.alg[0] == '\0') {
+      continue;
+    }
+    if (!run_record(&r, filename)) {
+      failed++;
+    }
+    count++;
+    memset(&r, 0, sizeof(r));
+    r.repeat = 1;
+  } while (len >= 0);
+
+  printf("%s: %d records, %d failed, SHA-256 via %s, SHA-512 via %s\n",
+         avb_basename(filename), count, failed, sha256_backend(),
+         sha512_backend());
+  free(line);
+  fclose(fp);
+  return failed;
+}
+
+static void bench(bool sha512, const uint8_t* data, size_t len) {
+  uint8_t md[AVB_SHA512_DIGEST_SIZE];
+  clock_t start;
+  double secs;
+
+  start = clock();
+  /* 1 MB updates, like the hash worker's */
+  hash(sha512, data, len, 1024 * 1024, md);
+  secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+  printf("%s via %s: %.1f MB/s\n", sha512 ? "SHA-512" : "SHA-256",
+         sha512 ? sha512_backend() : sha256_backend(),
+         len / (1024.0 * 1024.0) / secs);
+}
+
+int main(int argc, char** argv) {
+  int megabytes = 0;
+  int failed = 0;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "l:nb:")) != -1) {
+    switch (opt) {
+      case 'l':
+        HostIsar0Sha2 = (unsigned int)atoi(optarg);
+        break;
+      case 'n':
+        HostHash2 = 0;
+        break;
+      case 'b':
+        megabytes = atoi(optarg);
+        break;
+      default:
+        optind = argc + 1;
+        break;
+    }
+  }
+  if (HostIsar0Sha2 > 2 || megabytes < 0 || optind > argc ||
+      (megabytes == 0) == (optind == argc)) {
+    fprintf(stderr,
+            "Usage: %s [-l LEVEL] [-n] KAT...\n"
+            "       %s [-l LEVEL] [-n] -b MEGABYTES\n",
+            argv[0], argv[0]);
+    return 1;
+  }
+
+  if (megabytes > 0) {
+    size_t len = (size_t)megabytes * 1024 * 1024;
+    uint8_t* data = malloc(len);
+    size_t i;
+
+    if (data == NULL) {
+      fprintf(stderr, "Out of memory\n");
+      return 1;
+    }
+    for (i = 0; i < len; i++) {
+      data[i] = (uint8_t)(i * 2654435761u >> 24);
+    }
+    bench(false, data, len);
+    bench(true, data, len);
+    free(data);
+    return 0;
+  }
+
+  for (; optind < argc; optind++) {
+    failed += run_file(argv[optind]);
+  }
+  /* Hash2Client.c caches the level */
+  if (HostCounters.isar0_reads != 1) {
+    fprintf(stderr, "ID_AA64ISAR0_EL1 read %zu times\n",
+            HostCounters.isar0_reads);
+    failed++;
+  }
+  return failed != 0;
+}
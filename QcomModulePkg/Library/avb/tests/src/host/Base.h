@@ -0,0 +1,26 @@
+#ifndef _AVB_TEST_BASE_H_
+#define _AVB_TEST_BASE_H_
+
+/* Host stand-in for MdePkg's Base.h: just the types avb_sysdeps.h maps
+ * onto the C runtime ones. Lets tests/Makefile build avb_rsa.c with libc.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef unsigned char BOOLEAN;
+typedef int8_t INT8;
+typedef uint8_t UINT8;
+typedef uint16_t UINT16;
+typedef int32_t INT32;
+typedef uint32_t UINT32;
+typedef int64_t INT64;
+typedef uint64_t UINT64;
+typedef size_t UINTN;
+typedef char CHAR8;
+typedef void VOID;
+typedef UINTN EFI_STATUS;
+
+#define CONST const
+
+#endif
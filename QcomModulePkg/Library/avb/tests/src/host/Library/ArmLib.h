@@ -0,0 +1,15 @@
+#ifndef _AVB_TEST_ARM_LIB_H_
+#define _AVB_TEST_ARM_LIB_H_
+
+/* Host stand-in for ArmLib.h and the ID_AA64ISAR0 fields of
+ * Chipset/AArch64.h. ArmReadIdAa64Isar0 () is in sha_host.c.
+ */
+
+#define AARCH64_ISAR0_SHA2_SHIFT 12
+#define AARCH64_ISAR0_SHA2_MASK (0xFUL << AARCH64_ISAR0_SHA2_SHIFT)
+#define AARCH64_ISAR0_SHA2_256 1
+#define AARCH64_ISAR0_SHA2_512 2
+
+UINTN ArmReadIdAa64Isar0 (VOID);
+
+#endif
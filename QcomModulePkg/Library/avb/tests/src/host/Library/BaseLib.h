@@ -0,0 +1,6 @@
+#ifndef _AVB_TEST_BASE_LIB_H_
+#define _AVB_TEST_BASE_LIB_H_
+
+/* Host stand-in for BaseLib.h, Hash2Client.c uses none of it */
+
+#endif
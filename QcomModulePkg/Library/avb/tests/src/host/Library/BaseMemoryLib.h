@@ -0,0 +1,9 @@
+#ifndef _AVB_TEST_BASE_MEMORY_LIB_H_
+#define _AVB_TEST_BASE_MEMORY_LIB_H_
+
+#include <string.h>
+
+#define CopyMem(Dst, Src, Len) memmove ((Dst), (Src), (Len))
+#define SetMem(Buf, Len, Value) memset ((Buf), (Value), (Len))
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef _AVB_TEST_UEFI_BOOT_SERVICES_TABLE_LIB_H_
+#define _AVB_TEST_UEFI_BOOT_SERVICES_TABLE_LIB_H_
+
+/* Host stand-in for the boot services table: just LocateProtocol, which
+ * sha_host.c implements.
+ */
+
+#include <Uefi.h>
+
+typedef struct {
+  EFI_STATUS (*LocateProtocol) (EFI_GUID *Protocol, VOID *Registration,
+                                VOID **Interface);
+} EFI_BOOT_SERVICES;
+
+extern EFI_BOOT_SERVICES *gBS;
+
+#endif
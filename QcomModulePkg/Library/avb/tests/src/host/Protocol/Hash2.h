@@ -0,0 +1,29 @@
+#ifndef _AVB_TEST_HASH2_H_
+#define _AVB_TEST_HASH2_H_
+
+/* Host stand-in for Protocol/Hash2.h, same member order as the real one */
+
+#include <Uefi.h>
+
+typedef struct _EFI_HASH2_PROTOCOL EFI_HASH2_PROTOCOL;
+
+typedef union {
+  UINT8 Sha256Hash[32];
+  UINT8 Sha512Hash[64];
+} EFI_HASH2_OUTPUT;
+
+struct _EFI_HASH2_PROTOCOL {
+  VOID *GetHashSize;
+  VOID *Hash;
+  EFI_STATUS (*HashInit) (CONST EFI_HASH2_PROTOCOL *This,
+                          CONST EFI_GUID *HashAlgorithm);
+  EFI_STATUS (*HashUpdate) (CONST EFI_HASH2_PROTOCOL *This,
+                            CONST UINT8 *Message, UINTN MessageSize);
+  EFI_STATUS (*HashFinal) (CONST EFI_HASH2_PROTOCOL *This,
+                           EFI_HASH2_OUTPUT *Hash);
+};
+
+extern EFI_GUID gEfiHash2ProtocolGuid;
+extern EFI_GUID gEfiHashAlgorithmSha256Guid;
+
+#endif
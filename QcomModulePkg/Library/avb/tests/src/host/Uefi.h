@@ -0,0 +1,30 @@
+#ifndef _AVB_TEST_UEFI_H_
+#define _AVB_TEST_UEFI_H_
+
+/* Host stand-in for MdePkg's Uefi.h: the status codes and GUID type
+ * Hash2Client.c uses.
+ */
+
+#include "Base.h"
+
+typedef struct {
+  UINT32 Data1;
+  UINT16 Data2;
+  UINT16 Data3;
+  UINT8 Data4[8];
+} EFI_GUID;
+
+#define EFIAPI
+#define IN
+#define OUT
+#define STATIC static
+#define MAX_UINTN SIZE_MAX
+
+#define EFI_SUCCESS 0
+#define EFI_ERROR_BIT ((EFI_STATUS)1 << (sizeof (EFI_STATUS) * 8 - 1))
+#define EFI_INVALID_PARAMETER (EFI_ERROR_BIT | 2)
+#define EFI_UNSUPPORTED (EFI_ERROR_BIT | 3)
+#define EFI_OUT_OF_RESOURCES (EFI_ERROR_BIT | 9)
+#define EFI_NOT_FOUND (EFI_ERROR_BIT | 14)
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef _AVB_TEST_VERIFIED_BOOT_H_
+#define _AVB_TEST_VERIFIED_BOOT_H_
+
+/* Host stand-in for the boot loader's VerifiedBoot.h. avb_rsa.c needs
+ * nothing from it, Hash2Client.c only GUARD_OUT.
+ */
+
+#define GUARD_OUT(code)                                                        \
+  do {                                                                         \
+    Status = (code);                                                           \
+    if (Status != EFI_SUCCESS) {                                               \
+      goto out;                                                                \
+    }                                                                          \
+  } while (0)
+
+#endif
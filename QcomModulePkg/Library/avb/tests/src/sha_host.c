@@ -0,0 +1,237 @@
+/* What Hash2Client.c and the SHA-256/512 transforms reach outside libavb,
+ * for a host build with MDE_CPU_AARCH64 set:
+ *   - ArmReadIdAa64Isar0 (), reporting HostIsar0Sha2 as the SHA2 field,
+ *   - gBS->LocateProtocol (), finding a Hash2 protocol if HostHash2 is set,
+ *   - avb_sha256_ce_transform () and avb_sha512_ce_transform (), standing
+ *     in for AArch64/ShaCe.S with the FIPS 180-4 reference compression.
+ * Each path counts its use in HostCounters, so the test can tell which
+ * backend hashed a message.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sha_host.h"
+
+#include <Uefi.h>
+#include <Library/ArmLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Protocol/Hash2.h>
+
+#include "avb_sha.h"
+
+unsigned int HostIsar0Sha2;
+int HostHash2 = 1;
+host_counters_t HostCounters;
+
+EFI_GUID gEfiHash2ProtocolGuid = {
+    0x55b1d734, 0xc5e1, 0x49db, {0x96, 0x47, 0xb1, 0x6a, 0xfb, 0x0e, 0x30, 0x5b}};
+EFI_GUID gEfiHashAlgorithmSha256Guid = {
+    0x51aa59de, 0xfdf2, 0x4ea3, {0xbc, 0x63, 0x87, 0x5f, 0xb7, 0x84, 0x2e, 0xe9}};
+
+static const uint32_t k256[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+static const uint64_t k512[80] = {
+    0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL,
+    0xe9b5dba58189dbbcULL, 0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL,
+    0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL, 0xd807aa98a3030242ULL,
+    0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+    0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL,
+    0xc19bf174cf692694ULL, 0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL,
+    0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL, 0x2de92c6f592b0275ULL,
+    0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+    0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL,
+    0xbf597fc7beef0ee4ULL, 0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL,
+    0x06ca6351e003826fULL, 0x142929670a0e6e70ULL, 0x27b70a8546d22ffcULL,
+    0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+    0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL,
+    0x92722c851482353bULL, 0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL,
+    0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL, 0xd192e819d6ef5218ULL,
+    0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+    0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL,
+    0x34b0bcb5e19b48a8ULL, 0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL,
+    0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL, 0x748f82ee5defb2fcULL,
+    0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+    0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL,
+    0xc67178f2e372532bULL, 0xca273eceea26619cULL, 0xd186b8c721c0c207ULL,
+    0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL, 0x06f067aa72176fbaULL,
+    0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+    0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL,
+    0x431d67c49c100d4cULL, 0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL,
+    0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL};
+
+#define ROR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define ROR64(x, n) (((x) >> (n)) | ((x) << (64 - (n))))
+
+/* FIPS 180-4 section 6.2.2 */
+static void ref_sha256_block(uint32_t h[8], const uint8_t* p) {
+  uint32_t w[64], s[8], t1, t2;
+  int i;
+
+  for (i = 0; i < 16; i++) {
+    w[i] = (uint32_t)p[4 * i] << 24 | (uint32_t)p[4 * i + 1] << 16 |
+           (uint32_t)p[4 * i + 2] << 8 | p[4 * i + 3];
+  }
+  for (; i < 64; i++) {
+    w[i] = (ROR32(w[i - 2], 17) ^ ROR32(w[i - 2], 19) ^ (w[i - 2] >> 10)) +
+           w[i - 7] +
+           (ROR32(w[i - 15], 7) ^ ROR32(w[i - 15], 18) ^ (w[i - 15] >> 3)) +
+           w[i - 16];
+  }
+  memcpy(s, h, sizeof(s));
+  for (i = 0; i < 64; i++) {
+    t1 = s[7] + (ROR32(s[4], 6) ^ ROR32(s[4], 11) ^ ROR32(s[4], 25)) +
+         ((s[4] & s[5]) ^ (~s[4] & s[6])) + k256[i] + w[i];
+    t2 = (ROR32(s[0], 2) ^ ROR32(s[0], 13) ^ ROR32(s[0], 22)) +
+         ((s[0] & s[1]) ^ (s[0] & s[2]) ^ (s[1] & s[2]));
+    memmove(s + 1, s, 7 * sizeof(s[0]));
+    s[4] += t1;
+    s[0] = t1 + t2;
+  }
+  for (i = 0; i < 8; i++) {
+    h[i] += s[i];
+  }
+}
+
+/* FIPS 180-4 section 6.4.2 */
+static void ref_sha512_block(uint64_t h[8], const uint8_t* p) {
+  uint64_t w[80], s[8], t1, t2;
+  int i, j;
+
+  for (i = 0; i < 16; i++) {
+    w[i] = 0;
+    for (j = 0; j < 8; j++) {
+      w[i] = w[i] << 8 | p[8 * i + j];
+    }
+  }
+  for (; i < 80; i++) {
+    w[i] = (ROR64(w[i - 2], 19) ^ ROR64(w[i - 2], 61) ^ (w[i - 2] >> 6)) +
+           w[i - 7] +
+           (ROR64(w[i - 15], 1) ^ ROR64(w[i - 15], 8) ^ (w[i - 15] >> 7)) +
+           w[i - 16];
+  }
+  memcpy(s, h, sizeof(s));
+  for (i = 0; i < 80; i++) {
+    t1 = s[7] + (ROR64(s[4], 14) ^ ROR64(s[4], 18) ^ ROR64(s[4], 41)) +
+         ((s[4] & s[5]) ^ (~s[4] & s[6])) + k512[i] + w[i];
+    t2 = (ROR64(s[0], 28) ^ ROR64(s[0], 34) ^ ROR64(s[0], 39)) +
+         ((s[0] & s[1]) ^ (s[0] & s[2]) ^ (s[1] & s[2]));
+    memmove(s + 1, s, 7 * sizeof(s[0]));
+    s[4] += t1;
+    s[0] = t1 + t2;
+  }
+  for (i = 0; i < 8; i++) {
+    h[i] += s[i];
+  }
+}
+
+void avb_sha256_ce_transform(uint32_t h[8], const uint8_t* data,
+                             size_t blocks) {
+  HostCounters.ce256_blocks += blocks;
+  for (; blocks; blocks--, data += 64) {
+    ref_sha256_block(h, data);
+  }
+}
+
+void avb_sha512_ce_transform(uint64_t h[8], const uint8_t* data,
+                             size_t blocks) {
+  HostCounters.ce512_blocks += blocks;
+  for (; blocks; blocks--, data += 128) {
+    ref_sha512_block(h, data);
+  }
+}
+
+UINTN ArmReadIdAa64Isar0(VOID) {
+  HostCounters.isar0_reads++;
+  return (UINTN)HostIsar0Sha2 << AARCH64_ISAR0_SHA2_SHIFT;
+}
+
+/* Hash2 protocol: keeps the message and hashes it on HashFinal */
+static uint8_t* hash2_msg;
+static size_t hash2_len;
+
+static EFI_STATUS Hash2Init(CONST EFI_HASH2_PROTOCOL* This,
+                            CONST EFI_GUID* HashAlgorithm) {
+  if (memcmp(HashAlgorithm, &gEfiHashAlgorithmSha256Guid, sizeof(EFI_GUID))) {
+    return EFI_UNSUPPORTED;
+  }
+  HostCounters.hash2_inits++;
+  free(hash2_msg);
+  hash2_msg = NULL;
+  hash2_len = 0;
+  return EFI_SUCCESS;
+}
+
+static EFI_STATUS Hash2Update(CONST EFI_HASH2_PROTOCOL* This,
+                              CONST UINT8* Message,
+                              UINTN MessageSize) {
+  uint8_t* msg = realloc(hash2_msg, hash2_len + MessageSize + 1);
+
+  if (msg == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  memcpy(msg + hash2_len, Message, MessageSize);
+  hash2_msg = msg;
+  hash2_len += MessageSize;
+  return EFI_SUCCESS;
+}
+
+static EFI_STATUS Hash2Final(CONST EFI_HASH2_PROTOCOL* This,
+                             EFI_HASH2_OUTPUT* Hash) {
+  uint32_t h[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                   0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+  uint8_t block[128];
+  size_t done = hash2_len & ~(size_t)63;
+  size_t rest = hash2_len - done;
+  size_t pad = rest < 56 ? 64 : 128;
+  uint64_t bits = (uint64_t)hash2_len * 8;
+  size_t i;
+
+  for (i = 0; i < done; i += 64) {
+    ref_sha256_block(h, hash2_msg + i);
+  }
+  memset(block, 0, sizeof(block));
+  if (rest) {
+    memcpy(block, hash2_msg + done, rest);
+  }
+  block[rest] = 0x80;
+  for (i = 0; i < 8; i++) {
+    block[pad - 1 - i] = (uint8_t)(bits >> (8 * i));
+  }
+  for (i = 0; i < pad; i += 64) {
+    ref_sha256_block(h, block + i);
+  }
+  for (i = 0; i < 32; i++) {
+    Hash->Sha256Hash[i] = (uint8_t)(h[i / 4] >> (24 - 8 * (i % 4)));
+  }
+  return EFI_SUCCESS;
+}
+
+static EFI_HASH2_PROTOCOL Hash2 = {
+    NULL, NULL, Hash2Init, Hash2Update, Hash2Final,
+};
+
+static EFI_STATUS LocateProtocol(EFI_GUID* Protocol,
+                                 VOID* Registration,
+                                 VOID** Interface) {
+  if (!HostHash2 || memcmp(Protocol, &gEfiHash2ProtocolGuid, sizeof(*Protocol))) {
+    return EFI_NOT_FOUND;
+  }
+  *Interface = &Hash2;
+  return EFI_SUCCESS;
+}
+
+static EFI_BOOT_SERVICES BootServices = {LocateProtocol};
+EFI_BOOT_SERVICES* gBS = &BootServices;
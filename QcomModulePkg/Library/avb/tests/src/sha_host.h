@@ -0,0 +1,24 @@
+#ifndef _AVB_TEST_SHA_HOST_H_
+#define _AVB_TEST_SHA_HOST_H_
+
+/* The boot loader environment sha_host.c simulates for Hash2Client.c and
+ * the SHA-256/512 transforms.
+ */
+
+#include <stddef.h>
+
+/* ID_AA64ISAR0_EL1.SHA2: 0 none, 1 SHA-256, 2 SHA-256 and SHA-512 */
+extern unsigned int HostIsar0Sha2;
+/* Whether gBS->LocateProtocol () finds the Hash2 protocol */
+extern int HostHash2;
+
+typedef struct {
+  size_t isar0_reads;
+  size_t ce256_blocks;
+  size_t ce512_blocks;
+  size_t hash2_inits;
+} host_counters_t;
+
+extern host_counters_t HostCounters;
+
+#endif
@@ -0,0 +1,389 @@
+/* Copyright (c) 2026, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimer in the documentation and/or other materials provided
+ *  with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * LZ4 decoder for compressed kernel images. Both the legacy format written
+ * by "lz4 -l" (what the Linux build produces for Image.lz4) and the LZ4 frame
+ * format are accepted. Data is always decoded into one flat output buffer,
+ * so matches of dependent frame blocks can reach back into earlier blocks.
+ * Block and content checksums are skipped, the boot image that carries the
+ * kernel is already verified.
+ */
+
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Uefi.h>
+
+#include "Decompress.h"
+
+#define LZ4_LEGACY_MAGIC 0x184C2102
+#define LZ4_FRAME_MAGIC 0x184D2204
+#define LZ4_LEGACY_BLOCK_SIZE (8 * 1024 * 1024)
+#define LZ4_COMPRESS_BOUND(Size) ((Size) + ((Size) / 255) + 16)
+#define LZ4_MIN_MATCH 4
+#define LZ4_RUN_MASK 15
+
+#define LZ4_FLG_VERSION_MASK 0xC0
+#define LZ4_FLG_VERSION 0x40
+#define LZ4_FLG_BLOCK_CHECKSUM BIT4
+#define LZ4_FLG_CONTENT_SIZE BIT3
+#define LZ4_FLG_CONTENT_CHECKSUM BIT2
+#define LZ4_FLG_DICT_ID BIT0
+#define LZ4_BLOCK_UNCOMPRESSED BIT31
+
+STATIC inline UINT32
+Lz4Read32 (CONST UINT8 *Ptr)
+{
+  return Ptr[0] | (Ptr[1] << 8) | (Ptr[2] << 16) | ((UINT32)Ptr[3] << 24);
+}
+
+STATIC inline VOID
+Lz4Copy8 (UINT8 *Dst, CONST UINT8 *Src)
+{
+  __builtin_memcpy (Dst, Src, 8);
+}
+
+/* Adds the 255-terminated length extension at *Ip to *Length */
+STATIC BOOLEAN
+Lz4ReadLength (CONST UINT8 **Ip, CONST UINT8 *IpEnd, UINT32 *Length)
+{
+  UINT32 Byte;
+
+  do {
+    if (*Ip >= IpEnd) {
+      return FALSE;
+    }
+    Byte = *(*Ip)++;
+    *Length += Byte;
+  } while (Byte == 255 && *Length < LZ4_LEGACY_BLOCK_SIZE);
+
+  return Byte != 255;
+}
+
+/* Decodes one block into Dst, Dst may not grow past DstEnd. Matches may
+ * refer back as far as OutStart. Returns the decoded size or -1.
+ */
+STATIC INT64
+Lz4DecodeBlock (CONST UINT8 *Src,
+                UINT32 SrcLen,
+                UINT8 *OutStart,
+                UINT8 *Dst,
+                UINT8 *DstEnd)
+{
+  CONST UINT8 *Ip = Src;
+  CONST UINT8 *IpEnd = Src + SrcLen;
+  UINT8 *Op = Dst;
+  CONST UINT8 *Match;
+  UINT8 *CopyEnd;
+  UINT32 Token;
+  UINT32 Length;
+  UINT32 Offset;
+
+  while (Ip < IpEnd) {
+    Token = *Ip++;
+
+    Length = Token >> 4;
+    if (Length == LZ4_RUN_MASK &&
+        !Lz4ReadLength (&Ip, IpEnd, &Length)) {
+      return -1;
+    }
+    if (Length > (UINTN)(IpEnd - Ip) ||
+        Length > (UINTN)(DstEnd - Op)) {
+      return -1;
+    }
+    if (Length <= 16 &&
+        IpEnd - Ip >= 16 &&
+        DstEnd - Op >= 16) {
+      Lz4Copy8 (Op, Ip);
+      Lz4Copy8 (Op + 8, Ip + 8);
+    } else {
+      CopyMem (Op, Ip, Length);
+    }
+    Op += Length;
+    Ip += Length;
+
+    /* The last sequence carries literals only */
+    if (Ip == IpEnd) {
+      break;
+    }
+
+    if (IpEnd - Ip < 2) {
+      return -1;
+    }
+    Offset = Ip[0] | (Ip[1] << 8);
+    Ip += 2;
+    if (Offset == 0 ||
+        Offset > (UINTN)(Op - OutStart)) {
+      return -1;
+    }
+
+    Length = Token & LZ4_RUN_MASK;
+    if (Length == LZ4_RUN_MASK &&
+        !Lz4ReadLength (&Ip, IpEnd, &Length)) {
+      return -1;
+    }
+    Length += LZ4_MIN_MATCH;
+    if (Length > (UINTN)(DstEnd - Op)) {
+      return -1;
+    }
+
+    Match = Op - Offset;
+    CopyEnd = Op + Length;
+    if (Offset >= 8 &&
+        (UINTN)(DstEnd - Op) >= Length + 8) {
+      do {
+        Lz4Copy8 (Op, Match);
+        Op += 8;
+        Match += 8;
+      } while (Op < CopyEnd);
+      Op = CopyEnd;
+    } else {
+      while (Op < CopyEnd) {
+        *Op++ = *Match++;
+      }
+    }
+  }
+
+  return Op - Dst;
+}
+
+/* Legacy format: a magic followed by blocks of a 32-bit compressed size and
+ * data. Every block but the last decodes to exactly 8 MB. There is no end
+ * marker, so the stream ends after a short block or at the first size that
+ * cannot be a block, e.g. the magic of an appended DTB.
+ */
+STATIC INT32
+Lz4DecodeLegacy (CONST UINT8 *In,
+                 UINT32 InLen,
+                 UINT8 *Out,
+                 UINT8 *OutEnd,
+                 UINT32 *Pos,
+                 UINT32 *OutLen)
+{
+  CONST UINT8 *Ip = In + sizeof (UINT32);
+  CONST UINT8 *IpEnd = In + InLen;
+  UINT8 *Op = Out;
+  UINT8 *BlockEnd;
+  UINT32 BlockSize;
+  INT64 Decoded;
+
+  while ((UINTN)(IpEnd - Ip) >= sizeof (UINT32)) {
+    BlockSize = Lz4Read32 (Ip);
+    /* After a full last block comes the size trailer, see lz4_decompress () */
+    if (Op != Out &&
+        BlockSize == (UINT32)(Op - Out)) {
+      break;
+    }
+    if (BlockSize == LZ4_LEGACY_MAGIC) {
+      Ip += sizeof (UINT32);
+      continue;
+    }
+    if (BlockSize == 0 ||
+        BlockSize > LZ4_COMPRESS_BOUND (LZ4_LEGACY_BLOCK_SIZE) ||
+        BlockSize > (UINTN)(IpEnd - Ip) - sizeof (UINT32)) {
+      break;
+    }
+
+    BlockEnd = OutEnd;
+    if ((UINTN)(OutEnd - Op) > LZ4_LEGACY_BLOCK_SIZE) {
+      BlockEnd = Op + LZ4_LEGACY_BLOCK_SIZE;
+    }
+    Decoded = Lz4DecodeBlock (Ip + sizeof (UINT32), BlockSize, Out, Op,
+                              BlockEnd);
+    if (Decoded < 0) {
+      DEBUG ((EFI_D_ERROR, "lz4: corrupt block at offset %u\n",
+              (UINT32)(Ip - In)));
+      return -1;
+    }
+    Op += Decoded;
+    Ip += sizeof (UINT32) + BlockSize;
+    if (Decoded < LZ4_LEGACY_BLOCK_SIZE) {
+      break;
+    }
+  }
+
+  if (Op == Out) {
+    DEBUG ((EFI_D_ERROR, "lz4: no data decoded\n"));
+    return -1;
+  }
+
+  *Pos = Ip - In;
+  *OutLen = Op - Out;
+  return 0;
+}
+
+STATIC INT32
+Lz4DecodeFrame (CONST UINT8 *In,
+                UINT32 InLen,
+                UINT8 *Out,
+                UINT8 *OutEnd,
+                UINT32 *Pos,
+                UINT32 *OutLen)
+{
+  CONST UINT8 *Ip = In + sizeof (UINT32);
+  CONST UINT8 *IpEnd = In + InLen;
+  UINT8 *Op = Out;
+  UINT32 HeaderLen = 3;
+  UINT32 BlockSize;
+  UINT8 Flags;
+  INT64 Decoded;
+
+  if ((UINTN)(IpEnd - Ip) < HeaderLen) {
+    return -1;
+  }
+  Flags = Ip[0];
+  if ((Flags & LZ4_FLG_VERSION_MASK) != LZ4_FLG_VERSION) {
+    DEBUG ((EFI_D_ERROR, "lz4: unsupported frame version\n"));
+    return -1;
+  }
+  if (Flags & LZ4_FLG_DICT_ID) {
+    DEBUG ((EFI_D_ERROR, "lz4: dictionaries are not supported\n"));
+    return -1;
+  }
+  if (Flags & LZ4_FLG_CONTENT_SIZE) {
+    HeaderLen += sizeof (UINT64);
+  }
+  if ((UINTN)(IpEnd - Ip) < HeaderLen) {
+    return -1;
+  }
+  Ip += HeaderLen;
+
+  for (;;) {
+    if ((UINTN)(IpEnd - Ip) < sizeof (UINT32)) {
+      return -1;
+    }
+    BlockSize = Lz4Read32 (Ip);
+    Ip += sizeof (UINT32);
+    if (BlockSize == 0) {
+      break;
+    }
+
+    if ((BlockSize & ~LZ4_BLOCK_UNCOMPRESSED) > (UINTN)(IpEnd - Ip)) {
+      return -1;
+    }
+    if (BlockSize & LZ4_BLOCK_UNCOMPRESSED) {
+      BlockSize &= ~LZ4_BLOCK_UNCOMPRESSED;
+      if (BlockSize > (UINTN)(OutEnd - Op)) {
+        return -1;
+      }
+      CopyMem (Op, Ip, BlockSize);
+      Op += BlockSize;
+    } else {
+      Decoded = Lz4DecodeBlock (Ip, BlockSize, Out, Op, OutEnd);
+      if (Decoded < 0) {
+        DEBUG ((EFI_D_ERROR, "lz4: corrupt block at offset %u\n",
+                (UINT32)(Ip - In)));
+        return -1;
+      }
+      Op += Decoded;
+    }
+    Ip += BlockSize;
+
+    if (Flags & LZ4_FLG_BLOCK_CHECKSUM) {
+      if ((UINTN)(IpEnd - Ip) < sizeof (UINT32)) {
+        return -1;
+      }
+      Ip += sizeof (UINT32);
+    }
+  }
+
+  if (Flags & LZ4_FLG_CONTENT_CHECKSUM) {
+    if ((UINTN)(IpEnd - Ip) < sizeof (UINT32)) {
+      return -1;
+    }
+    Ip += sizeof (UINT32);
+  }
+
+  *Pos = Ip - In;
+  *OutLen = Op - Out;
+  return 0;
+}
+
+/* Decompress the LZ4 data in in_buf, same contract as decompress ():
+ * pos - offset of the first byte after the LZ4 stream and its size trailer
+ * out_len - the length of decompressed data
+ * Returns 0 on success, -1 on failure.
+ */
+int
+lz4_decompress (unsigned char *in_buf,
+                unsigned int in_len,
+                unsigned char *out_buf,
+                unsigned int out_buf_len,
+                unsigned int *pos,
+                unsigned int *out_len)
+{
+  UINT32 Pos = 0;
+  UINT32 OutLen = 0;
+  INT32 Rc;
+
+  if (!is_lz4_package (in_buf, in_len)) {
+    DEBUG ((EFI_D_ERROR, "the input data is not an lz4 package.\n"));
+    return -1;
+  }
+
+  if (Lz4Read32 (in_buf) == LZ4_LEGACY_MAGIC) {
+    Rc = Lz4DecodeLegacy (in_buf, in_len, out_buf, out_buf + out_buf_len,
+                          &Pos, &OutLen);
+  } else {
+    Rc = Lz4DecodeFrame (in_buf, in_len, out_buf, out_buf + out_buf_len,
+                         &Pos, &OutLen);
+  }
+  if (Rc) {
+    return Rc;
+  }
+
+  /* kbuild's size_append puts the decompressed size, little endian, right
+   * after the stream; an appended DTB follows it.
+   */
+  if (in_len - Pos >= sizeof (UINT32) &&
+      Lz4Read32 (in_buf + Pos) == OutLen) {
+    Pos += sizeof (UINT32);
+  }
+
+  if (pos) {
+    *pos = Pos;
+  }
+  if (out_len) {
+    *out_len = OutLen;
+  }
+  return 0;
+}
+
+/* Return true if "buf" starts with an LZ4 legacy or frame magic */
+int
+is_lz4_package (unsigned char *buf, unsigned int len)
+{
+  UINT32 Magic;
+
+  if (!buf || len < 8) {
+    return FALSE;
+  }
+
+  Magic = Lz4Read32 (buf);
+  return Magic == LZ4_LEGACY_MAGIC || Magic == LZ4_FRAME_MAGIC;
+}
@@ -29,6 +29,25 @@
 #  define PUP(a) *++(a)
 #endif
 
+#ifdef INFLATE_FAST_WIDE
+/* Unaligned little-endian 64-bit load and 8-byte copy; these compile to
+   single load/store instructions. */
+#  define LOAD64(p, v) __builtin_memcpy(&(v), (p), 8)
+#  define COPY8(d, s) __builtin_memcpy((d), (s), 8)
+
+/* Fill the bit buffer to at least 56 bits with one load.  Only whole bytes
+   are counted in bits, the partial byte above them is loaded again by the
+   next refill, which is why the bytes are or'ed in rather than added. */
+#  define REFILL() \
+    do { \
+        unsigned long next; \
+        LOAD64(in + OFF, next); \
+        hold |= next << bits; \
+        in += (63 - bits) >> 3; \
+        bits |= 56; \
+    } while (0)
+#endif
+
 /*
    Decode literal, length, and distance codes and write out the resulting
    literal and match bytes until either not enough input or output is
@@ -63,6 +82,11 @@
       bytes, which is the maximum length that can be coded.  inflate_fast()
       requires strm->avail_out >= 258 for each loop to avoid checking for
       output space.
+
+    - With INFLATE_FAST_WIDE the bit buffer is refilled with eight-byte loads,
+      at most twice per length/distance pair, and matches are copied eight
+      bytes at a time, overrunning by up to seven bytes.  That raises the
+      requirements to INFLATE_FAST_MIN_HAVE and INFLATE_FAST_MIN_LEFT.
  */
 void ZLIB_INTERNAL inflate_fast(strm, start)
 z_streamp strm;
@@ -97,10 +121,10 @@ unsigned start;         /* inflate()'s starting value for strm->avail_out */
     /* copy state to local variables */
     state = (struct inflate_state FAR *)strm->state;
     in = strm->next_in - OFF;
-    last = in + (strm->avail_in - 5);
+    last = in + (strm->avail_in - (INFLATE_FAST_MIN_HAVE - 1));
     out = strm->next_out - OFF;
     beg = out - (start - strm->avail_out);
-    end = out + (strm->avail_out - 257);
+    end = out + (strm->avail_out - (INFLATE_FAST_MIN_LEFT - 1));
 #ifdef INFLATE_STRICT
     dmax = state->dmax;
 #endif
@@ -119,10 +143,14 @@ unsigned start;         /* inflate()'s starting value for strm->avail_out */
        input data or output space */
     do {
         if (bits < 15) {
+#ifdef INFLATE_FAST_WIDE
+            REFILL();
+#else
             hold += (unsigned long)(PUP(in)) << bits;
             bits += 8;
             hold += (unsigned long)(PUP(in)) << bits;
             bits += 8;
+#endif
         }
         here = lcode[hold & lmask];
       dolen:
@@ -139,22 +167,31 @@ unsigned start;         /* inflate()'s starting value for strm->avail_out */
         else if (op & 16) {                     /* length base */
             len = (unsigned)(here.val);
             op &= 15;                           /* number of extra bits */
+#ifdef INFLATE_FAST_WIDE
+            /* length extra, distance code and distance extra: 5+15+13 */
+            if (bits < 33)
+                REFILL();
+#endif
             if (op) {
+#ifndef INFLATE_FAST_WIDE
                 if (bits < op) {
                     hold += (unsigned long)(PUP(in)) << bits;
                     bits += 8;
                 }
+#endif
                 len += (unsigned)hold & ((1U << op) - 1);
                 hold >>= op;
                 bits -= op;
             }
             Tracevv((stderr, "inflate:         length %u\n", len));
+#ifndef INFLATE_FAST_WIDE
             if (bits < 15) {
                 hold += (unsigned long)(PUP(in)) << bits;
                 bits += 8;
                 hold += (unsigned long)(PUP(in)) << bits;
                 bits += 8;
             }
+#endif
             here = dcode[hold & dmask];
           dodist:
             op = (unsigned)(here.bits);
@@ -164,6 +201,7 @@ unsigned start;         /* inflate()'s starting value for strm->avail_out */
             if (op & 16) {                      /* distance base */
                 dist = (unsigned)(here.val);
                 op &= 15;                       /* number of extra bits */
+#ifndef INFLATE_FAST_WIDE
                 if (bits < op) {
                     hold += (unsigned long)(PUP(in)) << bits;
                     bits += 8;
@@ -172,6 +210,7 @@ unsigned start;         /* inflate()'s starting value for strm->avail_out */
                         bits += 8;
                     }
                 }
+#endif
                 dist += (unsigned)hold & ((1U << op) - 1);
 #ifdef INFLATE_STRICT
                 if (dist > dmax) {
@@ -267,6 +306,18 @@ unsigned start;         /* inflate()'s starting value for strm->avail_out */
                 }
                 else {
                     from = out - dist;          /* copy direct from output */
+#ifdef INFLATE_FAST_WIDE
+                    if (dist >= 8) {            /* chunks don't overlap */
+                        unsigned char FAR *stop = out + len;
+                        do {
+                            COPY8(out + OFF, from + OFF);
+                            out += 8;
+                            from += 8;
+                        } while (out < stop);
+                        out = stop;
+                        continue;
+                    }
+#endif
                     do {                        /* minimum length is three */
                         PUP(out) = PUP(from);
                         PUP(out) = PUP(from);
@@ -315,9 +366,12 @@ unsigned start;         /* inflate()'s starting value for strm->avail_out */
     /* update state and return */
     strm->next_in = in + OFF;
     strm->next_out = out + OFF;
-    strm->avail_in = (unsigned)(in < last ? 5 + (last - in) : 5 - (in - last));
+    strm->avail_in = (unsigned)(in < last ?
+                                (INFLATE_FAST_MIN_HAVE - 1) + (last - in) :
+                                (INFLATE_FAST_MIN_HAVE - 1) - (in - last));
     strm->avail_out = (unsigned)(out < end ?
-                                 257 + (end - out) : 257 - (out - end));
+                                 (INFLATE_FAST_MIN_LEFT - 1) + (end - out) :
+                                 (INFLATE_FAST_MIN_LEFT - 1) - (out - end));
     state->hold = hold;
     state->bits = bits;
     return;
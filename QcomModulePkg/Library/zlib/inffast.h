@@ -8,4 +8,24 @@
    subject to change. Applications should only use zlib.h.
  */
 
+/* On 64-bit little-endian targets inflate_fast() refills its bit buffer
+   eight bytes at a time and copies matches eight bytes at a time.  Both may
+   touch a few bytes past what the current code needs, so the loop needs more
+   slack on input and output than the byte-wise version.  Defining
+   INFLATE_FAST_BYTEWISE keeps the byte-wise loop, the host test in
+   BootLib/tests builds it both ways. */
+#if !defined(INFLATE_FAST_BYTEWISE) && defined(__GNUC__) && \
+    (defined(__aarch64__) || defined(__x86_64__)) && \
+    defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#  define INFLATE_FAST_WIDE
+#endif
+
+#ifdef INFLATE_FAST_WIDE
+#  define INFLATE_FAST_MIN_HAVE 16
+#  define INFLATE_FAST_MIN_LEFT 266
+#else
+#  define INFLATE_FAST_MIN_HAVE 6
+#  define INFLATE_FAST_MIN_LEFT 258
+#endif
+
 void ZLIB_INTERNAL inflate_fast OF((z_streamp strm, unsigned start));
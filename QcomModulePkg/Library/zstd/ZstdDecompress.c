@@ -0,0 +1,1274 @@
+/* Copyright (c) 2026, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimer in the documentation and/or other materials provided
+ *  with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * Zstandard (RFC 8878) decoder for compressed kernel images. The whole
+ * output is decoded into one flat buffer, so the window is simply everything
+ * decoded so far in the current frame and no separate history is kept.
+ * Dictionaries are not supported and the optional content checksum is
+ * skipped, the boot image that carries the kernel is already verified.
+ */
+
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Uefi.h>
+
+#include "Decompress.h"
+
+#define ZSTD_MAGIC 0xFD2FB528
+#define ZSTD_SKIPPABLE_MAGIC 0x184D2A50
+#define ZSTD_SKIPPABLE_MASK 0xFFFFFFF0
+#define ZSTD_BLOCK_SIZE_MAX (128 * 1024)
+#define ZSTD_WILDCOPY 16
+
+#define ZSTD_BLOCK_RAW 0
+#define ZSTD_BLOCK_RLE 1
+#define ZSTD_BLOCK_COMPRESSED 2
+
+#define ZSTD_LIT_RAW 0
+#define ZSTD_LIT_RLE 1
+#define ZSTD_LIT_COMPRESSED 2
+#define ZSTD_LIT_TREELESS 3
+
+#define ZSTD_SEQ_PREDEFINED 0
+#define ZSTD_SEQ_RLE 1
+#define ZSTD_SEQ_FSE 2
+#define ZSTD_SEQ_REPEAT 3
+
+#define ZSTD_HUF_MAX_BITS 11
+#define ZSTD_HUF_MAX_SYMBOLS 256
+#define ZSTD_FSE_MAX_LOG 9
+#define ZSTD_FSE_MAX_SYMBOLS 256
+
+#define ZSTD_LL_MAX_SYMBOL 35
+#define ZSTD_ML_MAX_SYMBOL 52
+#define ZSTD_OF_MAX_SYMBOL 31
+#define ZSTD_LL_MAX_LOG 9
+#define ZSTD_ML_MAX_LOG 9
+#define ZSTD_OF_MAX_LOG 8
+#define ZSTD_HUF_WEIGHT_MAX_LOG 6
+
+typedef struct {
+  UINT16 NewState;
+  UINT8 Symbol;
+  UINT8 NumBits;
+} ZSTD_FSE_ENTRY;
+
+typedef struct {
+  ZSTD_FSE_ENTRY Table[1 << ZSTD_FSE_MAX_LOG];
+  UINT32 AccuracyLog;
+  BOOLEAN Valid;
+} ZSTD_FSE_TABLE;
+
+typedef struct {
+  UINT8 Symbol;
+  UINT8 NumBits;
+} ZSTD_HUF_ENTRY;
+
+typedef struct {
+  ZSTD_HUF_ENTRY Table[1 << ZSTD_HUF_MAX_BITS];
+  UINT32 MaxBits;
+  BOOLEAN Valid;
+} ZSTD_HUF_TABLE;
+
+/* Backward bit stream: bits are consumed from the top of Container, which
+ * holds the eight bytes at Ptr. Reading past the start yields zeros.
+ */
+typedef struct {
+  CONST UINT8 *Start;
+  CONST UINT8 *Ptr;
+  UINT64 Container;
+  UINT32 Consumed;
+} ZSTD_BIT_READER;
+
+typedef struct {
+  UINT8 *OutStart;
+  UINT8 *Op;
+  UINT8 *OutEnd;
+  UINT32 RepOffsets[3];
+  ZSTD_HUF_TABLE Huf;
+  ZSTD_FSE_TABLE LlTable;
+  ZSTD_FSE_TABLE OfTable;
+  ZSTD_FSE_TABLE MlTable;
+  UINT8 Literals[ZSTD_BLOCK_SIZE_MAX + ZSTD_WILDCOPY];
+} ZSTD_CTX;
+
+STATIC CONST UINT32 LlBase[ZSTD_LL_MAX_SYMBOL + 1] = {
+    0,  1,  2,   3,   4,   5,    6,    7,    8,    9,     10,    11,
+    12, 13, 14,  15,  16,  18,   20,   22,   24,   28,    32,    40,
+    48, 64, 128, 256, 512, 1024, 2048, 4096, 8192, 16384, 32768, 65536};
+
+STATIC CONST UINT8 LlBits[ZSTD_LL_MAX_SYMBOL + 1] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  0,  0,  1,  1,
+    1, 1, 2, 2, 3, 3, 4, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16};
+
+STATIC CONST UINT32 MlBase[ZSTD_ML_MAX_SYMBOL + 1] = {
+    3,   4,   5,    6,    7,    8,    9,    10,    11,    12,    13,
+    14,  15,  16,   17,   18,   19,   20,   21,    22,    23,    24,
+    25,  26,  27,   28,   29,   30,   31,   32,    33,    34,    35,
+    37,  39,  41,   43,   47,   51,   59,   67,    83,    99,    131,
+    259, 515, 1027, 2051, 4099, 8195, 16387, 32771, 65539};
+
+STATIC CONST UINT8 MlBits[ZSTD_ML_MAX_SYMBOL + 1] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  0,  0,  0,  0,  0,  0,  0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  0,  0,  0,  1,  1,  1,  1,
+    2, 2, 3, 3, 4, 4, 5, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16};
+
+/* Predefined distributions, RFC 8878 section 3.1.1.3.2.2 */
+STATIC CONST INT16 LlDefaultNorm[ZSTD_LL_MAX_SYMBOL + 1] = {
+    4, 3, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 1,  1,  1,  2,  2,
+    2, 2, 2, 2, 2, 2, 2, 3, 2, 1, 1, 1, 1, 1, -1, -1, -1, -1};
+
+STATIC CONST INT16 MlDefaultNorm[ZSTD_ML_MAX_SYMBOL + 1] = {
+    1, 4, 3, 2, 2, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1,  1,  1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  1,  1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, -1, -1, -1, -1, -1, -1, -1};
+
+STATIC CONST INT16 OfDefaultNorm[ZSTD_OF_MAX_SYMBOL + 1] = {
+    1, 1, 1, 1, 1, 1, 2, 2, 2, 1,  1,  1,  1,  1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, -1, -1, -1, -1, -1};
+
+STATIC inline UINT32
+ZstdRead16 (CONST UINT8 *Ptr)
+{
+  return Ptr[0] | (Ptr[1] << 8);
+}
+
+STATIC inline UINT32
+ZstdRead24 (CONST UINT8 *Ptr)
+{
+  return Ptr[0] | (Ptr[1] << 8) | (Ptr[2] << 16);
+}
+
+STATIC inline UINT32
+ZstdRead32 (CONST UINT8 *Ptr)
+{
+  return Ptr[0] | (Ptr[1] << 8) | (Ptr[2] << 16) | ((UINT32)Ptr[3] << 24);
+}
+
+STATIC inline UINT64
+ZstdRead64 (CONST UINT8 *Ptr)
+{
+  UINT64 Value;
+
+  __builtin_memcpy (&Value, Ptr, sizeof (Value));
+  return Value;
+}
+
+STATIC inline VOID
+ZstdCopy16 (UINT8 *Dst, CONST UINT8 *Src)
+{
+  __builtin_memcpy (Dst, Src, 16);
+}
+
+STATIC inline UINT32
+ZstdHighBit (UINT32 Value)
+{
+  return 31 - __builtin_clz (Value);
+}
+
+STATIC BOOLEAN
+BitInit (ZSTD_BIT_READER *Reader, CONST UINT8 *Src, UINTN Size)
+{
+  UINT8 Last;
+  UINTN Index;
+
+  if (Size == 0) {
+    return FALSE;
+  }
+  Last = Src[Size - 1];
+  if (Last == 0) {
+    return FALSE;
+  }
+
+  Reader->Start = Src;
+  if (Size >= sizeof (UINT64)) {
+    Reader->Ptr = Src + Size - sizeof (UINT64);
+    Reader->Container = ZstdRead64 (Reader->Ptr);
+    Reader->Consumed = 0;
+  } else {
+    Reader->Ptr = Src;
+    Reader->Container = 0;
+    for (Index = 0; Index < Size; Index++) {
+      Reader->Container |= (UINT64)Src[Index] << (Index * 8);
+    }
+    Reader->Consumed = (sizeof (UINT64) - Size) * 8;
+  }
+  /* Skip the zero padding and the end marker bit */
+  Reader->Consumed += 8 - ZstdHighBit (Last);
+  return TRUE;
+}
+
+STATIC inline UINT32
+BitPeek (ZSTD_BIT_READER *Reader, UINT32 NumBits)
+{
+  if (Reader->Consumed >= 64) {
+    return 0;
+  }
+  return (Reader->Container << Reader->Consumed) >> (64 - NumBits);
+}
+
+STATIC inline UINT32
+BitRead (ZSTD_BIT_READER *Reader, UINT32 NumBits)
+{
+  UINT32 Value;
+
+  if (NumBits == 0) {
+    return 0;
+  }
+  Value = BitPeek (Reader, NumBits);
+  Reader->Consumed += NumBits;
+  return Value;
+}
+
+/* Moves the container back so that at least 56 bits are available, unless
+ * the start of the stream has been reached.
+ */
+STATIC inline VOID
+BitReload (ZSTD_BIT_READER *Reader)
+{
+  UINTN Bytes;
+
+  if (Reader->Ptr == Reader->Start) {
+    return;
+  }
+  Bytes = Reader->Consumed >> 3;
+  if (Bytes > (UINTN)(Reader->Ptr - Reader->Start)) {
+    Bytes = Reader->Ptr - Reader->Start;
+  }
+  Reader->Ptr -= Bytes;
+  Reader->Consumed -= Bytes * 8;
+  Reader->Container = ZstdRead64 (Reader->Ptr);
+}
+
+/* Reloads only if fewer than NumBits bits are left in the container */
+STATIC inline VOID
+BitEnsure (ZSTD_BIT_READER *Reader, UINT32 NumBits)
+{
+  if (Reader->Consumed + NumBits > 64) {
+    BitReload (Reader);
+  }
+}
+
+/* True once more bits were read than the stream holds */
+STATIC inline BOOLEAN
+BitOverflow (ZSTD_BIT_READER *Reader)
+{
+  return Reader->Ptr == Reader->Start && Reader->Consumed > 64;
+}
+
+STATIC inline BOOLEAN
+BitFinished (ZSTD_BIT_READER *Reader)
+{
+  return Reader->Ptr == Reader->Start && Reader->Consumed == 64;
+}
+
+/* Builds a decoding table from normalized counts, where -1 marks a
+ * "less than one" probability symbol.
+ */
+STATIC BOOLEAN
+FseBuildTable (ZSTD_FSE_TABLE *Fse,
+               CONST INT16 *Norm,
+               UINT32 NumSymbols,
+               UINT32 AccuracyLog)
+{
+  UINT16 SymbolNext[ZSTD_FSE_MAX_SYMBOLS];
+  UINT32 TableSize = 1 << AccuracyLog;
+  UINT32 HighThreshold = TableSize - 1;
+  UINT32 Step = (TableSize >> 1) + (TableSize >> 3) + 3;
+  UINT32 Mask = TableSize - 1;
+  UINT32 Position = 0;
+  UINT32 Symbol;
+  UINT32 Index;
+  UINT32 Next;
+  INT32 Count;
+
+  for (Symbol = 0; Symbol < NumSymbols; Symbol++) {
+    if (Norm[Symbol] == -1) {
+      Fse->Table[HighThreshold--].Symbol = Symbol;
+      SymbolNext[Symbol] = 1;
+    } else {
+      SymbolNext[Symbol] = Norm[Symbol];
+    }
+  }
+
+  for (Symbol = 0; Symbol < NumSymbols; Symbol++) {
+    for (Count = 0; Count < Norm[Symbol]; Count++) {
+      Fse->Table[Position].Symbol = Symbol;
+      do {
+        Position = (Position + Step) & Mask;
+      } while (Position > HighThreshold);
+    }
+  }
+  if (Position != 0) {
+    return FALSE;
+  }
+
+  for (Index = 0; Index < TableSize; Index++) {
+    Symbol = Fse->Table[Index].Symbol;
+    Next = SymbolNext[Symbol]++;
+    Fse->Table[Index].NumBits = AccuracyLog - ZstdHighBit (Next);
+    Fse->Table[Index].NewState =
+        (Next << Fse->Table[Index].NumBits) - TableSize;
+  }
+
+  Fse->AccuracyLog = AccuracyLog;
+  Fse->Valid = TRUE;
+  return TRUE;
+}
+
+STATIC VOID
+FseBuildRle (ZSTD_FSE_TABLE *Fse, UINT8 Symbol)
+{
+  Fse->Table[0].Symbol = Symbol;
+  Fse->Table[0].NumBits = 0;
+  Fse->Table[0].NewState = 0;
+  Fse->AccuracyLog = 0;
+  Fse->Valid = TRUE;
+}
+
+/* Returns the 32 bits at bit offset BitPos of a forward little-endian bit
+ * stream. Bytes past the end read as zero, callers check the final length.
+ */
+STATIC UINT32
+FsePeekForward (CONST UINT8 *Src, UINTN SrcLen, UINT64 BitPos)
+{
+  UINTN Offset = BitPos >> 3;
+  UINT32 Value = 0;
+  UINTN Index;
+
+  if (Offset + sizeof (UINT32) <= SrcLen) {
+    Value = ZstdRead32 (Src + Offset);
+  } else {
+    for (Index = 0; Offset + Index < SrcLen; Index++) {
+      Value |= (UINT32)Src[Offset + Index] << (Index * 8);
+    }
+  }
+  return Value >> (BitPos & 7);
+}
+
+/* Reads an FSE table description (RFC 8878 section 4.1.1) from Src and
+ * builds the table. *Used is set to the size of the description.
+ */
+STATIC BOOLEAN
+FseReadTable (ZSTD_FSE_TABLE *Fse,
+              CONST UINT8 *Src,
+              UINTN SrcLen,
+              UINT32 MaxSymbol,
+              UINT32 MaxLog,
+              UINTN *Used)
+{
+  INT16 Norm[ZSTD_FSE_MAX_SYMBOLS];
+  UINT64 BitPos;
+  UINT32 AccuracyLog;
+  INT32 Remaining;
+  UINT32 Threshold;
+  UINT32 NumBits;
+  UINT32 Symbol = 0;
+  UINT32 Value;
+  UINT32 Max;
+  UINT32 Repeat;
+  UINT32 Index;
+  INT32 Count;
+
+  if (SrcLen < 1) {
+    return FALSE;
+  }
+
+  AccuracyLog = (Src[0] & 0xF) + 5;
+  if (AccuracyLog > MaxLog) {
+    return FALSE;
+  }
+  BitPos = 4;
+
+  Remaining = (1 << AccuracyLog) + 1;
+  Threshold = 1 << AccuracyLog;
+  NumBits = AccuracyLog + 1;
+
+  while (Remaining > 1 && Symbol <= MaxSymbol) {
+    Value = FsePeekForward (Src, SrcLen, BitPos);
+    Max = (2 * Threshold - 1) - Remaining;
+    if ((Value & (Threshold - 1)) < Max) {
+      Value &= Threshold - 1;
+      BitPos += NumBits - 1;
+    } else {
+      Value &= 2 * Threshold - 1;
+      if (Value >= Threshold) {
+        Value -= Max;
+      }
+      BitPos += NumBits;
+    }
+
+    Count = (INT32)Value - 1;
+    Norm[Symbol++] = Count;
+    Remaining -= Count < 0 ? -Count : Count;
+    if (Remaining < 1) {
+      return FALSE;
+    }
+
+    /* A zero count is followed by 2-bit repeat flags for more zeros */
+    if (Count == 0) {
+      do {
+        Repeat = FsePeekForward (Src, SrcLen, BitPos) & 3;
+        BitPos += 2;
+        for (Index = 0; Index < Repeat; Index++) {
+          if (Symbol > MaxSymbol) {
+            return FALSE;
+          }
+          Norm[Symbol++] = 0;
+        }
+      } while (Repeat == 3);
+    }
+
+    while (Remaining < (INT32)Threshold) {
+      NumBits--;
+      Threshold >>= 1;
+    }
+  }
+
+  if (Remaining != 1 ||
+      ((BitPos + 7) >> 3) > SrcLen) {
+    return FALSE;
+  }
+  while (Symbol <= MaxSymbol) {
+    Norm[Symbol++] = 0;
+  }
+
+  *Used = (BitPos + 7) >> 3;
+  return FseBuildTable (Fse, Norm, MaxSymbol + 1, AccuracyLog);
+}
+
+/* Builds the Huffman decoding table from per-symbol weights. The weight of
+ * the last symbol is implied by the others (RFC 8878 section 4.2.1).
+ */
+STATIC BOOLEAN
+HufBuildTable (ZSTD_HUF_TABLE *Huf, UINT8 *Weights, UINT32 NumWeights)
+{
+  UINT32 Total = 0;
+  UINT32 MaxBits;
+  UINT32 Rest;
+  UINT32 Weight;
+  UINT32 Symbol;
+  UINT32 Position = 0;
+  UINT32 Count;
+  UINT32 NumBits;
+  UINT32 Index;
+
+  if (NumWeights == 0 ||
+      NumWeights >= ZSTD_HUF_MAX_SYMBOLS) {
+    return FALSE;
+  }
+
+  for (Symbol = 0; Symbol < NumWeights; Symbol++) {
+    if (Weights[Symbol] > ZSTD_HUF_MAX_BITS) {
+      return FALSE;
+    }
+    if (Weights[Symbol]) {
+      Total += 1 << (Weights[Symbol] - 1);
+    }
+  }
+  if (Total == 0) {
+    return FALSE;
+  }
+
+  MaxBits = ZstdHighBit (Total) + 1;
+  if (MaxBits > ZSTD_HUF_MAX_BITS) {
+    return FALSE;
+  }
+  Rest = (1 << MaxBits) - Total;
+  if (Rest & (Rest - 1)) {
+    return FALSE;
+  }
+  Weights[NumWeights++] = ZstdHighBit (Rest) + 1;
+
+  /* Codes are handed out from the lowest weight (longest code) up */
+  for (Weight = 1; Weight <= MaxBits; Weight++) {
+    Count = 1 << (Weight - 1);
+    NumBits = MaxBits + 1 - Weight;
+    for (Symbol = 0; Symbol < NumWeights; Symbol++) {
+      if (Weights[Symbol] != Weight) {
+        continue;
+      }
+      for (Index = 0; Index < Count; Index++) {
+        Huf->Table[Position + Index].Symbol = Symbol;
+        Huf->Table[Position + Index].NumBits = NumBits;
+      }
+      Position += Count;
+    }
+  }
+  if (Position != (1U << MaxBits)) {
+    return FALSE;
+  }
+
+  Huf->MaxBits = MaxBits;
+  Huf->Valid = TRUE;
+  return TRUE;
+}
+
+/* Reads a Huffman tree description. *Used is set to its size. */
+STATIC BOOLEAN
+HufReadTable (ZSTD_HUF_TABLE *Huf, CONST UINT8 *Src, UINTN SrcLen, UINTN *Used)
+{
+  UINT8 Weights[ZSTD_HUF_MAX_SYMBOLS];
+  ZSTD_FSE_TABLE Fse;
+  ZSTD_BIT_READER Reader;
+  UINT32 NumWeights = 0;
+  UINT32 State1;
+  UINT32 State2;
+  UINTN TableLen;
+  UINTN Header;
+  UINTN Index;
+
+  if (SrcLen < 1) {
+    return FALSE;
+  }
+  Header = Src[0];
+
+  if (Header >= 128) {
+    /* Direct representation, two 4-bit weights per byte */
+    NumWeights = Header - 127;
+    if (1 + (NumWeights + 1) / 2 > SrcLen) {
+      return FALSE;
+    }
+    for (Index = 0; Index < NumWeights; Index++) {
+      Weights[Index] = (Index & 1) ? (Src[1 + Index / 2] & 0xF) :
+                                     (Src[1 + Index / 2] >> 4);
+    }
+    *Used = 1 + (NumWeights + 1) / 2;
+    return HufBuildTable (Huf, Weights, NumWeights);
+  }
+
+  /* FSE compressed weights, decoded with two interleaved states */
+  if (Header == 0 ||
+      1 + Header > SrcLen) {
+    return FALSE;
+  }
+  if (!FseReadTable (&Fse, Src + 1, Header, ZSTD_HUF_MAX_BITS,
+                     ZSTD_HUF_WEIGHT_MAX_LOG, &TableLen)) {
+    return FALSE;
+  }
+  if (TableLen >= Header ||
+      !BitInit (&Reader, Src + 1 + TableLen, Header - TableLen)) {
+    return FALSE;
+  }
+
+  State1 = BitRead (&Reader, Fse.AccuracyLog);
+  State2 = BitRead (&Reader, Fse.AccuracyLog);
+  BitReload (&Reader);
+  for (;;) {
+    if (NumWeights >= ZSTD_HUF_MAX_SYMBOLS - 2) {
+      return FALSE;
+    }
+    Weights[NumWeights++] = Fse.Table[State1].Symbol;
+    State1 = Fse.Table[State1].NewState +
+             BitRead (&Reader, Fse.Table[State1].NumBits);
+    BitReload (&Reader);
+    if (BitOverflow (&Reader)) {
+      Weights[NumWeights++] = Fse.Table[State2].Symbol;
+      break;
+    }
+
+    Weights[NumWeights++] = Fse.Table[State2].Symbol;
+    State2 = Fse.Table[State2].NewState +
+             BitRead (&Reader, Fse.Table[State2].NumBits);
+    BitReload (&Reader);
+    if (BitOverflow (&Reader)) {
+      Weights[NumWeights++] = Fse.Table[State1].Symbol;
+      break;
+    }
+  }
+
+  *Used = 1 + Header;
+  return HufBuildTable (Huf, Weights, NumWeights);
+}
+
+/* Decodes Count literals from one Huffman coded stream */
+STATIC BOOLEAN
+HufDecodeStream (ZSTD_HUF_TABLE *Huf,
+                 CONST UINT8 *Src,
+                 UINTN SrcLen,
+                 UINT8 *Dst,
+                 UINTN Count)
+{
+  ZSTD_BIT_READER Reader;
+  ZSTD_HUF_ENTRY *Entry;
+  UINT8 *DstEnd = Dst + Count;
+  UINT32 MaxBits = Huf->MaxBits;
+
+  if (!BitInit (&Reader, Src, SrcLen)) {
+    return FALSE;
+  }
+
+  /* Four codes of at most 11 bits fit in the 56 bits left after a reload */
+  while (DstEnd - Dst >= 4) {
+    Entry = &Huf->Table[BitPeek (&Reader, MaxBits)];
+    *Dst++ = Entry->Symbol;
+    Reader.Consumed += Entry->NumBits;
+    Entry = &Huf->Table[BitPeek (&Reader, MaxBits)];
+    *Dst++ = Entry->Symbol;
+    Reader.Consumed += Entry->NumBits;
+    Entry = &Huf->Table[BitPeek (&Reader, MaxBits)];
+    *Dst++ = Entry->Symbol;
+    Reader.Consumed += Entry->NumBits;
+    Entry = &Huf->Table[BitPeek (&Reader, MaxBits)];
+    *Dst++ = Entry->Symbol;
+    Reader.Consumed += Entry->NumBits;
+    BitReload (&Reader);
+  }
+  while (Dst < DstEnd) {
+    Entry = &Huf->Table[BitPeek (&Reader, MaxBits)];
+    *Dst++ = Entry->Symbol;
+    Reader.Consumed += Entry->NumBits;
+    BitReload (&Reader);
+  }
+
+  return BitFinished (&Reader);
+}
+
+/* Decodes the literals section of a compressed block. *Literals points at
+ * the regenerated literals, which are either in Ctx->Literals or, for raw
+ * literals, in the input itself.
+ */
+STATIC BOOLEAN
+ZstdDecodeLiterals (ZSTD_CTX *Ctx,
+                    CONST UINT8 *Src,
+                    UINTN SrcLen,
+                    CONST UINT8 **Literals,
+                    UINTN *LitSize,
+                    UINTN *Used)
+{
+  UINT32 Type = Src[0] & 3;
+  UINT32 SizeFormat = (Src[0] >> 2) & 3;
+  UINTN Header;
+  UINTN Regen;
+  UINTN Comp;
+  UINTN TableLen = 0;
+  UINTN Segment;
+  UINTN Sizes[4];
+  UINT64 Bits;
+  UINTN Index;
+  CONST UINT8 *Stream;
+  UINT8 *Dst;
+
+  if (Type == ZSTD_LIT_RAW ||
+      Type == ZSTD_LIT_RLE) {
+    switch (SizeFormat) {
+    case 1:
+      Header = 2;
+      break;
+    case 3:
+      Header = 3;
+      break;
+    default:
+      Header = 1;
+      break;
+    }
+    if (Header > SrcLen) {
+      return FALSE;
+    }
+    if (Header == 1) {
+      Regen = Src[0] >> 3;
+    } else if (Header == 2) {
+      Regen = (Src[0] >> 4) | (Src[1] << 4);
+    } else {
+      Regen = (Src[0] >> 4) | (Src[1] << 4) | (Src[2] << 12);
+    }
+    if (Regen > ZSTD_BLOCK_SIZE_MAX) {
+      return FALSE;
+    }
+
+    if (Type == ZSTD_LIT_RAW) {
+      if (Regen > SrcLen - Header) {
+        return FALSE;
+      }
+      *Literals = Src + Header;
+      *Used = Header + Regen;
+    } else {
+      if (Header + 1 > SrcLen) {
+        return FALSE;
+      }
+      SetMem (Ctx->Literals, Regen, Src[Header]);
+      *Literals = Ctx->Literals;
+      *Used = Header + 1;
+    }
+    *LitSize = Regen;
+    return TRUE;
+  }
+
+  /* Huffman coded literals in one or four streams */
+  Header = SizeFormat < 2 ? 3 : SizeFormat + 2;
+  if (Header > SrcLen) {
+    return FALSE;
+  }
+  Bits = 0;
+  for (Index = 0; Index < Header; Index++) {
+    Bits |= (UINT64)Src[Index] << (Index * 8);
+  }
+  Bits >>= 4;
+  switch (SizeFormat) {
+  case 0:
+  case 1:
+    Regen = Bits & 0x3FF;
+    Comp = (Bits >> 10) & 0x3FF;
+    break;
+  case 2:
+    Regen = Bits & 0x3FFF;
+    Comp = (Bits >> 14) & 0x3FFF;
+    break;
+  default:
+    Regen = Bits & 0x3FFFF;
+    Comp = (Bits >> 18) & 0x3FFFF;
+    break;
+  }
+  if (Regen > ZSTD_BLOCK_SIZE_MAX ||
+      Comp > SrcLen - Header) {
+    return FALSE;
+  }
+  Src += Header;
+
+  if (Type == ZSTD_LIT_COMPRESSED) {
+    if (!HufReadTable (&Ctx->Huf, Src, Comp, &TableLen)) {
+      DEBUG ((EFI_D_ERROR, "zstd: bad huffman table\n"));
+      return FALSE;
+    }
+  } else if (!Ctx->Huf.Valid) {
+    return FALSE;
+  }
+  Stream = Src + TableLen;
+  Comp -= TableLen;
+  Dst = Ctx->Literals;
+
+  if (SizeFormat == 0) {
+    if (!HufDecodeStream (&Ctx->Huf, Stream, Comp, Dst, Regen)) {
+      return FALSE;
+    }
+  } else {
+    if (Comp < 6) {
+      return FALSE;
+    }
+    Sizes[0] = ZstdRead16 (Stream);
+    Sizes[1] = ZstdRead16 (Stream + 2);
+    Sizes[2] = ZstdRead16 (Stream + 4);
+    Stream += 6;
+    Comp -= 6;
+    if (Sizes[0] + Sizes[1] + Sizes[2] > Comp) {
+      return FALSE;
+    }
+    Sizes[3] = Comp - Sizes[0] - Sizes[1] - Sizes[2];
+    Segment = (Regen + 3) / 4;
+    if (Segment * 3 > Regen) {
+      return FALSE;
+    }
+    for (Index = 0; Index < 4; Index++) {
+      if (!HufDecodeStream (&Ctx->Huf, Stream, Sizes[Index], Dst,
+                            Index < 3 ? Segment : Regen - 3 * Segment)) {
+        return FALSE;
+      }
+      Stream += Sizes[Index];
+      Dst += Segment;
+    }
+  }
+
+  *Literals = Ctx->Literals;
+  *LitSize = Regen;
+  *Used = Header + TableLen + Comp + (SizeFormat == 0 ? 0 : 6);
+  return TRUE;
+}
+
+/* Sets up one of the three sequence decoding tables according to its
+ * compression mode. *Used is set to the bytes consumed from Src.
+ */
+STATIC BOOLEAN
+ZstdSetupSeqTable (ZSTD_FSE_TABLE *Fse,
+                   UINT32 Mode,
+                   CONST INT16 *DefaultNorm,
+                   UINT32 DefaultLog,
+                   UINT32 MaxSymbol,
+                   UINT32 MaxLog,
+                   CONST UINT8 *Src,
+                   UINTN SrcLen,
+                   UINTN *Used)
+{
+  *Used = 0;
+
+  switch (Mode) {
+  case ZSTD_SEQ_PREDEFINED:
+    return FseBuildTable (Fse, DefaultNorm, MaxSymbol + 1, DefaultLog);
+  case ZSTD_SEQ_RLE:
+    if (SrcLen < 1 ||
+        Src[0] > MaxSymbol) {
+      return FALSE;
+    }
+    FseBuildRle (Fse, Src[0]);
+    *Used = 1;
+    return TRUE;
+  case ZSTD_SEQ_FSE:
+    return FseReadTable (Fse, Src, SrcLen, MaxSymbol, MaxLog, Used);
+  default:
+    return Fse->Valid;
+  }
+}
+
+STATIC inline VOID
+ZstdCopyMatch (UINT8 *Op, UINTN Offset, UINTN Length, UINT8 *OutEnd)
+{
+  CONST UINT8 *Match = Op - Offset;
+  UINT8 *CopyEnd = Op + Length;
+
+  if (Offset >= 16 &&
+      (UINTN)(OutEnd - Op) >= Length + ZSTD_WILDCOPY) {
+    do {
+      ZstdCopy16 (Op, Match);
+      Op += 16;
+      Match += 16;
+    } while (Op < CopyEnd);
+  } else {
+    while (Op < CopyEnd) {
+      *Op++ = *Match++;
+    }
+  }
+}
+
+STATIC BOOLEAN
+ZstdDecodeSequences (ZSTD_CTX *Ctx,
+                     CONST UINT8 *Src,
+                     UINTN SrcLen,
+                     CONST UINT8 *Literals,
+                     UINTN LitSize)
+{
+  CONST UINT8 *LitEnd = Literals + LitSize;
+  ZSTD_BIT_READER Reader;
+  ZSTD_FSE_ENTRY *LlEntry;
+  ZSTD_FSE_ENTRY *OfEntry;
+  ZSTD_FSE_ENTRY *MlEntry;
+  UINT8 *Op = Ctx->Op;
+  UINT8 *OutEnd = Ctx->OutEnd;
+  UINT32 NumSeq;
+  UINT32 Modes;
+  UINT32 LlState;
+  UINT32 OfState;
+  UINT32 MlState;
+  UINT32 LlCode;
+  UINT32 MlCode;
+  UINT32 OfCode;
+  UINTN LitLen;
+  UINTN MatchLen;
+  UINTN Offset;
+  UINTN RepIndex;
+  UINTN Used;
+  UINTN Index;
+
+  if (SrcLen < 1) {
+    return FALSE;
+  }
+  NumSeq = Src[0];
+  if (NumSeq < 128) {
+    Src += 1;
+    SrcLen -= 1;
+  } else if (NumSeq < 255) {
+    if (SrcLen < 2) {
+      return FALSE;
+    }
+    NumSeq = ((NumSeq - 128) << 8) + Src[1];
+    Src += 2;
+    SrcLen -= 2;
+  } else {
+    if (SrcLen < 3) {
+      return FALSE;
+    }
+    NumSeq = ZstdRead16 (Src + 1) + 0x7F00;
+    Src += 3;
+    SrcLen -= 3;
+  }
+
+  if (NumSeq > 0) {
+    if (SrcLen < 1) {
+      return FALSE;
+    }
+    Modes = Src[0];
+    Src++;
+    SrcLen--;
+    if (Modes & 3) {
+      return FALSE;
+    }
+
+    if (!ZstdSetupSeqTable (&Ctx->LlTable, Modes >> 6, LlDefaultNorm, 6,
+                            ZSTD_LL_MAX_SYMBOL, ZSTD_LL_MAX_LOG, Src, SrcLen,
+                            &Used)) {
+      return FALSE;
+    }
+    Src += Used;
+    SrcLen -= Used;
+    if (!ZstdSetupSeqTable (&Ctx->OfTable, (Modes >> 4) & 3, OfDefaultNorm, 5,
+                            ZSTD_OF_MAX_SYMBOL, ZSTD_OF_MAX_LOG,
+                            Src, SrcLen, &Used)) {
+      return FALSE;
+    }
+    Src += Used;
+    SrcLen -= Used;
+    if (!ZstdSetupSeqTable (&Ctx->MlTable, (Modes >> 2) & 3, MlDefaultNorm, 6,
+                            ZSTD_ML_MAX_SYMBOL, ZSTD_ML_MAX_LOG, Src, SrcLen,
+                            &Used)) {
+      return FALSE;
+    }
+    Src += Used;
+    SrcLen -= Used;
+
+    if (!BitInit (&Reader, Src, SrcLen)) {
+      return FALSE;
+    }
+    LlState = BitRead (&Reader, Ctx->LlTable.AccuracyLog);
+    OfState = BitRead (&Reader, Ctx->OfTable.AccuracyLog);
+    MlState = BitRead (&Reader, Ctx->MlTable.AccuracyLog);
+    BitReload (&Reader);
+
+    for (Index = 0; Index < NumSeq; Index++) {
+      LlEntry = &Ctx->LlTable.Table[LlState];
+      OfEntry = &Ctx->OfTable.Table[OfState];
+      MlEntry = &Ctx->MlTable.Table[MlState];
+      LlCode = LlEntry->Symbol;
+      MlCode = MlEntry->Symbol;
+      OfCode = OfEntry->Symbol;
+      if (OfCode > ZSTD_OF_MAX_SYMBOL) {
+        return FALSE;
+      }
+
+      /* Extra bits come in offset, match length, literal length order.
+       * Most sequences fit in one container, so reload only when needed.
+       */
+      BitEnsure (&Reader, OfCode);
+      Offset = ((UINTN)1 << OfCode) + BitRead (&Reader, OfCode);
+      BitEnsure (&Reader, MlBits[MlCode] + LlBits[LlCode]);
+      MatchLen = MlBase[MlCode] + BitRead (&Reader, MlBits[MlCode]);
+      LitLen = LlBase[LlCode] + BitRead (&Reader, LlBits[LlCode]);
+
+      if (Offset > 3) {
+        Offset -= 3;
+        Ctx->RepOffsets[2] = Ctx->RepOffsets[1];
+        Ctx->RepOffsets[1] = Ctx->RepOffsets[0];
+        Ctx->RepOffsets[0] = Offset;
+      } else {
+        /* Repeat offsets, shifted by one when there are no literals */
+        RepIndex = Offset - 1 + (LitLen == 0);
+        if (RepIndex == 0) {
+          Offset = Ctx->RepOffsets[0];
+        } else {
+          Offset = (RepIndex == 3) ? Ctx->RepOffsets[0] - 1 :
+                                     Ctx->RepOffsets[RepIndex];
+          if (Offset == 0) {
+            return FALSE;
+          }
+          if (RepIndex > 1) {
+            Ctx->RepOffsets[2] = Ctx->RepOffsets[1];
+          }
+          Ctx->RepOffsets[1] = Ctx->RepOffsets[0];
+          Ctx->RepOffsets[0] = Offset;
+        }
+      }
+
+      if (Index + 1 < NumSeq) {
+        BitEnsure (&Reader, LlEntry->NumBits + MlEntry->NumBits +
+                                OfEntry->NumBits);
+        LlState = LlEntry->NewState + BitRead (&Reader, LlEntry->NumBits);
+        MlState = MlEntry->NewState + BitRead (&Reader, MlEntry->NumBits);
+        OfState = OfEntry->NewState + BitRead (&Reader, OfEntry->NumBits);
+      }
+
+      if (LitLen > (UINTN)(LitEnd - Literals) ||
+          LitLen + MatchLen > (UINTN)(OutEnd - Op)) {
+        return FALSE;
+      }
+      if (LitLen <= ZSTD_WILDCOPY &&
+          (UINTN)(LitEnd - Literals) >= ZSTD_WILDCOPY &&
+          (UINTN)(OutEnd - Op) >= ZSTD_WILDCOPY) {
+        ZstdCopy16 (Op, Literals);
+      } else {
+        CopyMem (Op, Literals, LitLen);
+      }
+      Op += LitLen;
+      Literals += LitLen;
+
+      if (Offset > (UINTN)(Op - Ctx->OutStart)) {
+        return FALSE;
+      }
+      ZstdCopyMatch (Op, Offset, MatchLen, OutEnd);
+      Op += MatchLen;
+    }
+
+    if (!BitFinished (&Reader)) {
+      return FALSE;
+    }
+  }
+
+  /* Literals left after the last sequence */
+  LitSize = LitEnd - Literals;
+  if (LitSize > (UINTN)(OutEnd - Op)) {
+    return FALSE;
+  }
+  CopyMem (Op, Literals, LitSize);
+  Ctx->Op = Op + LitSize;
+  return TRUE;
+}
+
+STATIC BOOLEAN
+ZstdDecodeBlock (ZSTD_CTX *Ctx, CONST UINT8 *Src, UINTN SrcLen)
+{
+  CONST UINT8 *Literals;
+  UINTN LitSize;
+  UINTN Used;
+
+  if (SrcLen < 1 ||
+      !ZstdDecodeLiterals (Ctx, Src, SrcLen, &Literals, &LitSize, &Used)) {
+    return FALSE;
+  }
+  return ZstdDecodeSequences (Ctx, Src + Used, SrcLen - Used, Literals,
+                              LitSize);
+}
+
+/* Decodes one frame at In. *Used is set to the size of the frame. */
+STATIC BOOLEAN
+ZstdDecodeFrame (ZSTD_CTX *Ctx, CONST UINT8 *In, UINTN InLen, UINTN *Used)
+{
+  CONST UINT8 *Ip = In + sizeof (UINT32);
+  CONST UINT8 *IpEnd = In + InLen;
+  UINT64 ContentSize = 0;
+  BOOLEAN HasContentSize;
+  UINT32 Descriptor;
+  UINT32 FcsFlag;
+  UINT32 SingleSegment;
+  UINT32 DictIdLen;
+  UINT32 FcsLen;
+  UINT32 BlockHeader;
+  UINT32 BlockSize;
+  UINT32 BlockType;
+  BOOLEAN LastBlock;
+  UINTN Index;
+
+  STATIC CONST UINT8 DictIdLens[4] = {0, 1, 2, 4};
+  STATIC CONST UINT8 FcsLens[4] = {0, 2, 4, 8};
+
+  if (Ip >= IpEnd) {
+    return FALSE;
+  }
+  Descriptor = *Ip++;
+  FcsFlag = Descriptor >> 6;
+  SingleSegment = (Descriptor >> 5) & 1;
+  DictIdLen = DictIdLens[Descriptor & 3];
+  FcsLen = FcsLens[FcsFlag];
+  if (FcsFlag == 0 &&
+      SingleSegment) {
+    FcsLen = 1;
+  }
+  HasContentSize = FcsLen != 0;
+  if (Descriptor & BIT3) {
+    return FALSE;
+  }
+
+  if ((UINTN)(IpEnd - Ip) < !SingleSegment + DictIdLen + FcsLen) {
+    return FALSE;
+  }
+  /* The window descriptor is not needed for a flat output buffer */
+  Ip += !SingleSegment;
+  for (Index = 0; Index < DictIdLen; Index++) {
+    if (Ip[Index]) {
+      DEBUG ((EFI_D_ERROR, "zstd: dictionaries are not supported\n"));
+      return FALSE;
+    }
+  }
+  Ip += DictIdLen;
+  for (Index = 0; Index < FcsLen; Index++) {
+    ContentSize |= (UINT64)Ip[Index] << (Index * 8);
+  }
+  if (FcsLen == 2) {
+    ContentSize += 256;
+  }
+  Ip += FcsLen;
+  if (HasContentSize &&
+      ContentSize > (UINT64)(Ctx->OutEnd - Ctx->Op)) {
+    DEBUG ((EFI_D_ERROR, "zstd: output buffer too small, need %llu\n",
+            ContentSize));
+    return FALSE;
+  }
+
+  Ctx->OutStart = Ctx->Op;
+  Ctx->RepOffsets[0] = 1;
+  Ctx->RepOffsets[1] = 4;
+  Ctx->RepOffsets[2] = 8;
+  Ctx->Huf.Valid = FALSE;
+  Ctx->LlTable.Valid = FALSE;
+  Ctx->OfTable.Valid = FALSE;
+  Ctx->MlTable.Valid = FALSE;
+
+  do {
+    if (IpEnd - Ip < 3) {
+      return FALSE;
+    }
+    BlockHeader = ZstdRead24 (Ip);
+    Ip += 3;
+    LastBlock = BlockHeader & 1;
+    BlockType = (BlockHeader >> 1) & 3;
+    BlockSize = BlockHeader >> 3;
+
+    switch (BlockType) {
+    case ZSTD_BLOCK_RAW:
+      if (BlockSize > (UINTN)(IpEnd - Ip) ||
+          BlockSize > (UINTN)(Ctx->OutEnd - Ctx->Op)) {
+        return FALSE;
+      }
+      CopyMem (Ctx->Op, Ip, BlockSize);
+      Ctx->Op += BlockSize;
+      Ip += BlockSize;
+      break;
+    case ZSTD_BLOCK_RLE:
+      if (Ip >= IpEnd ||
+          BlockSize > (UINTN)(Ctx->OutEnd - Ctx->Op)) {
+        return FALSE;
+      }
+      SetMem (Ctx->Op, BlockSize, *Ip);
+      Ctx->Op += BlockSize;
+      Ip++;
+      break;
+    case ZSTD_BLOCK_COMPRESSED:
+      if (BlockSize > ZSTD_BLOCK_SIZE_MAX ||
+          BlockSize > (UINTN)(IpEnd - Ip) ||
+          !ZstdDecodeBlock (Ctx, Ip, BlockSize)) {
+        DEBUG ((EFI_D_ERROR, "zstd: corrupt block at offset %u\n",
+                (UINT32)(Ip - In)));
+        return FALSE;
+      }
+      Ip += BlockSize;
+      break;
+    default:
+      return FALSE;
+    }
+  } while (!LastBlock);
+
+  /* Content checksum */
+  if (Descriptor & BIT2) {
+    if ((UINTN)(IpEnd - Ip) < sizeof (UINT32)) {
+      return FALSE;
+    }
+    Ip += sizeof (UINT32);
+  }
+
+  if (HasContentSize &&
+      ContentSize != (UINT64)(Ctx->Op - Ctx->OutStart)) {
+    DEBUG ((EFI_D_ERROR, "zstd: frame content size mismatch\n"));
+    return FALSE;
+  }
+
+  *Used = Ip - In;
+  return TRUE;
+}
+
+/* Decompress the zstd data in in_buf, same contract as decompress ():
+ * pos - offset of the first byte after the last zstd or skippable frame and
+ *       the size trailer kbuild appends, if any
+ * out_len - the length of decompressed data
+ * Returns 0 on success, -1 on failure.
+ */
+int
+zstd_decompress (unsigned char *in_buf,
+                 unsigned int in_len,
+                 unsigned char *out_buf,
+                 unsigned int out_buf_len,
+                 unsigned int *pos,
+                 unsigned int *out_len)
+{
+  ZSTD_CTX *Ctx;
+  UINTN Offset = 0;
+  UINTN Used;
+  UINT32 Magic;
+  int rc = -1;
+
+  if (!is_zstd_package (in_buf, in_len)) {
+    DEBUG ((EFI_D_ERROR, "the input data is not a zstd package.\n"));
+    return rc;
+  }
+
+  Ctx = AllocatePool (sizeof (*Ctx));
+  if (Ctx == NULL) {
+    DEBUG ((EFI_D_ERROR, "allocating zstd context failed.\n"));
+    return rc;
+  }
+  Ctx->Op = out_buf;
+  Ctx->OutEnd = out_buf + out_buf_len;
+
+  /* Concatenated frames are decoded back to back; anything else ends the
+   * stream, e.g. an appended DTB.
+   */
+  while (in_len - Offset >= sizeof (UINT32)) {
+    Magic = ZstdRead32 (in_buf + Offset);
+    /* kbuild's size_append: the decompressed size, little endian */
+    if (Ctx->Op != out_buf &&
+        Magic == (UINT32)(Ctx->Op - out_buf)) {
+      Offset += sizeof (UINT32);
+      break;
+    }
+    if ((Magic & ZSTD_SKIPPABLE_MASK) == ZSTD_SKIPPABLE_MAGIC) {
+      if (in_len - Offset < 2 * sizeof (UINT32) ||
+          ZstdRead32 (in_buf + Offset + 4) >
+              in_len - Offset - 2 * sizeof (UINT32)) {
+        goto out;
+      }
+      Offset += 2 * sizeof (UINT32) + ZstdRead32 (in_buf + Offset + 4);
+      continue;
+    }
+    if (Magic != ZSTD_MAGIC) {
+      break;
+    }
+    if (!ZstdDecodeFrame (Ctx, in_buf + Offset, in_len - Offset, &Used)) {
+      goto out;
+    }
+    Offset += Used;
+  }
+
+  if (pos) {
+    *pos = Offset;
+  }
+  if (out_len) {
+    *out_len = Ctx->Op - out_buf;
+  }
+  rc = 0;
+
+out:
+  FreePool (Ctx);
+  return rc;
+}
+
+/* Return true if "buf" starts with a zstd frame */
+int
+is_zstd_package (unsigned char *buf, unsigned int len)
+{
+  if (!buf || len < 8) {
+    return FALSE;
+  }
+
+  return ZstdRead32 (buf) == ZSTD_MAGIC;
+}